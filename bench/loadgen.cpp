@@ -0,0 +1,755 @@
+// HTTP 压测工具：多线程，每个线程一个 epoll 管理自己的连接。
+// 闭环模式：每个连接收到响应后立即发送下一个请求（测最大吞吐）；
+// 开环模式（-R）：按固定总速率发送，延迟从计划发送时间算起，校正 coordinated omission——
+// 服务器变慢时排队等待发送的时间也计入延迟，而不是随着发送变慢一起被“隐藏”。
+//
+// 用法：./loadgen [选项] [host:]port
+//   -c 连接数（默认 64）          -t 线程数（默认 4）         -d 持续秒数（默认 10）
+//   -w 预热秒数（默认 1，不计入结果） -R 总速率 请求/秒（默认 0：闭环）
+//   -p 流水线深度（默认 1）       -k 0|1 是否 keep-alive（默认 1）
+//   -r 权重:方法:路径[:请求体字节数]  请求组合，可重复，按权重随机选择（默认 1:GET:/index.html）
+//   -n 场景名                     -o 结果追加写入的文件（每个场景一行，便于与基线对比）
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 延迟直方图（HDR 风格的对数-线性分桶，单位微秒）：
+// 小于 HIST_SUB_COUNT 的值精确记录，之后每个2的幂区间分为 HIST_SUB_COUNT/2 个桶，相对误差约0.2%
+#define HIST_SUB_BITS 10
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_HALF_COUNT (HIST_SUB_COUNT / 2)
+#define HIST_MAX_SHIFT 28
+#define HIST_SIZE (HIST_SUB_COUNT + HIST_MAX_SHIFT * HIST_HALF_COUNT)
+
+// 每个连接一次读取的缓冲区大小
+#define READ_CHUNK 65536
+#define MAX_EVENTS 256
+
+class LatencyHistogram {
+public:
+    LatencyHistogram() : counts_(HIST_SIZE, 0), total_(0), sum_(0), max_(0) {}
+
+    void record(uint64_t value_us) {
+        counts_[index_of(value_us)]++;
+        total_++;
+        sum_ += value_us;
+        max_ = std::max(max_, value_us);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t i = 0; i < HIST_SIZE; ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+        sum_ += other.sum_;
+        max_ = std::max(max_, other.max_);
+    }
+
+    // 百分位数（0-100），返回该桶能表示的最大值
+    uint64_t percentile(double p) const {
+        if (total_ == 0) {
+            return 0;
+        }
+        uint64_t target = static_cast<uint64_t>(p / 100.0 * total_ + 0.5);
+        target = std::max<uint64_t>(target, 1);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < HIST_SIZE; ++i) {
+            seen += counts_[i];
+            if (seen >= target) {
+                return std::min(highest_equivalent(i), max_);
+            }
+        }
+        return max_;
+    }
+
+    uint64_t count() const { return total_; }
+    uint64_t max() const { return max_; }
+    double mean() const { return total_ ? static_cast<double>(sum_) / total_ : 0; }
+
+private:
+    static size_t index_of(uint64_t value) {
+        if (value < HIST_SUB_COUNT) {
+            return static_cast<size_t>(value);
+        }
+        int msb = 63 - __builtin_clzll(value);
+        int shift = std::min(msb - (HIST_SUB_BITS - 1), HIST_MAX_SHIFT);
+        uint64_t sub = std::min<uint64_t>(value >> shift, HIST_SUB_COUNT - 1);
+        return HIST_SUB_COUNT + (shift - 1) * HIST_HALF_COUNT + (sub - HIST_HALF_COUNT);
+    }
+
+    static uint64_t highest_equivalent(size_t index) {
+        if (index < HIST_SUB_COUNT) {
+            return index;
+        }
+        size_t k = index - HIST_SUB_COUNT;
+        int shift = static_cast<int>(k / HIST_HALF_COUNT) + 1;
+        uint64_t sub = k % HIST_HALF_COUNT + HIST_HALF_COUNT;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    std::vector<uint64_t> counts_;
+    uint64_t total_;
+    uint64_t sum_;
+    uint64_t max_;
+};
+
+// 请求组合中的一项
+struct RequestSpec {
+    unsigned weight;
+    std::string method;
+    std::string path;
+    size_t body_size;
+    std::string wire;   // 预先生成的完整请求
+};
+
+struct Options {
+    struct sockaddr_in addr;
+    int connections = 64;
+    int threads = 4;
+    double duration_s = 10;
+    double warmup_s = 1;
+    double rate = 0;
+    int pipeline = 1;
+    bool keep_alive = true;
+    std::vector<RequestSpec> mix;
+    unsigned total_weight = 0;
+    std::string name = "default";
+    std::string output;
+};
+
+static int64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// 响应解析状态
+enum ResponseState {
+    RESP_HEADER,    // 等待完整的响应头
+    RESP_BODY,      // 按 Content-Length 读取（丢弃）响应体
+    RESP_CHUNKED,   // chunked 响应体，缓冲后解析
+    RESP_UNTIL_EOF  // 没有长度信息，读到连接关闭
+};
+
+struct Conn {
+    int fd = -1;
+    bool connecting = false;
+    std::string out;
+    size_t out_off = 0;
+    std::string in;
+    size_t in_off = 0;
+    ResponseState state = RESP_HEADER;
+    uint64_t body_remaining = 0;
+    int status = 0;
+    bool server_close = false;
+    std::deque<int64_t> inflight;   // 已发送请求的开始时间（开环为计划时间）
+    std::deque<int64_t> backlog;    // 开环：已到计划时间但还未发送的请求
+    int64_t next_send_ns = 0;
+    bool want_write = false;
+};
+
+struct ThreadStats {
+    LatencyHistogram latency;
+    uint64_t completed = 0;
+    uint64_t errors = 0;          // 连接/读写/解析错误
+    uint64_t bad_status = 0;      // 非 2xx/3xx
+    uint64_t bytes = 0;
+};
+
+class Worker {
+public:
+    Worker(const Options& options, int index, int conn_count, int64_t start_ns)
+        : opt_(options), conns_(conn_count), rng_(static_cast<uint32_t>(index * 2654435761u + 7)),
+          measure_from_ns_(start_ns + static_cast<int64_t>(options.warmup_s * 1e9)),
+          end_ns_(measure_from_ns_ + static_cast<int64_t>(options.duration_s * 1e9)) {
+        if (opt_.rate > 0) {
+            // 总速率平均分给所有连接，各连接的起始时间错开，避免同时发出
+            interval_ns_ = static_cast<int64_t>(1e9 * opt_.connections / opt_.rate);
+            for (size_t i = 0; i < conns_.size(); ++i) {
+                conns_[i].next_send_ns = start_ns + interval_ns_ * (index + i * opt_.threads) /
+                                                        opt_.connections;
+            }
+        }
+    }
+
+    void run();
+    const ThreadStats& stats() const { return stats_; }
+
+private:
+    void open_conn(Conn& c);
+    void close_conn(Conn& c);
+    void fail(Conn& c);
+    void update_events(Conn& c);
+    void fill(Conn& c, int64_t now);
+    void queue_request(Conn& c, int64_t start);
+    bool flush(Conn& c);
+    void on_readable(Conn& c);
+    bool parse(Conn& c);
+    void complete(Conn& c);
+    const RequestSpec& pick();
+
+    const Options& opt_;
+    std::vector<Conn> conns_;
+    ThreadStats stats_;
+    int epoll_fd_ = -1;
+    uint32_t rng_;
+    int64_t interval_ns_ = 0;
+    int64_t measure_from_ns_;
+    int64_t end_ns_;
+};
+
+const RequestSpec& Worker::pick() {
+    if (opt_.mix.size() == 1) {
+        return opt_.mix[0];
+    }
+    rng_ ^= rng_ << 13;
+    rng_ ^= rng_ >> 17;
+    rng_ ^= rng_ << 5;
+    unsigned r = rng_ % opt_.total_weight;
+    for (const RequestSpec& spec : opt_.mix) {
+        if (r < spec.weight) {
+            return spec;
+        }
+        r -= spec.weight;
+    }
+    return opt_.mix.back();
+}
+
+void Worker::open_conn(Conn& c) {
+    c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (c.fd == -1) {
+        stats_.errors++;
+        return;
+    }
+    int one = 1;
+    setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    c.out.clear();
+    c.out_off = 0;
+    c.in.clear();
+    c.in_off = 0;
+    c.state = RESP_HEADER;
+    c.server_close = false;
+    c.inflight.clear();
+    if (connect(c.fd, reinterpret_cast<const struct sockaddr*>(&opt_.addr), sizeof(opt_.addr)) == -1 &&
+        errno != EINPROGRESS) {
+        stats_.errors++;
+        close(c.fd);
+        c.fd = -1;
+        return;
+    }
+    c.connecting = true;
+    c.want_write = true;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLOUT;
+    ev.data.ptr = &c;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, c.fd, &ev);
+}
+
+void Worker::close_conn(Conn& c) {
+    if (c.fd != -1) {
+        close(c.fd);
+        c.fd = -1;
+    }
+    // 开环模式下未完成的请求放回队列，重连后重新发送，延迟仍从计划时间算起
+    if (opt_.rate > 0) {
+        while (!c.inflight.empty()) {
+            c.backlog.push_front(c.inflight.back());
+            c.inflight.pop_back();
+        }
+    }
+    c.inflight.clear();
+}
+
+void Worker::fail(Conn& c) {
+    if (now_ns() < end_ns_) {
+        stats_.errors++;
+    }
+    close_conn(c);
+    open_conn(c);
+}
+
+void Worker::update_events(Conn& c) {
+    bool want = c.connecting || c.out_off < c.out.size();
+    if (want == c.want_write || c.fd == -1) {
+        return;
+    }
+    c.want_write = want;
+    struct epoll_event ev;
+    ev.events = EPOLLIN | (want ? EPOLLOUT : 0);
+    ev.data.ptr = &c;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, c.fd, &ev);
+}
+
+void Worker::queue_request(Conn& c, int64_t start) {
+    if (c.out_off == c.out.size()) {
+        c.out.clear();
+        c.out_off = 0;
+    }
+    c.out += pick().wire;
+    c.inflight.push_back(start);
+}
+
+// 在流水线深度允许的范围内排入请求
+void Worker::fill(Conn& c, int64_t now) {
+    if (opt_.rate > 0) {
+        // 到达计划时间的请求先进入队列，连接暂时不可用（重连中、流水线已满）时在队列中等待
+        while (c.next_send_ns <= now && c.next_send_ns < end_ns_) {
+            c.backlog.push_back(c.next_send_ns);
+            c.next_send_ns += interval_ns_;
+        }
+    }
+    if (c.fd == -1 || c.connecting || c.server_close) {
+        return;
+    }
+    // 非 keep-alive 时每个连接只发一个请求
+    size_t depth = opt_.keep_alive ? static_cast<size_t>(opt_.pipeline) : 1;
+    if (!opt_.keep_alive && (c.inflight.size() > 0 || c.state != RESP_HEADER || c.in_off > 0)) {
+        return;
+    }
+    if (opt_.rate > 0) {
+        while (c.inflight.size() < depth && !c.backlog.empty()) {
+            queue_request(c, c.backlog.front());
+            c.backlog.pop_front();
+        }
+    } else {
+        while (c.inflight.size() < depth) {
+            queue_request(c, now);
+        }
+    }
+}
+
+bool Worker::flush(Conn& c) {
+    while (c.out_off < c.out.size()) {
+        ssize_t n = send(c.fd, c.out.data() + c.out_off, c.out.size() - c.out_off, MSG_NOSIGNAL);
+        if (n > 0) {
+            c.out_off += static_cast<size_t>(n);
+        } else if (n == -1 && errno == EAGAIN) {
+            break;
+        } else if (n == -1 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    update_events(c);
+    return true;
+}
+
+void Worker::complete(Conn& c) {
+    int64_t now = now_ns();
+    int64_t start = c.inflight.empty() ? now : c.inflight.front();
+    if (!c.inflight.empty()) {
+        c.inflight.pop_front();
+    }
+    // 只统计测量窗口内计划发送的请求
+    if (start >= measure_from_ns_ && start < end_ns_) {
+        stats_.completed++;
+        stats_.latency.record(static_cast<uint64_t>((now - start) / 1000));
+        if (c.status < 200 || c.status >= 400) {
+            stats_.bad_status++;
+        }
+    }
+    c.state = RESP_HEADER;
+}
+
+// 解析缓冲区中的响应，返回 false 表示出错
+bool Worker::parse(Conn& c) {
+    while (true) {
+        if (c.state == RESP_HEADER) {
+            size_t end = c.in.find("\r\n\r\n", c.in_off);
+            if (end == std::string::npos) {
+                return true;
+            }
+            const char* head = c.in.data() + c.in_off;
+            size_t head_len = end + 4 - c.in_off;
+            if (head_len < 12 || strncmp(head, "HTTP/1.", 7) != 0) {
+                return false;
+            }
+            c.status = atoi(head + 9);
+            // 查找需要的响应头（大小写不敏感）
+            long long content_length = -1;
+            bool chunked = false;
+            size_t pos = c.in_off;
+            while (pos < end) {
+                size_t line_end = c.in.find("\r\n", pos);
+                const char* line = c.in.data() + pos;
+                size_t len = line_end - pos;
+                if (len > 15 && strncasecmp(line, "content-length:", 15) == 0) {
+                    content_length = atoll(line + 15);
+                } else if (len > 18 && strncasecmp(line, "transfer-encoding:", 18) == 0) {
+                    chunked = memmem(line, len, "chunked", 7) != nullptr;
+                } else if (len > 11 && strncasecmp(line, "connection:", 11) == 0) {
+                    c.server_close = memmem(line, len, "close", 5) != nullptr;
+                }
+                pos = line_end + 2;
+            }
+            c.in_off = end + 4;
+            if (c.status == 204 || c.status == 304 || (c.status >= 100 && c.status < 200)) {
+                complete(c);
+            } else if (chunked) {
+                c.state = RESP_CHUNKED;
+            } else if (content_length >= 0) {
+                c.state = RESP_BODY;
+                c.body_remaining = static_cast<uint64_t>(content_length);
+            } else {
+                c.state = RESP_UNTIL_EOF;
+                return true;
+            }
+        }
+        if (c.state == RESP_BODY) {
+            size_t available = c.in.size() - c.in_off;
+            size_t take = static_cast<size_t>(std::min<uint64_t>(available, c.body_remaining));
+            c.in_off += take;
+            c.body_remaining -= take;
+            if (c.body_remaining > 0) {
+                return true;
+            }
+            complete(c);
+        } else if (c.state == RESP_CHUNKED) {
+            // 逐块跳过：块大小行 + 数据 + CRLF，大小为0的块之后是（可能为空的）trailer
+            size_t pos = c.in_off;
+            bool done = false;
+            while (true) {
+                size_t line_end = c.in.find("\r\n", pos);
+                if (line_end == std::string::npos) {
+                    break;
+                }
+                unsigned long long size = strtoull(c.in.c_str() + pos, nullptr, 16);
+                if (size == 0) {
+                    size_t trailer_end = c.in.find("\r\n\r\n", line_end);
+                    if (trailer_end == std::string::npos) {
+                        break;
+                    }
+                    pos = trailer_end + 4;
+                    done = true;
+                    break;
+                }
+                if (c.in.size() < line_end + 2 + size + 2) {
+                    break;
+                }
+                pos = line_end + 2 + size + 2;
+                c.in_off = pos;
+            }
+            if (!done) {
+                return true;
+            }
+            c.in_off = pos;
+            complete(c);
+        } else if (c.state == RESP_UNTIL_EOF) {
+            c.in_off = c.in.size();
+            return true;
+        }
+        if (c.server_close) {
+            return true;
+        }
+    }
+}
+
+void Worker::on_readable(Conn& c) {
+    char buf[READ_CHUNK];
+    while (true) {
+        ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            if (now_ns() >= measure_from_ns_) {
+                stats_.bytes += static_cast<uint64_t>(n);
+            }
+            if (c.state == RESP_BODY && c.in_off == c.in.size()) {
+                // 大响应体直接丢弃，不进入缓冲区
+                uint64_t take = std::min<uint64_t>(static_cast<uint64_t>(n), c.body_remaining);
+                c.body_remaining -= take;
+                c.in.assign(buf + take, static_cast<size_t>(n) - take);
+                c.in_off = 0;
+                if (c.body_remaining == 0) {
+                    complete(c);
+                }
+            } else {
+                c.in.append(buf, static_cast<size_t>(n));
+            }
+            if (!parse(c)) {
+                fail(c);
+                return;
+            }
+            if (c.in_off > 0 && c.in_off * 2 >= c.in.size()) {
+                c.in.erase(0, c.in_off);
+                c.in_off = 0;
+            }
+            if (static_cast<size_t>(n) < sizeof(buf)) {
+                break;
+            }
+        } else if (n == 0) {
+            if (c.state == RESP_UNTIL_EOF) {
+                complete(c);
+            }
+            // 服务器按约定关闭（非 keep-alive 或响应带 Connection: close）时重连，否则计为错误
+            bool expected = c.inflight.empty() && (c.server_close || !opt_.keep_alive);
+            if (expected) {
+                close_conn(c);
+                open_conn(c);
+            } else {
+                fail(c);
+            }
+            return;
+        } else if (errno == EAGAIN) {
+            break;
+        } else if (errno != EINTR) {
+            fail(c);
+            return;
+        }
+    }
+    if (c.server_close && c.inflight.empty()) {
+        close_conn(c);
+        open_conn(c);
+    }
+}
+
+void Worker::run() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    for (Conn& c : conns_) {
+        open_conn(c);
+    }
+    std::vector<struct epoll_event> events(MAX_EVENTS);
+    while (true) {
+        int64_t now = now_ns();
+        if (now >= end_ns_) {
+            break;
+        }
+        for (Conn& c : conns_) {
+            if (c.fd == -1) {
+                open_conn(c);
+            }
+            fill(c, now);
+            if (c.fd != -1 && !c.connecting && !flush(c)) {
+                fail(c);
+            }
+        }
+
+        // 开环：最多等到下一个计划发送时间
+        int timeout_ms = 100;
+        if (opt_.rate > 0) {
+            int64_t next = end_ns_;
+            for (const Conn& c : conns_) {
+                next = std::min(next, c.next_send_ns);
+            }
+            timeout_ms = static_cast<int>(std::max<int64_t>(0, (next - now + 999999) / 1000000));
+            timeout_ms = std::min(timeout_ms, 100);
+        }
+        int n = epoll_wait(epoll_fd_, events.data(), MAX_EVENTS, timeout_ms);
+        for (int i = 0; i < n; ++i) {
+            Conn& c = *static_cast<Conn*>(events[i].data.ptr);
+            if (c.fd == -1) {
+                continue;
+            }
+            if (c.connecting && (events[i].events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+                int err = 0;
+                socklen_t len = sizeof(err);
+                getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+                if (err != 0) {
+                    fail(c);
+                    continue;
+                }
+                c.connecting = false;
+                fill(c, now_ns());
+                if (!flush(c)) {
+                    fail(c);
+                }
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                on_readable(c);
+                if (c.fd == -1 || c.connecting) {
+                    continue;
+                }
+            }
+            if (events[i].events & EPOLLOUT) {
+                if (!flush(c)) {
+                    fail(c);
+                }
+            }
+        }
+    }
+    for (Conn& c : conns_) {
+        if (c.fd != -1) {
+            close(c.fd);
+        }
+    }
+    close(epoll_fd_);
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "用法：%s [-c 连接数] [-t 线程数] [-d 秒] [-w 预热秒] [-R 请求/秒] [-p 流水线深度]\n"
+            "          [-k 0|1] [-r 权重:方法:路径[:请求体字节数]]... [-n 场景名] [-o 结果文件] [host:]port\n",
+            prog);
+    exit(EXIT_FAILURE);
+}
+
+static bool parse_spec(const char* arg, RequestSpec* spec) {
+    std::string text(arg);
+    std::vector<std::string> parts;
+    size_t pos = 0;
+    while (true) {
+        size_t colon = text.find(':', pos);
+        parts.push_back(text.substr(pos, colon == std::string::npos ? std::string::npos : colon - pos));
+        if (colon == std::string::npos) {
+            break;
+        }
+        pos = colon + 1;
+    }
+    if (parts.size() < 3 || parts.size() > 4 || parts[2].empty() || parts[2][0] != '/') {
+        return false;
+    }
+    spec->weight = static_cast<unsigned>(atoi(parts[0].c_str()));
+    spec->method = parts[1];
+    spec->path = parts[2];
+    spec->body_size = parts.size() == 4 ? static_cast<size_t>(atol(parts[3].c_str())) : 0;
+    return spec->weight > 0 && !spec->method.empty();
+}
+
+int main(int argc, char* argv[]) {
+    Options opt;
+    int ch;
+    while ((ch = getopt(argc, argv, "c:t:d:w:R:p:k:r:n:o:")) != -1) {
+        switch (ch) {
+        case 'c': opt.connections = atoi(optarg); break;
+        case 't': opt.threads = atoi(optarg); break;
+        case 'd': opt.duration_s = atof(optarg); break;
+        case 'w': opt.warmup_s = atof(optarg); break;
+        case 'R': opt.rate = atof(optarg); break;
+        case 'p': opt.pipeline = atoi(optarg); break;
+        case 'k': opt.keep_alive = atoi(optarg) != 0; break;
+        case 'r': {
+            RequestSpec spec;
+            if (!parse_spec(optarg, &spec)) {
+                fprintf(stderr, "无效的请求组合：%s\n", optarg);
+                usage(argv[0]);
+            }
+            opt.mix.push_back(spec);
+            break;
+        }
+        case 'n': opt.name = optarg; break;
+        case 'o': opt.output = optarg; break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || opt.connections < 1 || opt.threads < 1 || opt.pipeline < 1 ||
+        opt.duration_s <= 0) {
+        usage(argv[0]);
+    }
+    opt.threads = std::min(opt.threads, opt.connections);
+
+    std::string target(argv[optind]);
+    std::string host = "127.0.0.1";
+    size_t colon = target.rfind(':');
+    if (colon != std::string::npos) {
+        host = target.substr(0, colon);
+        target = target.substr(colon + 1);
+    }
+    memset(&opt.addr, 0, sizeof(opt.addr));
+    opt.addr.sin_family = AF_INET;
+    opt.addr.sin_port = htons(static_cast<uint16_t>(atoi(target.c_str())));
+    if (inet_pton(AF_INET, host.c_str(), &opt.addr.sin_addr) != 1) {
+        fprintf(stderr, "无效的地址：%s\n", host.c_str());
+        return EXIT_FAILURE;
+    }
+
+    if (opt.mix.empty()) {
+        RequestSpec spec;
+        parse_spec("1:GET:/index.html", &spec);
+        opt.mix.push_back(spec);
+    }
+    for (RequestSpec& spec : opt.mix) {
+        spec.wire = spec.method + " " + spec.path + " HTTP/1.1\r\nHost: " + host + "\r\n";
+        if (!opt.keep_alive) {
+            spec.wire += "Connection: close\r\n";
+        }
+        if (spec.body_size > 0 || spec.method == "POST") {
+            spec.wire += "Content-Length: " + std::to_string(spec.body_size) + "\r\n";
+        }
+        spec.wire += "\r\n";
+        spec.wire.append(spec.body_size, 'x');
+        opt.total_weight += spec.weight;
+    }
+
+    int64_t start = now_ns();
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < opt.threads; ++i) {
+        int count = opt.connections / opt.threads + (i < opt.connections % opt.threads ? 1 : 0);
+        workers.emplace_back(new Worker(opt, i, count, start));
+    }
+    for (int i = 0; i < opt.threads; ++i) {
+        threads.emplace_back(&Worker::run, workers[i].get());
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+
+    ThreadStats total;
+    for (const auto& w : workers) {
+        const ThreadStats& s = w->stats();
+        total.latency.merge(s.latency);
+        total.completed += s.completed;
+        total.errors += s.errors;
+        total.bad_status += s.bad_status;
+        total.bytes += s.bytes;
+    }
+    double rps = total.completed / opt.duration_s;
+    double mbps = total.bytes / opt.duration_s / (1024 * 1024);
+    const LatencyHistogram& h = total.latency;
+
+    printf("场景：%s\n", opt.name.c_str());
+    if (opt.rate > 0) {
+        printf("模式：开环 %.0f 请求/秒（延迟从计划发送时间算起，已校正 coordinated omission）\n", opt.rate);
+    } else {
+        printf("模式：闭环（延迟从实际发送时间算起，未校正 coordinated omission）\n");
+    }
+    printf("连接 %d  线程 %d  流水线 %d  keep-alive %s  时长 %.1fs（预热 %.1fs）\n", opt.connections,
+           opt.threads, opt.pipeline, opt.keep_alive ? "开" : "关", opt.duration_s, opt.warmup_s);
+    printf("完成 %llu 个请求  吞吐 %.1f 请求/秒  %.2f MB/s  错误 %llu  非2xx/3xx %llu\n",
+           static_cast<unsigned long long>(total.completed), rps, mbps,
+           static_cast<unsigned long long>(total.errors),
+           static_cast<unsigned long long>(total.bad_status));
+    printf("延迟(us)  平均 %.0f  p50 %llu  p90 %llu  p99 %llu  p99.9 %llu  p99.99 %llu  最大 %llu\n",
+           h.mean(), static_cast<unsigned long long>(h.percentile(50)),
+           static_cast<unsigned long long>(h.percentile(90)),
+           static_cast<unsigned long long>(h.percentile(99)),
+           static_cast<unsigned long long>(h.percentile(99.9)),
+           static_cast<unsigned long long>(h.percentile(99.99)),
+           static_cast<unsigned long long>(h.max()));
+
+    if (!opt.output.empty()) {
+        FILE* out = fopen(opt.output.c_str(), "a");
+        if (out == nullptr) {
+            perror("fopen");
+            return EXIT_FAILURE;
+        }
+        // 场景名 请求/秒 MB/s p50 p90 p99 p99.9 最大 错误数
+        fprintf(out, "%s %.1f %.2f %llu %llu %llu %llu %llu %llu\n", opt.name.c_str(), rps, mbps,
+                static_cast<unsigned long long>(h.percentile(50)),
+                static_cast<unsigned long long>(h.percentile(90)),
+                static_cast<unsigned long long>(h.percentile(99)),
+                static_cast<unsigned long long>(h.percentile(99.9)),
+                static_cast<unsigned long long>(h.max()),
+                static_cast<unsigned long long>(total.errors + total.bad_status));
+        fclose(out);
+    }
+    return total.completed > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,131 @@
+// 请求解析性能对比：旧的 istringstream/getline 实现 vs 增量解析器 HttpParser
+// 用法：./parser_bench [迭代次数]
+#include "http_parser.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sstream>
+#include <unordered_map>
+#include <algorithm>
+#include <cctype>
+
+// 旧实现（原 Server::parse_request_header + parse_http_request 中的查找逻辑），仅作对比基线
+struct LegacyRequest {
+    std::string method;
+    std::string url;
+    std::string version;
+    std::unordered_map<std::string, std::string> headers;
+};
+
+static bool legacy_parse(const std::string& buffer, LegacyRequest& request) {
+    size_t pos = buffer.find("\r\n\r\n");
+    if (pos == std::string::npos) {
+        return false;
+    }
+    std::istringstream stream(buffer.substr(0, pos + 4));
+    std::string line;
+    if (!std::getline(stream, line)) {
+        return false;
+    }
+    std::istringstream line_stream(line);
+    if (!(line_stream >> request.method >> request.url >> request.version)) {
+        return false;
+    }
+    while (std::getline(stream, line) && line != "\r") {
+        size_t colon = line.find(":");
+        if (colon != std::string::npos) {
+            std::string key = line.substr(0, colon);
+            std::string value = line.substr(colon + 1);
+            key.erase(std::remove_if(key.begin(), key.end(), ::isspace), key.end());
+            value.erase(std::remove_if(value.begin(), value.end(), ::isspace), value.end());
+            request.headers[key] = value;
+        }
+    }
+    return true;
+}
+
+static const char* const SAMPLE_REQUEST =
+    "GET /image/sample.jpg HTTP/1.1\r\n"
+    "Host: 127.0.0.1:8080\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:131.0) Gecko/20100101 Firefox/131.0\r\n"
+    "Accept: image/avif,image/webp,image/png,image/svg+xml,image/*;q=0.8,*/*;q=0.5\r\n"
+    "Accept-Language: en-US,en;q=0.5\r\n"
+    "Accept-Encoding: gzip, deflate, br, zstd\r\n"
+    "Connection: keep-alive\r\n"
+    "Referer: http://127.0.0.1:8080/\r\n"
+    "Sec-Fetch-Dest: image\r\n"
+    "Sec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Site: same-origin\r\n"
+    "If-None-Match: \"ce8010-3f-670ccded.0\"\r\n"
+    "Priority: u=5, i\r\n"
+    "\r\n";
+
+// 每次读取到达的字节数，模拟请求被拆成多个TCP段
+static const size_t SEGMENT_SIZE = 64;
+
+template <typename Fn>
+static double run(const char* name, long iterations, Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    long ok = 0;
+    for (long i = 0; i < iterations; ++i) {
+        ok += fn();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+    printf("%-34s %10.1f ns/request  (%ld ok)\n", name, ns, ok);
+    return ns;
+}
+
+int main(int argc, char* argv[]) {
+    long iterations = argc >= 2 ? atol(argv[1]) : 1000000;
+    const std::string request(SAMPLE_REQUEST);
+    printf("request size: %zu bytes, %ld iterations\n", request.size(), iterations);
+
+    double legacy_whole = run("legacy, whole request", iterations, [&]() {
+        LegacyRequest req;
+        return legacy_parse(request, req) ? 1 : 0;
+    });
+
+    double parser_whole = run("HttpParser, whole request", iterations, [&]() {
+        HttpParser parser;
+        HttpRequest req;
+        if (parser.parse(request.data(), request.size()) != PARSE_COMPLETE) {
+            return 0;
+        }
+        parser.fill_request(request.data(), &req);
+        return req.header("accept-encoding").empty() ? 0 : 1;
+    });
+
+    // 分段到达：旧实现每次读取后都从头查找 \r\n\r\n，完整后才解析
+    double legacy_segmented = run("legacy, 64-byte segments", iterations / 4, [&]() {
+        std::string buffer;
+        LegacyRequest req;
+        for (size_t off = 0; off < request.size(); off += SEGMENT_SIZE) {
+            buffer.append(request, off, SEGMENT_SIZE);
+            if (legacy_parse(buffer, req)) {
+                return 1;
+            }
+        }
+        return 0;
+    });
+
+    double parser_segmented = run("HttpParser, 64-byte segments", iterations / 4, [&]() {
+        std::string buffer;
+        HttpParser parser;
+        for (size_t off = 0; off < request.size(); off += SEGMENT_SIZE) {
+            buffer.append(request, off, SEGMENT_SIZE);
+            if (parser.parse(buffer.data(), buffer.size()) == PARSE_COMPLETE) {
+                HttpRequest req;
+                parser.fill_request(buffer.data(), &req);
+                return 1;
+            }
+        }
+        return 0;
+    });
+
+    printf("speedup: whole %.1fx, segmented %.1fx\n",
+           legacy_whole / parser_whole, legacy_segmented / parser_segmented);
+    return 0;
+}
@@ -0,0 +1,80 @@
+#!/bin/bash
+# 基准测试场景集：在本机回环端口启动 ./server，依次运行 loadgen 的各个场景，结果追加到结果文件。
+# 用法：bench/run_bench.sh [结果文件]
+# 环境变量：
+#   PORT      监听端口（默认 18080）
+#   DURATION  每个场景的秒数（默认 5）
+#   THREADS   服务器工作线程数（默认 8）
+#   REACTORS  服务器Reactor数（默认 2）
+#   BACKEND   epoll 或 uring（默认 epoll）
+#   RATE      开环场景的总速率，请求/秒（默认 20000）
+#   BASELINE  基线结果文件，给出时打印每个场景相对基线的变化
+set -e
+cd "$(dirname "$0")/.."
+
+PORT=${PORT:-18080}
+DURATION=${DURATION:-5}
+THREADS=${THREADS:-8}
+REACTORS=${REACTORS:-2}
+BACKEND=${BACKEND:-epoll}
+RATE=${RATE:-20000}
+REV=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+OUTPUT=${1:-bench/results/$(date +%Y%m%d-%H%M%S)-$REV.txt}
+LOADGEN="./loadgen -d $DURATION -w 1"
+
+mkdir -p "$(dirname "$OUTPUT")"
+echo "# rev=$REV backend=$BACKEND threads=$THREADS reactors=$REACTORS duration=${DURATION}s" >> "$OUTPUT"
+echo "# 场景 请求/秒 MB/s p50(us) p90 p99 p99.9 最大 错误" >> "$OUTPUT"
+
+# 不同大小的静态文件，测试结束后删除
+mkdir -p resource/bench
+head -c 1024 /dev/urandom > resource/bench/1k.bin
+head -c 65536 /dev/urandom > resource/bench/64k.bin
+head -c 1048576 /dev/urandom > resource/bench/1m.bin
+
+./server "$PORT" "$THREADS" "$REACTORS" 64 "$BACKEND" > /dev/null 2>&1 &
+SERVER_PID=$!
+cleanup() {
+    local status=$?
+    kill "$SERVER_PID" 2> /dev/null || true
+    wait "$SERVER_PID" 2> /dev/null || true
+    rm -rf resource/bench
+    exit $status
+}
+trap cleanup EXIT
+
+# 等待服务器开始监听
+for _ in $(seq 50); do
+    if (exec 3<> "/dev/tcp/127.0.0.1/$PORT") 2> /dev/null; then
+        break
+    fi
+    sleep 0.1
+done
+
+run() {
+    local name=$1
+    shift
+    echo "== $name"
+    $LOADGEN -n "$name" -o "$OUTPUT" "$@" "$PORT" | sed -n '4,5p'
+}
+
+run small-keepalive     -c 64  -t 4 -r 1:GET:/index.html
+run small-pipeline8     -c 64  -t 4 -p 8 -r 1:GET:/index.html
+run small-close         -c 32  -t 4 -k 0 -r 1:GET:/index.html
+run file-64k            -c 64  -t 4 -r 1:GET:/bench/64k.bin
+run file-1m             -c 16  -t 4 -r 1:GET:/bench/1m.bin
+run post-4k             -c 64  -t 4 -r 1:POST:/echo:4096
+run mixed               -c 128 -t 4 -r 6:GET:/index.html -r 2:GET:/style.css -r 2:GET:/bench/1k.bin \
+                                    -r 1:GET:/bench/64k.bin -r 1:GET:/image/sample.jpg -r 1:POST:/echo:1024
+run open-loop           -c 128 -t 4 -R "$RATE" -r 3:GET:/index.html -r 1:GET:/bench/64k.bin
+
+echo "结果已写入 $OUTPUT"
+
+if [ -n "$BASELINE" ]; then
+    echo "== 相对基线 $BASELINE 的变化（吞吐越高越好，延迟越低越好）"
+    awk 'FNR == NR && !/^#/ { rps[$1] = $2; p99[$1] = $6; next }
+         !/^#/ && ($1 in rps) && rps[$1] > 0 && p99[$1] > 0 {
+             printf "%-18s 吞吐 %+6.1f%%  p99 %+6.1f%%\n", $1,
+                    ($2 - rps[$1]) * 100 / rps[$1], ($6 - p99[$1]) * 100 / p99[$1]
+         }' "$BASELINE" "$OUTPUT"
+fi
@@ -1,46 +1,244 @@
 #include "ThreadPool.h"
+#include "metrics.h"
+#include "utils.h"
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <sched.h>
+#include <algorithm>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
-ThreadPool::ThreadPool(size_t thread_count) : stop_(false) {
+// 自旋轮数的自适应范围：上次自旋等到了任务就加倍，否则减半
+#define MIN_SPIN_ROUNDS 16
+#define MAX_SPIN_ROUNDS 1024
+
+// 当前线程所属的线程池和工作线程编号，用于工作线程内部提交时直接压入自己的队列
+static thread_local ThreadPool* current_pool = nullptr;
+static thread_local size_t current_index = 0;
+
+static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#else
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+}
+
+static void futex_wait(std::atomic<uint32_t>* addr, uint32_t expected) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT_PRIVATE, expected,
+            nullptr, nullptr, 0);
+}
+
+static void futex_wake(std::atomic<uint32_t>* addr, int count) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE_PRIVATE, count,
+            nullptr, nullptr, 0);
+}
+
+ThreadPool::ThreadPool(size_t thread_count, const std::vector<ThreadPlacement>& placement)
+    : wake_seq_(0), sleepers_(0), stop_(false) {
+    if (thread_count == 0) {
+        thread_count = 1;
+    }
     for (size_t i = 0; i < thread_count; ++i) {
-        workers_.emplace_back(std::thread(&ThreadPool::worker, this));
+        workers_.emplace_back(new Worker());
+        Worker& worker = *workers_.back();
+        worker.rng = static_cast<uint32_t>(i * 2654435761u + 1);
+        if (i < placement.size()) {
+            worker.placement = placement[i];
+        }
+        // 按节点分组，未绑定的线程归入节点-1所在的组
+        int node = worker.placement.node;
+        size_t group = std::find(group_nodes_.begin(), group_nodes_.end(), node) - group_nodes_.begin();
+        if (group == group_nodes_.size()) {
+            group_nodes_.push_back(node);
+            injections_.emplace_back(new InjectionQueue());
+        }
+        worker.group = group;
+    }
+    // 所有队列就绪后再启动线程，窃取时可以安全访问 workers_
+    for (size_t i = 0; i < thread_count; ++i) {
+        workers_[i]->thread = std::thread(&ThreadPool::worker_loop, this, i);
     }
 }
 
 ThreadPool::~ThreadPool() {
     stop_.store(true);
-    condition_.notify_all();
-    for (std::thread &worker : workers_) {
-        if (worker.joinable())
-            worker.join();
+    wake_seq_.fetch_add(1);
+    futex_wake(&wake_seq_, INT32_MAX);
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable())
+            worker->thread.join();
+    }
+}
+
+void ThreadPool::submit_batch(const Task* tasks, size_t count, int node) {
+    if (count == 0) {
+        return;
+    }
+    if (stop_.load(std::memory_order_relaxed))
+        throw std::runtime_error("enqueue on stopped ThreadPool");
+
+    bool local = current_pool == this;
+    size_t group = 0;
+    if (local) {
+        group = workers_[current_index]->group;
+    } else if (node >= 0) {
+        group = std::find(group_nodes_.begin(), group_nodes_.end(), node) - group_nodes_.begin();
+        if (group == group_nodes_.size()) {
+            group = 0;
+        }
+    }
+    InjectionQueue& injection = *injections_[group];
+    int64_t now = current_time_ns();
+    for (size_t i = 0; i < count; ++i) {
+        Task task = tasks[i];
+        task.enqueued_ns = now;
+        if (local && workers_[current_index]->deque.push(task)) {
+            continue;
+        }
+        // 注入队列满时让出CPU等待消费，形成对 Reactor 的背压
+        while (!injection.push(task)) {
+            notify(workers_.size());
+            sched_yield();
+        }
+    }
+    notify(count);
+}
+
+size_t ThreadPool::pending_tasks() const {
+    size_t total = 0;
+    for (const auto& injection : injections_) {
+        total += injection->size();
+    }
+    for (const auto& worker : workers_) {
+        total += worker->deque.size();
+    }
+    return total;
+}
+
+void ThreadPool::notify(size_t count) {
+    // 与 park() 中的 sleepers_ 自增 + 复查队列配对，保证不会丢失唤醒
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint32_t sleepers = sleepers_.load(std::memory_order_relaxed);
+    if (sleepers == 0) {
+        return;
     }
+    wake_seq_.fetch_add(1, std::memory_order_release);
+    futex_wake(&wake_seq_, static_cast<int>(std::min<size_t>(count, sleepers)));
 }
 
-void ThreadPool::worker() {
-    while (!stop_) {
-        std::function<void()> task;
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex_);
-            condition_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
-            if (stop_ && tasks_.empty())
-                return;
-            task = std::move(tasks_.front());
-            tasks_.pop();
+bool ThreadPool::find_task(size_t index, Task* task) {
+    Worker& self = *workers_[index];
+    if (self.deque.pop(task)) {
+        return true;
+    }
+    if (injections_[self.group]->pop(task)) {
+        return true;
+    }
+    if (steal_task(index, true, task)) {
+        return true;
+    }
+    // 本节点没有任务时才跨节点，数据留在原节点的缓存中更划算
+    for (size_t g = 0; g < injections_.size(); ++g) {
+        if (g != self.group && injections_[g]->pop(task)) {
+            return true;
         }
-        try {
-            // 将线程ID转换为字符串
-            std::ostringstream oss_start;
-            oss_start << "工作线程 " << std::this_thread::get_id() << " 开始执行任务。";
-            LOG_DEBUG(oss_start.str());
+    }
+    return injections_.size() > 1 && steal_task(index, false, task);
+}
 
-            task(); // 执行任务
+bool ThreadPool::steal_task(size_t index, bool same_group, Task* task) {
+    Worker& self = *workers_[index];
+    size_t n = workers_.size();
+    if (n <= 1) {
+        return false;
+    }
+    // 从随机位置开始轮流窃取其他线程的队列
+    self.rng ^= self.rng << 13;
+    self.rng ^= self.rng >> 17;
+    self.rng ^= self.rng << 5;
+    size_t start = self.rng % n;
+    for (size_t i = 0; i < n; ++i) {
+        size_t victim = (start + i) % n;
+        if (victim == index || (workers_[victim]->group == self.group) != same_group) {
+            continue;
+        }
+        if (workers_[victim]->deque.steal(task)) {
+            return true;
+        }
+    }
+    return false;
+}
 
-            std::ostringstream oss_end;
-            oss_end << "工作线程 " << std::this_thread::get_id() << " 完成任务。";
-            LOG_DEBUG(oss_end.str());
-        } catch (const std::exception& e) {
-            LOG_ERROR("工作线程发生异常：" + std::string(e.what()));
+bool ThreadPool::has_work() const {
+    for (const auto& injection : injections_) {
+        if (injection->size() > 0) {
+            return true;
         }
-    
     }
+    for (const auto& worker : workers_) {
+        if (worker->deque.size() > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::park() {
+    uint32_t seq = wake_seq_.load(std::memory_order_acquire);
+    sleepers_.fetch_add(1, std::memory_order_seq_cst);
+    // 登记为休眠者之后再复查一次，提交方要么看到休眠者，要么这里看到任务
+    if (!has_work() && !stop_.load()) {
+        futex_wait(&wake_seq_, seq);
+    }
+    sleepers_.fetch_sub(1, std::memory_order_relaxed);
 }
 
+void ThreadPool::run_task(Task& task) {
+    Metrics::local().stages[STAGE_TASK_WAIT].record(current_time_ns() - task.enqueued_ns);
+    try {
+        task(); // 执行任务
+    } catch (const std::exception& e) {
+        LOGF_ERROR("工作线程发生异常：{}", e.what());
+    }
+}
+
+void ThreadPool::worker_loop(size_t index) {
+    current_pool = this;
+    current_index = index;
+    // 先绑定再开始处理任务，线程之后首次访问的内存（线程局部缓存、缓冲区分段）落在本节点
+    apply_thread_placement(workers_[index]->placement);
+    size_t spin_rounds = MIN_SPIN_ROUNDS;
+    Task task;
+
+    while (true) {
+        if (find_task(index, &task)) {
+            run_task(task);
+            continue;
+        }
+
+        bool found = false;
+        for (size_t i = 0; i < spin_rounds; ++i) {
+            for (int j = 0; j < 32; ++j) {
+                cpu_relax();
+            }
+            if (find_task(index, &task)) {
+                found = true;
+                break;
+            }
+        }
+        if (found) {
+            spin_rounds = std::min<size_t>(spin_rounds * 2, MAX_SPIN_ROUNDS);
+            run_task(task);
+            continue;
+        }
+        spin_rounds = std::max<size_t>(spin_rounds / 2, MIN_SPIN_ROUNDS);
+
+        if (stop_.load() && !has_work()) {
+            return;
+        }
+        park();
+    }
+}
@@ -2,18 +2,22 @@
 #define THREADPOOL_H
 
 #include <thread>
-#include <mutex>
-#include <condition_variable>
-#include <queue>
-#include <functional>
 #include <vector>
+#include <memory>
 #include <atomic>
 #include <stdexcept>
 #include <logger.h>
-#include <sstream>
+#include "task_queue.h"
+#include "cpu_topology.h"
+
+// 工作窃取线程池：每个工作线程一个 Chase-Lev 双端队列，外部线程通过无锁注入队列提交。
+// 空闲线程先自旋（自适应时长），仍无任务时在 futex 上休眠。
+// 给定绑定位置时按NUMA节点分组：每组一个注入队列，空闲线程先取本组的任务、先窃取同组线程，最后才跨节点。
 class ThreadPool {
 public:
-    ThreadPool(size_t thread_count = 8);
+    // placement 为每个工作线程的绑定位置（为空则不绑定，所有线程同属一组）
+    ThreadPool(size_t thread_count = 8,
+               const std::vector<ThreadPlacement>& placement = std::vector<ThreadPlacement>());
     ~ThreadPool();
 
     // 禁止拷贝和赋值
@@ -21,25 +25,45 @@ public:
     ThreadPool& operator=(const ThreadPool&) = delete;
 
     // 提交任务，使用模板支持任意可调用对象
-    template<typename Task>
-    void enqueue(Task task) {
-        {
-            std::unique_lock<std::mutex> lock(queue_mutex_);
-            if (stop_)
-                throw std::runtime_error("enqueue on stopped ThreadPool");
-            tasks_.emplace(task);
-        }
-        condition_.notify_one();
+    template<typename F>
+    void enqueue(F&& f) {
+        Task task(std::forward<F>(f));
+        submit_batch(&task, 1);
     }
 
+    // 批量提交任务，只做一次唤醒（Reactor 把一次 epoll_wait 的结果整体交给线程池）。
+    // node 为提交者所在的NUMA节点，任务进入该节点的注入队列（-1或没有该节点的线程时进入第一组）
+    void submit_batch(const Task* tasks, size_t count, int node = -1);
+
+    size_t thread_count() const { return workers_.size(); }
+    // 排队中的任务数（近似值）
+    size_t pending_tasks() const;
+
 private:
-    void worker();
+    struct alignas(64) Worker {
+        std::thread thread;
+        WorkStealingDeque deque;
+        uint32_t rng; // 选择窃取对象用的随机数状态
+        size_t group; // 所属NUMA分组
+        ThreadPlacement placement;
+    };
+
+    void worker_loop(size_t index);
+    bool find_task(size_t index, Task* task);
+    // 从随机位置开始窃取同组（same_group）或其他组线程的队列
+    bool steal_task(size_t index, bool same_group, Task* task);
+    bool has_work() const;
+    void park();
+    void notify(size_t count);
+    void run_task(Task& task);
 
-    std::vector<std::thread> workers_;
-    std::queue<std::function<void()>> tasks_;
+    std::vector<std::unique_ptr<Worker>> workers_;
+    // 每个NUMA分组一个注入队列，group_nodes_[i] 为第i组的节点号
+    std::vector<std::unique_ptr<InjectionQueue>> injections_;
+    std::vector<int> group_nodes_;
 
-    std::mutex queue_mutex_;
-    std::condition_variable condition_;
+    alignas(64) std::atomic<uint32_t> wake_seq_; // futex 字
+    alignas(64) std::atomic<uint32_t> sleepers_; // 正在休眠（或准备休眠）的线程数
     std::atomic<bool> stop_;
 };
 
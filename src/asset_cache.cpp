@@ -0,0 +1,459 @@
+#include "asset_cache.h"
+#include "utils.h"
+#include "logger.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/eventfd.h>
+#include <zlib.h>
+
+AssetCache::AssetCache(const std::string& root, size_t memory_budget, size_t max_file_size)
+    : root_(root), shard_budget_(memory_budget / SHARD_COUNT), max_file_size_(max_file_size),
+      inotify_fd_(-1), wakeup_fd_(-1), revalidate_on_hit_(true) {
+    init_watch();
+}
+
+AssetCache::~AssetCache() {
+    if (watch_thread_.joinable()) {
+        uint64_t one = 1;
+        if (write(wakeup_fd_, &one, sizeof(one)) != sizeof(one)) {
+            perror("eventfd write error");
+        }
+        watch_thread_.join();
+    }
+    if (inotify_fd_ != -1) {
+        close(inotify_fd_);
+    }
+    if (wakeup_fd_ != -1) {
+        close(wakeup_fd_);
+    }
+}
+
+AssetCache::Shard& AssetCache::shard_for(const std::string& key) {
+    return shards_[std::hash<std::string>()(key) % SHARD_COUNT];
+}
+
+// 压缩版本在缓存中的key：路径 + 换行 + 编码名（路径中不会出现换行）
+static std::string variant_key(const std::string& path, ContentEncoding encoding) {
+    return path + (encoding == ENCODING_BR ? "\nbr" : "\ngzip");
+}
+
+std::shared_ptr<const CachedAsset> AssetCache::lookup(const std::string& key) {
+    Shard& shard = shard_for(key);
+    std::shared_ptr<const CachedAsset> asset;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        if (it != shard.entries.end()) {
+            // 命中，移到LRU表头
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lru_it);
+            asset = it->second.asset;
+        }
+    }
+
+    if (asset && revalidate_on_hit_) {
+        // 没有inotify时只能用stat确认文件未变化
+        struct stat st;
+        if (stat(asset->source_path.c_str(), &st) == -1 || make_etag(st) != asset->source_etag) {
+            invalidate_key(key);
+            asset.reset();
+        }
+    }
+    return asset;
+}
+
+std::shared_ptr<const CachedAsset> AssetCache::get(const std::string& path, unsigned accepted_encodings) {
+    std::shared_ptr<const CachedAsset> base = lookup(path);
+    if (!base) {
+        base = load(path);
+        if (!base) {
+            return nullptr;
+        }
+        insert(path, base);
+    }
+
+    if (!base->compressible) {
+        return base;
+    }
+    if (accepted_encodings & ENCODING_BR) {
+        std::shared_ptr<const CachedAsset> variant = get_variant(base, ENCODING_BR);
+        if (variant != base) {
+            return variant;
+        }
+    }
+    if (accepted_encodings & ENCODING_GZIP) {
+        return get_variant(base, ENCODING_GZIP);
+    }
+    return base;
+}
+
+std::shared_ptr<const CachedAsset> AssetCache::get_variant(const std::shared_ptr<const CachedAsset>& base,
+                                                           ContentEncoding encoding) {
+    std::string key = variant_key(base->path, encoding);
+    std::shared_ptr<const CachedAsset> variant = lookup(key);
+    if (variant && variant->base_etag == base->etag) {
+        return variant;
+    }
+
+    // 未命中时串行构建；拿到锁后再查一次，其他线程可能刚刚构建完成
+    std::lock_guard<std::mutex> lock(variant_mutex_);
+    variant = lookup(key);
+    if (variant && variant->base_etag == base->etag) {
+        return variant;
+    }
+    variant = load_sidecar(base, encoding);
+    if (!variant && encoding == ENCODING_GZIP) {
+        variant = compress_gzip(base);
+    }
+    if (!variant) {
+        // 没有可用的压缩版本（或压缩后没有变小），缓存原版本，避免每次都重新尝试
+        variant = base;
+    }
+    insert(key, variant);
+    return variant;
+}
+
+void AssetCache::invalidate(const std::string& path) {
+    invalidate_key(path);
+    invalidate_key(variant_key(path, ENCODING_GZIP));
+    invalidate_key(variant_key(path, ENCODING_BR));
+    // 预压缩文件变化时，对应原文件的压缩版本失效
+    if (ends_with(path, ".gz")) {
+        invalidate_key(variant_key(path.substr(0, path.size() - 3), ENCODING_GZIP));
+    } else if (ends_with(path, ".br")) {
+        invalidate_key(variant_key(path.substr(0, path.size() - 3), ENCODING_BR));
+    }
+}
+
+void AssetCache::invalidate_key(const std::string& key) {
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.entries.find(key);
+    if (it != shard.entries.end()) {
+        erase_locked(shard, it);
+    }
+}
+
+void AssetCache::invalidate_prefix(const std::string& prefix) {
+    for (size_t i = 0; i < SHARD_COUNT; ++i) {
+        Shard& shard = shards_[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto it = shard.entries.begin(); it != shard.entries.end(); ) {
+            auto next = std::next(it);
+            if (it->first.compare(0, prefix.size(), prefix) == 0) {
+                erase_locked(shard, it);
+            }
+            it = next;
+        }
+    }
+}
+
+// 读取整个小文件，失败或超过max_size时返回nullptr
+static std::shared_ptr<const std::string> read_small_file(const std::string& path, size_t max_size,
+                                                          struct stat* st) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return nullptr;
+    }
+    if (fstat(fd, st) == -1 || !S_ISREG(st->st_mode) ||
+        static_cast<size_t>(st->st_size) > max_size) {
+        close(fd);
+        return nullptr;
+    }
+
+    std::string* body = new std::string(st->st_size, '\0');
+    std::shared_ptr<const std::string> body_ptr(body);
+    size_t total = 0;
+    while (total < body->size()) {
+        ssize_t n = read(fd, &(*body)[total], body->size() - total);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        total += n;
+    }
+    close(fd);
+    if (total != body->size()) {
+        // 读取期间文件被修改，不缓存
+        return nullptr;
+    }
+    return body_ptr;
+}
+
+// 根据资源的各字段生成200/304响应头（不含结尾空行，Date 和空行在发送时追加）
+static void build_headers(CachedAsset* asset) {
+    std::string validators = "ETag: " + asset->etag + "\r\n"
+                             "Last-Modified: " + asset->last_modified + "\r\n"
+                             "Accept-Ranges: bytes\r\n";
+    if (asset->compressible) {
+        validators += "Vary: Accept-Encoding\r\n";
+    }
+    asset->header = "HTTP/1.1 200 OK\r\n"
+                    "Content-Type: " + asset->content_type + "\r\n";
+    if (!asset->content_encoding.empty()) {
+        asset->header += "Content-Encoding: " + asset->content_encoding + "\r\n";
+    }
+    asset->header += "Content-Length: " + std::to_string(asset->body->size()) + "\r\n" + validators;
+    asset->not_modified_header = "HTTP/1.1 304 Not Modified\r\n" + validators;
+}
+
+// 压缩版本的ETag：在原ETag的引号内追加编码名
+static std::string variant_etag(const std::string& etag, const std::string& encoding) {
+    return etag.substr(0, etag.size() - 1) + "-" + encoding + "\"";
+}
+
+std::shared_ptr<const CachedAsset> AssetCache::load(const std::string& path) {
+    struct stat st;
+    std::shared_ptr<const std::string> body = read_small_file(path, max_file_size_, &st);
+    if (!body) {
+        return nullptr;
+    }
+
+    std::shared_ptr<CachedAsset> asset = std::make_shared<CachedAsset>();
+    asset->path = path;
+    asset->body = body;
+    asset->content_type = get_content_type(path);
+    asset->etag = make_etag(st);
+    asset->last_modified = format_http_date(st.st_mtime);
+    asset->mtime = st.st_mtime;
+    asset->compressible = is_compressible_type(asset->content_type);
+    asset->source_path = path;
+    asset->source_etag = asset->etag;
+    asset->base_etag = asset->etag;
+    build_headers(asset.get());
+    return asset;
+}
+
+std::shared_ptr<const CachedAsset> AssetCache::load_sidecar(const std::shared_ptr<const CachedAsset>& base,
+                                                            ContentEncoding encoding) {
+    const char* name = encoding == ENCODING_BR ? "br" : "gzip";
+    std::string sidecar_path = base->path + (encoding == ENCODING_BR ? ".br" : ".gz");
+    struct stat st;
+    std::shared_ptr<const std::string> body = read_small_file(sidecar_path, max_file_size_, &st);
+    // 比原文件旧的预压缩文件视为过期，不使用
+    if (!body || st.st_mtime < base->mtime) {
+        return nullptr;
+    }
+
+    std::shared_ptr<CachedAsset> asset = std::make_shared<CachedAsset>(*base);
+    asset->body = body;
+    asset->content_encoding = name;
+    asset->etag = variant_etag(base->etag, name);
+    asset->source_path = sidecar_path;
+    asset->source_etag = make_etag(st);
+    build_headers(asset.get());
+    return asset;
+}
+
+std::shared_ptr<const CachedAsset> AssetCache::compress_gzip(const std::shared_ptr<const CachedAsset>& base) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    // windowBits 15 + 16 表示输出gzip格式
+    if (deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return nullptr;
+    }
+    const std::string& input = *base->body;
+    std::string* output = new std::string(deflateBound(&zs, input.size()), '\0');
+    std::shared_ptr<const std::string> output_ptr(output);
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    zs.avail_in = input.size();
+    zs.next_out = reinterpret_cast<Bytef*>(&(*output)[0]);
+    zs.avail_out = output->size();
+    int ret = deflate(&zs, Z_FINISH);
+    size_t compressed_size = zs.total_out;
+    deflateEnd(&zs);
+    if (ret != Z_STREAM_END || compressed_size >= input.size()) {
+        return nullptr;
+    }
+    output->resize(compressed_size);
+    output->shrink_to_fit();
+
+    std::shared_ptr<CachedAsset> asset = std::make_shared<CachedAsset>(*base);
+    asset->body = output_ptr;
+    asset->content_encoding = "gzip";
+    asset->etag = variant_etag(base->etag, "gzip");
+    build_headers(asset.get());
+    LOG_DEBUG("即时gzip压缩：" + base->path + " " + std::to_string(input.size()) +
+              " -> " + std::to_string(compressed_size));
+    return asset;
+}
+
+void AssetCache::insert(const std::string& key, const std::shared_ptr<const CachedAsset>& asset) {
+    // 压缩版本的位置上缓存的是原版本时，正文已经按原版本计算过，不重复计算
+    bool shares_base_body = key != asset->path && asset->content_encoding.empty();
+    size_t charge = key.size() + asset->header.size() + (shares_base_body ? 0 : asset->body->size());
+    if (charge > shard_budget_) {
+        return;
+    }
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.entries.find(key);
+    if (it != shard.entries.end()) {
+        // 其他线程已经加载过，用新的替换
+        erase_locked(shard, it);
+    }
+    shard.lru.push_front(key);
+    Entry entry;
+    entry.asset = asset;
+    entry.lru_it = shard.lru.begin();
+    entry.charge = charge;
+    shard.entries[key] = entry;
+    shard.used += charge;
+
+    // 超出预算时从LRU表尾淘汰
+    while (shard.used > shard_budget_ && !shard.lru.empty()) {
+        erase_locked(shard, shard.entries.find(shard.lru.back()));
+    }
+}
+
+void AssetCache::erase_locked(Shard& shard, std::unordered_map<std::string, Entry>::iterator it) {
+    shard.used -= it->second.charge;
+    shard.lru.erase(it->second.lru_it);
+    shard.entries.erase(it);
+}
+
+void AssetCache::init_watch() {
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotify_fd_ == -1 || wakeup_fd_ == -1) {
+        LOG_WARN("inotify 不可用，静态资源缓存退化为每次命中时校验：" + std::string(strerror(errno)));
+        return;
+    }
+    add_watch_recursive(root_);
+    if (watch_dirs_.empty()) {
+        LOG_WARN("无法监听资源目录 " + root_ + "，静态资源缓存退化为每次命中时校验");
+        return;
+    }
+    revalidate_on_hit_ = false;
+    watch_thread_ = std::thread(&AssetCache::watch_loop, this);
+}
+
+void AssetCache::add_watch_recursive(const std::string& dir) {
+    int wd = inotify_add_watch(inotify_fd_, dir.c_str(),
+                               IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE |
+                               IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR);
+    if (wd == -1) {
+        return;
+    }
+    watch_dirs_[wd] = dir;
+
+    DIR* d = opendir(dir.c_str());
+    if (d == nullptr) {
+        return;
+    }
+    struct dirent* ent;
+    while ((ent = readdir(d)) != nullptr) {
+        if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0) {
+            continue;
+        }
+        std::string child = dir + "/" + ent->d_name;
+        struct stat st;
+        if (lstat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+            add_watch_recursive(child);
+        }
+    }
+    closedir(d);
+}
+
+void AssetCache::watch_loop() {
+    alignas(struct inotify_event) char buffer[4096];
+    struct pollfd fds[2];
+    fds[0].fd = inotify_fd_;
+    fds[0].events = POLLIN;
+    fds[1].fd = wakeup_fd_;
+    fds[1].events = POLLIN;
+
+    while (true) {
+        if (poll(fds, 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("inotify poll() 错误：" + std::string(strerror(errno)));
+            return;
+        }
+        if (fds[1].revents & POLLIN) {
+            return;
+        }
+
+        ssize_t len;
+        while ((len = read(inotify_fd_, buffer, sizeof(buffer))) > 0) {
+            for (char* p = buffer; p < buffer + len; ) {
+                struct inotify_event* event = reinterpret_cast<struct inotify_event*>(p);
+                p += sizeof(struct inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    // 事件丢失，无法确定哪些文件变化，清空整个缓存
+                    invalidate_prefix("");
+                    continue;
+                }
+                auto dir_it = watch_dirs_.find(event->wd);
+                if (dir_it == watch_dirs_.end()) {
+                    continue;
+                }
+                if (event->mask & IN_IGNORED) {
+                    watch_dirs_.erase(dir_it);
+                    continue;
+                }
+                if (event->len == 0) {
+                    continue;
+                }
+                std::string path = dir_it->second + "/" + event->name;
+                invalidate(path);
+                if (event->mask & IN_ISDIR) {
+                    // 整个子目录被删除/移动时，其下的缓存全部失效
+                    invalidate_prefix(path + "/");
+                    if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                        // 新建的子目录也需要监听
+                        add_watch_recursive(path);
+                    }
+                }
+                LOG_DEBUG("资源文件变化，缓存失效：" + path);
+            }
+        }
+    }
+}
+
+bool is_compressible_type(const std::string& content_type) {
+    return content_type.compare(0, 5, "text/") == 0 ||
+           content_type == "application/javascript" ||
+           content_type == "application/json" ||
+           content_type == "application/xml" ||
+           content_type == "image/svg+xml";
+}
+
+std::string make_etag(const struct stat& st) {
+    char buf[96];
+    snprintf(buf, sizeof(buf), "\"%lx-%lx-%lx.%lx\"",
+             static_cast<unsigned long>(st.st_ino),
+             static_cast<unsigned long>(st.st_size),
+             static_cast<unsigned long>(st.st_mtim.tv_sec),
+             static_cast<unsigned long>(st.st_mtim.tv_nsec));
+    return buf;
+}
+
+std::string format_http_date(time_t t) {
+    struct tm tm_gmt;
+    gmtime_r(&t, &tm_gmt);
+    char buf[64];
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &tm_gmt);
+    return buf;
+}
+
+bool parse_http_date(const std::string& value, time_t* t) {
+    struct tm tm_gmt;
+    memset(&tm_gmt, 0, sizeof(tm_gmt));
+    const char* end = strptime(value.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm_gmt);
+    if (end == nullptr || *end != '\0') {
+        return false;
+    }
+    *t = timegm(&tm_gmt);
+    return true;
+}
@@ -0,0 +1,127 @@
+#ifndef ASSET_CACHE_H
+#define ASSET_CACHE_H
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <list>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <sys/stat.h>
+#include <time.h>
+
+// 默认缓存总内存预算
+#define DEFAULT_ASSET_CACHE_BUDGET (64 * 1024 * 1024)
+// 超过该大小的文件不进缓存，直接用sendfile发送
+#define DEFAULT_ASSET_MAX_FILE_SIZE (1024 * 1024)
+
+// 客户端可接受的内容编码（位掩码）
+enum ContentEncoding {
+    ENCODING_IDENTITY = 0,
+    ENCODING_GZIP = 1 << 0,
+    ENCODING_BR = 1 << 1
+};
+
+// 一个缓存的静态资源（或它的某个压缩版本），构建完成后只读，可被多个连接同时引用
+struct CachedAsset {
+    std::string path;                          // 请求对应的文件路径
+    std::shared_ptr<const std::string> body;   // 响应体（原文件或压缩后的内容）
+    std::string header;                        // 预生成的200响应头（不含结尾空行）
+    std::string not_modified_header;           // 预生成的304响应头（不含结尾空行）
+    std::string content_type;
+    std::string content_encoding;              // 为空表示未压缩
+    std::string etag;                          // 强ETag，不同编码的版本各不相同
+    std::string last_modified;                 // HTTP-date格式
+    time_t mtime;
+    bool compressible;                         // 是否为可压缩的文本类型，需要 Vary: Accept-Encoding
+
+    // 用于校验的数据来源：原文件、预压缩的 .gz/.br 文件
+    std::string source_path;
+    std::string source_etag;
+    // 派生自哪个版本的原文件，原文件变化后压缩版本随之失效
+    std::string base_etag;
+};
+
+// 共享、读多写少的静态资源缓存：分片LRU + 内存预算，通过inotify监听资源目录失效
+class AssetCache {
+public:
+    AssetCache(const std::string& root, size_t memory_budget = DEFAULT_ASSET_CACHE_BUDGET,
+               size_t max_file_size = DEFAULT_ASSET_MAX_FILE_SIZE);
+    ~AssetCache();
+
+    AssetCache(const AssetCache&) = delete;
+    AssetCache& operator=(const AssetCache&) = delete;
+
+    // 查找资源，未命中时从磁盘加载。文件不存在、不是普通文件或过大时返回nullptr。
+    // accepted_encodings 为客户端接受的编码，可压缩的资源优先返回 .br/.gz 预压缩文件，
+    // 没有预压缩文件时即时gzip压缩一次并缓存，之后直到文件变化都直接复用
+    std::shared_ptr<const CachedAsset> get(const std::string& path,
+                                           unsigned accepted_encodings = ENCODING_IDENTITY);
+
+    // 使某个路径的缓存失效
+    void invalidate(const std::string& path);
+    // 使某个前缀（目录）下的所有缓存失效
+    void invalidate_prefix(const std::string& prefix);
+
+private:
+    struct Entry {
+        std::shared_ptr<const CachedAsset> asset;
+        std::list<std::string>::iterator lru_it;
+        size_t charge;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<std::string> lru;            // 表头为最近使用
+        std::unordered_map<std::string, Entry> entries;
+        size_t used;
+        Shard() : used(0) {}
+    };
+
+    static const size_t SHARD_COUNT = 8;
+
+    Shard& shard_for(const std::string& key);
+    // 按key查找（命中时移到LRU表头，必要时用stat校验）
+    std::shared_ptr<const CachedAsset> lookup(const std::string& key);
+    std::shared_ptr<const CachedAsset> load(const std::string& path);
+    std::shared_ptr<const CachedAsset> get_variant(const std::shared_ptr<const CachedAsset>& base,
+                                                   ContentEncoding encoding);
+    std::shared_ptr<const CachedAsset> load_sidecar(const std::shared_ptr<const CachedAsset>& base,
+                                                    ContentEncoding encoding);
+    std::shared_ptr<const CachedAsset> compress_gzip(const std::shared_ptr<const CachedAsset>& base);
+    void insert(const std::string& key, const std::shared_ptr<const CachedAsset>& asset);
+    void invalidate_key(const std::string& key);
+    void erase_locked(Shard& shard, std::unordered_map<std::string, Entry>::iterator it);
+
+    // inotify相关
+    void init_watch();
+    void add_watch_recursive(const std::string& dir);
+    void watch_loop();
+
+    std::string root_;
+    size_t shard_budget_;
+    size_t max_file_size_;
+    Shard shards_[SHARD_COUNT];
+
+    // 串行化压缩版本的构建，保证每个资源每次变化最多压缩一次
+    std::mutex variant_mutex_;
+
+    int inotify_fd_;
+    int wakeup_fd_;                            // eventfd，析构时唤醒监听线程
+    std::unordered_map<int, std::string> watch_dirs_;  // wd -> 目录路径，仅监听线程访问
+    std::thread watch_thread_;
+    // inotify不可用时退化为每次命中都用stat校验
+    bool revalidate_on_hit_;
+};
+
+// 是否为值得压缩的文本类型
+bool is_compressible_type(const std::string& content_type);
+// 根据文件的 inode/大小/修改时间 生成强ETag
+std::string make_etag(const struct stat& st);
+// 格式化为HTTP-date，如 "Sun, 06 Nov 1994 08:49:37 GMT"
+std::string format_http_date(time_t t);
+// 解析HTTP-date，失败返回false
+bool parse_http_date(const std::string& value, time_t* t);
+
+#endif // ASSET_CACHE_H
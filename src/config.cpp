@@ -0,0 +1,292 @@
+#include "config.h"
+#include <fstream>
+#include <ctype.h>
+#include <limits.h>
+#include <strings.h>
+
+static std::string_view trim(std::string_view text) {
+    while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+        text.remove_prefix(1);
+    }
+    while (!text.empty() && (text.back() == ' ' || text.back() == '\t' || text.back() == '\r')) {
+        text.remove_suffix(1);
+    }
+    return text;
+}
+
+static bool equals_ignore_case(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+// 十进制整数，范围 [min, max]
+static bool parse_integer(std::string_view value, uint64_t min, uint64_t max, uint64_t* result) {
+    return parse_decimal(value, result) && *result >= min && *result <= max;
+}
+
+// 字节数，可带 K/M/G 后缀（1024进制）
+static bool parse_size(std::string_view value, uint64_t* result) {
+    unsigned shift = 0;
+    if (!value.empty()) {
+        switch (value.back()) {
+        case 'k': case 'K': shift = 10; break;
+        case 'm': case 'M': shift = 20; break;
+        case 'g': case 'G': shift = 30; break;
+        default: break;
+        }
+    }
+    if (shift > 0) {
+        value.remove_suffix(1);
+    }
+    if (!parse_decimal(value, result) || *result > (UINT64_MAX >> shift)) {
+        return false;
+    }
+    *result <<= shift;
+    return true;
+}
+
+static bool parse_bool(std::string_view value, bool* result) {
+    if (equals_ignore_case(value, "true") || equals_ignore_case(value, "on") || value == "1") {
+        *result = true;
+        return true;
+    }
+    if (equals_ignore_case(value, "false") || equals_ignore_case(value, "off") || value == "0") {
+        *result = false;
+        return true;
+    }
+    return false;
+}
+
+bool set_config_option(std::string_view key, std::string_view value, ServerConfig* config, std::string* error) {
+    uint64_t number = 0;
+    bool ok = true;
+
+    if (key == "port") {
+        ok = parse_integer(value, 1, 65535, &number);
+        config->port = static_cast<int>(number);
+    } else if (key == "workers") {
+        ok = parse_integer(value, 1, 4096, &number);
+        config->worker_threads = static_cast<int>(number);
+    } else if (key == "reactors") {
+        ok = parse_integer(value, 1, 1024, &number);
+        config->reactors = static_cast<int>(number);
+    } else if (key == "io_backend") {
+        if (equals_ignore_case(value, "epoll")) {
+            config->io_backend = IO_BACKEND_EPOLL;
+        } else if (equals_ignore_case(value, "uring")) {
+            config->io_backend = IO_BACKEND_URING;
+        } else {
+            ok = false;
+        }
+    } else if (key == "cache_size") {
+        ok = parse_size(value, &number);
+        config->cache_budget = number;
+    } else if (key == "max_connections") {
+        ok = parse_integer(value, 1, MAX_CONNECTIONS, &number);
+        config->admission.max_connections = number;
+    } else if (key == "high_water") {
+        ok = parse_integer(value, 0, MAX_CONNECTIONS, &number);
+        config->admission.high_water = number;
+    } else if (key == "retry_after") {
+        ok = parse_integer(value, 0, 86400, &number);
+        config->admission.retry_after_s = static_cast<int>(number);
+    } else if (key == "idle_timeout_ms") {
+        ok = parse_integer(value, 1, INT_MAX, &number);
+        config->timeouts.idle_ms = number;
+    } else if (key == "header_timeout_ms") {
+        ok = parse_integer(value, 1, INT_MAX, &number);
+        config->timeouts.header_ms = number;
+    } else if (key == "body_timeout_ms") {
+        ok = parse_integer(value, 1, INT_MAX, &number);
+        config->timeouts.body_ms = number;
+    } else if (key == "write_timeout_ms") {
+        ok = parse_integer(value, 1, INT_MAX, &number);
+        config->timeouts.write_ms = number;
+    } else if (key == "max_body_size") {
+        ok = parse_size(value, &number);
+        config->body_limits.max_size = number;
+    } else if (key == "body_memory_threshold") {
+        ok = parse_size(value, &number);
+        config->body_limits.memory_threshold = number;
+    } else if (key == "spill_dir") {
+        ok = !value.empty();
+        config->body_limits.spill_dir = std::string(value);
+    } else if (key == "event_batch") {
+        ok = parse_integer(value, 1, 65536, &number);
+        config->event_batch = static_cast<int>(number);
+    } else if (key == "read_per_event") {
+        ok = parse_size(value, &number) && number >= 4096;
+        config->read_per_event = number;
+    } else if (key == "write_per_event") {
+        ok = parse_size(value, &number) && number >= 4096;
+        config->write_per_event = number;
+    } else if (key == "uring_buffer_count") {
+        // 内核要求 buffer ring 的条目数为2的幂，最多32768
+        ok = parse_integer(value, 1, 32768, &number) && (number & (number - 1)) == 0;
+        config->uring_buffer_count = static_cast<unsigned>(number);
+    } else if (key == "uring_buffer_size") {
+        ok = parse_size(value, &number) && number >= 1024 && number <= 1024 * 1024;
+        config->uring_buffer_size = static_cast<unsigned>(number);
+    } else if (key == "log_level") {
+        if (equals_ignore_case(value, "debug")) {
+            config->log_level = DEBUG;
+        } else if (equals_ignore_case(value, "info")) {
+            config->log_level = INFO;
+        } else if (equals_ignore_case(value, "warn")) {
+            config->log_level = WARN;
+        } else if (equals_ignore_case(value, "error")) {
+            config->log_level = ERROR;
+        } else {
+            ok = false;
+        }
+    } else if (key == "log_async") {
+        ok = parse_bool(value, &config->log_async);
+    } else if (key == "log_console") {
+        ok = parse_bool(value, &config->log_console);
+    } else if (key == "log_flush_interval_ms") {
+        ok = parse_integer(value, 1, 60000, &number);
+        config->log_flush_interval_ms = static_cast<int>(number);
+    } else if (key == "log_full_policy") {
+        if (equals_ignore_case(value, "drop")) {
+            config->log_full_policy = LOG_DROP;
+        } else if (equals_ignore_case(value, "block")) {
+            config->log_full_policy = LOG_BLOCK;
+        } else {
+            ok = false;
+        }
+    } else if (key == "log_binary") {
+        ok = parse_bool(value, &config->log_binary);
+    } else if (key == "drain_timeout_ms") {
+        ok = parse_integer(value, 0, INT_MAX, &number);
+        config->drain_timeout_ms = number;
+    } else if (key == "proxy") {
+        // "<路由模式> <上游> [<上游> ...]"
+        ProxyRoute proxy;
+        size_t pos = 0;
+        while (pos < value.size()) {
+            size_t begin = value.find_first_not_of(" \t", pos);
+            if (begin == std::string_view::npos) {
+                break;
+            }
+            size_t end = std::min(value.find_first_of(" \t", begin), value.size());
+            std::string_view item = value.substr(begin, end - begin);
+            pos = end;
+            if (proxy.pattern.empty()) {
+                proxy.pattern = std::string(item);
+                continue;
+            }
+            UpstreamAddress address;
+            if (!parse_upstream_address(item, &address, error)) {
+                return false;
+            }
+            proxy.upstreams.push_back(address);
+        }
+        ok = !proxy.pattern.empty() && proxy.pattern[0] == '/' && !proxy.upstreams.empty();
+        if (ok) {
+            config->proxy_routes.push_back(std::move(proxy));
+        }
+    } else if (key == "proxy_balance") {
+        if (equals_ignore_case(value, "round_robin")) {
+            config->proxy.balance = PROXY_ROUND_ROBIN;
+        } else if (equals_ignore_case(value, "least_conn")) {
+            config->proxy.balance = PROXY_LEAST_CONN;
+        } else {
+            ok = false;
+        }
+    } else if (key == "proxy_connect_timeout_ms") {
+        ok = parse_integer(value, 1, INT_MAX, &number);
+        config->proxy.connect_timeout_ms = number;
+    } else if (key == "proxy_timeout_ms") {
+        ok = parse_integer(value, 1, INT_MAX, &number);
+        config->proxy.timeout_ms = number;
+    } else if (key == "proxy_keepalive") {
+        ok = parse_integer(value, 0, 65536, &number);
+        config->proxy.keepalive = number;
+    } else if (key == "proxy_max_fails") {
+        ok = parse_integer(value, 0, 1000, &number);
+        config->proxy.max_fails = static_cast<unsigned>(number);
+    } else if (key == "proxy_fail_timeout_ms") {
+        ok = parse_integer(value, 1, INT_MAX, &number);
+        config->proxy.fail_timeout_ms = number;
+    } else if (key == "microcache") {
+        // "<路由模式> <新鲜期ms> [<stale期ms>] [<请求头> ...]"
+        MicrocachePolicy policy;
+        int field = 0;
+        size_t pos = 0;
+        while (ok && pos < value.size()) {
+            size_t begin = value.find_first_not_of(" \t", pos);
+            if (begin == std::string_view::npos) {
+                break;
+            }
+            size_t end = std::min(value.find_first_of(" \t", begin), value.size());
+            std::string_view item = value.substr(begin, end - begin);
+            pos = end;
+            if (field == 0) {
+                policy.pattern = std::string(item);
+            } else if (field == 1) {
+                ok = parse_integer(item, 1, INT_MAX, &number);
+                policy.ttl_ms = number;
+            } else if (field == 2 && isdigit(static_cast<unsigned char>(item[0]))) {
+                ok = parse_integer(item, 0, INT_MAX, &number);
+                policy.stale_ms = number;
+            } else {
+                policy.vary.push_back(std::string(item));
+            }
+            ++field;
+        }
+        ok = ok && field >= 2 && policy.pattern[0] == '/';
+        if (ok) {
+            config->microcache.push_back(std::move(policy));
+        }
+    } else if (key == "microcache_size") {
+        ok = parse_size(value, &number);
+        config->microcache_budget = number;
+    } else if (key == "http2") {
+        ok = parse_bool(value, &config->http2);
+    } else if (key == "cpu_affinity") {
+        if (equals_ignore_case(value, "none")) {
+            config->affinity = AFFINITY_NONE;
+        } else if (equals_ignore_case(value, "auto")) {
+            config->affinity = AFFINITY_AUTO;
+        } else {
+            ok = parse_cpu_list(value, &config->cpu_list);
+            config->affinity = AFFINITY_LIST;
+        }
+    } else {
+        *error = "未知的配置项：" + std::string(key);
+        return false;
+    }
+
+    if (!ok) {
+        *error = "配置项 " + std::string(key) + " 的值无效：" + std::string(value);
+    }
+    return ok;
+}
+
+bool load_config_file(const std::string& path, ServerConfig* config, std::string* error) {
+    std::ifstream file(path);
+    if (!file) {
+        *error = "无法打开配置文件：" + path;
+        return false;
+    }
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line)) {
+        ++line_number;
+        std::string_view text = line;
+        text = trim(text.substr(0, text.find('#')));
+        if (text.empty()) {
+            continue;
+        }
+        size_t equal = text.find('=');
+        if (equal == std::string_view::npos) {
+            *error = path + ":" + std::to_string(line_number) + "：缺少 '='";
+            return false;
+        }
+        std::string reason;
+        if (!set_config_option(trim(text.substr(0, equal)), trim(text.substr(equal + 1)), config, &reason)) {
+            *error = path + ":" + std::to_string(line_number) + "：" + reason;
+            return false;
+        }
+    }
+    return true;
+}
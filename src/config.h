@@ -0,0 +1,51 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <string>
+#include <string_view>
+#include "server.h"
+
+// 配置文件格式：每行一个 "key = value"，'#' 之后为注释，空行忽略。命令行用 --key=value 覆盖。
+//
+//   port                    监听端口
+//   workers / reactors      工作线程数 / Reactor（事件循环）数
+//   io_backend              epoll | uring
+//   cache_size              静态资源缓存内存预算（大小可带 K/M/G 后缀）
+//   max_connections         连接数上限
+//   high_water              返回503的连接数阈值（0表示上限的90%）
+//   retry_after             503 响应的 Retry-After（秒）
+//   idle_timeout_ms / header_timeout_ms / body_timeout_ms / write_timeout_ms
+//   max_body_size           请求体大小上限
+//   body_memory_threshold   请求体超过后转存临时文件
+//   spill_dir               临时文件目录
+//   event_batch             一次 epoll_wait / 收割CQE 最多处理的事件数
+//   read_per_event          单次读事件最多读取的字节数
+//   write_per_event         单次写事件最多发送的字节数
+//   uring_buffer_count      io_uring 接收缓冲区数量（2的幂）
+//   uring_buffer_size       io_uring 接收缓冲区大小
+//   log_level               debug | info | warn | error
+//   log_async / log_console true | false
+//   log_flush_interval_ms   异步日志写线程批量写出的间隔
+//   log_full_policy         drop | block，日志缓冲区写满时丢弃并计数，或等待写线程腾出空间
+//   log_binary              true | false，写二进制日志 server.binlog（用 logdecode 还原为文本）
+//   cpu_affinity            none | auto | CPU列表（如 "0-3,8-11"）
+//   drain_timeout_ms        热升级（SIGUSR2）后旧进程等待已有连接处理完毕的时限
+//   http2                   true | false，是否接受明文 HTTP/2（h2c）
+//   proxy                   反向代理路由："<路由模式> <上游> [<上游> ...]"，可以出现多次，
+//                           上游为 host:port 或 unix:/path，例如 "proxy = /api/*path 127.0.0.1:9000 127.0.0.1:9001"
+//   proxy_balance           round_robin | least_conn
+//   proxy_connect_timeout_ms / proxy_timeout_ms   连接上游 / 两次读写之间的超时
+//   proxy_keepalive         每个Reactor对每个上游保留的空闲连接数
+//   proxy_max_fails / proxy_fail_timeout_ms       连续失败次数达到后在该时长内不再选择（0表示不检查）
+//   microcache              动态响应缓存："<路由模式> <新鲜期ms> [<stale期ms>] [<请求头> ...]"，可以出现多次，
+//                           对该模式注册的 GET/HEAD/POST 生效，列出的请求头参与缓存键，
+//                           例如 "microcache = /api/*path 1000 5000 Accept-Encoding"
+//   microcache_size         动态响应缓存内存预算
+
+// 设置单个配置项，配置文件和命令行共用；出错时 *error 给出原因
+bool set_config_option(std::string_view key, std::string_view value, ServerConfig* config, std::string* error);
+
+// 读取配置文件，出错时 *error 给出行号和原因
+bool load_config_file(const std::string& path, ServerConfig* config, std::string* error);
+
+#endif // CONFIG_H
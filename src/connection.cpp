@@ -0,0 +1,124 @@
+#include "connection.h"
+#include "utils.h"
+#include "http2.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include <unistd.h>
+#include <sys/mman.h>
+
+ConnectionSlab::ConnectionSlab(size_t capacity)
+    : slots_(nullptr), capacity_(capacity), constructed_(nullptr) {
+    // 匿名映射按页对齐（满足缓存行对齐），物理内存在槽位第一次被写入时才分配
+    void* mem = mmap(nullptr, sizeof(Connection) * capacity_, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem == MAP_FAILED) {
+        perror("mmap connection slab error");
+        exit(EXIT_FAILURE);
+    }
+    slots_ = static_cast<Connection*>(mem);
+    constructed_ = new std::atomic<uint8_t>[capacity_]();
+}
+
+ConnectionSlab::~ConnectionSlab() {
+    for (size_t i = 0; i < capacity_; ++i) {
+        if (constructed_[i].load(std::memory_order_relaxed)) {
+            slots_[i].~Connection();
+        }
+    }
+    munmap(slots_, sizeof(Connection) * capacity_);
+    delete[] constructed_;
+}
+
+Connection* ConnectionSlab::open(int fd, Reactor* reactor) {
+    if (fd < 0 || static_cast<size_t>(fd) >= capacity_) {
+        return nullptr;
+    }
+    Connection* conn = &slots_[fd];
+    if (!constructed_[fd].load(std::memory_order_relaxed)) {
+        new (conn) Connection();
+        constructed_[fd].store(1, std::memory_order_release);
+    }
+    conn->fd = fd;
+    conn->reactor = reactor;
+    conn->read_buffer.clear();
+    conn->clear_responses();
+    conn->parser.reset();
+    conn->body.reset();
+    conn->close_after_write = false;
+    conn->peer_closed = false;
+    conn->offload = Connection::OFFLOAD_NONE;
+    delete conn->h2;
+    conn->h2 = nullptr;
+    conn->timer_tick.store(-1, std::memory_order_relaxed);
+    conn->park.store(Connection::PARK_NONE, std::memory_order_relaxed);
+    conn->created_ms = current_time_ms();
+    conn->last_active_ms = conn->created_ms;
+    conn->request_started_ms = conn->created_ms;
+    conn->request_count = 0;
+    conn->inbox.clear();
+    conn->inbox_eof = false;
+    conn->scheduled = false;
+    conn->recv_paused = false;
+    conn->recv_active = false;
+    conn->upstream_ready = false;
+    // 最后置位：看到 active 的线程也能看到上面的初始化
+    conn->active.store(true, std::memory_order_release);
+    return conn;
+}
+
+Connection* ConnectionSlab::get(int fd, uint32_t generation) {
+    if (fd < 0 || static_cast<size_t>(fd) >= capacity_) {
+        return nullptr;
+    }
+    Connection* conn = &slots_[fd];
+    if (!constructed_[fd].load(std::memory_order_acquire) || !conn->active.load(std::memory_order_acquire) ||
+        conn->generation.load(std::memory_order_acquire) != generation) {
+        return nullptr;
+    }
+    return conn;
+}
+
+void ConnectionSlab::release(Connection* conn) {
+    conn->active.store(false, std::memory_order_release);
+    // 归还缓冲区分段，空闲槽位不占用缓冲区内存
+    conn->read_buffer.clear();
+    conn->clear_responses();
+    std::vector<Response>().swap(conn->responses);
+    conn->parser.reset();
+    conn->body.reset();
+    conn->close_after_write = false;
+    conn->peer_closed = false;
+    conn->offload = Connection::OFFLOAD_NONE;
+    conn->wait_key.clear();
+    conn->coalesced = false;
+    conn->lead_key.clear();
+    // 进行中的转发关闭上游连接
+    conn->exchange.reset();
+    // 会话中未发送完的响应（文件）一并释放
+    delete conn->h2;
+    conn->h2 = nullptr;
+    conn->inbox.clear();
+    conn->inbox_eof = false;
+    conn->scheduled = false;
+    conn->recv_paused = false;
+    conn->upstream_ready = false;
+    conn->reactor = nullptr;
+    conn->generation.fetch_add(1, std::memory_order_release);
+}
+
+void Response::close_file() {
+    if (file_fd != -1) {
+        close(file_fd);
+        file_fd = -1;
+    }
+    file_remaining = 0;
+}
+
+void Connection::clear_responses() {
+    for (size_t i = response_head; i < responses.size(); ++i) {
+        responses[i].close_file();
+    }
+    responses.clear();
+    response_head = 0;
+}
@@ -0,0 +1,251 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include "http_parser.h"
+#include "request_body.h"
+#include "io_buffer.h"
+
+struct Reactor;
+class Http2Session;
+class UpstreamExchange;
+
+static_assert(MAX_HEADER_SIZE < IO_SEGMENT_SIZE, "request header must fit in one read buffer segment");
+
+// 连接槽位数量上限，fd 大于等于该值的连接会被拒绝
+#define MAX_CONNECTIONS 65536
+
+// 流水线请求的最大排队响应数，达到后暂停解析，等队列发送完再继续
+#define MAX_PIPELINE_DEPTH 64
+
+// 逐段到达的响应体（如反向代理正在接收的上游响应）：发送时按需读取，客户端写不进去时不再读取，
+// 来源随之被TCP流量控制限速；读不到数据时由持有连接的线程挂起连接，等待 wait_fd 就绪
+class ResponseSource {
+public:
+    virtual ~ResponseSource() {}
+    // 读取下一段响应体（已去掉来源的分帧），返回字节数，0表示结束；暂时没有数据时返回-1且errno为EAGAIN，
+    // 其他错误（来源断开、超时、格式错误）返回-1，已发出的响应无法补救，只能中止
+    virtual ssize_t read(char* buf, size_t len) = 0;
+    // 等待的fd和事件（POLLIN/POLLOUT），以及截止时间：到期后无论fd是否就绪都唤醒连接
+    virtual int wait_fd() const = 0;
+    virtual uint32_t wait_events() const = 0;
+    virtual int64_t deadline_ms() const = 0;
+};
+
+// 一个待发送的响应：不可变的响应头片段 + 内存中的数据 + 可选的共享响应体 + 可选的文件体（sendfile发送）
+// 或逐段到达的响应体，各部分作为独立的iovec发送，不拼接
+struct Response {
+    // 状态行（静态表）或预生成的响应头（错误页、缓存资源），head_owner 持有其内存（静态内存时为空）
+    std::string_view head;
+    size_t head_offset;
+    std::shared_ptr<const void> head_owner;
+
+    std::string buffer;         // 逐个请求不同的响应头字段、结尾空行（以及小的动态响应体）
+    size_t buffer_offset;
+    size_t header_end;          // buffer 中结尾空行的位置，Connection 头部插入到这里
+    int status;                 // 状态码，用于指标统计
+
+    // 共享的只读响应体（如缓存中的静态资源），直接从这里发送，不做拷贝
+    std::shared_ptr<const std::string> body;
+    size_t body_offset;
+
+    // 文件体：前面的数据发送完毕后，用 sendfile 从 file_fd 直接发送到socket
+    int file_fd;
+    off_t file_offset;          // 下一次sendfile的起始偏移，部分发送后从这里继续
+    size_t file_remaining;      // 剩余未发送的字节数
+
+    // 逐段到达的响应体：前面的数据发送完毕后从 source 读取，读完后置空。
+    // source_chunked 时按 chunked 编码重新分帧（HTTP/1.1 客户端、长度未知）；
+    // source_buffer 中 source_offset 之后是已读出但还没写进socket的数据（含分块头）
+    std::shared_ptr<ResponseSource> source;
+    bool source_chunked;
+    bool source_blocked;        // 上一次读取没有数据，等待来源就绪
+    std::string source_buffer;
+    size_t source_offset;
+
+    // 属于前一个响应的后续部分（multipart/byteranges 的各个分段），不是独立的响应
+    bool continuation;
+
+    Response() : head_offset(0), buffer_offset(0), header_end(std::string::npos), status(0), body_offset(0),
+                 file_fd(-1), file_offset(0), file_remaining(0), source_chunked(false), source_blocked(false),
+                 source_offset(0), continuation(false) {}
+
+    // 内存中的部分（head、buffer和body）是否已全部发送
+    bool memory_sent() const {
+        return head_offset >= head.size() && buffer_offset >= buffer.size() &&
+               (!body || body_offset >= body->size());
+    }
+
+    // 关闭未发送完的文件
+    void close_file();
+};
+
+// 每个连接的全部状态。按缓存行对齐，避免不同线程处理的相邻连接发生伪共享。
+// 同一时刻只有一个线程拥有某个连接：epoll 使用 EPOLLONESHOT 注册，
+// 事件触发后该fd被禁用，直到持有者处理完毕并重新 arm。
+struct alignas(64) Connection {
+    int fd;
+    // 代数：槽位每次被释放时递增，过期的事件/任务据此识别并丢弃
+    std::atomic<uint32_t> generation;
+    // 槽位是否在使用：open 最后以 release 置位、release 最先清零，
+    // 不持有连接的线程（热升级时遍历槽位）以 acquire 读取
+    std::atomic<bool> active;
+    Reactor* reactor;           // 接受该连接的Reactor
+
+    IoBuffer read_buffer;       // 读缓冲区（池化分段，空闲时不占用内存）
+
+    // 待发送的响应队列，按请求顺序排列；response_head 之前的已发送完毕
+    std::vector<Response> responses;
+    size_t response_head;
+
+    // 增量解析状态，跨多次读取保存解析位置
+    HttpParser parser;
+    // 当前请求的请求体：请求头完整后开始接收，数据从读缓冲区移入，读缓冲区中只保留请求头
+    RequestBody body;
+    // 队列中最后一个响应要求关闭连接（Connection: close、HTTP/1.0、请求格式错误），
+    // 发送完毕后关闭，此后不再解析新的请求
+    bool close_after_write;
+    // 对端已关闭写方向，处理完已收到的请求后关闭
+    bool peer_closed;
+    // 当前请求匹配到需要转交线程池的路由（ROUTE_OFFLOAD）
+    enum OffloadState : uint8_t {
+        OFFLOAD_NONE,
+        OFFLOAD_PENDING,   // 停止解析，由持有连接的线程重新提交为新任务
+        OFFLOAD_READY,     // 新任务中重新解析到该请求时直接执行
+        OFFLOAD_WAITING,   // 同一缓存键的处理函数正在执行：停止解析，由持有连接的线程挂起，执行结束后重新提交
+        OFFLOAD_UPSTREAM,  // 处理函数在等待上游：停止解析，由持有连接的线程挂起，上游就绪后重新提交
+        OFFLOAD_RESUME     // 重新解析到该请求时回到挂起的处理函数，不再查找缓存
+    };
+    OffloadState offload;
+    std::string wait_key;   // OFFLOAD_WAITING 等待的缓存键
+    bool coalesced;         // 当前请求已作为等待者计数，重新处理时不再计入缓存指标
+    std::string lead_key;   // 正在执行、结果要放入缓存的缓存键（处理函数挂起期间保持）
+    // 反向代理：正在等待上游响应头的转发，处理函数重新执行时继续
+    std::shared_ptr<UpstreamExchange> exchange;
+    // HTTP/2 会话（h2c 前言或 Upgrade 之后），为空时按 HTTP/1.x 处理
+    Http2Session* h2;
+
+    // 时间戳（单调时钟，毫秒）
+    int64_t created_ms;
+    int64_t last_active_ms;
+    int64_t request_started_ms;   // 当前请求第一个字节到达的时间
+    uint32_t request_count;       // 已处理的请求数
+
+    // 超时截止时间和所处阶段：由持有连接的线程在重新arm前更新，Reactor的时间轮读取
+    std::atomic<int64_t> deadline_ms;
+    std::atomic<uint8_t> timeout_kind;
+    // 时间轮中该连接的有效条目所在的tick（-1表示没有），只由所属Reactor线程访问
+    std::atomic<int64_t> timer_tick;
+
+    // epoll 后端等待上游时的交接状态（见 Server::park_connection）。
+    // 挂起的连接同时在客户端和上游fd上等待，先到的事件把 PARK_WAITING 改为 PARK_CLAIMED 并取得连接；
+    // 持有期间到达的事件改为 PARK_MISSED，由持有者在交出连接之前补上
+    enum ParkState : uint8_t {
+        PARK_NONE,       // 按 EPOLLONESHOT 正常交接
+        PARK_WAITING,
+        PARK_CLAIMED,
+        PARK_MISSED
+    };
+    std::atomic<uint8_t> park;
+
+    // 关闭fd与超时处理中的shutdown互斥，保证shutdown不会作用到已被复用的fd上
+    std::mutex close_mutex;
+
+    // io_uring 后端：Reactor 收到的数据先追加到 inbox，由持有连接的工作线程取走
+    std::mutex inbox_mutex;
+    IoBuffer inbox;
+    bool inbox_eof;       // 对端关闭或接收出错
+    bool scheduled;       // 已有工作线程持有（或即将处理）该连接
+    bool recv_paused;     // inbox 积压过多，已取消接收，工作线程取走数据后恢复
+    bool recv_active;     // 是否有进行中的 multishot recv（只由 Reactor 线程访问）
+    bool upstream_ready;  // 持有期间等待的上游已就绪（或等待超时），交出前再处理一次
+
+    Connection() : fd(-1), generation(0), active(false), reactor(nullptr),
+                   response_head(0), close_after_write(false), peer_closed(false),
+                   offload(OFFLOAD_NONE), coalesced(false), h2(nullptr),
+                   created_ms(0), last_active_ms(0), request_started_ms(0), request_count(0),
+                   deadline_ms(0), timeout_kind(0), timer_tick(-1), park(PARK_NONE), inbox_eof(false),
+                   scheduled(false), recv_paused(false), recv_active(false), upstream_ready(false) {}
+
+    // 当前请求需要在新任务中重新执行（转交线程池、等待缓存结果或等待上游）
+    bool offload_pending() const {
+        return offload == OFFLOAD_PENDING || offload == OFFLOAD_WAITING || offload == OFFLOAD_UPSTREAM;
+    }
+
+    // 在队尾追加一个新响应
+    Response& add_response() {
+        responses.emplace_back();
+        return responses.back();
+    }
+
+    // 尚未发送完毕的响应数量
+    size_t pending_responses() const { return responses.size() - response_head; }
+
+    // 最后一个请求的响应（跳过 multipart 的后续分段），用于补充响应头
+    Response& last_response_head() {
+        size_t i = responses.size() - 1;
+        while (i > response_head && responses[i].continuation) {
+            --i;
+        }
+        return responses[i];
+    }
+
+    // 关闭所有未发送完的文件、释放逐段响应体的来源并清空响应队列
+    void clear_responses();
+};
+
+// 将 fd 和代数打包进 epoll_event.data.u64
+inline uint64_t pack_conn_key(int fd, uint32_t generation) {
+    return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+}
+
+inline int conn_key_fd(uint64_t key) {
+    return static_cast<int>(key & 0xffffffffu);
+}
+
+inline uint32_t conn_key_generation(uint64_t key) {
+    return static_cast<uint32_t>(key >> 32);
+}
+
+// 预分配（按需提交物理内存）、按fd下标索引的连接槽位表
+class ConnectionSlab {
+public:
+    explicit ConnectionSlab(size_t capacity = MAX_CONNECTIONS);
+    ~ConnectionSlab();
+
+    ConnectionSlab(const ConnectionSlab&) = delete;
+    ConnectionSlab& operator=(const ConnectionSlab&) = delete;
+
+    // 为新accept的fd初始化槽位，fd超出容量时返回nullptr
+    Connection* open(int fd, Reactor* reactor);
+
+    // 按fd和代数查找连接，代数不匹配（fd已被复用或已关闭）时返回nullptr
+    Connection* get(int fd, uint32_t generation);
+
+    // 释放槽位：清空状态（包括关闭未发送完的文件）并递增代数，必须在 close(fd) 之前调用
+    void release(Connection* conn);
+
+    size_t capacity() const { return capacity_; }
+
+    // 直接访问槽位（可能空闲），未构造过的槽位返回nullptr。用于遍历所有连接，调用方在 close_mutex 下判断状态
+    Connection* slot(size_t fd) {
+        return fd < capacity_ && constructed_[fd].load(std::memory_order_acquire) ? &slots_[fd] : nullptr;
+    }
+
+private:
+    Connection* slots_;
+    size_t capacity_;
+    // 槽位是否已构造：槽位在第一次使用时才构造，未用到的内存页不会被实际分配。
+    // 构造完成后以 release 置位，遍历槽位的线程据此安全地访问
+    std::atomic<uint8_t>* constructed_;
+};
+
+#endif // CONNECTION_H
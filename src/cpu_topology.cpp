@@ -0,0 +1,199 @@
+#include "cpu_topology.h"
+#include "logger.h"
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#define SYSFS_NODE_DIR "/sys/devices/system/node"
+
+bool parse_cpu_list(std::string_view text, std::vector<int>* cpus) {
+    cpus->clear();
+    while (!text.empty() && (text.back() == '\n' || text.back() == ' ')) {
+        text.remove_suffix(1);
+    }
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = std::min(text.find(',', pos), text.size());
+        std::string item(text.substr(pos, end - pos));
+        pos = end + 1;
+        char* rest = nullptr;
+        long first = strtol(item.c_str(), &rest, 10);
+        long last = first;
+        if (rest == item.c_str()) {
+            return false;
+        }
+        if (*rest == '-') {
+            const char* second = rest + 1;
+            last = strtol(second, &rest, 10);
+            if (rest == second) {
+                return false;
+            }
+        }
+        if (*rest != '\0' || first < 0 || last < first || last >= CPU_SETSIZE) {
+            return false;
+        }
+        for (long cpu = first; cpu <= last; ++cpu) {
+            cpus->push_back(static_cast<int>(cpu));
+        }
+    }
+    return !cpus->empty();
+}
+
+CpuTopology CpuTopology::detect() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        long count = sysconf(_SC_NPROCESSORS_ONLN);
+        for (long cpu = 0; cpu < count && cpu < CPU_SETSIZE; ++cpu) {
+            CPU_SET(cpu, &allowed);
+        }
+    }
+
+    // 每个 nodeN 目录下的 cpulist 列出该节点的CPU
+    std::vector<std::pair<int, std::vector<int>>> nodes;
+    DIR* dir = opendir(SYSFS_NODE_DIR);
+    if (dir != nullptr) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != nullptr) {
+            int node;
+            if (strncmp(entry->d_name, "node", 4) != 0 || sscanf(entry->d_name + 4, "%d", &node) != 1) {
+                continue;
+            }
+            std::ifstream file(std::string(SYSFS_NODE_DIR) + "/" + entry->d_name + "/cpulist");
+            std::string line;
+            std::vector<int> cpus;
+            if (!std::getline(file, line) || !parse_cpu_list(line, &cpus)) {
+                continue;
+            }
+            cpus.erase(std::remove_if(cpus.begin(), cpus.end(), [&allowed](int cpu) {
+                return !CPU_ISSET(cpu, &allowed);
+            }), cpus.end());
+            if (!cpus.empty()) {
+                nodes.emplace_back(node, std::move(cpus));
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(nodes.begin(), nodes.end());
+
+    CpuTopology topology;
+    for (auto& node : nodes) {
+        topology.node_ids.push_back(node.first);
+        topology.node_cpus.push_back(std::move(node.second));
+    }
+    if (topology.node_ids.empty()) {
+        std::vector<int> cpus;
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                cpus.push_back(cpu);
+            }
+        }
+        topology.node_ids.push_back(0);
+        topology.node_cpus.push_back(std::move(cpus));
+    }
+    return topology;
+}
+
+size_t CpuTopology::cpu_count() const {
+    size_t count = 0;
+    for (const auto& cpus : node_cpus) {
+        count += cpus.size();
+    }
+    return count;
+}
+
+int CpuTopology::node_of(int cpu) const {
+    for (size_t i = 0; i < node_cpus.size(); ++i) {
+        if (std::find(node_cpus[i].begin(), node_cpus[i].end(), cpu) != node_cpus[i].end()) {
+            return node_ids[i];
+        }
+    }
+    return -1;
+}
+
+void plan_thread_placement(const CpuTopology& topology, const std::vector<int>& cpu_list,
+                           size_t reactor_count, size_t worker_count,
+                           std::vector<ThreadPlacement>* reactors, std::vector<ThreadPlacement>* workers) {
+    reactors->assign(reactor_count, ThreadPlacement());
+    workers->assign(worker_count, ThreadPlacement());
+
+    if (!cpu_list.empty()) {
+        size_t next = 0;
+        auto assign = [&](ThreadPlacement& placement) {
+            int cpu = cpu_list[next++ % cpu_list.size()];
+            placement.cpus.push_back(cpu);
+            placement.node = topology.node_of(cpu);
+        };
+        std::for_each(reactors->begin(), reactors->end(), assign);
+        std::for_each(workers->begin(), workers->end(), assign);
+        return;
+    }
+
+    if (topology.cpu_count() == 0) {
+        return;
+    }
+    // 只使用放了Reactor的节点，工作线程和产生任务的Reactor在同一节点
+    size_t nodes = std::min(topology.node_ids.size(), std::max<size_t>(reactor_count, 1));
+    std::vector<size_t> threads_on(nodes, 0);
+    for (size_t i = 0; i < reactor_count; ++i) {
+        ++threads_on[i % nodes];
+    }
+    for (size_t i = 0; i < worker_count; ++i) {
+        ++threads_on[i % nodes];
+    }
+
+    std::vector<size_t> cursor(nodes, 0);
+    for (size_t i = 0; i < reactor_count; ++i) {
+        size_t n = i % nodes;
+        const std::vector<int>& cpus = topology.node_cpus[n];
+        (*reactors)[i].node = topology.node_ids[n];
+        (*reactors)[i].cpus.push_back(cpus[cursor[n]++ % cpus.size()]);
+    }
+    for (size_t i = 0; i < worker_count; ++i) {
+        size_t n = i % nodes;
+        const std::vector<int>& cpus = topology.node_cpus[n];
+        (*workers)[i].node = topology.node_ids[n];
+        if (threads_on[n] <= cpus.size()) {
+            (*workers)[i].cpus.push_back(cpus[cursor[n]++]);
+        } else {
+            // CPU不够每个线程独占一个：绑定到整个节点，由调度器在节点内均衡
+            (*workers)[i].cpus = cpus;
+        }
+    }
+}
+
+bool apply_thread_placement(const ThreadPlacement& placement) {
+    if (placement.cpus.empty()) {
+        return true;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : placement.cpus) {
+        CPU_SET(cpu, &set);
+    }
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        LOGF_WARN("绑定CPU失败：{}", strerror(errno));
+        return false;
+    }
+    if (placement.node >= 0) {
+        // 优先（而不是强制）在本节点分配：节点内存不足时仍可以使用其他节点
+        unsigned long mask[16] = {};
+        size_t bits = sizeof(unsigned long) * 8;
+        if (static_cast<size_t>(placement.node) < sizeof(mask) * 8) {
+            mask[placement.node / bits] |= 1UL << (placement.node % bits);
+            if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, sizeof(mask) * 8) != 0) {
+                LOGF_DEBUG("set_mempolicy() 错误：{}", strerror(errno));
+            }
+        }
+    }
+    return true;
+}
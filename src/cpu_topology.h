@@ -0,0 +1,43 @@
+#ifndef CPU_TOPOLOGY_H
+#define CPU_TOPOLOGY_H
+
+#include <string_view>
+#include <vector>
+#include <stddef.h>
+
+// 一个线程的绑定位置：cpus 为空表示不绑定
+struct ThreadPlacement {
+    int node;                // NUMA节点，-1表示未知
+    std::vector<int> cpus;   // 允许运行的CPU
+
+    ThreadPlacement() : node(-1) {}
+};
+
+// 从 /sys/devices/system/node 读取的CPU拓扑，只包含本进程允许使用的CPU（taskset/cgroup）
+struct CpuTopology {
+    std::vector<int> node_ids;                 // 有可用CPU的NUMA节点
+    std::vector<std::vector<int>> node_cpus;   // 与 node_ids 一一对应
+
+    // 没有NUMA信息时所有CPU归入节点0
+    static CpuTopology detect();
+
+    size_t cpu_count() const;
+    // CPU所在的NUMA节点，未知时返回-1
+    int node_of(int cpu) const;
+};
+
+// 解析 "0-3,8,10-11" 格式的CPU列表，格式错误时返回false
+bool parse_cpu_list(std::string_view text, std::vector<int>* cpus);
+
+// 计算Reactor和工作线程的绑定位置。
+// cpu_list 为空时自动布局：Reactor 轮流放在各个NUMA节点上，工作线程按Reactor所在的节点均分，
+// 同一节点内先给Reactor、再给工作线程各分一个CPU；节点上的线程多于CPU时工作线程绑定到整个节点。
+// cpu_list 非空时按顺序依次分给Reactor和工作线程（不够时循环使用）
+void plan_thread_placement(const CpuTopology& topology, const std::vector<int>& cpu_list,
+                           size_t reactor_count, size_t worker_count,
+                           std::vector<ThreadPlacement>* reactors, std::vector<ThreadPlacement>* workers);
+
+// 把当前线程绑定到指定的CPU，并让之后的内存分配优先落在其NUMA节点上
+bool apply_thread_placement(const ThreadPlacement& placement);
+
+#endif // CPU_TOPOLOGY_H
@@ -4,7 +4,7 @@
 #include <unistd.h>
 
 int create_epoll_fd() {
-    int epoll_fd = epoll_create1(0);
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
     if (epoll_fd == -1) {
         perror("epoll_create1 error");
         exit(EXIT_FAILURE);
@@ -44,3 +44,25 @@ void delete_fd_from_epoll(int epoll_fd, int fd) {
     }
 }
 
+
+bool add_fd_to_epoll(int epoll_fd, int fd, uint32_t events, uint64_t data) {
+    struct epoll_event ev;
+    ev.data.u64 = data;
+    ev.events = events;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        perror("epoll_ctl add error");
+        return false;
+    }
+    return true;
+}
+
+bool modify_fd_in_epoll(int epoll_fd, int fd, uint32_t events, uint64_t data) {
+    struct epoll_event ev;
+    ev.data.u64 = data;
+    ev.events = events;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+        perror("epoll_ctl mod error");
+        return false;
+    }
+    return true;
+}
@@ -3,11 +3,16 @@
 
 #include <sys/epoll.h>
 
-#define MAX_EVENTS 1
+// 每次epoll_wait批量取回的最大事件数
+#define MAX_EVENTS 1024
 
 int create_epoll_fd();
 void add_fd_to_epoll(int epoll_fd, int fd, bool enable_et);
 void modify_fd_in_epoll(int epoll_fd, int fd, uint32_t events);
 void delete_fd_from_epoll(int epoll_fd, int fd);
 
+// 以自定义的64位数据注册/修改fd（连接使用 fd + 代数 打包），失败时返回false，由调用方负责关闭
+bool add_fd_to_epoll(int epoll_fd, int fd, uint32_t events, uint64_t data);
+bool modify_fd_in_epoll(int epoll_fd, int fd, uint32_t events, uint64_t data);
+
 #endif // EPOLL_H
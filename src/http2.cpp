@@ -0,0 +1,1336 @@
+#include "http2.h"
+#include "logger.h"
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <ctype.h>
+#include <strings.h>
+
+struct HpackEntry {
+    std::string_view name;
+    std::string_view value;
+};
+
+// RFC 7541 附录A
+#define HPACK_STATIC_COUNT 61
+static const HpackEntry HPACK_STATIC_TABLE[HPACK_STATIC_COUNT] = {
+    { ":authority", "" },
+    { ":method", "GET" },
+    { ":method", "POST" },
+    { ":path", "/" },
+    { ":path", "/index.html" },
+    { ":scheme", "http" },
+    { ":scheme", "https" },
+    { ":status", "200" },
+    { ":status", "204" },
+    { ":status", "206" },
+    { ":status", "304" },
+    { ":status", "400" },
+    { ":status", "404" },
+    { ":status", "500" },
+    { "accept-charset", "" },
+    { "accept-encoding", "gzip, deflate" },
+    { "accept-language", "" },
+    { "accept-ranges", "" },
+    { "accept", "" },
+    { "access-control-allow-origin", "" },
+    { "age", "" },
+    { "allow", "" },
+    { "authorization", "" },
+    { "cache-control", "" },
+    { "content-disposition", "" },
+    { "content-encoding", "" },
+    { "content-language", "" },
+    { "content-length", "" },
+    { "content-location", "" },
+    { "content-range", "" },
+    { "content-type", "" },
+    { "cookie", "" },
+    { "date", "" },
+    { "etag", "" },
+    { "expect", "" },
+    { "expires", "" },
+    { "from", "" },
+    { "host", "" },
+    { "if-match", "" },
+    { "if-modified-since", "" },
+    { "if-none-match", "" },
+    { "if-range", "" },
+    { "if-unmodified-since", "" },
+    { "last-modified", "" },
+    { "link", "" },
+    { "location", "" },
+    { "max-forwards", "" },
+    { "proxy-authenticate", "" },
+    { "proxy-authorization", "" },
+    { "range", "" },
+    { "referer", "" },
+    { "refresh", "" },
+    { "retry-after", "" },
+    { "server", "" },
+    { "set-cookie", "" },
+    { "strict-transport-security", "" },
+    { "transfer-encoding", "" },
+    { "user-agent", "" },
+    { "vary", "" },
+    { "via", "" },
+    { "www-authenticate", "" },
+};
+
+// RFC 7541 附录B 中各符号（0-255 和 EOS）的码长。这套 Huffman 码是规范码（canonical）：
+// 同样长度的码按符号顺序连续分配，所以只需要码长就能还原出全部码字
+static const uint8_t HUFFMAN_CODE_LENGTHS[257] = {
+    13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+    28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+    6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+    5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+    13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+    7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+    15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+    6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+    20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+    24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+    22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+    21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+    26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+    19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+    20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+    26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    30,
+};
+
+#define HUFFMAN_MAX_LENGTH 30
+#define HUFFMAN_EOS 256
+
+// 按码长分组的解码表：长度为 len 的码字是 [first_code[len], first_code[len] + count[len])，
+// 对应的符号依次是 symbols[first_index[len]...]
+struct HuffmanTable {
+    uint32_t first_code[HUFFMAN_MAX_LENGTH + 1];
+    uint32_t count[HUFFMAN_MAX_LENGTH + 1];
+    uint32_t first_index[HUFFMAN_MAX_LENGTH + 1];
+    uint16_t symbols[257];
+
+    HuffmanTable() {
+        memset(count, 0, sizeof(count));
+        for (int symbol = 0; symbol < 257; ++symbol) {
+            ++count[HUFFMAN_CODE_LENGTHS[symbol]];
+        }
+        uint32_t code = 0;
+        uint32_t index = 0;
+        for (int len = 1; len <= HUFFMAN_MAX_LENGTH; ++len) {
+            first_code[len] = code;
+            first_index[len] = index;
+            code = (code + count[len]) << 1;
+            index += count[len];
+        }
+        uint32_t next[HUFFMAN_MAX_LENGTH + 1];
+        memcpy(next, first_index, sizeof(next));
+        for (int symbol = 0; symbol < 257; ++symbol) {
+            symbols[next[HUFFMAN_CODE_LENGTHS[symbol]]++] = static_cast<uint16_t>(symbol);
+        }
+    }
+};
+
+static const HuffmanTable& huffman_table() {
+    static const HuffmanTable table;
+    return table;
+}
+
+static bool huffman_decode(const uint8_t* data, size_t len, std::string* out) {
+    const HuffmanTable& table = huffman_table();
+    uint32_t code = 0;
+    int code_len = 0;
+    for (size_t i = 0; i < len; ++i) {
+        for (int bit = 7; bit >= 0; --bit) {
+            code = (code << 1) | ((data[i] >> bit) & 1);
+            ++code_len;
+            uint32_t offset = code - table.first_code[code_len];
+            if (offset < table.count[code_len]) {
+                uint16_t symbol = table.symbols[table.first_index[code_len] + offset];
+                if (symbol == HUFFMAN_EOS) {
+                    return false;
+                }
+                out->push_back(static_cast<char>(symbol));
+                code = 0;
+                code_len = 0;
+            } else if (code_len == HUFFMAN_MAX_LENGTH) {
+                return false;
+            }
+        }
+    }
+    // 结尾的填充不超过7位，且必须是 EOS 的前缀（全1）
+    return code_len <= 7 && code == (1u << code_len) - 1;
+}
+
+// N位前缀的整数（RFC 7541 5.1），超过32位的值视为错误
+static bool decode_integer(const uint8_t** pos, const uint8_t* end, int prefix_bits, uint64_t* value) {
+    const uint8_t* p = *pos;
+    if (p == end) {
+        return false;
+    }
+    uint64_t max_prefix = (1u << prefix_bits) - 1;
+    uint64_t result = *p++ & max_prefix;
+    if (result == max_prefix) {
+        unsigned shift = 0;
+        while (true) {
+            if (p == end || shift > 28) {
+                return false;
+            }
+            uint8_t byte = *p++;
+            result += static_cast<uint64_t>(byte & 0x7f) << shift;
+            shift += 7;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+        }
+    }
+    *pos = p;
+    *value = result;
+    return true;
+}
+
+static bool decode_string(const uint8_t** pos, const uint8_t* end, std::string* out) {
+    if (*pos == end) {
+        return false;
+    }
+    bool huffman = (**pos & 0x80) != 0;
+    uint64_t len;
+    if (!decode_integer(pos, end, 7, &len) || len > static_cast<uint64_t>(end - *pos)) {
+        return false;
+    }
+    out->clear();
+    const uint8_t* data = *pos;
+    *pos += len;
+    if (huffman) {
+        return huffman_decode(data, len, out);
+    }
+    out->assign(reinterpret_cast<const char*>(data), len);
+    return true;
+}
+
+static void encode_integer(uint64_t value, int prefix_bits, uint8_t first_byte, std::string* out) {
+    uint64_t max_prefix = (1u << prefix_bits) - 1;
+    if (value < max_prefix) {
+        out->push_back(static_cast<char>(first_byte | value));
+        return;
+    }
+    out->push_back(static_cast<char>(first_byte | max_prefix));
+    value -= max_prefix;
+    while (value >= 0x80) {
+        out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+}
+
+static void encode_string(std::string_view value, std::string* out) {
+    encode_integer(value.size(), 7, 0x00, out);
+    out->append(value);
+}
+
+void HeaderList::add(std::string_view name, std::string_view value) {
+    list_size += name.size() + value.size() + 32;
+    if (too_large || list_size > H2_MAX_HEADER_LIST_SIZE) {
+        too_large = true;
+        return;
+    }
+    Field field;
+    field.name_offset = static_cast<uint32_t>(data.size());
+    field.name_length = static_cast<uint32_t>(name.size());
+    data.append(name);
+    field.value_offset = static_cast<uint32_t>(data.size());
+    field.value_length = static_cast<uint32_t>(value.size());
+    data.append(value);
+    fields.push_back(field);
+}
+
+void HeaderList::clear() {
+    data.clear();
+    fields.clear();
+    list_size = 0;
+    too_large = false;
+}
+
+bool HpackDecoder::lookup(uint64_t index, std::string_view* name, std::string_view* value) const {
+    if (index == 0) {
+        return false;
+    }
+    if (index <= HPACK_STATIC_COUNT) {
+        *name = HPACK_STATIC_TABLE[index - 1].name;
+        *value = HPACK_STATIC_TABLE[index - 1].value;
+        return true;
+    }
+    index -= HPACK_STATIC_COUNT + 1;
+    if (index >= table_.size()) {
+        return false;
+    }
+    *name = table_[index].first;
+    *value = table_[index].second;
+    return true;
+}
+
+void HpackDecoder::evict(size_t limit) {
+    while (table_size_ > limit && !table_.empty()) {
+        table_size_ -= table_.back().first.size() + table_.back().second.size() + 32;
+        table_.pop_back();
+    }
+}
+
+void HpackDecoder::insert(std::string_view name, std::string_view value) {
+    size_t entry_size = name.size() + value.size() + 32;
+    // 名称可能引用即将被淘汰的条目，先拷贝
+    std::pair<std::string, std::string> entry{ std::string(name), std::string(value) };
+    if (entry_size > max_table_size_) {
+        // 比整个表还大的条目使表变空
+        evict(0);
+        return;
+    }
+    evict(max_table_size_ - entry_size);
+    table_size_ += entry_size;
+    table_.push_front(std::move(entry));
+}
+
+bool HpackDecoder::decode(const uint8_t* data, size_t len, HeaderList* headers) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + len;
+    std::string name_buffer;
+    std::string value_buffer;
+    bool field_seen = false;
+    while (p < end) {
+        uint8_t byte = *p;
+        uint64_t index;
+        std::string_view name;
+        std::string_view value;
+        if (byte & 0x80) {
+            // 索引字段
+            if (!decode_integer(&p, end, 7, &index) || !lookup(index, &name, &value)) {
+                return false;
+            }
+            headers->add(name, value);
+            field_seen = true;
+            continue;
+        }
+        if ((byte & 0xe0) == 0x20) {
+            // 动态表大小更新，只能出现在头部块开头，且不超过通告的 SETTINGS_HEADER_TABLE_SIZE
+            if (field_seen || !decode_integer(&p, end, 5, &index) || index > HPACK_TABLE_SIZE) {
+                return false;
+            }
+            max_table_size_ = static_cast<size_t>(index);
+            evict(max_table_size_);
+            continue;
+        }
+        // 字面量：带增量索引（01）、不索引（0000）、永不索引（0001）
+        bool indexing = (byte & 0xc0) == 0x40;
+        if (!decode_integer(&p, end, indexing ? 6 : 4, &index)) {
+            return false;
+        }
+        if (index == 0) {
+            if (!decode_string(&p, end, &name_buffer)) {
+                return false;
+            }
+            name = name_buffer;
+        } else {
+            std::string_view unused;
+            if (!lookup(index, &name, &unused)) {
+                return false;
+            }
+        }
+        if (!decode_string(&p, end, &value_buffer)) {
+            return false;
+        }
+        value = value_buffer;
+        headers->add(name, value);
+        if (indexing) {
+            insert(name, value);
+        }
+        field_seen = true;
+    }
+    return true;
+}
+
+void hpack_encode_status(int status, std::string* out) {
+    // 静态表中的 :status 直接索引
+    for (int i = 7; i < 14; ++i) {
+        const HpackEntry& entry = HPACK_STATIC_TABLE[i];
+        if (entry.value.size() == 3 && (entry.value[0] - '0') * 100 + (entry.value[1] - '0') * 10 +
+                                           (entry.value[2] - '0') == status) {
+            encode_integer(i + 1, 7, 0x80, out);
+            return;
+        }
+    }
+    char digits[3] = { static_cast<char>('0' + status / 100 % 10), static_cast<char>('0' + status / 10 % 10),
+                       static_cast<char>('0' + status % 10) };
+    // 不索引的字面量，名称取静态表第8项（:status）
+    encode_integer(8, 4, 0x00, out);
+    encode_string(std::string_view(digits, sizeof(digits)), out);
+}
+
+void hpack_encode_field(std::string_view name, std::string_view value, std::string* out) {
+    // 名称在静态表中时只写索引（从第15项开始是普通头部）
+    for (int i = 14; i < HPACK_STATIC_COUNT; ++i) {
+        if (HPACK_STATIC_TABLE[i].name == name) {
+            encode_integer(i + 1, 4, 0x00, out);
+            encode_string(value, out);
+            return;
+        }
+    }
+    out->push_back(0x00);
+    encode_string(name, out);
+    encode_string(value, out);
+}
+
+// HTTP/2 中禁止出现的连接相关头部（RFC 9113 8.2.2）
+static bool is_connection_specific(std::string_view name) {
+    static const std::string_view names[] = {
+        "connection", "keep-alive", "proxy-connection", "transfer-encoding", "upgrade"
+    };
+    for (std::string_view forbidden : names) {
+        if (name == forbidden) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void hpack_encode_http1_fields(std::string_view lines, std::string* out) {
+    char name[256];
+    while (!lines.empty()) {
+        size_t eol = lines.find("\r\n");
+        std::string_view line = lines.substr(0, eol);
+        lines = eol == std::string_view::npos ? std::string_view() : lines.substr(eol + 2);
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos || colon == 0 || colon > sizeof(name) || line.substr(0, 5) == "HTTP/") {
+            continue;
+        }
+        for (size_t i = 0; i < colon; ++i) {
+            name[i] = static_cast<char>(tolower(static_cast<unsigned char>(line[i])));
+        }
+        std::string_view lower(name, colon);
+        if (is_connection_specific(lower)) {
+            continue;
+        }
+        std::string_view value = line.substr(colon + 1);
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+            value.remove_prefix(1);
+        }
+        hpack_encode_field(lower, value, out);
+    }
+}
+
+Http2Stream::Http2Stream(uint32_t stream_id, int64_t initial_send_window)
+    : id(stream_id), remote_closed(false), queued(false), discard_body(false), error_status(0),
+      send_window(initial_send_window), recv_window(H2_STREAM_WINDOW), recv_unacked(0), response_head(0),
+      data_remaining(0), source_blocked(false) {}
+
+Http2Stream::~Http2Stream() {
+    for (size_t i = response_head; i < responses.size(); ++i) {
+        responses[i].close_file();
+    }
+}
+
+void Http2Stream::fill_request(HttpRequest* request) const {
+    request->version = "HTTP/2.0";
+    std::string_view authority;
+    bool has_host = false;
+    for (size_t i = 0; i < headers.size(); ++i) {
+        std::string_view name = headers.name(i);
+        std::string_view value = headers.value(i);
+        if (!name.empty() && name[0] == ':') {
+            if (name == ":method") {
+                request->method = value;
+            } else if (name == ":path") {
+                request->url = value;
+            } else if (name == ":authority") {
+                authority = value;
+            }
+            continue;
+        }
+        if (request->header_count < MAX_HEADERS) {
+            has_host = has_host || name == "host";
+            request->headers[request->header_count++] = HttpHeader{ name, value };
+        }
+    }
+    if (!has_host && !authority.empty() && request->header_count < MAX_HEADERS) {
+        request->headers[request->header_count++] = HttpHeader{ "host", authority };
+    }
+}
+
+static uint32_t read_u32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) << 24 | static_cast<uint32_t>(p[1]) << 16 |
+           static_cast<uint32_t>(p[2]) << 8 | p[3];
+}
+
+static void put_u32(char* p, uint32_t value) {
+    p[0] = static_cast<char>(value >> 24);
+    p[1] = static_cast<char>(value >> 16);
+    p[2] = static_cast<char>(value >> 8);
+    p[3] = static_cast<char>(value);
+}
+
+// 从分段缓冲区中拷贝一段数据
+static void copy_from(const IoBuffer& input, size_t offset, char* out, size_t len) {
+    while (len > 0) {
+        const char* data;
+        size_t n = std::min(input.peek(offset, &data), len);
+        memcpy(out, data, n);
+        out += n;
+        offset += n;
+        len -= n;
+    }
+}
+
+Http2Session::Http2Session(const BodyLimits* limits)
+    : limits_(limits), header_stream_(0), header_flags_(0), preface_received_(false), goaway_sent_(false),
+      goaway_received_(false), closing_(false), last_stream_id_(0), send_window_(H2_DEFAULT_WINDOW),
+      recv_window_(H2_DEFAULT_WINDOW), recv_unacked_(0), peer_initial_window_(H2_DEFAULT_WINDOW),
+      peer_max_frame_size_(H2_MAX_FRAME_SIZE) {}
+
+Http2Session::~Http2Session() {}
+
+void Http2Session::write_frame_header(uint32_t length, uint8_t type, uint8_t flags, uint32_t stream_id) {
+    char header[H2_FRAME_HEADER_SIZE];
+    header[0] = static_cast<char>(length >> 16);
+    header[1] = static_cast<char>(length >> 8);
+    header[2] = static_cast<char>(length);
+    header[3] = static_cast<char>(type);
+    header[4] = static_cast<char>(flags);
+    put_u32(header + 5, stream_id);
+    out_.append(header, sizeof(header));
+}
+
+void Http2Session::write_window_update(uint32_t stream_id, uint32_t increment) {
+    char payload[4];
+    put_u32(payload, increment);
+    write_frame_header(sizeof(payload), H2_WINDOW_UPDATE, 0, stream_id);
+    out_.append(payload, sizeof(payload));
+}
+
+void Http2Session::write_rst_stream(uint32_t stream_id, Http2Error code) {
+    char payload[4];
+    put_u32(payload, code);
+    write_frame_header(sizeof(payload), H2_RST_STREAM, 0, stream_id);
+    out_.append(payload, sizeof(payload));
+}
+
+void Http2Session::write_goaway(Http2Error code) {
+    char payload[8];
+    put_u32(payload, last_stream_id_);
+    put_u32(payload + 4, code);
+    write_frame_header(sizeof(payload), H2_GOAWAY, 0, 0);
+    out_.append(payload, sizeof(payload));
+    goaway_sent_ = true;
+}
+
+void Http2Session::start() {
+    static const struct {
+        uint16_t id;
+        uint32_t value;
+    } settings[] = {
+        { H2_SETTINGS_MAX_CONCURRENT_STREAMS, H2_MAX_CONCURRENT_STREAMS },
+        { H2_SETTINGS_INITIAL_WINDOW_SIZE, H2_STREAM_WINDOW },
+        { H2_SETTINGS_MAX_HEADER_LIST_SIZE, H2_MAX_HEADER_LIST_SIZE },
+    };
+    write_frame_header(sizeof(settings) / sizeof(settings[0]) * 6, H2_SETTINGS, 0, 0);
+    for (const auto& setting : settings) {
+        char entry[6];
+        entry[0] = static_cast<char>(setting.id >> 8);
+        entry[1] = static_cast<char>(setting.id);
+        put_u32(entry + 2, setting.value);
+        out_.append(entry, sizeof(entry));
+    }
+    write_window_update(0, H2_CONNECTION_WINDOW - H2_DEFAULT_WINDOW);
+    recv_window_ = H2_CONNECTION_WINDOW;
+}
+
+static int base64url_value(char c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '-' || c == '+') return 62;
+    if (c == '_' || c == '/') return 63;
+    return -1;
+}
+
+bool Http2Session::apply_upgrade_settings(std::string_view value) {
+    std::string payload;
+    uint32_t bits = 0;
+    int bit_count = 0;
+    for (char c : value) {
+        if (c == '=') {
+            break;
+        }
+        int v = base64url_value(c);
+        if (v < 0) {
+            return false;
+        }
+        bits = (bits << 6) | static_cast<uint32_t>(v);
+        bit_count += 6;
+        if (bit_count >= 8) {
+            bit_count -= 8;
+            payload.push_back(static_cast<char>(bits >> bit_count));
+        }
+    }
+    return payload.size() % 6 == 0 &&
+           apply_settings(reinterpret_cast<const uint8_t*>(payload.data()), payload.size()) == H2_NO_ERROR;
+}
+
+void Http2Session::open_upgrade_stream(const HttpRequest& request) {
+    std::unique_ptr<Http2Stream> stream(new Http2Stream(1, peer_initial_window_));
+    stream->headers.add(":method", request.method);
+    stream->headers.add(":scheme", "http");
+    stream->headers.add(":path", request.url);
+    for (size_t i = 0; i < request.header_count; ++i) {
+        std::string_view name = request.headers[i].name;
+        if (strncasecmp(name.data(), "http2-settings", name.size()) == 0 && name.size() == 14) {
+            continue;
+        }
+        std::string lower(name);
+        std::transform(lower.begin(), lower.end(), lower.begin(), ::tolower);
+        if (!is_connection_specific(lower)) {
+            stream->headers.add(lower, request.headers[i].value);
+        }
+    }
+    stream->remote_closed = true;
+    last_stream_id_ = 1;
+    Http2Stream* raw = stream.get();
+    streams_[1] = std::move(stream);
+    mark_ready(raw);
+}
+
+bool Http2Session::connection_error(Http2Error code, const char* reason) {
+    LOGF_DEBUG("HTTP/2 连接错误：{}（错误码 {}）", reason, static_cast<uint32_t>(code));
+    write_goaway(code);
+    closing_ = true;
+    return false;
+}
+
+void Http2Session::reset_stream(uint32_t stream_id, Http2Error code) {
+    LOGF_DEBUG("HTTP/2 重置流 {}（错误码 {}）", stream_id, static_cast<uint32_t>(code));
+    write_rst_stream(stream_id, code);
+    streams_.erase(stream_id);
+}
+
+bool Http2Session::receive(IoBuffer& input) {
+    if (closing_) {
+        return false;
+    }
+    if (!preface_received_) {
+        size_t n = std::min<size_t>(input.size(), H2_PREFACE_SIZE);
+        input.pullup(n);
+        if (memcmp(input.front_data(), H2_PREFACE, n) != 0) {
+            return connection_error(H2_PROTOCOL_ERROR, "连接前言不正确");
+        }
+        if (n < H2_PREFACE_SIZE) {
+            return true;
+        }
+        input.consume(H2_PREFACE_SIZE);
+        preface_received_ = true;
+    }
+
+    // 输出积压时暂停，剩余的帧留在缓冲区中，写出之后再继续（对端不读响应时不会无限排入 PING/SETTINGS 的应答）
+    while (out_.size() < H2_OUTPUT_LIMIT && input.size() >= H2_FRAME_HEADER_SIZE) {
+        uint8_t header[H2_FRAME_HEADER_SIZE];
+        copy_from(input, 0, reinterpret_cast<char*>(header), sizeof(header));
+        uint32_t length = static_cast<uint32_t>(header[0]) << 16 | static_cast<uint32_t>(header[1]) << 8 | header[2];
+        uint8_t type = header[3];
+        uint8_t flags = header[4];
+        uint32_t stream_id = read_u32(header + 5) & 0x7fffffff;
+        if (length > H2_MAX_FRAME_SIZE) {
+            return connection_error(H2_FRAME_SIZE_ERROR, "帧过大");
+        }
+        if (input.size() < H2_FRAME_HEADER_SIZE + length) {
+            break;
+        }
+        // 头部块没有结束时只能出现同一个流的 CONTINUATION
+        if (header_stream_ != 0 && (type != H2_CONTINUATION || stream_id != header_stream_)) {
+            return connection_error(H2_PROTOCOL_ERROR, "头部块被其他帧打断");
+        }
+
+        bool ok = true;
+        if (type == H2_DATA) {
+            // 请求体数据不拷贝，直接从读缓冲区交给流的请求体
+            ok = on_data(input, flags, stream_id, length);
+        } else {
+            payload_.resize(length);
+            copy_from(input, H2_FRAME_HEADER_SIZE, &payload_[0], length);
+            switch (type) {
+            case H2_HEADERS:
+                ok = on_headers(flags, stream_id);
+                break;
+            case H2_CONTINUATION:
+                ok = on_continuation(flags, stream_id);
+                break;
+            case H2_PRIORITY:
+                // 不做优先级调度，只检查格式
+                if (stream_id == 0) {
+                    ok = connection_error(H2_PROTOCOL_ERROR, "PRIORITY 的流ID为0");
+                } else if (length != 5) {
+                    reset_stream(stream_id, H2_FRAME_SIZE_ERROR);
+                }
+                break;
+            case H2_RST_STREAM:
+                ok = on_rst_stream(stream_id);
+                break;
+            case H2_SETTINGS:
+                ok = on_settings(flags, stream_id);
+                break;
+            case H2_PUSH_PROMISE:
+                ok = connection_error(H2_PROTOCOL_ERROR, "客户端发送了 PUSH_PROMISE");
+                break;
+            case H2_PING:
+                ok = on_ping(flags, stream_id);
+                break;
+            case H2_GOAWAY:
+                ok = on_goaway(stream_id);
+                break;
+            case H2_WINDOW_UPDATE:
+                ok = on_window_update(stream_id);
+                break;
+            default:
+                // 未知类型的帧忽略
+                break;
+            }
+        }
+        input.consume(H2_FRAME_HEADER_SIZE + length);
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Http2Session::credit_connection(uint32_t length) {
+    recv_unacked_ += length;
+    if (recv_unacked_ >= H2_CONNECTION_WINDOW / 2) {
+        write_window_update(0, recv_unacked_);
+        recv_window_ += recv_unacked_;
+        recv_unacked_ = 0;
+    }
+}
+
+void Http2Session::credit_stream(Http2Stream* stream, uint32_t length) {
+    stream->recv_unacked += length;
+    // 对端已结束发送的流不再需要窗口
+    if (!stream->remote_closed && stream->recv_unacked >= H2_STREAM_WINDOW / 2) {
+        write_window_update(stream->id, stream->recv_unacked);
+        stream->recv_window += stream->recv_unacked;
+        stream->recv_unacked = 0;
+    }
+}
+
+bool Http2Session::on_data(IoBuffer& input, uint8_t flags, uint32_t stream_id, uint32_t length) {
+    if (stream_id == 0) {
+        return connection_error(H2_PROTOCOL_ERROR, "DATA 的流ID为0");
+    }
+    size_t offset = H2_FRAME_HEADER_SIZE;
+    size_t data_len = length;
+    if (flags & H2_FLAG_PADDED) {
+        uint8_t pad = 0;
+        if (length < 1) {
+            return connection_error(H2_FRAME_SIZE_ERROR, "DATA 缺少填充长度");
+        }
+        copy_from(input, offset, reinterpret_cast<char*>(&pad), 1);
+        if (pad >= length) {
+            return connection_error(H2_PROTOCOL_ERROR, "DATA 填充过长");
+        }
+        offset += 1;
+        data_len = length - 1 - pad;
+    }
+    // 整个帧（包括填充）都计入流量控制
+    recv_window_ -= length;
+    if (recv_window_ < 0) {
+        return connection_error(H2_FLOW_CONTROL_ERROR, "超出连接接收窗口");
+    }
+    credit_connection(length);
+
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end()) {
+        if (stream_id > last_stream_id_) {
+            return connection_error(H2_PROTOCOL_ERROR, "DATA 属于未打开的流");
+        }
+        // 已关闭的流（例如提前响应后重置的流）上仍在路上的数据，直接丢弃
+        return true;
+    }
+    Http2Stream* stream = it->second.get();
+    if (stream->remote_closed) {
+        reset_stream(stream_id, H2_STREAM_CLOSED);
+        return true;
+    }
+    stream->recv_window -= length;
+    if (stream->recv_window < 0) {
+        reset_stream(stream_id, H2_FLOW_CONTROL_ERROR);
+        return true;
+    }
+    credit_stream(stream, length);
+
+    if (!stream->discard_body) {
+        while (data_len > 0) {
+            const char* data;
+            size_t n = std::min(input.peek(offset, &data), data_len);
+            size_t consumed = 0;
+            BodyResult result = stream->body.consume(data, n, &consumed);
+            if (result == BODY_TOO_LARGE || result == BODY_IO_ERROR) {
+                if (result == BODY_IO_ERROR) {
+                    LOG_ERROR("请求体写入临时文件失败：" + std::string(strerror(errno)));
+                }
+                stream->error_status = result == BODY_TOO_LARGE ? 413 : 500;
+                stream->discard_body = true;
+                stream->body.reset();
+                mark_ready(stream);
+                break;
+            }
+            if (result == BODY_BAD_REQUEST || consumed < n) {
+                // 数据超出了 Content-Length
+                reset_stream(stream_id, H2_PROTOCOL_ERROR);
+                return true;
+            }
+            offset += n;
+            data_len -= n;
+        }
+    }
+    if (flags & H2_FLAG_END_STREAM) {
+        end_stream(stream);
+    }
+    return true;
+}
+
+void Http2Session::end_stream(Http2Stream* stream) {
+    stream->remote_closed = true;
+    if (stream->discard_body) {
+        return;
+    }
+    if (!stream->body.finish()) {
+        // 请求体比 Content-Length 短
+        reset_stream(stream->id, H2_PROTOCOL_ERROR);
+        return;
+    }
+    mark_ready(stream);
+}
+
+void Http2Session::mark_ready(Http2Stream* stream) {
+    if (!stream->queued) {
+        stream->queued = true;
+        ready_.push_back(stream->id);
+    }
+}
+
+bool Http2Session::on_headers(uint8_t flags, uint32_t stream_id) {
+    if (stream_id == 0) {
+        return connection_error(H2_PROTOCOL_ERROR, "HEADERS 的流ID为0");
+    }
+    size_t begin = 0;
+    size_t end = payload_.size();
+    if (flags & H2_FLAG_PADDED) {
+        if (end < 1) {
+            return connection_error(H2_FRAME_SIZE_ERROR, "HEADERS 缺少填充长度");
+        }
+        size_t pad = static_cast<uint8_t>(payload_[0]);
+        begin = 1;
+        if (pad > end - begin) {
+            return connection_error(H2_PROTOCOL_ERROR, "HEADERS 填充过长");
+        }
+        end -= pad;
+    }
+    if (flags & H2_FLAG_PRIORITY) {
+        if (end - begin < 5) {
+            return connection_error(H2_FRAME_SIZE_ERROR, "HEADERS 优先级字段不完整");
+        }
+        begin += 5;
+    }
+    header_block_.assign(payload_, begin, end - begin);
+    header_stream_ = stream_id;
+    header_flags_ = flags;
+    if (flags & H2_FLAG_END_HEADERS) {
+        return on_header_block();
+    }
+    return true;
+}
+
+bool Http2Session::on_continuation(uint8_t flags, uint32_t stream_id) {
+    if (header_stream_ == 0 || stream_id != header_stream_) {
+        return connection_error(H2_PROTOCOL_ERROR, "CONTINUATION 之前没有未结束的头部块");
+    }
+    if (header_block_.size() + payload_.size() > H2_MAX_HEADER_BLOCK) {
+        return connection_error(H2_ENHANCE_YOUR_CALM, "头部块过大");
+    }
+    header_block_.append(payload_);
+    if (flags & H2_FLAG_END_HEADERS) {
+        return on_header_block();
+    }
+    return true;
+}
+
+bool Http2Session::on_header_block() {
+    uint32_t stream_id = header_stream_;
+    bool end = (header_flags_ & H2_FLAG_END_STREAM) != 0;
+    header_stream_ = 0;
+
+    // 无论流最终是否被接受，头部块都要解码，保持 HPACK 动态表与对端同步
+    HeaderList headers;
+    if (!decoder_.decode(reinterpret_cast<const uint8_t*>(header_block_.data()), header_block_.size(), &headers)) {
+        return connection_error(H2_COMPRESSION_ERROR, "HPACK 解码失败");
+    }
+
+    auto it = streams_.find(stream_id);
+    if (it != streams_.end()) {
+        // 已打开的流上的第二个头部块是尾部字段：不使用，但必须结束请求
+        Http2Stream* stream = it->second.get();
+        if (stream->remote_closed) {
+            reset_stream(stream_id, H2_STREAM_CLOSED);
+        } else if (!end) {
+            reset_stream(stream_id, H2_PROTOCOL_ERROR);
+        } else {
+            end_stream(stream);
+        }
+        return true;
+    }
+    if ((stream_id & 1) == 0 || stream_id <= last_stream_id_) {
+        return connection_error(H2_PROTOCOL_ERROR, "流ID不合法");
+    }
+    last_stream_id_ = stream_id;
+    if (goaway_sent_ || streams_.size() >= H2_MAX_CONCURRENT_STREAMS) {
+        write_rst_stream(stream_id, H2_REFUSED_STREAM);
+        return true;
+    }
+
+    std::unique_ptr<Http2Stream> stream(new Http2Stream(stream_id, peer_initial_window_));
+    stream->headers = std::move(headers);
+    Http2Stream* raw = stream.get();
+    streams_[stream_id] = std::move(stream);
+    if (!begin_stream(raw, end)) {
+        reset_stream(stream_id, H2_PROTOCOL_ERROR);
+    }
+    return true;
+}
+
+bool Http2Session::begin_stream(Http2Stream* stream, bool end) {
+    const HeaderList& headers = stream->headers;
+    std::string_view method;
+    std::string_view path;
+    std::string_view scheme;
+    std::string_view content_length;
+    size_t regular = 0;
+    for (size_t i = 0; i < headers.size(); ++i) {
+        std::string_view name = headers.name(i);
+        std::string_view value = headers.value(i);
+        if (name.empty()) {
+            return false;
+        }
+        if (name[0] == ':') {
+            // 伪头部只能出现在普通字段之前，且每个只能出现一次
+            std::string_view* target = name == ":method" ? &method : name == ":path" ? &path :
+                                       name == ":scheme" ? &scheme : nullptr;
+            if (regular > 0 || (target == nullptr && name != ":authority") || (target && !target->empty())) {
+                return false;
+            }
+            if (target != nullptr) {
+                *target = value;
+            }
+            continue;
+        }
+        ++regular;
+        for (char c : name) {
+            if (c >= 'A' && c <= 'Z') {
+                return false;
+            }
+        }
+        if (is_connection_specific(name) || (name == "te" && value != "trailers")) {
+            return false;
+        }
+        if (name == "content-length") {
+            content_length = value;
+        }
+    }
+    if (method.empty() || path.empty() || scheme.empty()) {
+        return false;
+    }
+
+    if (headers.too_large || regular > MAX_HEADERS) {
+        stream->error_status = 431;
+    }
+    uint64_t length = 0;
+    if (!content_length.empty()) {
+        if (!parse_decimal(content_length, &length) || (end && length != 0)) {
+            return false;
+        }
+        if (length > limits_->max_size) {
+            stream->error_status = 413;
+        }
+    }
+    if (stream->error_status != 0) {
+        // 不必等请求体，直接响应
+        stream->discard_body = true;
+        stream->remote_closed = end;
+        mark_ready(stream);
+        return true;
+    }
+    if (end) {
+        stream->remote_closed = true;
+        mark_ready(stream);
+    } else if (!content_length.empty()) {
+        stream->body.begin(false, length, limits_);
+    } else {
+        stream->body.begin_unframed(limits_);
+    }
+    return true;
+}
+
+bool Http2Session::on_settings(uint8_t flags, uint32_t stream_id) {
+    if (stream_id != 0) {
+        return connection_error(H2_PROTOCOL_ERROR, "SETTINGS 的流ID不为0");
+    }
+    if (flags & H2_FLAG_ACK) {
+        return payload_.empty() ? true : connection_error(H2_FRAME_SIZE_ERROR, "SETTINGS ACK 带有负载");
+    }
+    if (payload_.size() % 6 != 0) {
+        return connection_error(H2_FRAME_SIZE_ERROR, "SETTINGS 长度不是6的倍数");
+    }
+    Http2Error error = apply_settings(reinterpret_cast<const uint8_t*>(payload_.data()), payload_.size());
+    if (error != H2_NO_ERROR) {
+        return connection_error(error, "SETTINGS 的值不合法");
+    }
+    write_frame_header(0, H2_SETTINGS, H2_FLAG_ACK, 0);
+    return true;
+}
+
+Http2Error Http2Session::apply_settings(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i + 6 <= len; i += 6) {
+        uint16_t id = static_cast<uint16_t>(data[i] << 8 | data[i + 1]);
+        uint32_t value = read_u32(data + i + 2);
+        switch (id) {
+        case H2_SETTINGS_ENABLE_PUSH:
+            if (value > 1) {
+                return H2_PROTOCOL_ERROR;
+            }
+            break;
+        case H2_SETTINGS_INITIAL_WINDOW_SIZE: {
+            if (value > 0x7fffffff) {
+                return H2_FLOW_CONTROL_ERROR;
+            }
+            // 已打开的流的发送窗口按差值调整，可能变为负数
+            int64_t delta = static_cast<int64_t>(value) - peer_initial_window_;
+            peer_initial_window_ = value;
+            for (auto& entry : streams_) {
+                entry.second->send_window += delta;
+                if (entry.second->send_window > 0x7fffffff) {
+                    return H2_FLOW_CONTROL_ERROR;
+                }
+            }
+            break;
+        }
+        case H2_SETTINGS_MAX_FRAME_SIZE:
+            if (value < H2_MAX_FRAME_SIZE || value > 0xffffff) {
+                return H2_PROTOCOL_ERROR;
+            }
+            peer_max_frame_size_ = value;
+            break;
+        default:
+            // 响应头不使用动态表，HEADER_TABLE_SIZE 无需处理；其余设置和未知设置忽略
+            break;
+        }
+    }
+    return H2_NO_ERROR;
+}
+
+bool Http2Session::on_rst_stream(uint32_t stream_id) {
+    if (stream_id == 0 || stream_id > last_stream_id_) {
+        return connection_error(H2_PROTOCOL_ERROR, "RST_STREAM 的流不存在");
+    }
+    if (payload_.size() != 4) {
+        return connection_error(H2_FRAME_SIZE_ERROR, "RST_STREAM 长度不为4");
+    }
+    // 对端取消了请求：丢弃流和尚未生成的响应
+    streams_.erase(stream_id);
+    return true;
+}
+
+bool Http2Session::on_ping(uint8_t flags, uint32_t stream_id) {
+    if (stream_id != 0) {
+        return connection_error(H2_PROTOCOL_ERROR, "PING 的流ID不为0");
+    }
+    if (payload_.size() != 8) {
+        return connection_error(H2_FRAME_SIZE_ERROR, "PING 长度不为8");
+    }
+    if (!(flags & H2_FLAG_ACK)) {
+        write_frame_header(8, H2_PING, H2_FLAG_ACK, 0);
+        out_.append(payload_.data(), 8);
+    }
+    return true;
+}
+
+bool Http2Session::on_goaway(uint32_t stream_id) {
+    if (stream_id != 0) {
+        return connection_error(H2_PROTOCOL_ERROR, "GOAWAY 的流ID不为0");
+    }
+    if (payload_.size() < 8) {
+        return connection_error(H2_FRAME_SIZE_ERROR, "GOAWAY 长度不足");
+    }
+    // 服务器不主动创建流，已有的流照常完成，之后关闭连接
+    goaway_received_ = true;
+    return true;
+}
+
+bool Http2Session::on_window_update(uint32_t stream_id) {
+    if (payload_.size() != 4) {
+        return connection_error(H2_FRAME_SIZE_ERROR, "WINDOW_UPDATE 长度不为4");
+    }
+    uint32_t increment = read_u32(reinterpret_cast<const uint8_t*>(payload_.data())) & 0x7fffffff;
+    if (stream_id == 0) {
+        if (increment == 0) {
+            return connection_error(H2_PROTOCOL_ERROR, "WINDOW_UPDATE 增量为0");
+        }
+        send_window_ += increment;
+        if (send_window_ > 0x7fffffff) {
+            return connection_error(H2_FLOW_CONTROL_ERROR, "连接发送窗口溢出");
+        }
+        return true;
+    }
+    auto it = streams_.find(stream_id);
+    if (it == streams_.end()) {
+        // 已关闭的流，忽略
+        return true;
+    }
+    Http2Stream* stream = it->second.get();
+    if (increment == 0) {
+        reset_stream(stream_id, H2_PROTOCOL_ERROR);
+        return true;
+    }
+    stream->send_window += increment;
+    if (stream->send_window > 0x7fffffff) {
+        reset_stream(stream_id, H2_FLOW_CONTROL_ERROR);
+    }
+    return true;
+}
+
+Http2Stream* Http2Session::next_ready() {
+    while (!ready_.empty()) {
+        auto it = streams_.find(ready_.front());
+        if (it != streams_.end()) {
+            return it->second.get();
+        }
+        // 在处理之前就被对端重置了
+        ready_.pop_front();
+    }
+    return nullptr;
+}
+
+void Http2Session::pop_ready() {
+    ready_.pop_front();
+}
+
+void Http2Session::submit_response(Http2Stream* stream, const std::string& header_block) {
+    stream->data_remaining = 0;
+    for (size_t i = stream->response_head; i < stream->responses.size(); ++i) {
+        const Response& response = stream->responses[i];
+        stream->data_remaining += response.buffer.size() - response.buffer_offset + response.file_remaining;
+        if (response.body) {
+            stream->data_remaining += response.body->size() - response.body_offset;
+        }
+    }
+    for (Response& response : stream->responses) {
+        if (response.source) {
+            stream->source = std::move(response.source);
+        }
+    }
+    bool end = stream->data_remaining == 0 && !stream->source;
+
+    // 头部块超过对端的帧大小时拆成 HEADERS + CONTINUATION
+    size_t frame_size = std::min<size_t>(peer_max_frame_size_, H2_MAX_FRAME_SIZE);
+    size_t offset = 0;
+    do {
+        size_t n = std::min(frame_size, header_block.size() - offset);
+        bool last = offset + n == header_block.size();
+        uint8_t flags = (last ? H2_FLAG_END_HEADERS : 0) | (offset == 0 && end ? H2_FLAG_END_STREAM : 0);
+        write_frame_header(static_cast<uint32_t>(n), offset == 0 ? H2_HEADERS : H2_CONTINUATION, flags, stream->id);
+        out_.append(header_block.data() + offset, n);
+        offset += n;
+    } while (offset < header_block.size());
+
+    if (end) {
+        close_stream(stream);
+    } else {
+        sending_.push_back(stream->id);
+    }
+}
+
+void Http2Session::close_stream(Http2Stream* stream) {
+    if (!stream->remote_closed) {
+        write_rst_stream(stream->id, H2_NO_ERROR);
+    }
+    streams_.erase(stream->id);
+}
+
+void Http2Session::shutdown() {
+    if (!goaway_sent_ && !closing_) {
+        write_goaway(H2_NO_ERROR);
+    }
+}
+
+bool Http2Session::has_open_streams() const {
+    for (const auto& entry : streams_) {
+        if (!entry.second->remote_closed) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Http2Session::wants_write() const {
+    if (!out_.empty()) {
+        return true;
+    }
+    if (closing_ || send_window_ <= 0) {
+        return false;
+    }
+    for (uint32_t id : sending_) {
+        auto it = streams_.find(id);
+        if (it != streams_.end() && it->second->send_window > 0 && !it->second->source_blocked) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Http2Session::has_pending_data() const {
+    for (uint32_t id : sending_) {
+        auto it = streams_.find(id);
+        if (it != streams_.end() && (it->second->data_remaining > 0 || !it->second->source_blocked)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Http2Session::blocked_sources(std::vector<ResponseSource*>* sources) const {
+    for (uint32_t id : sending_) {
+        auto it = streams_.find(id);
+        if (it != streams_.end() && it->second->source_blocked && it->second->data_remaining == 0) {
+            sources->push_back(it->second->source.get());
+        }
+    }
+}
+
+bool Http2Session::produce() {
+    if (closing_) {
+        return true;
+    }
+    // 等待来源的流重新尝试读取
+    for (uint32_t id : sending_) {
+        auto it = streams_.find(id);
+        if (it != streams_.end()) {
+            it->second->source_blocked = false;
+        }
+    }
+    // 一轮中每个流最多生成一帧，多个流的 DATA 帧交错排在同一个输出缓冲区里，一次 sendmsg 写出
+    bool progress = true;
+    while (progress && out_.size() < H2_OUTPUT_LIMIT && send_window_ > 0 && !sending_.empty()) {
+        progress = false;
+        size_t count = sending_.size();
+        for (size_t i = 0; i < count && out_.size() < H2_OUTPUT_LIMIT && send_window_ > 0; ++i) {
+            uint32_t id = sending_.front();
+            sending_.pop_front();
+            auto it = streams_.find(id);
+            if (it == streams_.end()) {
+                continue;
+            }
+            Http2Stream* stream = it->second.get();
+            if (stream->send_window <= 0) {
+                // 等待该流的 WINDOW_UPDATE
+                sending_.push_back(id);
+                continue;
+            }
+            if (stream->data_remaining > 0) {
+                if (!write_data_frame(stream)) {
+                    return false;
+                }
+                progress = true;
+            } else if (!write_source_frame(stream, &progress)) {
+                // 响应头已经发出：只能重置该流，其他流不受影响
+                LOGF_WARN("HTTP/2 流 {} 的响应体来源出错：{}", id, strerror(errno));
+                reset_stream(id, H2_INTERNAL_ERROR);
+                continue;
+            }
+            if (stream->data_remaining > 0 || stream->source) {
+                sending_.push_back(id);
+            } else {
+                close_stream(stream);
+            }
+        }
+    }
+    return true;
+}
+
+bool Http2Session::write_data_frame(Http2Stream* stream) {
+    uint64_t length = std::min<uint64_t>(stream->data_remaining, std::min(send_window_, stream->send_window));
+    length = std::min<uint64_t>(length, std::min<uint32_t>(peer_max_frame_size_, H2_MAX_FRAME_SIZE));
+    bool end = length == stream->data_remaining && !stream->source;
+    write_frame_header(static_cast<uint32_t>(length), H2_DATA, end ? H2_FLAG_END_STREAM : 0, stream->id);
+
+    // 依次取各个响应的内存数据、共享响应体和文件（pread 直接读进输出缓冲区）
+    size_t left = static_cast<size_t>(length);
+    while (left > 0) {
+        Response& response = stream->responses[stream->response_head];
+        if (response.buffer_offset < response.buffer.size()) {
+            size_t n = std::min(left, response.buffer.size() - response.buffer_offset);
+            out_.append(response.buffer.data() + response.buffer_offset, n);
+            response.buffer_offset += n;
+            left -= n;
+        } else if (response.body && response.body_offset < response.body->size()) {
+            size_t n = std::min(left, response.body->size() - response.body_offset);
+            out_.append(response.body->data() + response.body_offset, n);
+            response.body_offset += n;
+            left -= n;
+        } else if (response.file_remaining > 0) {
+            size_t n = std::min(left, response.file_remaining);
+            ssize_t read = out_.pread_from(response.file_fd, response.file_offset, n);
+            if (read != static_cast<ssize_t>(n)) {
+                if (read >= 0) {
+                    errno = EIO;
+                }
+                return false;
+            }
+            response.file_offset += n;
+            response.file_remaining -= n;
+            left -= n;
+        } else {
+            response.close_file();
+            response.buffer.clear();
+            response.body.reset();
+            response.head_owner.reset();
+            ++stream->response_head;
+        }
+    }
+    stream->data_remaining -= length;
+    stream->send_window -= length;
+    send_window_ -= length;
+    return true;
+}
+
+bool Http2Session::write_source_frame(Http2Stream* stream, bool* progress) {
+    if (stream->source_blocked) {
+        return true;
+    }
+    int64_t window = std::min(send_window_, stream->send_window);
+    size_t length = std::min<size_t>(static_cast<size_t>(window), std::min<uint32_t>(peer_max_frame_size_, H2_MAX_FRAME_SIZE));
+    char buf[H2_MAX_FRAME_SIZE];
+    ssize_t n = stream->source->read(buf, length);
+    if (n == -1) {
+        if (errno == EAGAIN) {
+            stream->source_blocked = true;
+            return true;
+        }
+        return false;
+    }
+    *progress = true;
+    if (n == 0) {
+        // 来源结束：空的 DATA 帧结束流
+        write_frame_header(0, H2_DATA, H2_FLAG_END_STREAM, stream->id);
+        stream->source.reset();
+        return true;
+    }
+    write_frame_header(static_cast<uint32_t>(n), H2_DATA, 0, stream->id);
+    out_.append(buf, n);
+    stream->send_window -= n;
+    send_window_ -= n;
+    return true;
+}
@@ -0,0 +1,273 @@
+#ifndef HTTP2_H
+#define HTTP2_H
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include "connection.h"
+
+// 明文 HTTP/2（h2c，RFC 9113）：连接前言直接开始（prior knowledge），或由 HTTP/1.1 的
+// "Upgrade: h2c" 切换而来。帧的解析和生成、HPACK、流的状态和流量控制都在这里；
+// 请求的处理与 HTTP/1 相同（Server::handle_request），见 server_http2.cpp
+
+// 客户端连接前言
+#define H2_PREFACE "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+#define H2_PREFACE_SIZE 24
+#define H2_FRAME_HEADER_SIZE 9
+// 帧负载上限：接收时为 SETTINGS_MAX_FRAME_SIZE 的默认值（不另行通告），发送时也不超过它
+#define H2_MAX_FRAME_SIZE 16384
+// 协议规定的初始窗口
+#define H2_DEFAULT_WINDOW 65535
+// 同时打开的流数量上限（SETTINGS_MAX_CONCURRENT_STREAMS），超出的流以 REFUSED_STREAM 拒绝
+#define H2_MAX_CONCURRENT_STREAMS 100
+// 接收窗口：流级用 SETTINGS_INITIAL_WINDOW_SIZE 通告，连接级用 WINDOW_UPDATE 扩大。
+// 请求体收下（内存或临时文件）后即可归还，未归还的超过一半时发送 WINDOW_UPDATE
+#define H2_STREAM_WINDOW (1024 * 1024)
+#define H2_CONNECTION_WINDOW (4 * 1024 * 1024)
+// 解码后的请求头部总大小上限（SETTINGS_MAX_HEADER_LIST_SIZE），超出时以431响应
+#define H2_MAX_HEADER_LIST_SIZE (2 * MAX_HEADER_SIZE)
+// HEADERS + CONTINUATION 拼接后的头部块上限，超出时关闭连接（不解码就无法保持 HPACK 状态同步）
+#define H2_MAX_HEADER_BLOCK (64 * 1024)
+// 待写出的帧超过该值后暂停解析新的帧和生成 DATA 帧，先写出去
+#define H2_OUTPUT_LIMIT (256 * 1024)
+// HPACK 动态表大小（SETTINGS_HEADER_TABLE_SIZE 的默认值）
+#define HPACK_TABLE_SIZE 4096
+
+enum Http2FrameType : uint8_t {
+    H2_DATA = 0x0,
+    H2_HEADERS = 0x1,
+    H2_PRIORITY = 0x2,
+    H2_RST_STREAM = 0x3,
+    H2_SETTINGS = 0x4,
+    H2_PUSH_PROMISE = 0x5,
+    H2_PING = 0x6,
+    H2_GOAWAY = 0x7,
+    H2_WINDOW_UPDATE = 0x8,
+    H2_CONTINUATION = 0x9
+};
+
+#define H2_FLAG_END_STREAM 0x1
+#define H2_FLAG_ACK 0x1
+#define H2_FLAG_END_HEADERS 0x4
+#define H2_FLAG_PADDED 0x8
+#define H2_FLAG_PRIORITY 0x20
+
+enum Http2Error : uint32_t {
+    H2_NO_ERROR = 0x0,
+    H2_PROTOCOL_ERROR = 0x1,
+    H2_INTERNAL_ERROR = 0x2,
+    H2_FLOW_CONTROL_ERROR = 0x3,
+    H2_STREAM_CLOSED = 0x5,
+    H2_FRAME_SIZE_ERROR = 0x6,
+    H2_REFUSED_STREAM = 0x7,
+    H2_CANCEL = 0x8,
+    H2_COMPRESSION_ERROR = 0x9,
+    H2_ENHANCE_YOUR_CALM = 0xb
+};
+
+enum Http2Setting : uint16_t {
+    H2_SETTINGS_HEADER_TABLE_SIZE = 0x1,
+    H2_SETTINGS_ENABLE_PUSH = 0x2,
+    H2_SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,
+    H2_SETTINGS_INITIAL_WINDOW_SIZE = 0x4,
+    H2_SETTINGS_MAX_FRAME_SIZE = 0x5,
+    H2_SETTINGS_MAX_HEADER_LIST_SIZE = 0x6
+};
+
+// 解码得到的头部字段，名称和值都存放在 data 中（字段视图在列表不再修改后才有效）
+struct HeaderList {
+    struct Field {
+        uint32_t name_offset;
+        uint32_t name_length;
+        uint32_t value_offset;
+        uint32_t value_length;
+    };
+
+    std::string data;
+    std::vector<Field> fields;
+    size_t list_size;    // 按 SETTINGS_MAX_HEADER_LIST_SIZE 的算法：每个字段 名称+值+32
+    bool too_large;      // 超过 H2_MAX_HEADER_LIST_SIZE，之后的字段不再保存
+
+    HeaderList() : list_size(0), too_large(false) {}
+
+    void add(std::string_view name, std::string_view value);
+    void clear();
+
+    size_t size() const { return fields.size(); }
+    std::string_view name(size_t i) const { return std::string_view(data).substr(fields[i].name_offset, fields[i].name_length); }
+    std::string_view value(size_t i) const { return std::string_view(data).substr(fields[i].value_offset, fields[i].value_length); }
+};
+
+// HPACK 解码器（RFC 7541）：静态表和 Huffman 码表编译在程序中，动态表按连接维护
+class HpackDecoder {
+public:
+    HpackDecoder() : table_size_(0), max_table_size_(HPACK_TABLE_SIZE) {}
+
+    // 解码一个完整的头部块，字段追加到 headers；格式错误返回false（连接错误 COMPRESSION_ERROR）
+    bool decode(const uint8_t* data, size_t len, HeaderList* headers);
+
+private:
+    // 1..61 为静态表，62 起为动态表（最新的条目在前）
+    bool lookup(uint64_t index, std::string_view* name, std::string_view* value) const;
+    void insert(std::string_view name, std::string_view value);
+    void evict(size_t limit);
+
+    std::deque<std::pair<std::string, std::string>> table_;
+    size_t table_size_;
+    size_t max_table_size_;
+};
+
+// HPACK 编码：响应头只用静态表和不索引的字面量，编码器没有状态，各个流的头部块可以按任意顺序生成
+void hpack_encode_status(int status, std::string* out);
+void hpack_encode_field(std::string_view name, std::string_view value, std::string* out);
+// 把 HTTP/1 格式的响应头行（"Name: value\r\n"，状态行跳过）逐个编码：名称转为小写，
+// 去掉 HTTP/2 中禁止的连接相关头部
+void hpack_encode_http1_fields(std::string_view lines, std::string* out);
+
+// 一个请求/响应流
+struct Http2Stream {
+    uint32_t id;
+    HeaderList headers;          // 请求头部（含伪头部）
+    RequestBody body;
+    bool remote_closed;          // 已收到 END_STREAM（半关闭）
+    bool queued;                 // 已进入待处理队列
+    bool discard_body;           // 已决定提前响应（如413），之后到达的 DATA 直接丢弃
+    int error_status;            // 请求不合法时直接以该状态码响应，0表示交给处理函数
+    int64_t send_window;
+    int64_t recv_window;
+    uint32_t recv_unacked;       // 已收下但尚未用 WINDOW_UPDATE 归还的字节数
+
+    // 处理函数生成的响应（与 HTTP/1 相同的 Response），响应头已转换为 HEADERS 帧，
+    // 其后的内存数据、共享响应体和文件按顺序切成 DATA 帧
+    std::vector<Response> responses;
+    size_t response_head;
+    uint64_t data_remaining;     // 尚未生成 DATA 帧的字节数
+    // 逐段到达的响应体（反向代理），在 data_remaining 之后读取，读完后置空
+    std::shared_ptr<ResponseSource> source;
+    bool source_blocked;         // 上一次读取没有数据，等待来源就绪
+
+    Http2Stream(uint32_t stream_id, int64_t initial_send_window);
+    ~Http2Stream();
+
+    // 用请求头部填充 HttpRequest，视图指向 headers（:authority 作为 Host）
+    void fill_request(HttpRequest* request) const;
+};
+
+// 一个 HTTP/2 连接的协议状态。与连接的其他部分一样，同一时刻只由持有连接的线程访问
+class Http2Session {
+public:
+    explicit Http2Session(const BodyLimits* limits);
+    ~Http2Session();
+
+    Http2Session(const Http2Session&) = delete;
+    Http2Session& operator=(const Http2Session&) = delete;
+
+    // 排入服务器的连接前言：SETTINGS 和扩大连接窗口的 WINDOW_UPDATE
+    void start();
+
+    // h2c 升级：HTTP2-Settings 的值（base64url 编码的 SETTINGS 负载），格式错误返回false
+    bool apply_upgrade_settings(std::string_view value);
+    // h2c 升级：原请求作为流1（对端已半关闭），请求的内容拷贝到流中
+    void open_upgrade_stream(const HttpRequest& request);
+
+    // 解析 input 中完整的帧并移除（先检查客户端的连接前言）。连接错误时已排入 GOAWAY，
+    // 返回false，写出后应关闭连接
+    bool receive(IoBuffer& input);
+
+    // 请求已完整、等待处理的流（按到达顺序），没有时返回nullptr
+    Http2Stream* next_ready();
+    // 队首的流已处理完毕
+    void pop_ready();
+    // 提交流的响应：responses 已移入流中，header_block 为 HPACK 编码好的响应头；
+    // 没有响应体时 HEADERS 直接结束流
+    void submit_response(Http2Stream* stream, const std::string& header_block);
+
+    // 不再接受新的流（GOAWAY），已有的流继续处理
+    void shutdown();
+    // 已发送或收到 GOAWAY 且所有流都已结束，或发生了连接错误：可以关闭连接
+    bool finished() const { return closing_ || ((goaway_sent_ || goaway_received_) && streams_.empty()); }
+
+    // 在已排入的帧之后生成 DATA 帧：各个流轮流生成一帧，直到输出达到 H2_OUTPUT_LIMIT
+    // 或流量控制窗口用完。读取响应文件失败（出错或被截短）时返回false；
+    // 逐段响应体的来源出错只重置该流
+    bool produce();
+    // 有可以立即写出的数据：已生成的帧，或窗口允许发送的 DATA
+    bool wants_write() const;
+    IoBuffer& output() { return out_; }
+
+    // 有响应数据在等待对端的 WINDOW_UPDATE（不含在等待来源的流）
+    bool has_pending_data() const;
+    // 有流还在发送响应体
+    bool streaming() const { return !sending_.empty(); }
+    // 在等待来源就绪的响应体
+    void blocked_sources(std::vector<ResponseSource*>* sources) const;
+    // 有流在接收请求
+    bool has_open_streams() const;
+
+private:
+    bool on_data(IoBuffer& input, uint8_t flags, uint32_t stream_id, uint32_t length);
+    bool on_headers(uint8_t flags, uint32_t stream_id);
+    bool on_continuation(uint8_t flags, uint32_t stream_id);
+    bool on_header_block();
+    bool on_settings(uint8_t flags, uint32_t stream_id);
+    bool on_rst_stream(uint32_t stream_id);
+    bool on_ping(uint8_t flags, uint32_t stream_id);
+    bool on_goaway(uint32_t stream_id);
+    bool on_window_update(uint32_t stream_id);
+
+    // 应用对端的设置，出错时返回错误码
+    Http2Error apply_settings(const uint8_t* data, size_t len);
+    // 检查新流的请求头部并准备接收请求体；请求格式错误（malformed）时返回false
+    bool begin_stream(Http2Stream* stream, bool end_stream);
+    // 请求体结束（END_STREAM）
+    void end_stream(Http2Stream* stream);
+    void mark_ready(Http2Stream* stream);
+    // 流级错误：发送 RST_STREAM 并丢弃流
+    void reset_stream(uint32_t stream_id, Http2Error code);
+    // 连接级错误：发送 GOAWAY，之后不再处理任何帧
+    bool connection_error(Http2Error code, const char* reason);
+    // 响应已全部生成：对端还没结束请求时用 RST_STREAM(NO_ERROR) 告知不再需要剩余的请求体
+    void close_stream(Http2Stream* stream);
+    // 把接收的数据计入窗口，必要时发送 WINDOW_UPDATE
+    void credit_connection(uint32_t length);
+    void credit_stream(Http2Stream* stream, uint32_t length);
+    bool write_data_frame(Http2Stream* stream);
+    // 从流的来源读取一段生成 DATA 帧，读完时结束流；来源出错时返回false
+    bool write_source_frame(Http2Stream* stream, bool* progress);
+
+    void write_frame_header(uint32_t length, uint8_t type, uint8_t flags, uint32_t stream_id);
+    void write_window_update(uint32_t stream_id, uint32_t increment);
+    void write_rst_stream(uint32_t stream_id, Http2Error code);
+    void write_goaway(Http2Error code);
+
+    const BodyLimits* limits_;
+    HpackDecoder decoder_;
+    std::map<uint32_t, std::unique_ptr<Http2Stream>> streams_;
+    std::deque<uint32_t> ready_;      // 请求已完整、等待处理的流
+    std::deque<uint32_t> sending_;    // 还有响应数据的流，按轮转顺序
+
+    IoBuffer out_;                    // 已生成、待写出的帧
+    std::string payload_;             // 当前帧的负载（DATA 之外的帧拷贝出来连续处理）
+    std::string header_block_;        // 正在拼接的头部块（HEADERS + CONTINUATION）
+    uint32_t header_stream_;          // 头部块所属的流，0表示没有未结束的头部块
+    uint8_t header_flags_;            // 头部块所在 HEADERS 帧的标志
+
+    bool preface_received_;
+    bool goaway_sent_;
+    bool goaway_received_;
+    bool closing_;                    // 发生了连接错误
+    uint32_t last_stream_id_;         // 已处理的最大流ID
+    int64_t send_window_;             // 连接级发送窗口
+    int64_t recv_window_;             // 连接级接收窗口
+    uint32_t recv_unacked_;
+    int64_t peer_initial_window_;     // 对端的 SETTINGS_INITIAL_WINDOW_SIZE
+    uint32_t peer_max_frame_size_;
+};
+
+#endif // HTTP2_H
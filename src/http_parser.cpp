@@ -0,0 +1,272 @@
+#include "http_parser.h"
+#include <string.h>
+#include <strings.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HTTP_PARSER_X86 1
+#endif
+
+std::string_view HttpRequest::header(std::string_view name) const {
+    // 头部字段数量有上限，线性比较比建哈希表更快，也不需要分配内存
+    for (size_t i = 0; i < header_count; ++i) {
+        const HttpHeader& h = headers[i];
+        if (h.name.size() == name.size() &&
+            strncasecmp(h.name.data(), name.data(), name.size()) == 0) {
+            return h.value;
+        }
+    }
+    return std::string_view();
+}
+
+bool HttpRequest::has_header(std::string_view name) const {
+    for (size_t i = 0; i < header_count; ++i) {
+        const HttpHeader& h = headers[i];
+        if (h.name.size() == name.size() &&
+            strncasecmp(h.name.data(), name.data(), name.size()) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+#ifdef HTTP_PARSER_X86
+static const char* find_char_sse2(const char* p, const char* end, char c) {
+    const __m128i needle = _mm_set1_epi8(c);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    while (p < end && *p != c) {
+        ++p;
+    }
+    return p;
+}
+
+__attribute__((target("avx2")))
+static const char* find_char_avx2(const char* p, const char* end, char c) {
+    const __m256i needle = _mm256_set1_epi8(c);
+    while (end - p >= 32) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return find_char_sse2(p, end, c);
+}
+
+typedef const char* (*FindCharFn)(const char*, const char*, char);
+
+// 启动时根据CPU能力选择一次实现
+static FindCharFn select_find_char() {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? find_char_avx2 : find_char_sse2;
+}
+
+static const FindCharFn find_char_impl = select_find_char();
+
+const char* find_char(const char* begin, const char* end, char c) {
+    return find_char_impl(begin, end, c);
+}
+#else
+const char* find_char(const char* begin, const char* end, char c) {
+    const void* p = memchr(begin, c, end - begin);
+    return p ? static_cast<const char*>(p) : end;
+}
+#endif
+
+bool parse_decimal(std::string_view value, uint64_t* result) {
+    if (value.empty() || value.size() > 19) {
+        return false;
+    }
+    uint64_t n = 0;
+    for (char c : value) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        n = n * 10 + (c - '0');
+    }
+    *result = n;
+    return true;
+}
+
+// RFC 7230 中的 tchar 查找表
+struct TokenTable {
+    bool allowed[256];
+    TokenTable() {
+        memset(allowed, 0, sizeof(allowed));
+        for (int c = '0'; c <= '9'; ++c) allowed[c] = true;
+        for (int c = 'a'; c <= 'z'; ++c) allowed[c] = true;
+        for (int c = 'A'; c <= 'Z'; ++c) allowed[c] = true;
+        for (const char* p = "!#$%&'*+-.^_`|~"; *p; ++p) allowed[static_cast<unsigned char>(*p)] = true;
+    }
+};
+
+static const TokenTable token_table;
+
+static inline bool is_token_char(char c) {
+    return token_table.allowed[static_cast<unsigned char>(c)];
+}
+
+void HttpParser::reset() {
+    state_ = STATE_REQUEST_LINE;
+    error_ = PARSE_BAD_REQUEST;
+    line_start_ = 0;
+    scan_pos_ = 0;
+    header_length_ = 0;
+    header_count_ = 0;
+}
+
+ParseResult HttpParser::parse(const char* data, size_t len) {
+    if (state_ == STATE_DONE) {
+        return PARSE_COMPLETE;
+    }
+    if (state_ == STATE_ERROR) {
+        return error_;
+    }
+
+    while (true) {
+        // 只扫描上次之后新到达的数据
+        const char* lf = find_char(data + scan_pos_, data + len, '\n');
+        if (lf == data + len) {
+            scan_pos_ = len;
+            if (len > MAX_HEADER_SIZE) {
+                state_ = STATE_ERROR;
+                error_ = PARSE_HEADER_TOO_LARGE;
+                return error_;
+            }
+            return PARSE_INCOMPLETE;
+        }
+
+        size_t begin = line_start_;
+        size_t next = lf - data + 1;
+        if (next > MAX_HEADER_SIZE) {
+            state_ = STATE_ERROR;
+            error_ = PARSE_HEADER_TOO_LARGE;
+            return error_;
+        }
+        // 行尾允许CRLF或单独的LF
+        size_t end = lf - data;
+        if (end > begin && data[end - 1] == '\r') {
+            --end;
+        }
+        line_start_ = next;
+        scan_pos_ = next;
+
+        if (state_ == STATE_REQUEST_LINE) {
+            if (end == begin) {
+                // 请求行之前的空行可以忽略（RFC 7230 3.5）
+                continue;
+            }
+            if (!parse_request_line(data, begin, end)) {
+                state_ = STATE_ERROR;
+                return error_;
+            }
+            state_ = STATE_HEADERS;
+        } else {
+            if (end == begin) {
+                // 空行，请求头结束
+                header_length_ = next;
+                state_ = STATE_DONE;
+                return PARSE_COMPLETE;
+            }
+            if (!parse_header_line(data, begin, end)) {
+                state_ = STATE_ERROR;
+                return error_;
+            }
+        }
+    }
+}
+
+bool HttpParser::parse_request_line(const char* data, size_t begin, size_t end) {
+    // METHOD SP request-target SP HTTP/x.y
+    const char* line = data + begin;
+    const char* line_end = data + end;
+    const char* sp1 = find_char(line, line_end, ' ');
+    if (sp1 == line || sp1 == line_end) {
+        return false;
+    }
+    for (const char* p = line; p < sp1; ++p) {
+        if (!is_token_char(*p)) {
+            return false;
+        }
+    }
+    const char* target = sp1 + 1;
+    const char* sp2 = find_char(target, line_end, ' ');
+    if (sp2 == target || sp2 == line_end) {
+        return false;
+    }
+    const char* version = sp2 + 1;
+    if (line_end - version != 8 || memcmp(version, "HTTP/", 5) != 0 ||
+        version[5] < '0' || version[5] > '9' || version[6] != '.' ||
+        version[7] < '0' || version[7] > '9') {
+        return false;
+    }
+
+    method_.offset = static_cast<uint16_t>(begin);
+    method_.length = static_cast<uint16_t>(sp1 - line);
+    target_.offset = static_cast<uint16_t>(target - data);
+    target_.length = static_cast<uint16_t>(sp2 - target);
+    version_.offset = static_cast<uint16_t>(version - data);
+    version_.length = 8;
+    return true;
+}
+
+bool HttpParser::parse_header_line(const char* data, size_t begin, size_t end) {
+    // 不支持已废弃的折行（以空白开头的续行）
+    if (data[begin] == ' ' || data[begin] == '\t') {
+        return false;
+    }
+    const char* line = data + begin;
+    const char* line_end = data + end;
+    const char* colon = find_char(line, line_end, ':');
+    if (colon == line || colon == line_end) {
+        return false;
+    }
+    // 字段名必须是token，冒号前不允许有空白
+    for (const char* p = line; p < colon; ++p) {
+        if (!is_token_char(*p)) {
+            return false;
+        }
+    }
+    if (header_count_ >= MAX_HEADERS) {
+        error_ = PARSE_HEADER_TOO_LARGE;
+        return false;
+    }
+
+    // 字段值去除首尾的空格和制表符，内部空白原样保留
+    const char* value = colon + 1;
+    while (value < line_end && (*value == ' ' || *value == '\t')) {
+        ++value;
+    }
+    const char* value_end = line_end;
+    while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t')) {
+        --value_end;
+    }
+
+    Span& name_span = header_names_[header_count_];
+    Span& value_span = header_values_[header_count_];
+    name_span.offset = static_cast<uint16_t>(begin);
+    name_span.length = static_cast<uint16_t>(colon - line);
+    value_span.offset = static_cast<uint16_t>(value - data);
+    value_span.length = static_cast<uint16_t>(value_end - value);
+    ++header_count_;
+    return true;
+}
+
+void HttpParser::fill_request(const char* data, HttpRequest* request) const {
+    request->method = std::string_view(data + method_.offset, method_.length);
+    request->url = std::string_view(data + target_.offset, target_.length);
+    request->version = std::string_view(data + version_.offset, version_.length);
+    request->header_count = header_count_;
+    for (uint16_t i = 0; i < header_count_; ++i) {
+        request->headers[i].name = std::string_view(data + header_names_[i].offset, header_names_[i].length);
+        request->headers[i].value = std::string_view(data + header_values_[i].offset, header_values_[i].length);
+    }
+}
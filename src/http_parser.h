@@ -0,0 +1,102 @@
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <string_view>
+#include <stdint.h>
+#include <stddef.h>
+
+// 单个请求允许的最大头部字段数量
+#define MAX_HEADERS 32
+// 请求行加全部头部字段的最大字节数
+#define MAX_HEADER_SIZE 8192
+
+class RequestBody;
+
+struct HttpHeader {
+    std::string_view name;
+    std::string_view value;
+};
+
+// 解析出的请求，所有字段都是指向连接读缓冲区的视图，不做拷贝；
+// 读缓冲区被修改（追加/消费）之后这些视图即失效
+struct HttpRequest {
+    std::string_view method;
+    std::string_view url;
+    std::string_view version;
+    HttpHeader headers[MAX_HEADERS];
+    size_t header_count;
+    // 请求体（没有请求体时为nullptr），用 BodyReader 顺序读取
+    const RequestBody* body;
+
+    HttpRequest() : header_count(0), body(nullptr) {}
+
+    // 按名称查找头部字段（大小写不敏感），不存在时返回空视图
+    std::string_view header(std::string_view name) const;
+    bool has_header(std::string_view name) const;
+};
+
+enum ParseResult {
+    PARSE_INCOMPLETE,        // 数据不够，等待更多数据后从当前位置继续
+    PARSE_COMPLETE,          // 请求头已完整
+    PARSE_BAD_REQUEST,       // 格式错误
+    PARSE_HEADER_TOO_LARGE   // 超出 MAX_HEADER_SIZE 或 MAX_HEADERS
+};
+
+// 可恢复的增量HTTP/1.1请求头解析器。
+// 在多次读取之间保存解析位置，每个字节只扫描一次；用SSE2/AVX2查找换行和冒号。
+// 只记录相对缓冲区起始位置的偏移，因此缓冲区在两次调用之间重新分配也不受影响。
+class HttpParser {
+public:
+    HttpParser() { reset(); }
+
+    // 开始解析下一个请求（缓冲区中已消费的数据应同时移除）
+    void reset();
+
+    // data/len 为读缓冲区的全部内容（每次都从缓冲区起始位置传入）
+    ParseResult parse(const char* data, size_t len);
+
+    // 请求头是否已解析完整（正在等待请求体）
+    bool headers_complete() const { return state_ == STATE_DONE; }
+
+    // 请求头的总长度（包括结尾空行），仅在 PARSE_COMPLETE 后有效
+    size_t header_length() const { return header_length_; }
+
+    // 用解析结果填充请求，视图指向 data
+    void fill_request(const char* data, HttpRequest* request) const;
+
+private:
+    struct Span {
+        uint16_t offset;
+        uint16_t length;
+    };
+
+    enum State {
+        STATE_REQUEST_LINE,
+        STATE_HEADERS,
+        STATE_DONE,
+        STATE_ERROR
+    };
+
+    bool parse_request_line(const char* data, size_t begin, size_t end);
+    bool parse_header_line(const char* data, size_t begin, size_t end);
+
+    State state_;
+    ParseResult error_;
+    uint32_t line_start_;     // 当前行的起始偏移
+    uint32_t scan_pos_;       // 下一次从这里继续查找换行
+    uint32_t header_length_;
+    Span method_;
+    Span target_;
+    Span version_;
+    uint16_t header_count_;
+    Span header_names_[MAX_HEADERS];
+    Span header_values_[MAX_HEADERS];
+};
+
+// 在 [begin, end) 中查找字符c，找不到返回end（SSE2/AVX2实现）
+const char* find_char(const char* begin, const char* end, char c);
+
+// 严格解析十进制非负整数（用于Content-Length等不可信输入），溢出或含非数字字符时返回false
+bool parse_decimal(std::string_view value, uint64_t* result);
+
+#endif // HTTP_PARSER_H
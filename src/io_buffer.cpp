@@ -0,0 +1,289 @@
+#include "io_buffer.h"
+#include <algorithm>
+#include <errno.h>
+#include <new>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace {
+
+// 线程退出时释放缓存的分段
+struct SegmentCache {
+    IoSegment* free_list = nullptr;
+    size_t count = 0;
+
+    ~SegmentCache() {
+        while (free_list != nullptr) {
+            IoSegment* next = free_list->next;
+            delete free_list;
+            free_list = next;
+        }
+    }
+};
+
+thread_local SegmentCache segment_cache;
+
+}  // namespace
+
+IoSegment* IoBufferPool::acquire() {
+    IoSegment* segment = segment_cache.free_list;
+    if (segment != nullptr) {
+        segment_cache.free_list = segment->next;
+        --segment_cache.count;
+    } else {
+        segment = new IoSegment;
+    }
+    segment->next = nullptr;
+    segment->read = 0;
+    segment->write = 0;
+    return segment;
+}
+
+void IoBufferPool::release(IoSegment* segment) {
+    if (segment_cache.count >= IO_POOL_MAX_CACHED) {
+        delete segment;
+        return;
+    }
+    segment->next = segment_cache.free_list;
+    segment_cache.free_list = segment;
+    ++segment_cache.count;
+}
+
+void IoBuffer::push_segment(IoSegment* segment) {
+    segment->next = nullptr;
+    if (tail_ == nullptr) {
+        head_ = tail_ = segment;
+    } else {
+        tail_->next = segment;
+        tail_ = segment;
+    }
+}
+
+void IoBuffer::pop_front() {
+    IoSegment* segment = head_;
+    head_ = segment->next;
+    if (head_ == nullptr) {
+        tail_ = nullptr;
+    }
+    IoBufferPool::release(segment);
+}
+
+void IoBuffer::pullup(size_t n) {
+    n = std::min(n, std::min<size_t>(size_, IO_SEGMENT_SIZE));
+    if (head_ == nullptr || head_->size() >= n) {
+        return;
+    }
+    size_t need = n - head_->size();
+    if (head_->space() < need) {
+        // 把已有数据移到分段开头，腾出后面的空间
+        memmove(head_->data, head_->data + head_->read, head_->size());
+        head_->write -= head_->read;
+        head_->read = 0;
+    }
+    while (need > 0) {
+        IoSegment* next = head_->next;
+        size_t take = std::min(need, next->size());
+        memcpy(head_->data + head_->write, next->data + next->read, take);
+        head_->write += take;
+        next->read += take;
+        need -= take;
+        if (next->size() == 0) {
+            head_->next = next->next;
+            if (tail_ == next) {
+                tail_ = head_;
+            }
+            IoBufferPool::release(next);
+        }
+    }
+}
+
+size_t IoBuffer::peek(size_t offset, const char** data) const {
+    for (IoSegment* segment = head_; segment != nullptr; segment = segment->next) {
+        if (offset < segment->size()) {
+            *data = segment->data + segment->read + offset;
+            return segment->size() - offset;
+        }
+        offset -= segment->size();
+    }
+    *data = nullptr;
+    return 0;
+}
+
+void IoBuffer::append(const char* data, size_t len) {
+    size_ += len;
+    while (len > 0) {
+        if (tail_ == nullptr || tail_->space() == 0) {
+            push_segment(IoBufferPool::acquire());
+        }
+        size_t n = std::min(len, tail_->space());
+        memcpy(tail_->data + tail_->write, data, n);
+        tail_->write += n;
+        data += n;
+        len -= n;
+    }
+}
+
+void IoBuffer::append(IoBuffer& other) {
+    if (other.head_ == nullptr) {
+        return;
+    }
+    if (tail_ == nullptr) {
+        head_ = other.head_;
+    } else {
+        tail_->next = other.head_;
+    }
+    tail_ = other.tail_;
+    size_ += other.size_;
+    other.head_ = other.tail_ = nullptr;
+    other.size_ = 0;
+}
+
+void IoBuffer::consume(size_t n) {
+    n = std::min(n, size_);
+    size_ -= n;
+    while (n > 0) {
+        size_t take = std::min(n, head_->size());
+        head_->read += take;
+        n -= take;
+        if (head_->size() == 0) {
+            pop_front();
+        }
+    }
+}
+
+void IoBuffer::erase_after(size_t prefix, size_t n) {
+    if (n == 0) {
+        return;
+    }
+    if (prefix == 0) {
+        consume(n);
+        return;
+    }
+    n = std::min(n, size_ - prefix);
+    size_ -= n;
+    // 第一个分段中 prefix 之后的部分：把 prefix 向后移动覆盖被移除的数据（prefix 只是请求头，很短）
+    size_t in_front = std::min(n, head_->size() - prefix);
+    if (in_front > 0) {
+        memmove(head_->data + head_->read + in_front, head_->data + head_->read, prefix);
+        head_->read += in_front;
+        n -= in_front;
+    }
+    // 其余部分在后续分段的开头
+    while (n > 0) {
+        IoSegment* next = head_->next;
+        size_t take = std::min(n, next->size());
+        next->read += take;
+        n -= take;
+        if (next->size() == 0) {
+            head_->next = next->next;
+            if (tail_ == next) {
+                tail_ = head_;
+            }
+            IoBufferPool::release(next);
+        }
+    }
+}
+
+ssize_t IoBuffer::read_from(int fd) {
+    char overflow[IO_READ_OVERFLOW];
+    struct iovec iov[3];
+    int iov_count = 0;
+    if (tail_ != nullptr && tail_->space() > 0) {
+        iov[iov_count].iov_base = tail_->data + tail_->write;
+        iov[iov_count].iov_len = tail_->space();
+        ++iov_count;
+    }
+    IoSegment* fresh = IoBufferPool::acquire();
+    iov[iov_count].iov_base = fresh->data;
+    iov[iov_count].iov_len = IO_SEGMENT_SIZE;
+    ++iov_count;
+    iov[iov_count].iov_base = overflow;
+    iov[iov_count].iov_len = sizeof(overflow);
+    ++iov_count;
+
+    ssize_t n = readv(fd, iov, iov_count);
+    if (n <= 0) {
+        int saved = errno;
+        IoBufferPool::release(fresh);
+        errno = saved;
+        return n;
+    }
+    size_t left = n;
+    if (iov_count == 3) {
+        size_t take = std::min(left, tail_->space());
+        tail_->write += take;
+        size_ += take;
+        left -= take;
+    }
+    if (left > 0) {
+        size_t take = std::min<size_t>(left, IO_SEGMENT_SIZE);
+        fresh->write = take;
+        push_segment(fresh);
+        size_ += take;
+        left -= take;
+    } else {
+        IoBufferPool::release(fresh);
+    }
+    if (left > 0) {
+        append(overflow, left);
+    }
+    return n;
+}
+
+ssize_t IoBuffer::pread_from(int fd, off_t offset, size_t len) {
+    size_t total = 0;
+    while (total < len) {
+        if (tail_ == nullptr || tail_->space() == 0) {
+            push_segment(IoBufferPool::acquire());
+        }
+        size_t want = std::min(len - total, tail_->space());
+        ssize_t n = pread(fd, tail_->data + tail_->write, want, offset + static_cast<off_t>(total));
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            if (n == -1 && total == 0) {
+                return -1;
+            }
+            break;
+        }
+        tail_->write += n;
+        size_ += n;
+        total += n;
+    }
+    return static_cast<ssize_t>(total);
+}
+
+ssize_t IoBuffer::write_to(int fd) {
+    struct iovec iov[IO_WRITE_IOVECS];
+    int iov_count = 0;
+    for (IoSegment* segment = head_; segment != nullptr && iov_count < IO_WRITE_IOVECS; segment = segment->next) {
+        if (segment->size() == 0) {
+            continue;
+        }
+        iov[iov_count].iov_base = segment->data + segment->read;
+        iov[iov_count].iov_len = segment->size();
+        ++iov_count;
+    }
+    if (iov_count == 0) {
+        return 0;
+    }
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = iov_count;
+    ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+    if (n > 0) {
+        consume(n);
+    }
+    return n;
+}
+
+void IoBuffer::clear() {
+    while (head_ != nullptr) {
+        pop_front();
+    }
+    size_ = 0;
+}
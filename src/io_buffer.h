@@ -0,0 +1,91 @@
+#ifndef IO_BUFFER_H
+#define IO_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// 分段大小：请求头上限（MAX_HEADER_SIZE）必须能放进一个分段
+#define IO_SEGMENT_SIZE 16384
+// 每个线程缓存的空闲分段数量上限，超出的直接释放
+#define IO_POOL_MAX_CACHED 256
+// readv 的溢出缓冲区（在栈上），一次读取量超过现有空闲空间时使用
+#define IO_READ_OVERFLOW (64 * 1024)
+// write_to 一次 sendmsg 最多合并的分段数
+#define IO_WRITE_IOVECS 64
+
+// 固定大小的分段：[read, write) 为有效数据
+struct IoSegment {
+    IoSegment* next;
+    uint32_t read;
+    uint32_t write;
+    char data[IO_SEGMENT_SIZE];
+
+    size_t size() const { return write - read; }
+    size_t space() const { return IO_SEGMENT_SIZE - write; }
+};
+
+// 每个线程一个空闲分段链表，分配和归还都不加锁；
+// 在一个线程分配、另一个线程归还的分段进入归还线程的链表
+class IoBufferPool {
+public:
+    static IoSegment* acquire();
+    static void release(IoSegment* segment);
+};
+
+// 由池化分段组成的链式缓冲区。消费数据只移动游标，读空的分段立即归还线程池，
+// 空闲的连接不持有任何分段
+class IoBuffer {
+public:
+    IoBuffer() : head_(nullptr), tail_(nullptr), size_(0) {}
+    ~IoBuffer() { clear(); }
+
+    IoBuffer(const IoBuffer&) = delete;
+    IoBuffer& operator=(const IoBuffer&) = delete;
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // 第一个分段中的连续数据
+    const char* front_data() const { return head_ ? head_->data + head_->read : nullptr; }
+    size_t front_size() const { return head_ ? head_->size() : 0; }
+
+    // 保证前 n 字节（不超过总大小和 IO_SEGMENT_SIZE）在第一个分段中连续；
+    // 第一个分段内的数据可能被移动，但相对顺序不变
+    void pullup(size_t n);
+
+    // offset 处开始的一段连续数据，返回其长度（offset 超出时为0）
+    size_t peek(size_t offset, const char** data) const;
+
+    void append(const char* data, size_t len);
+    // 把 other 的分段整体移到末尾，不拷贝数据
+    void append(IoBuffer& other);
+
+    // 移除开头的 n 字节
+    void consume(size_t n);
+    // 保留开头的 prefix 字节（必须都在第一个分段中），移除其后的 n 字节
+    void erase_after(size_t prefix, size_t n);
+
+    // readv 读入最后一个分段的空闲空间、一个新分段和栈上的溢出缓冲区；返回值同 read
+    ssize_t read_from(int fd);
+
+    // 从文件的 offset 处读取最多 len 字节，直接 pread 进末尾的分段；返回读到的字节数，出错返回-1
+    ssize_t pread_from(int fd, off_t offset, size_t len);
+
+    // 把开头的数据用一次 sendmsg 写出（最多 IO_WRITE_IOVECS 个分段）并移除；返回值同 sendmsg
+    ssize_t write_to(int fd);
+
+    // 归还所有分段
+    void clear();
+
+private:
+    void push_segment(IoSegment* segment);
+    // 移除并归还第一个分段
+    void pop_front();
+
+    IoSegment* head_;
+    IoSegment* tail_;
+    size_t size_;
+};
+
+#endif // IO_BUFFER_H
@@ -1,39 +1,212 @@
 #include "logger.h"
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <cstdio>
 #include <ctime>
-#include <iomanip>
-#include <sstream>
+#include <iostream>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// 时间戳前缀 "[YYYY-mm-dd HH:MM:SS] " 的长度
+#define LOG_TIME_LEN 22
+// 级别前缀 "[DEBUG] " 的长度
+#define LOG_LEVEL_LEN 8
+// 一次writev最多合并的iovec数量
+#define LOG_MAX_IOVECS 512
+// 二进制事件记录的最大字节数，过长的字符串参数被截断
+#define LOG_MAX_EVENT 1024
+
+std::atomic<int> Logger::level_threshold_(INFO);
+
+static const char* const LEVEL_TAGS[] = { "[DEBUG] ", "[INFO ] ", "[WARN ] ", "[ERROR] " };
+
+// 每个线程缓存格式化好的时间戳，秒数变化时才重新调用 localtime_r
+struct TimeCache {
+    time_t second;
+    char text[LOG_TIME_LEN + 1];
+};
+static thread_local TimeCache time_cache = { -1, {0} };
+static thread_local LogRing* thread_ring = nullptr;
+
+// 事件时间戳：x86 上读 TSC，其他平台退化为单调时钟纳秒数
+static inline uint64_t read_tsc() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+static int64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000ll + ts.tv_nsec;
+}
+
+static int64_t realtime_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000ll + ts.tv_nsec;
+}
+
+const char* log_level_tag(LogLevel level) {
+    return LEVEL_TAGS[level];
+}
+
+std::string format_log_message(std::string_view format, const LogArg* args, size_t count) {
+    std::string message;
+    message.reserve(format.size() + count * 8);
+    size_t next = 0;
+    size_t pos = 0;
+    while (pos < format.size()) {
+        size_t brace = format.find("{}", pos);
+        if (brace == std::string_view::npos) {
+            break;
+        }
+        message.append(format.data() + pos, brace - pos);
+        if (next < count) {
+            const LogArg& arg = args[next++];
+            switch (arg.type) {
+                case 'i': message += std::to_string(arg.i); break;
+                case 'u': message += std::to_string(arg.u); break;
+                case 'd': message += std::to_string(arg.d); break;
+                default: message.append(arg.str, arg.len); break;
+            }
+        }
+        pos = brace + 2;
+    }
+    message.append(format.data() + pos, format.size() - pos);
+    return message;
+}
+
+// 把事件编码为二进制记录，返回记录长度
+static size_t encode_event(char* out, LogLevel level, uint32_t format_id, uint64_t tsc,
+                           const LogArg* args, size_t count) {
+    char* p = out + sizeof(LogRecordHeader);
+    memcpy(p, &tsc, sizeof(tsc));
+    p += sizeof(tsc);
+    char* payload = p;
+    char* end = out + LOG_MAX_EVENT;
+    for (size_t i = 0; i < count; ++i) {
+        const LogArg& arg = args[i];
+        if (arg.type == 's') {
+            if (end - p < 3) {
+                break;
+            }
+            uint16_t len = static_cast<uint16_t>(std::min<size_t>(arg.len, end - p - 3));
+            *p++ = 's';
+            memcpy(p, &len, sizeof(len));
+            p += sizeof(len);
+            memcpy(p, arg.str, len);
+            p += len;
+        } else {
+            if (end - p < 9) {
+                break;
+            }
+            *p++ = arg.type;
+            if (arg.type == 'i') {
+                memcpy(p, &arg.i, 8);
+            } else if (arg.type == 'u') {
+                memcpy(p, &arg.u, 8);
+            } else {
+                memcpy(p, &arg.d, 8);
+            }
+            p += 8;
+        }
+    }
+    LogRecordHeader header;
+    header.type = LOG_RECORD_EVENT;
+    header.level = static_cast<uint8_t>(level);
+    header.length = static_cast<uint16_t>(p - payload);
+    header.id = format_id;
+    memcpy(out, &header, sizeof(header));
+    return p - out;
+}
+
+static const char* cached_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+    if (ts.tv_sec != time_cache.second) {
+        struct tm tm_now;
+        localtime_r(&ts.tv_sec, &tm_now);
+        strftime(time_cache.text, sizeof(time_cache.text), "[%Y-%m-%d %H:%M:%S] ", &tm_now);
+        time_cache.second = ts.tv_sec;
+    }
+    return time_cache.text;
+}
+
+static size_t round_up_pow2(size_t n) {
+    size_t cap = 1024;
+    while (cap < n) {
+        cap <<= 1;
+    }
+    return cap;
+}
+
+LogRing::LogRing(size_t cap)
+    : buffer(new char[cap]), capacity(cap), head(0), tail(0) {}
+
+LogRing::~LogRing() {
+    delete[] buffer;
+}
+
+// 向环形缓冲区的 pos 处写入数据，必要时绕回开头
+static void ring_copy(LogRing* ring, size_t pos, const char* data, size_t len) {
+    size_t offset = pos & (ring->capacity - 1);
+    size_t first = std::min(len, ring->capacity - offset);
+    memcpy(ring->buffer + offset, data, first);
+    if (first < len) {
+        memcpy(ring->buffer, data + first, len - first);
+    }
+}
 
 Logger& Logger::get_instance() {
     static Logger instance;
     return instance;
 }
 
-Logger::Logger() : log_level_(INFO), is_async_(false), exit_flag_(false) {
-    log_file_.open("server.log", std::ios::out | std::ios::app);
-    if (!log_file_.is_open()) {
+Logger::Logger()
+    : is_async_(false), console_(true), full_policy_(LOG_DROP), flush_interval_ms_(100),
+      ring_capacity_(64 * 1024), log_fd_(-1), binary_(false), binary_fd_(-1), formats_(1, "{}"),
+      formats_written_(0), dropped_(0), dropped_reported_(0), wake_pending_(false),
+      exit_flag_(false) {
+    log_fd_ = open("server.log", O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (log_fd_ == -1) {
         std::cerr << "Failed to open log file." << std::endl;
     }
 }
 
 Logger::~Logger() {
-    if (is_async_) {
+    if (write_thread_.joinable()) {
         {
             std::lock_guard<std::mutex> lock(mtx_);
             exit_flag_ = true;
             cond_.notify_all();
         }
-        if (write_thread_.joinable()) {
-            write_thread_.join();
-        }
+        write_thread_.join();
     }
-    if (log_file_.is_open()) {
-        log_file_.close();
+    for (LogRing* ring : rings_) {
+        delete ring;
+    }
+    if (log_fd_ != -1) {
+        close(log_fd_);
+    }
+    if (binary_fd_ != -1) {
+        close(binary_fd_);
     }
 }
 
 void Logger::set_level(LogLevel level) {
-    log_level_ = level;
+    level_threshold_.store(level, std::memory_order_relaxed);
 }
 
 void Logger::set_async(bool is_async) {
@@ -43,75 +216,343 @@ void Logger::set_async(bool is_async) {
     }
 }
 
-void Logger::log(LogLevel level, const std::string& message) {
-    if (level < log_level_) {
+void Logger::set_console(bool enable) {
+    console_.store(enable, std::memory_order_relaxed);
+}
+
+void Logger::set_flush_interval(int interval_ms) {
+    flush_interval_ms_ = interval_ms > 0 ? interval_ms : 1;
+}
+
+void Logger::set_full_policy(LogFullPolicy policy) {
+    full_policy_ = policy;
+}
+
+void Logger::set_ring_capacity(size_t capacity) {
+    ring_capacity_ = round_up_pow2(capacity);
+}
+
+void Logger::set_binary(bool enable) {
+    if (!enable || binary_) {
+        return;
+    }
+    // 格式编号只在一个进程内有效：已有的文件（上次运行或热升级前的旧进程）改名保留，
+    // 旧进程持有的描述符随文件改名，继续写入自己的文件
+    time_t now = time(nullptr);
+    struct tm tm_now;
+    localtime_r(&now, &tm_now);
+    char rotated[64];
+    size_t len = strftime(rotated, sizeof(rotated), "server.binlog.%Y%m%d-%H%M%S", &tm_now);
+    snprintf(rotated + len, sizeof(rotated) - len, ".%d", static_cast<int>(getpid()));
+    if (rename("server.binlog", rotated) == -1 && errno != ENOENT) {
+        std::cerr << "Failed to rotate binary log file." << std::endl;
+        return;
+    }
+    binary_fd_ = open("server.binlog", O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (binary_fd_ == -1) {
+        std::cerr << "Failed to open binary log file." << std::endl;
         return;
     }
+    // 标定TSC频率，logdecode 据此把TSC换算为相对最近同步点的时间
+    uint64_t tsc0 = read_tsc();
+    int64_t ns0 = monotonic_ns();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    uint64_t tsc1 = read_tsc();
+    int64_t ns1 = monotonic_ns();
+    uint64_t tsc_hz = static_cast<uint64_t>((tsc1 - tsc0) * 1e9 / (ns1 - ns0));
 
-    // 获取当前时间
-    auto now = std::chrono::system_clock::now();
-    std::time_t now_time = std::chrono::system_clock::to_time_t(now);
-    std::tm* tm_now = std::localtime(&now_time);
+    char header[LOG_BINARY_MAGIC_LEN + sizeof(uint64_t)];
+    memcpy(header, LOG_BINARY_MAGIC, LOG_BINARY_MAGIC_LEN);
+    memcpy(header + LOG_BINARY_MAGIC_LEN, &tsc_hz, sizeof(tsc_hz));
+    if (write(binary_fd_, header, sizeof(header)) != static_cast<ssize_t>(sizeof(header))) {
+        std::cerr << "Failed to write binary log header." << std::endl;
+    }
+    binary_ = true;
+    set_async(true);
+}
 
-    // 格式化时间和日志级别
-    std::ostringstream oss;
-    oss << "[" << std::put_time(tm_now, "%Y-%m-%d %H:%M:%S") << "] ";
+uint32_t Logger::register_format(const char* format) {
+    std::lock_guard<std::mutex> lock(formats_mtx_);
+    formats_.push_back(format);
+    return static_cast<uint32_t>(formats_.size() - 1);
+}
 
-    switch (level) {
-        case DEBUG:
-            oss << "[DEBUG] ";
-            break;
-        case INFO:
-            oss << "[INFO ] ";
-            break;
-        case WARN:
-            oss << "[WARN ] ";
-            break;
-        case ERROR:
-            oss << "[ERROR] ";
-            break;
+void Logger::log_args(LogLevel level, uint32_t format_id, const char* format, const LogArg* args,
+                      size_t count) {
+    if (binary_) {
+        if (!push_event(level, format_id, args, count)) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+    log(level, format_log_message(format, args, count));
+}
+
+bool Logger::push_event(LogLevel level, uint32_t format_id, const LogArg* args, size_t count) {
+    char record[LOG_MAX_EVENT];
+    struct iovec part;
+    part.iov_base = record;
+    part.iov_len = encode_event(record, level, format_id, read_tsc(), args, count);
+    return push(&part, 1);
+}
+
+void Logger::log(LogLevel level, const std::string& message) {
+    if (!enabled(level)) {
+        return;
     }
 
-    oss << message << std::endl;
-    std::string log_entry = oss.str();
+    if (binary_) {
+        // 二进制模式下普通日志作为0号格式 "{}" 的事件
+        LogArg arg(message);
+        if (!push_event(level, 0, &arg, 1)) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+    }
 
     if (is_async_) {
-        // 异步模式，将日志加入队列
+        // 异步模式，写入本线程的缓冲区
+        LogRing* ring = local_ring();
+        // 单行最多占用缓冲区的一半，过长的消息被截断
+        size_t max_message = ring->capacity / 2 - LOG_TIME_LEN - LOG_LEVEL_LEN - 1;
+        struct iovec parts[4];
+        parts[0].iov_base = const_cast<char*>(cached_time());
+        parts[0].iov_len = LOG_TIME_LEN;
+        parts[1].iov_base = const_cast<char*>(LEVEL_TAGS[level]);
+        parts[1].iov_len = LOG_LEVEL_LEN;
+        parts[2].iov_base = const_cast<char*>(message.data());
+        parts[2].iov_len = std::min(message.size(), max_message);
+        parts[3].iov_base = const_cast<char*>("\n");
+        parts[3].iov_len = 1;
+        if (!push(parts, 4)) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+
+    // 同步模式，直接写日志
+    struct iovec iov[4];
+    iov[0].iov_base = const_cast<char*>(cached_time());
+    iov[0].iov_len = LOG_TIME_LEN;
+    iov[1].iov_base = const_cast<char*>(LEVEL_TAGS[level]);
+    iov[1].iov_len = LOG_LEVEL_LEN;
+    iov[2].iov_base = const_cast<char*>(message.data());
+    iov[2].iov_len = message.size();
+    iov[3].iov_base = const_cast<char*>("\n");
+    iov[3].iov_len = 1;
+    std::lock_guard<std::mutex> lock(mtx_);
+    write_out(iov, 4);
+}
+
+size_t Logger::queued_bytes() {
+    size_t total = 0;
+    std::lock_guard<std::mutex> lock(rings_mtx_);
+    for (LogRing* ring : rings_) {
+        total += ring->tail.load(std::memory_order_acquire) - ring->head.load(std::memory_order_acquire);
+    }
+    return total;
+}
+
+LogRing* Logger::local_ring() {
+    if (thread_ring == nullptr) {
+        thread_ring = new LogRing(ring_capacity_);
+        std::lock_guard<std::mutex> lock(rings_mtx_);
+        rings_.push_back(thread_ring);
+    }
+    return thread_ring;
+}
+
+bool Logger::push(const struct iovec* parts, int count) {
+    LogRing* ring = local_ring();
+    size_t len = 0;
+    for (int i = 0; i < count; ++i) {
+        len += parts[i].iov_len;
+    }
+
+    size_t tail = ring->tail.load(std::memory_order_relaxed);
+    size_t head = ring->head.load(std::memory_order_acquire);
+    while (ring->capacity - (tail - head) < len) {
+        if (full_policy_ == LOG_DROP || exit_flag_.load()) {
+            return false;
+        }
+        // 阻塞策略：唤醒写线程并让出CPU，直到腾出空间
         {
             std::lock_guard<std::mutex> lock(mtx_);
-            log_queue_.push(log_entry);
-            cond_.notify_one();
+            wake_pending_ = true;
         }
-    } else {
-        // 同步模式，直接写日志
-        std::lock_guard<std::mutex> lock(mtx_);
-        if (log_file_.is_open()) {
-            log_file_ << log_entry;
-            log_file_.flush();
+        cond_.notify_one();
+        sched_yield();
+        head = ring->head.load(std::memory_order_acquire);
+    }
+
+    size_t pos = tail;
+    for (int i = 0; i < count; ++i) {
+        ring_copy(ring, pos, static_cast<const char*>(parts[i].iov_base), parts[i].iov_len);
+        pos += parts[i].iov_len;
+    }
+    ring->tail.store(tail + len, std::memory_order_release);
+
+    // 刚越过半满时提前唤醒写线程，平时由写线程按刷新间隔批量写出
+    size_t half = ring->capacity / 2;
+    if (tail - head < half && tail + len - head >= half) {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            wake_pending_ = true;
         }
-        // 同时输出到控制台
-        std::cout << log_entry;
+        cond_.notify_one();
     }
+    return true;
 }
 
-void Logger::async_write() {
-    while (true) {
-        std::unique_lock<std::mutex> lock(mtx_);
-        cond_.wait(lock, [this]() { return !log_queue_.empty() || exit_flag_; });
+// 写出全部 iovec，部分写时调整 iov 后继续
+static void writev_all(int fd, struct iovec* iov, int count) {
+    int index = 0;
+    while (index < count) {
+        ssize_t written = writev(fd, iov + index, count - index);
+        if (written <= 0) {
+            return;
+        }
+        while (index < count && static_cast<size_t>(written) >= iov[index].iov_len) {
+            written -= iov[index].iov_len;
+            ++index;
+        }
+        if (index < count) {
+            iov[index].iov_base = static_cast<char*>(iov[index].iov_base) + written;
+            iov[index].iov_len -= written;
+        }
+    }
+}
+
+void Logger::write_out(struct iovec* iov, int count) {
+    if (binary_) {
+        if (binary_fd_ != -1) {
+            writev_all(binary_fd_, iov, count);
+        }
+        return;
+    }
+    if (console_.load(std::memory_order_relaxed)) {
+        // 部分写会修改 iov，控制台使用一份拷贝
+        struct iovec copy[LOG_MAX_IOVECS + 2];
+        memcpy(copy, iov, sizeof(struct iovec) * count);
+        writev_all(STDOUT_FILENO, copy, count);
+    }
+    if (log_fd_ != -1) {
+        writev_all(log_fd_, iov, count);
+    }
+}
 
-        while (!log_queue_.empty()) {
-            const std::string& log_entry = log_queue_.front();
-            if (log_file_.is_open()) {
-                log_file_ << log_entry;
-                log_file_.flush();
+size_t Logger::drain() {
+    struct iovec iov[LOG_MAX_IOVECS + 2];
+    // 与 iov 对应的缓冲区和本次写出后的新 head
+    LogRing* drained[LOG_MAX_IOVECS / 2];
+    size_t new_heads[LOG_MAX_IOVECS / 2];
+    int iov_count = 0;
+    int ring_count = 0;
+    size_t total = 0;
+
+    std::lock_guard<std::mutex> lock(rings_mtx_);
+    size_t index = 0;
+    do {
+        iov_count = 0;
+        ring_count = 0;
+        // 二进制模式：先写出新登记的格式串和一个时钟同步点（保留第一个 iovec 的位置）
+        std::string meta;
+        if (binary_) {
+            ++iov_count;
+        }
+        // 每个缓冲区占一到两个 iovec，drained/new_heads 只有 LOG_MAX_IOVECS / 2 项
+        for (; index < rings_.size() && iov_count + 2 <= LOG_MAX_IOVECS &&
+               ring_count < LOG_MAX_IOVECS / 2; ++index) {
+            LogRing* ring = rings_[index];
+            size_t head = ring->head.load(std::memory_order_relaxed);
+            size_t tail = ring->tail.load(std::memory_order_acquire);
+            if (head == tail) {
+                continue;
             }
-            // 同时输出到控制台
-            std::cout << log_entry;
-            log_queue_.pop();
+            size_t len = tail - head;
+            size_t offset = head & (ring->capacity - 1);
+            size_t first = std::min(len, ring->capacity - offset);
+            iov[iov_count].iov_base = ring->buffer + offset;
+            iov[iov_count].iov_len = first;
+            ++iov_count;
+            if (first < len) {
+                iov[iov_count].iov_base = ring->buffer;
+                iov[iov_count].iov_len = len - first;
+                ++iov_count;
+            }
+            drained[ring_count] = ring;
+            new_heads[ring_count] = tail;
+            ++ring_count;
+            total += len;
+        }
+
+        uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+        if (binary_ && ring_count == 0 && dropped == dropped_reported_) {
+            // 没有新事件时不写同步点
+            iov_count = 0;
+        } else if (binary_) {
+            // 格式串在对应事件写入缓冲区之前登记，读取 tail 之后再读格式表即可覆盖这些事件
+            std::lock_guard<std::mutex> formats_lock(formats_mtx_);
+            for (; formats_written_ < formats_.size(); ++formats_written_) {
+                LogRecordHeader header;
+                header.type = LOG_RECORD_FORMAT;
+                header.level = 0;
+                header.length = static_cast<uint16_t>(strlen(formats_[formats_written_]));
+                header.id = static_cast<uint32_t>(formats_written_);
+                meta.append(reinterpret_cast<const char*>(&header), sizeof(header));
+                meta.append(formats_[formats_written_], header.length);
+            }
+            LogRecordHeader header = { LOG_RECORD_SYNC, 0, 16, 0 };
+            uint64_t tsc = read_tsc();
+            int64_t now = realtime_ns();
+            meta.append(reinterpret_cast<const char*>(&header), sizeof(header));
+            meta.append(reinterpret_cast<const char*>(&tsc), sizeof(tsc));
+            meta.append(reinterpret_cast<const char*>(&now), sizeof(now));
+            iov[0].iov_base = const_cast<char*>(meta.data());
+            iov[0].iov_len = meta.size();
         }
 
+        // 报告因缓冲区已满而丢弃的日志
+        std::string dropped_line;
+        if (dropped != dropped_reported_) {
+            std::string text = "日志缓冲区已满，丢弃" + std::to_string(dropped - dropped_reported_) +
+                               "条日志";
+            if (binary_) {
+                LogArg arg(text);
+                dropped_line.resize(LOG_MAX_EVENT);
+                dropped_line.resize(encode_event(&dropped_line[0], WARN, 0, read_tsc(), &arg, 1));
+            } else {
+                dropped_line = std::string(cached_time()) + LEVEL_TAGS[WARN] + text + "\n";
+            }
+            dropped_reported_ = dropped;
+            iov[iov_count].iov_base = const_cast<char*>(dropped_line.data());
+            iov[iov_count].iov_len = dropped_line.size();
+            ++iov_count;
+        }
+
+        if (iov_count > 0) {
+            write_out(iov, iov_count);
+        }
+        for (int i = 0; i < ring_count; ++i) {
+            drained[i]->head.store(new_heads[i], std::memory_order_release);
+        }
+    } while (index < rings_.size());
+    return total;
+}
+
+void Logger::async_write() {
+    while (true) {
+        drain();
+
+        std::unique_lock<std::mutex> lock(mtx_);
         if (exit_flag_) {
+            lock.unlock();
+            // 退出前写出剩余的日志
+            drain();
             break;
         }
+        cond_.wait_for(lock, std::chrono::milliseconds(flush_interval_ms_),
+                       [this]() { return wake_pending_ || exit_flag_; });
+        wake_pending_ = false;
     }
 }
@@ -3,11 +3,15 @@
 
 #include <string>
 #include <mutex>
-#include <queue>
+#include <vector>
 #include <thread>
+#include <atomic>
 #include <condition_variable>
-#include <fstream>
-#include <iostream>
+#include <string_view>
+#include <type_traits>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
 
 enum LogLevel {
     DEBUG,
@@ -16,6 +20,68 @@ enum LogLevel {
     ERROR
 };
 
+// 异步模式下线程的日志缓冲区写满时的处理策略
+enum LogFullPolicy {
+    LOG_DROP,   // 丢弃这条日志并计数，由写线程定期报告丢弃数量
+    LOG_BLOCK   // 等待写线程腾出空间
+};
+
+// 延迟格式化的日志参数：热路径只记录原始值，格式串中的 {} 依次替换为参数
+struct LogArg {
+    char type;          // 'i' 有符号整数，'u' 无符号整数，'d' 浮点数，'s' 字符串
+    int64_t i;
+    uint64_t u;
+    double d;
+    const char* str;    // 字符串参数不拷贝，只在写入缓冲区时拷贝
+    size_t len;
+
+    LogArg() : type('s'), i(0), u(0), d(0), str(""), len(0) {}
+    template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+    LogArg(T v) : type(std::is_signed<T>::value ? 'i' : 'u'), i(static_cast<int64_t>(v)),
+                  u(static_cast<uint64_t>(v)), d(0), str(nullptr), len(0) {}
+    LogArg(double v) : type('d'), i(0), u(0), d(v), str(nullptr), len(0) {}
+    LogArg(const char* v) : type('s'), i(0), u(0), d(0), str(v), len(strlen(v)) {}
+    LogArg(const std::string& v) : type('s'), i(0), u(0), d(0), str(v.data()), len(v.size()) {}
+    LogArg(std::string_view v) : type('s'), i(0), u(0), d(0), str(v.data()), len(v.size()) {}
+};
+
+// 二进制日志文件格式（server.binlog），由 logdecode 工具还原为文本：
+// 文件头 LOG_BINARY_MAGIC + 每秒TSC计数（uint64），之后是一串记录，每条记录以 LogRecordHeader 开头。
+// 每个进程写自己的文件：启动时已有的 server.binlog 改名为 server.binlog.<启动时间>.<新进程pid>
+#define LOG_BINARY_MAGIC "TWBLOG01"
+#define LOG_BINARY_MAGIC_LEN 8
+
+enum LogRecordType {
+    LOG_RECORD_FORMAT = 'F',   // 格式串定义：length 字节的格式串，id 为格式编号
+    LOG_RECORD_SYNC = 'S',     // 时钟同步点：uint64 TSC + int64 墙上时间（纳秒）
+    LOG_RECORD_EVENT = 'E'     // 日志事件：uint64 TSC + length 字节的参数（类型字节 + 原始值）
+};
+
+struct LogRecordHeader {
+    uint8_t type;
+    uint8_t level;
+    uint16_t length;
+    uint32_t id;
+};
+
+// 日志级别的文本前缀，如 "[DEBUG] "
+const char* log_level_tag(LogLevel level);
+
+// 按格式串把参数格式化为日志正文（文本模式和 logdecode 共用）
+std::string format_log_message(std::string_view format, const LogArg* args, size_t count);
+
+// 单个线程的日志环形缓冲区（单生产者单消费者）。
+// 生产者把格式化好的整行直接写入，写线程把 [head, tail) 区间原样 writev 到文件，不再拷贝
+struct LogRing {
+    explicit LogRing(size_t capacity);
+    ~LogRing();
+
+    char* buffer;
+    size_t capacity;   // 2的幂
+    alignas(64) std::atomic<size_t> head;   // 写线程消费位置
+    alignas(64) std::atomic<size_t> tail;   // 生产者写入位置
+};
+
 class Logger {
 public:
     // 获取单例实例
@@ -24,12 +90,52 @@ public:
     // 设置日志级别
     void set_level(LogLevel level);
 
+    // 低于阈值的日志只需要这一次判断，日志宏据此跳过消息的拼接
+    static bool enabled(LogLevel level) {
+        return level >= level_threshold_.load(std::memory_order_relaxed);
+    }
+
     // 设置是否为异步日志
     void set_async(bool is_async);
 
+    // 是否同时输出到控制台
+    void set_console(bool enable);
+
+    // 写线程把各线程缓冲区写入文件的最长间隔（毫秒）
+    void set_flush_interval(int interval_ms);
+
+    // 设置缓冲区写满时的策略
+    void set_full_policy(LogFullPolicy policy);
+
+    // 每个线程日志缓冲区的字节数（向上取整到2的幂），只影响之后首次记录日志的线程
+    void set_ring_capacity(size_t capacity);
+
+    // 因缓冲区已满而丢弃的日志条数
+    uint64_t dropped_count() const { return dropped_.load(std::memory_order_relaxed); }
+
+    // 各线程缓冲区中等待写线程写出的字节数
+    size_t queued_bytes();
+
+    // 立即写出各线程缓冲区中已提交的日志（进程不经过正常析构退出之前调用）
+    void flush() { drain(); }
+
+    // 二进制模式：日志以格式编号+原始参数写入 server.binlog，由写线程批量写出，不输出到控制台。
+    // 需在其他线程开始记录日志之前调用，开启后总是异步
+    void set_binary(bool enable);
+
+    // 登记调用点的格式串，返回格式编号（格式串须为静态存储）
+    uint32_t register_format(const char* format);
+
     // 记录日志
     void log(LogLevel level, const std::string& message);
 
+    // 记录延迟格式化的日志：二进制模式只拷贝参数，文本模式在调用线程格式化
+    template <typename... Args>
+    void logf(LogLevel level, uint32_t format_id, const char* format, const Args&... args) {
+        LogArg packed[sizeof...(Args) + 1] = { LogArg(args)... };
+        log_args(level, format_id, format, packed, sizeof...(Args));
+    }
+
     // 禁用拷贝和赋值
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
@@ -41,26 +147,75 @@ private:
     // 异步日志处理函数
     void async_write();
 
-    // 日志级别
-    LogLevel log_level_;
+    // 把所有线程缓冲区中已提交的日志写出，返回写出的字节数
+    size_t drain();
+
+    // 当前线程的缓冲区，首次调用时创建并登记
+    LogRing* local_ring();
+
+    void log_args(LogLevel level, uint32_t format_id, const char* format, const LogArg* args,
+                  size_t count);
+
+    // 把一条完整的记录（由若干片段组成）写入当前线程的缓冲区，失败（已满且策略为丢弃）返回false
+    bool push(const struct iovec* parts, int count);
+
+    // 二进制模式下写入一个事件记录
+    bool push_event(LogLevel level, uint32_t format_id, const LogArg* args, size_t count);
+
+    // 写出 iovec 数组，处理部分写
+    void write_out(struct iovec* iov, int count);
+
+    static std::atomic<int> level_threshold_;
 
     // 是否异步
     bool is_async_;
+    std::atomic<bool> console_;
+    LogFullPolicy full_policy_;
+    int flush_interval_ms_;
+    size_t ring_capacity_;
 
     // 日志输出文件
-    std::ofstream log_file_;
+    int log_fd_;
 
-    // 线程安全相关
+    // 二进制模式
+    bool binary_;
+    int binary_fd_;
+    std::mutex formats_mtx_;
+    std::vector<const char*> formats_;   // 下标即格式编号，0号为 "{}"（普通 log 调用）
+    size_t formats_written_;             // 写线程已写入文件的格式串数量
+
+    // 各线程的缓冲区，只在登记新线程和写线程遍历时加锁
+    std::mutex rings_mtx_;
+    std::vector<LogRing*> rings_;
+
+    std::atomic<uint64_t> dropped_;
+    uint64_t dropped_reported_;   // 写线程已报告的丢弃数
+
+    // 写线程的唤醒（超过半满或阻塞等待时）
     std::mutex mtx_;
     std::condition_variable cond_;
-    std::queue<std::string> log_queue_;
+    bool wake_pending_;
     std::thread write_thread_;
-    bool exit_flag_;  // 标志位，通知线程退出
+    std::atomic<bool> exit_flag_;  // 标志位，通知线程退出
 };
 
-#define LOG_DEBUG(message) Logger::get_instance().log(DEBUG, message)
-#define LOG_INFO(message) Logger::get_instance().log(INFO, message)
-#define LOG_WARN(message) Logger::get_instance().log(WARN, message)
-#define LOG_ERROR(message) Logger::get_instance().log(ERROR, message)
+// 延迟格式化的日志宏，每个调用点只在第一次执行时登记格式串，例如
+// LOGF_DEBUG("处理读事件，文件描述符：{}", fd);
+#define LOGF(level, format, ...)                                                          \
+    do {                                                                                  \
+        if (Logger::enabled(level)) {                                                     \
+            static const uint32_t log_format_id = Logger::get_instance().register_format(format); \
+            Logger::get_instance().logf(level, log_format_id, format, ##__VA_ARGS__);     \
+        }                                                                                 \
+    } while (0)
+#define LOGF_DEBUG(format, ...) LOGF(DEBUG, format, ##__VA_ARGS__)
+#define LOGF_INFO(format, ...) LOGF(INFO, format, ##__VA_ARGS__)
+#define LOGF_WARN(format, ...) LOGF(WARN, format, ##__VA_ARGS__)
+#define LOGF_ERROR(format, ...) LOGF(ERROR, format, ##__VA_ARGS__)
+
+#define LOG_DEBUG(message) do { if (Logger::enabled(DEBUG)) Logger::get_instance().log(DEBUG, message); } while (0)
+#define LOG_INFO(message) do { if (Logger::enabled(INFO)) Logger::get_instance().log(INFO, message); } while (0)
+#define LOG_WARN(message) do { if (Logger::enabled(WARN)) Logger::get_instance().log(WARN, message); } while (0)
+#define LOG_ERROR(message) do { if (Logger::enabled(ERROR)) Logger::get_instance().log(ERROR, message); } while (0)
 
 #endif  // LOGGER_H
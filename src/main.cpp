@@ -1,18 +1,81 @@
 #include "server.h"
+#include "config.h"
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <signal.h>
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "用法：%s [端口 [线程数 [Reactor数 [缓存MB [epoll|uring [连接数上限]]]]]] "
+            "[-c 配置文件] [--key=value ...]\n"
+            "配置项见 src/config.h\n", program);
+}
 
 int main(int argc, char* argv[]) {
-    int port = 8080;       // 默认端口
-    int thread_num = 8;    // 默认线程数量
+    // 热升级信号由主线程同步等待，必须在创建任何线程之前屏蔽
+    block_upgrade_signal();
+
+    ServerConfig config;
+    config.exec_argv.assign(argv, argv + argc);
+    std::string error;
 
-    if (argc >= 2) {
-        port = atoi(argv[1]);
+    // 先读配置文件，命令行参数在其基础上覆盖（与出现顺序无关）
+    for (int i = 1; i < argc; ++i) {
+        const char* path = nullptr;
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            path = argv[++i];
+        } else if (strncmp(argv[i], "--config=", 9) == 0) {
+            path = argv[i] + 9;
+        }
+        if (path != nullptr && !load_config_file(path, &config, &error)) {
+            fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
     }
-    if (argc >= 3) {
-        thread_num = atoi(argv[2]);
+
+    // 位置参数依次为：端口、线程数、Reactor数、缓存（MB）、I/O后端、连接数上限
+    static const char* const positional[] = {
+        "port", "workers", "reactors", "cache_size", "io_backend", "max_connections"
+    };
+    size_t position = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        bool ok = true;
+        if (arg == "-c") {
+            ++i;
+        } else if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return 0;
+        } else if (arg.substr(0, 2) == "--") {
+            size_t equal = arg.find('=');
+            if (equal == std::string_view::npos) {
+                error = "缺少 '='：" + std::string(arg);
+                ok = false;
+            } else if (arg.substr(2, equal - 2) != "config") {
+                ok = set_config_option(arg.substr(2, equal - 2), arg.substr(equal + 1), &config, &error);
+            }
+        } else if (position < sizeof(positional) / sizeof(positional[0])) {
+            std::string value(arg);
+            if (position == 3) {
+                value += "M";
+            }
+            ok = set_config_option(positional[position++], value, &config, &error);
+        } else {
+            error = "多余的参数：" + std::string(arg);
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "%s\n", error.c_str());
+            usage(argv[0]);
+            return 1;
+        }
     }
 
-    Server server(port, thread_num);
+    // 忽略SIGPIPE：对端已关闭时写socket/sendfile返回EPIPE，而不是终止整个进程
+    signal(SIGPIPE, SIG_IGN);
+
+    Server server(config);
     server.run();
 
     return 0;
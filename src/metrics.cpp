@@ -0,0 +1,145 @@
+#include "metrics.h"
+#include <stdio.h>
+
+thread_local MetricsShard* Metrics::thread_shard_ = nullptr;
+
+static const char* const METHOD_NAMES[METHOD_COUNT] = { "GET", "HEAD", "POST", "OTHER" };
+
+static const char* const STAGE_NAMES[STAGE_COUNT] = {
+    "tws_parse_duration_seconds",
+    "tws_handler_duration_seconds",
+    "tws_write_duration_seconds",
+    "tws_task_wait_seconds",
+};
+
+static const char* const STAGE_HELP[STAGE_COUNT] = {
+    "Time spent parsing a complete request header.",
+    "Time spent in the request handler building the response.",
+    "Time spent in one flush of the response queue.",
+    "Time a task waited in the thread pool queue.",
+};
+
+void LatencyHistogram::record(int64_t ns) {
+    // 向上取整到微秒：1.5µs 不能落进上界为 1µs 的桶
+    uint64_t us = ns > 0 ? (static_cast<uint64_t>(ns) + 999) / 1000 : 0;
+    // 第k个桶的上界为 2^k 微秒
+    size_t index = us <= 1 ? 0 : static_cast<size_t>(64 - __builtin_clzll(us - 1));
+    if (index > METRICS_LATENCY_BUCKETS) {
+        index = METRICS_LATENCY_BUCKETS;
+    }
+    buckets[index].add();
+    sum_ns.add(ns > 0 ? static_cast<uint64_t>(ns) : 0);
+    count.add();
+}
+
+Metrics& Metrics::get_instance() {
+    static Metrics instance;
+    return instance;
+}
+
+MetricsShard* Metrics::register_shard() {
+    std::unique_ptr<MetricsShard> shard(new MetricsShard());
+    MetricsShard* raw = shard.get();
+    std::lock_guard<std::mutex> lock(shards_mtx_);
+    shards_.push_back(std::move(shard));
+    return raw;
+}
+
+MetricsMethod Metrics::method_index(std::string_view method) {
+    if (method == "GET") {
+        return METHOD_GET;
+    }
+    if (method == "HEAD") {
+        return METHOD_HEAD;
+    }
+    if (method == "POST") {
+        return METHOD_POST;
+    }
+    return METHOD_OTHER;
+}
+
+void metrics_append_header(std::string* out, const char* name, const char* type, const char* help) {
+    out->append("# HELP ").append(name).append(" ").append(help).append("\n");
+    out->append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+void metrics_append_value(std::string* out, const char* name, const std::string& labels, uint64_t value) {
+    out->append(name);
+    if (!labels.empty()) {
+        out->append("{").append(labels).append("}");
+    }
+    out->append(" ").append(std::to_string(value)).append("\n");
+}
+
+void Metrics::render(std::string* out) {
+    // 只在抓取时汇总，热路径上的计数器互不干扰
+    uint64_t accepted = 0;
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    uint64_t methods[METHOD_COUNT] = {};
+    std::vector<uint64_t> statuses(METRICS_STATUS_LIMIT, 0);
+    uint64_t buckets[STAGE_COUNT][METRICS_LATENCY_BUCKETS + 1] = {};
+    uint64_t sums[STAGE_COUNT] = {};
+    uint64_t counts[STAGE_COUNT] = {};
+    {
+        std::lock_guard<std::mutex> lock(shards_mtx_);
+        for (const auto& shard : shards_) {
+            accepted += shard->accepted.get();
+            bytes_in += shard->bytes_in.get();
+            bytes_out += shard->bytes_out.get();
+            for (int i = 0; i < METHOD_COUNT; ++i) {
+                methods[i] += shard->methods[i].get();
+            }
+            for (int i = 0; i < METRICS_STATUS_LIMIT; ++i) {
+                statuses[i] += shard->statuses[i].get();
+            }
+            for (int s = 0; s < STAGE_COUNT; ++s) {
+                const LatencyHistogram& h = shard->stages[s];
+                for (int b = 0; b <= METRICS_LATENCY_BUCKETS; ++b) {
+                    buckets[s][b] += h.buckets[b].get();
+                }
+                sums[s] += h.sum_ns.get();
+                counts[s] += h.count.get();
+            }
+        }
+    }
+
+    metrics_append_header(out, "tws_connections_accepted_total", "counter", "Accepted connections.");
+    metrics_append_value(out, "tws_connections_accepted_total", "", accepted);
+    metrics_append_header(out, "tws_bytes_received_total", "counter", "Bytes read from clients.");
+    metrics_append_value(out, "tws_bytes_received_total", "", bytes_in);
+    metrics_append_header(out, "tws_bytes_sent_total", "counter", "Bytes written to clients.");
+    metrics_append_value(out, "tws_bytes_sent_total", "", bytes_out);
+
+    metrics_append_header(out, "tws_requests_total", "counter", "Parsed requests by method.");
+    for (int i = 0; i < METHOD_COUNT; ++i) {
+        metrics_append_value(out, "tws_requests_total", std::string("method=\"") + METHOD_NAMES[i] + "\"",
+                             methods[i]);
+    }
+    metrics_append_header(out, "tws_responses_total", "counter", "Responses by status code.");
+    for (int i = 0; i < METRICS_STATUS_LIMIT; ++i) {
+        if (statuses[i] != 0) {
+            metrics_append_value(out, "tws_responses_total", "code=\"" + std::to_string(i) + "\"",
+                                 statuses[i]);
+        }
+    }
+
+    for (int s = 0; s < STAGE_COUNT; ++s) {
+        const char* name = STAGE_NAMES[s];
+        metrics_append_header(out, name, "histogram", STAGE_HELP[s]);
+        std::string bucket_name = std::string(name) + "_bucket";
+        uint64_t cumulative = 0;
+        char le[32];
+        for (int b = 0; b < METRICS_LATENCY_BUCKETS; ++b) {
+            cumulative += buckets[s][b];
+            snprintf(le, sizeof(le), "le=\"%g\"", static_cast<double>(1ULL << b) / 1e6);
+            metrics_append_value(out, bucket_name.c_str(), le, cumulative);
+        }
+        cumulative += buckets[s][METRICS_LATENCY_BUCKETS];
+        metrics_append_value(out, bucket_name.c_str(), "le=\"+Inf\"", cumulative);
+        char sum[64];
+        snprintf(sum, sizeof(sum), "%s_sum %.9f\n", name, sums[s] / 1e9);
+        out->append(sum);
+        metrics_append_value(out, (std::string(name) + "_count").c_str(), "", counts[s]);
+    }
+}
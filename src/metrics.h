@@ -0,0 +1,98 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <string_view>
+#include <stdint.h>
+#include <stddef.h>
+
+// 延迟直方图的桶：上界依次为 1us, 2us, 4us, ... 2^(N-1)us（约8.4秒），最后一个桶为 +Inf
+#define METRICS_LATENCY_BUCKETS 24
+// 按状态码计数的范围 [0, METRICS_STATUS_LIMIT)
+#define METRICS_STATUS_LIMIT 600
+
+// 分阶段的延迟直方图
+enum MetricsStage {
+    STAGE_PARSE,       // 解析请求头（请求完整后计时一次）
+    STAGE_HANDLER,     // 处理请求、生成响应
+    STAGE_WRITE,       // 发送响应（一次 flush 调用）
+    STAGE_TASK_WAIT,   // 任务在线程池队列中的等待时间
+    STAGE_COUNT
+};
+
+enum MetricsMethod {
+    METHOD_GET,
+    METHOD_HEAD,
+    METHOD_POST,
+    METHOD_OTHER,
+    METHOD_COUNT
+};
+
+// 单线程写、抓取时读的计数器：写线程只做普通的 load + store，不使用带 lock 前缀的原子指令
+struct LocalCounter {
+    std::atomic<uint64_t> value{0};
+
+    void add(uint64_t n = 1) {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+struct LatencyHistogram {
+    LocalCounter buckets[METRICS_LATENCY_BUCKETS + 1];
+    LocalCounter sum_ns;
+    LocalCounter count;
+
+    void record(int64_t ns);
+};
+
+// 每个线程一份的计数器，按缓存行对齐，线程之间没有共享写
+struct alignas(64) MetricsShard {
+    LocalCounter accepted;
+    LocalCounter bytes_in;
+    LocalCounter bytes_out;
+    LocalCounter methods[METHOD_COUNT];
+    LocalCounter statuses[METRICS_STATUS_LIMIT];
+    LatencyHistogram stages[STAGE_COUNT];
+};
+
+class Metrics {
+public:
+    static Metrics& get_instance();
+
+    // 当前线程的计数器，首次调用时创建并登记；线程退出后保留，累计值不丢失
+    static MetricsShard& local() {
+        if (thread_shard_ == nullptr) {
+            thread_shard_ = get_instance().register_shard();
+        }
+        return *thread_shard_;
+    }
+
+    static MetricsMethod method_index(std::string_view method);
+
+    // 汇总所有线程的计数器，按 Prometheus 文本格式追加到 out
+    void render(std::string* out);
+
+    Metrics(const Metrics&) = delete;
+    Metrics& operator=(const Metrics&) = delete;
+
+private:
+    Metrics() {}
+
+    MetricsShard* register_shard();
+
+    static thread_local MetricsShard* thread_shard_;
+
+    std::mutex shards_mtx_;
+    std::vector<std::unique_ptr<MetricsShard>> shards_;
+};
+
+// Prometheus 文本格式的辅助函数
+void metrics_append_header(std::string* out, const char* name, const char* type, const char* help);
+void metrics_append_value(std::string* out, const char* name, const std::string& labels, uint64_t value);
+
+#endif // METRICS_H
@@ -0,0 +1,276 @@
+#include "microcache.h"
+#include "router.h"
+
+#include <ctype.h>
+#include <stdio.h>
+
+// 按 RFC 9110 可以启发式缓存的状态码（206 需要按范围组合，不缓存）
+static const int CACHEABLE_STATUSES[] = {200, 203, 204, 300, 301, 308, 404, 405, 410, 414, 501};
+
+static bool equals_ignore_case(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (tolower(static_cast<unsigned char>(a[i])) != tolower(static_cast<unsigned char>(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool contains_ignore_case(std::string_view text, std::string_view word) {
+    for (size_t i = 0; i + word.size() <= text.size(); ++i) {
+        if (equals_ignore_case(text.substr(i, word.size()), word)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Microcache::Microcache(size_t memory_budget)
+    : shard_budget_(memory_budget / SHARD_COUNT), hits_(0), stale_hits_(0), coalesced_(0), misses_(0) {}
+
+Microcache::Shard& Microcache::shard_for(const std::string& key) {
+    return shards_[std::hash<std::string>()(key) % SHARD_COUNT];
+}
+
+std::shared_ptr<const MicrocachedResponse> Microcache::lookup_locked(Shard& shard, const std::string& key,
+                                                                     int64_t now_ms, bool* stale, bool* pass) {
+    *stale = false;
+    *pass = false;
+    auto it = shard.entries.find(key);
+    if (it == shard.entries.end()) {
+        return nullptr;
+    }
+    const Entry& entry = it->second;
+    if (now_ms >= (entry.response ? entry.response->stale_until_ms : entry.pass_until_ms)) {
+        erase_locked(shard, it);
+        return nullptr;
+    }
+    // 命中，移到LRU表头
+    shard.lru.splice(shard.lru.begin(), shard.lru, entry.lru_it);
+    if (!entry.response) {
+        *pass = true;
+        return nullptr;
+    }
+    *stale = now_ms >= entry.response->fresh_until_ms;
+    return entry.response;
+}
+
+std::shared_ptr<const MicrocachedResponse> Microcache::find(const std::string& key, int64_t now_ms, bool count) {
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    bool stale;
+    bool pass;
+    std::shared_ptr<const MicrocachedResponse> response = lookup_locked(shard, key, now_ms, &stale, &pass);
+    if (!response) {
+        return nullptr;
+    }
+    if (stale) {
+        // 还没有请求在重新执行：交给 acquire，由调用方执行
+        if (shard.flights.find(key) == shard.flights.end()) {
+            return nullptr;
+        }
+    }
+    if (count) {
+        (stale ? stale_hits_ : hits_).fetch_add(1, std::memory_order_relaxed);
+    }
+    return response;
+}
+
+MicrocacheStatus Microcache::acquire(const std::string& key, int64_t now_ms,
+                                     std::shared_ptr<const MicrocachedResponse>* cached, bool count) {
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    bool stale;
+    bool pass;
+    std::shared_ptr<const MicrocachedResponse> response = lookup_locked(shard, key, now_ms, &stale, &pass);
+    if (pass) {
+        return MICROCACHE_PASS;
+    }
+    auto it = shard.flights.find(key);
+    if (response && (!stale || it != shard.flights.end())) {
+        if (count) {
+            (stale ? stale_hits_ : hits_).fetch_add(1, std::memory_order_relaxed);
+        }
+        *cached = response;
+        return MICROCACHE_HIT;
+    }
+    if (it != shard.flights.end()) {
+        if (count) {
+            coalesced_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return MICROCACHE_WAIT;
+    }
+    // 未命中或旧响应需要重新执行：此后同一个key的请求等待（或返回旧响应）
+    shard.flights.emplace(key, std::vector<std::function<void()>>());
+    if (count) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return MICROCACHE_LEAD;
+}
+
+void Microcache::complete(const std::string& key, const std::shared_ptr<const MicrocachedResponse>& response,
+                          int64_t pass_until_ms) {
+    Shard& shard = shard_for(key);
+    std::vector<std::function<void()>> waiters;
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.flights.find(key);
+        if (it != shard.flights.end()) {
+            waiters.swap(it->second);
+            shard.flights.erase(it);
+        }
+        Entry entry;
+        entry.response = response;
+        entry.pass_until_ms = pass_until_ms;
+        insert_locked(shard, key, entry);
+    }
+    // 等待者重新执行时命中刚放入的响应（或按不可缓存直接执行）
+    for (std::function<void()>& resume : waiters) {
+        resume();
+    }
+}
+
+bool Microcache::wait(const std::string& key, std::function<void()> resume) {
+    Shard& shard = shard_for(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.flights.find(key);
+    if (it == shard.flights.end()) {
+        return false;
+    }
+    it->second.push_back(std::move(resume));
+    return true;
+}
+
+void Microcache::insert_locked(Shard& shard, const std::string& key, const Entry& entry) {
+    const MicrocachedResponse* response = entry.response.get();
+    size_t charge = key.size() + sizeof(Entry) +
+                    (response ? sizeof(MicrocachedResponse) + response->head.size() +
+                                (response->body ? response->body->size() : 0) : 0);
+    auto it = shard.entries.find(key);
+    if (it != shard.entries.end()) {
+        // 重新执行的结果替换旧响应
+        erase_locked(shard, it);
+    }
+    if (charge > shard_budget_) {
+        return;
+    }
+    shard.lru.push_front(key);
+    Entry& inserted = shard.entries[key];
+    inserted = entry;
+    inserted.lru_it = shard.lru.begin();
+    inserted.charge = charge;
+    shard.used += charge;
+
+    // 超出预算时从LRU表尾淘汰
+    while (shard.used > shard_budget_ && !shard.lru.empty()) {
+        erase_locked(shard, shard.entries.find(shard.lru.back()));
+    }
+}
+
+void Microcache::erase_locked(Shard& shard, std::unordered_map<std::string, Entry>::iterator it) {
+    shard.used -= it->second.charge;
+    shard.lru.erase(it->second.lru_it);
+    shard.entries.erase(it);
+}
+
+bool microcache_eligible(const HttpRequest& request, const MicrocachePolicy& policy) {
+    HttpMethod method = http_method_from(request.method);
+    // 区间请求的响应（206）不缓存，也不能用完整的响应代替
+    if ((method != HTTP_GET && method != HTTP_HEAD && method != HTTP_POST) || request.has_header("Range")) {
+        return false;
+    }
+    // 带身份的请求只有在 Authorization 参与缓存键时才能共用响应
+    if (request.has_header("Authorization")) {
+        for (const std::string& name : policy.vary) {
+            if (equals_ignore_case(name, "Authorization")) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+std::string microcache_key(const HttpRequest& request, const MicrocachePolicy& policy) {
+    // 各部分之间用换行分隔（请求行和头部值中不会出现换行）
+    std::string key;
+    key.reserve(request.method.size() + request.url.size() + 32);
+    key.append(request.method).append(" ").append(request.url);
+    for (const std::string& name : policy.vary) {
+        key.append("\n").append(request.header(name));
+    }
+    if (request.body != nullptr && request.body->size() > 0) {
+        // 请求体（可能在临时文件中）取 64 位 FNV-1a 摘要
+        uint64_t hash = 14695981039346656037ULL;
+        BodyReader reader(request.body);
+        char chunk[4096];
+        ssize_t n;
+        while ((n = reader.read(chunk, sizeof(chunk))) > 0) {
+            for (ssize_t i = 0; i < n; ++i) {
+                hash = (hash ^ static_cast<unsigned char>(chunk[i])) * 1099511628211ULL;
+            }
+        }
+        char digest[48];
+        snprintf(digest, sizeof(digest), "\n#%llu:%016llx", static_cast<unsigned long long>(request.body->size()),
+                 static_cast<unsigned long long>(hash));
+        key.append(digest);
+    }
+    return key;
+}
+
+std::shared_ptr<MicrocachedResponse> make_microcached_response(const Response& response) {
+    bool cacheable_status = false;
+    for (int status : CACHEABLE_STATUSES) {
+        cacheable_status = cacheable_status || status == response.status;
+    }
+    if (!cacheable_status || response.file_fd != -1 || response.file_remaining > 0 || response.source ||
+        response.header_end > response.buffer.size()) {
+        return nullptr;
+    }
+
+    // 响应头：预生成的部分（状态行）和 buffer 中结尾空行之前的字段，去掉 Date（命中时重新生成）
+    std::string fields(response.head);
+    fields.append(response.buffer, 0, response.header_end);
+    std::shared_ptr<MicrocachedResponse> cached = std::make_shared<MicrocachedResponse>();
+    cached->status = response.status;
+    cached->head.reserve(fields.size());
+    size_t pos = 0;
+    while (pos < fields.size()) {
+        size_t end = fields.find("\r\n", pos);
+        if (end == std::string::npos) {
+            end = fields.size();
+        }
+        std::string_view line = std::string_view(fields).substr(pos, end - pos);
+        pos = end + 2;
+        size_t colon = line.find(':');
+        std::string_view name = colon == std::string_view::npos ? std::string_view() : line.substr(0, colon);
+        std::string_view value = colon == std::string_view::npos ? std::string_view() : line.substr(colon + 1);
+        if (equals_ignore_case(name, "Date")) {
+            continue;
+        }
+        if (equals_ignore_case(name, "Set-Cookie") ||
+            (equals_ignore_case(name, "Cache-Control") &&
+             (contains_ignore_case(value, "no-store") || contains_ignore_case(value, "no-cache") ||
+              contains_ignore_case(value, "private"))) ||
+            (equals_ignore_case(name, "Vary") && value.find('*') != std::string_view::npos)) {
+            return nullptr;
+        }
+        cached->head.append(line).append("\r\n");
+    }
+
+    // 响应体：buffer 中结尾空行之后的小响应体和共享响应体，能共享时不拷贝
+    size_t tail = std::min(response.header_end + 2, response.buffer.size());
+    if (tail == response.buffer.size()) {
+        cached->body = response.body;
+    } else {
+        std::string body(response.buffer, tail);
+        if (response.body) {
+            body.append(*response.body);
+        }
+        cached->body = std::make_shared<const std::string>(std::move(body));
+    }
+    return cached;
+}
@@ -0,0 +1,124 @@
+#ifndef MICROCACHE_H
+#define MICROCACHE_H
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include "connection.h"
+#include "http_parser.h"
+
+// 默认缓存总内存预算
+#define DEFAULT_MICROCACHE_BUDGET (16 * 1024 * 1024)
+
+// 一条路由的响应缓存策略（配置项 microcache），按路由模式匹配，对该模式下 GET/HEAD/POST 生效
+struct MicrocachePolicy {
+    std::string pattern;
+    int64_t ttl_ms;                  // 新鲜期
+    int64_t stale_ms;                // 过期后仍返回旧响应的时长，期间由一个请求重新执行处理函数
+    std::vector<std::string> vary;   // 参与缓存键的请求头
+
+    MicrocachePolicy() : ttl_ms(0), stale_ms(0) {}
+};
+
+// 缓存的一个响应，构建完成后只读，可被多个连接同时引用
+struct MicrocachedResponse {
+    int status;
+    std::string head;                          // 状态行和响应头字段（不含 Date 和结尾空行）
+    std::shared_ptr<const std::string> body;   // 可能为空
+    int64_t fresh_until_ms;
+    int64_t stale_until_ms;
+
+    MicrocachedResponse() : status(0), fresh_until_ms(0), stale_until_ms(0) {}
+};
+
+enum MicrocacheStatus {
+    MICROCACHE_HIT,    // 有可返回的响应
+    MICROCACHE_LEAD,   // 由调用方执行处理函数，之后必须调用 complete
+    MICROCACHE_WAIT,   // 同一个key已有请求在执行，用 wait 登记，结束后重试
+    MICROCACHE_PASS    // 最近的结果不可缓存：直接执行，不缓存也不合并
+};
+
+// 动态处理函数的短时响应缓存：分片LRU + 内存预算。
+// 同一个key并发未命中时只有一个请求执行处理函数，其余请求挂起，执行结束后重新提交并命中；
+// 过期但仍在 stale 窗口内时，一个请求重新执行，其余请求直接返回旧响应
+class Microcache {
+public:
+    explicit Microcache(size_t memory_budget = DEFAULT_MICROCACHE_BUDGET);
+
+    Microcache(const Microcache&) = delete;
+    Microcache& operator=(const Microcache&) = delete;
+
+    // 查找可直接返回的响应：新鲜的，或在 stale 窗口内且已有请求在重新执行。否则返回nullptr。
+    // count 为false时不计入指标（等待者重新处理，已计为 coalesced）
+    std::shared_ptr<const MicrocachedResponse> find(const std::string& key, int64_t now_ms, bool count = true);
+
+    // 未命中时调用，MICROCACHE_HIT 时 *cached 为可返回的响应（期间已被填充，或旧响应）
+    MicrocacheStatus acquire(const std::string& key, int64_t now_ms,
+                             std::shared_ptr<const MicrocachedResponse>* cached, bool count = true);
+
+    // 结束 acquire 取得的执行：response 非空时放入缓存；为空时在 pass_until_ms 之前不再合并该key的请求。
+    // 之后调用登记的 resume
+    void complete(const std::string& key, const std::shared_ptr<const MicrocachedResponse>& response,
+                  int64_t pass_until_ms);
+
+    // 等待 MICROCACHE_WAIT 的执行结束：登记 resume 并返回true；执行已经结束时返回false，不调用 resume
+    bool wait(const std::string& key, std::function<void()> resume);
+
+    // 计数，用于指标
+    uint64_t hits() const { return hits_.load(std::memory_order_relaxed); }
+    uint64_t stale_hits() const { return stale_hits_.load(std::memory_order_relaxed); }
+    uint64_t coalesced() const { return coalesced_.load(std::memory_order_relaxed); }
+    uint64_t misses() const { return misses_.load(std::memory_order_relaxed); }
+
+private:
+    struct Entry {
+        std::shared_ptr<const MicrocachedResponse> response;   // 为空表示结果不可缓存
+        int64_t pass_until_ms;
+        std::list<std::string>::iterator lru_it;
+        size_t charge;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<std::string> lru;            // 表头为最近使用
+        std::unordered_map<std::string, Entry> entries;
+        // 进行中的执行 -> 等待其结束的请求
+        std::unordered_map<std::string, std::vector<std::function<void()>>> flights;
+        size_t used;
+        Shard() : used(0) {}
+    };
+
+    static const size_t SHARD_COUNT = 16;
+
+    Shard& shard_for(const std::string& key);
+    // 持锁查找条目，彻底过期的顺便删除；不可缓存的标记返回空并设置 *pass
+    std::shared_ptr<const MicrocachedResponse> lookup_locked(Shard& shard, const std::string& key, int64_t now_ms,
+                                                             bool* stale, bool* pass);
+    void insert_locked(Shard& shard, const std::string& key, const Entry& entry);
+    void erase_locked(Shard& shard, std::unordered_map<std::string, Entry>::iterator it);
+
+    size_t shard_budget_;
+    Shard shards_[SHARD_COUNT];
+
+    std::atomic<uint64_t> hits_;
+    std::atomic<uint64_t> stale_hits_;
+    std::atomic<uint64_t> coalesced_;     // 挂起等待执行结果的请求
+    std::atomic<uint64_t> misses_;
+};
+
+// 请求能否使用缓存：GET/HEAD/POST，不是区间请求，且没有未列入 vary 的 Authorization
+bool microcache_eligible(const HttpRequest& request, const MicrocachePolicy& policy);
+// 缓存键：方法、URL（含查询字符串）、vary 中的请求头，有请求体时加上其长度和摘要
+std::string microcache_key(const HttpRequest& request, const MicrocachePolicy& policy);
+// 从处理函数生成的响应构建缓存条目（不含有效期），不可缓存时返回nullptr：
+// 状态码不在可缓存的列表中、带文件体或逐段到达的响应体、有 Set-Cookie、Cache-Control 为 no-store/no-cache/private 或 Vary: *
+std::shared_ptr<MicrocachedResponse> make_microcached_response(const Response& response);
+
+#endif // MICROCACHE_H
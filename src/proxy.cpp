@@ -0,0 +1,888 @@
+#include "proxy.h"
+#include "logger.h"
+#include "response_builder.h"
+#include "utils.h"
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/sendfile.h>
+#include <sys/un.h>
+
+bool parse_upstream_address(std::string_view text, UpstreamAddress* address, std::string* error) {
+    memset(&address->addr, 0, sizeof(address->addr));
+    address->name = std::string(text);
+    if (text.substr(0, 5) == "unix:") {
+        std::string_view path = text.substr(5);
+        struct sockaddr_un* un = reinterpret_cast<struct sockaddr_un*>(&address->addr);
+        if (path.empty() || path.size() >= sizeof(un->sun_path)) {
+            *error = "Unix 套接字路径无效：" + std::string(text);
+            return false;
+        }
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, path.data(), path.size());
+        address->addr_len = static_cast<socklen_t>(offsetof(struct sockaddr_un, sun_path) + path.size() + 1);
+        return true;
+    }
+
+    size_t colon = text.rfind(':');
+    uint64_t port = 0;
+    if (colon == std::string_view::npos || !parse_decimal(text.substr(colon + 1), &port) || port == 0 ||
+        port > 65535) {
+        *error = "上游地址缺少有效的端口：" + std::string(text);
+        return false;
+    }
+    std::string host(text.substr(0, colon));
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2);
+    }
+    // 启动时解析一次，之后直接使用地址
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* result = nullptr;
+    int rc = getaddrinfo(host.c_str(), nullptr, &hints, &result);
+    if (rc != 0 || result == nullptr) {
+        *error = "无法解析上游地址 " + host + "：" + gai_strerror(rc);
+        return false;
+    }
+    memcpy(&address->addr, result->ai_addr, result->ai_addrlen);
+    address->addr_len = result->ai_addrlen;
+    freeaddrinfo(result);
+    if (address->addr.ss_family == AF_INET6) {
+        reinterpret_cast<struct sockaddr_in6*>(&address->addr)->sin6_port = htons(static_cast<uint16_t>(port));
+    } else {
+        reinterpret_cast<struct sockaddr_in*>(&address->addr)->sin_port = htons(static_cast<uint16_t>(port));
+    }
+    return true;
+}
+
+static bool equals_ignore_case(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && strncasecmp(a.data(), b.data(), a.size()) == 0;
+}
+
+// 逗号分隔的列表中是否包含某一项，大小写不敏感
+static bool list_has_token(std::string_view list, std::string_view token) {
+    size_t pos = 0;
+    while (pos < list.size()) {
+        size_t comma = std::min(list.find(',', pos), list.size());
+        std::string_view item = list.substr(pos, comma - pos);
+        size_t begin = item.find_first_not_of(" \t");
+        size_t end = item.find_last_not_of(" \t");
+        if (begin != std::string_view::npos && equals_ignore_case(item.substr(begin, end - begin + 1), token)) {
+            return true;
+        }
+        pos = comma + 1;
+    }
+    return false;
+}
+
+// 逐跳头部（RFC 9110 7.6.1）只对一段连接有效，不转发；Connection 中列出的头部同样处理
+static bool is_hop_by_hop(std::string_view name, std::string_view connection) {
+    static const std::string_view names[] = {
+        "Connection", "Keep-Alive", "Proxy-Connection", "Proxy-Authenticate", "Proxy-Authorization",
+        "TE", "Trailer", "Transfer-Encoding", "Upgrade"
+    };
+    for (std::string_view hop : names) {
+        if (equals_ignore_case(name, hop)) {
+            return true;
+        }
+    }
+    return list_has_token(connection, name);
+}
+
+// 这些方法的请求可以在复用的连接失效后安全地重发
+static bool is_idempotent(std::string_view method) {
+    return method == "GET" || method == "HEAD" || method == "OPTIONS" || method == "PUT" || method == "DELETE";
+}
+
+// 转发给上游的请求头：请求行固定为 HTTP/1.1，请求体已完整接收并解码，按 Content-Length 发送。
+// 客户端没有给出 Host 时（*has_host 为false）由调用方按所选上游补在 *head 和 *tail 之间
+static void build_request_head(const HttpRequest& request, std::string_view client_address,
+                               std::string* head, std::string* tail, bool* has_host) {
+    head->append(request.method).append(" ").append(request.url).append(" HTTP/1.1\r\n");
+    std::string_view connection = request.header("Connection");
+    std::string forwarded_for;
+    *has_host = false;
+    for (size_t i = 0; i < request.header_count; ++i) {
+        std::string_view name = request.headers[i].name;
+        std::string_view value = request.headers[i].value;
+        if (is_hop_by_hop(name, connection) || equals_ignore_case(name, "Content-Length") ||
+            equals_ignore_case(name, "Expect") || equals_ignore_case(name, "X-Forwarded-Proto")) {
+            continue;
+        }
+        if (equals_ignore_case(name, "X-Forwarded-For")) {
+            forwarded_for.append(value).append(", ");
+            continue;
+        }
+        *has_host = *has_host || equals_ignore_case(name, "Host");
+        head->append(name).append(": ").append(value).append("\r\n");
+    }
+    forwarded_for.append(client_address);
+    tail->append("X-Forwarded-For: ").append(forwarded_for).append("\r\n");
+    tail->append("X-Forwarded-Proto: http\r\n");
+    uint64_t length = request.body ? request.body->size() : 0;
+    if (length > 0 || request.method == "POST" || request.method == "PUT" || request.method == "PATCH") {
+        tail->append("Content-Length: ").append(std::to_string(length)).append("\r\n");
+    }
+    tail->append("\r\n");
+}
+
+// 上游的响应头，视图指向接收缓冲区
+struct UpstreamResponseHead {
+    int status;
+    std::string_view reason;
+    bool http10;
+    std::vector<HttpHeader> headers;
+
+    std::string_view header(std::string_view name) const {
+        for (const HttpHeader& h : headers) {
+            if (equals_ignore_case(h.name, name)) {
+                return h.value;
+            }
+        }
+        return std::string_view();
+    }
+};
+
+static bool parse_response_head(std::string_view text, UpstreamResponseHead* head) {
+    size_t eol = text.find("\r\n");
+    std::string_view line = text.substr(0, eol);
+    // "HTTP/1.x 200 OK"
+    if (line.size() < 12 || line.substr(0, 7) != "HTTP/1." || line[8] != ' ' || (line.size() > 12 && line[12] != ' ')) {
+        return false;
+    }
+    uint64_t status = 0;
+    if (!parse_decimal(line.substr(9, 3), &status) || status < 100 || status > 599) {
+        return false;
+    }
+    head->status = static_cast<int>(status);
+    head->reason = line.size() > 13 ? line.substr(13) : std::string_view();
+    head->http10 = line[7] == '0';
+    head->headers.clear();
+    text.remove_prefix(eol + 2);
+    while (!text.empty()) {
+        eol = text.find("\r\n");
+        if (eol == std::string_view::npos) {
+            return false;
+        }
+        line = text.substr(0, eol);
+        text.remove_prefix(eol + 2);
+        if (line.empty()) {
+            break;
+        }
+        size_t colon = line.find(':');
+        if (colon == std::string_view::npos || colon == 0 || head->headers.size() >= MAX_HEADERS) {
+            return false;
+        }
+        std::string_view value = line.substr(colon + 1);
+        size_t begin = value.find_first_not_of(" \t");
+        size_t end = value.find_last_not_of(" \t");
+        value = begin == std::string_view::npos ? std::string_view() : value.substr(begin, end - begin + 1);
+        head->headers.push_back(HttpHeader{ line.substr(0, colon), value });
+    }
+    return true;
+}
+
+// 分块长度行：十六进制长度，之后可以有扩展（忽略）
+static bool parse_chunk_size(std::string_view line, uint64_t* size) {
+    size_t digits = 0;
+    uint64_t value = 0;
+    while (digits < line.size() && isxdigit(static_cast<unsigned char>(line[digits]))) {
+        if (digits == 15) {
+            return false;
+        }
+        char c = line[digits++];
+        value = value * 16 + (isdigit(static_cast<unsigned char>(c)) ? c - '0' : (tolower(c) - 'a' + 10));
+    }
+    if (digits == 0 || (digits < line.size() && line[digits] != ';' && line[digits] != ' ' && line[digits] != '\t')) {
+        return false;
+    }
+    *size = value;
+    return true;
+}
+
+UpstreamExchange::UpstreamExchange(UpstreamGroup* group, size_t reactor_id)
+    : group_(group), reactor_id_(reactor_id), state_(STATE_SELECT), status_(502), has_host_(false),
+      request_sent_(0), body_(nullptr), body_sent_(0), idempotent_(false), head_request_(false),
+      client_http10_(false), client_h2_(false), index_(-1), use_idle_(true), fd_(-1), reused_(false),
+      counted_(false), received_(false), early_response_(false), events_(0), deadline_ms_(0), in_offset_(0),
+      decoded_offset_(0), framing_(FRAMING_NONE), chunk_state_(CHUNK_SIZE), remaining_(0), body_done_(false),
+      keep_alive_(false), client_close_(false), response_status_(0) {}
+
+UpstreamExchange::~UpstreamExchange() {
+    // 响应体没有读完（客户端断开或出错）：连接上还有数据，不能复用
+    release_upstream(false);
+}
+
+void UpstreamExchange::release_upstream(bool reuse) {
+    if (fd_ == -1) {
+        return;
+    }
+    if (counted_) {
+        group_->upstreams_[index_]->active.fetch_sub(1, std::memory_order_relaxed);
+        counted_ = false;
+    }
+    if (reuse) {
+        group_->put_idle(reactor_id_, index_, fd_);
+    } else {
+        // 先shutdown：Reactor 中还在等待该fd的 poll 随之结束
+        shutdown(fd_, SHUT_RDWR);
+        close(fd_);
+    }
+    fd_ = -1;
+}
+
+void UpstreamExchange::fail_attempt(const std::string& reason, int status, bool retry) {
+    UpstreamGroup::Upstream& upstream = *group_->upstreams_[index_];
+    LOGF_WARN("转发到上游 {} 失败：{}", upstream.address.name, reason);
+    group_->report_failure(upstream);
+    release_upstream(false);
+    status_ = status;
+    state_ = STATE_SELECT;
+    use_idle_ = true;
+    if (retry) {
+        tried_[index_] = true;
+        index_ = group_->select(tried_);
+    } else {
+        // 请求可能已被上游处理，不再转给其他上游
+        index_ = -1;
+    }
+}
+
+bool UpstreamExchange::retry_stale() {
+    if (!reused_ || received_ || !idempotent_) {
+        return false;
+    }
+    release_upstream(false);
+    use_idle_ = false;
+    state_ = STATE_SELECT;
+    return true;
+}
+
+bool UpstreamExchange::wait_for(uint32_t events) {
+    events_ = events;
+    errno = EAGAIN;
+    return current_time_ms() < deadline_ms_;
+}
+
+bool UpstreamExchange::send_request() {
+    uint64_t body_size = body_ != nullptr ? body_->size() : 0;
+    while (request_sent_ < request_.size()) {
+        ssize_t n = send(fd_, request_.data() + request_sent_, request_.size() - request_sent_,
+                         MSG_NOSIGNAL | (body_size > 0 ? MSG_MORE : 0));
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        request_sent_ += n;
+        deadline_ms_ = current_time_ms() + group_->settings_.timeout_ms;
+    }
+    char buf[PROXY_IO_CHUNK];
+    while (body_sent_ < body_size) {
+        ssize_t n;
+        if (body_->spilled()) {
+            // 请求体在临时文件中：用 sendfile 直接从文件发送
+            off_t offset = static_cast<off_t>(body_sent_);
+            n = sendfile(fd_, body_->file_fd(), &offset,
+                         static_cast<size_t>(std::min<uint64_t>(body_size - body_sent_, PROXY_IO_CHUNK * 16)));
+        } else {
+            n = body_->read_at(body_sent_, buf, static_cast<size_t>(std::min<uint64_t>(body_size - body_sent_,
+                                                                                         sizeof(buf))));
+            if (n > 0) {
+                n = send(fd_, buf, n, MSG_NOSIGNAL);
+            }
+        }
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        if (n == 0) {
+            errno = EIO;
+            return false;
+        }
+        body_sent_ += n;
+        deadline_ms_ = current_time_ms() + group_->settings_.timeout_ms;
+    }
+    return true;
+}
+
+ssize_t UpstreamExchange::receive() {
+    char buf[PROXY_IO_CHUNK];
+    ssize_t n;
+    do {
+        n = recv(fd_, buf, sizeof(buf), 0);
+    } while (n == -1 && errno == EINTR);
+    if (n > 0) {
+        in_.append(buf, n);
+        received_ = true;
+        deadline_ms_ = current_time_ms() + group_->settings_.timeout_ms;
+    }
+    return n;
+}
+
+ProxyProgress UpstreamExchange::advance(Response* response) {
+    const ProxySettings& settings = group_->settings_;
+    while (true) {
+        switch (state_) {
+        case STATE_SELECT: {
+            if (index_ == -1) {
+                return PROXY_FAILED;
+            }
+            UpstreamGroup::Upstream& upstream = *group_->upstreams_[index_];
+            fd_ = use_idle_ ? group_->take_idle(reactor_id_, index_) : -1;
+            reused_ = fd_ != -1;
+            bool in_progress = false;
+            if (fd_ == -1) {
+                fd_ = group_->connect_upstream(upstream, &in_progress);
+                if (fd_ == -1) {
+                    fail_attempt("连接失败：" + std::string(strerror(errno)), 502, true);
+                    continue;
+                }
+            }
+            upstream.active.fetch_add(1, std::memory_order_relaxed);
+            counted_ = true;
+            received_ = false;
+            early_response_ = false;
+            request_ = head_;
+            if (!has_host_) {
+                request_.append("Host: ").append(upstream.address.name).append("\r\n");
+            }
+            request_.append(head_tail_);
+            request_sent_ = 0;
+            body_sent_ = 0;
+            in_.clear();
+            in_offset_ = 0;
+            state_ = in_progress ? STATE_CONNECTING : STATE_SENDING;
+            deadline_ms_ = current_time_ms() + (in_progress ? settings.connect_timeout_ms : settings.timeout_ms);
+            break;
+        }
+
+        case STATE_CONNECTING: {
+            struct pollfd pfd = { fd_, POLLOUT, 0 };
+            if (poll(&pfd, 1, 0) == 0) {
+                if (wait_for(POLLOUT)) {
+                    return PROXY_PENDING;
+                }
+                fail_attempt("连接超时", 504, true);
+                continue;
+            }
+            int error = 0;
+            socklen_t len = sizeof(error);
+            if (getsockopt(fd_, SOL_SOCKET, SO_ERROR, &error, &len) == -1) {
+                error = errno;
+            }
+            if (error != 0) {
+                fail_attempt("连接失败：" + std::string(strerror(error)), 502, true);
+                continue;
+            }
+            state_ = STATE_SENDING;
+            deadline_ms_ = current_time_ms() + settings.timeout_ms;
+            break;
+        }
+
+        case STATE_SENDING: {
+            if (send_request()) {
+                state_ = STATE_READING_HEAD;
+                break;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // 上游可能在请求发完之前就开始响应（如拒绝过大的请求体），此后不再发送
+                ssize_t n = receive();
+                if (n > 0) {
+                    early_response_ = true;
+                    state_ = STATE_READING_HEAD;
+                    break;
+                }
+                if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    if (wait_for(POLLOUT | POLLIN)) {
+                        return PROXY_PENDING;
+                    }
+                    fail_attempt("发送请求超时", 504, false);
+                    continue;
+                }
+                if (n == 0) {
+                    errno = ECONNRESET;
+                }
+            }
+            // 复用的连接在空闲期间被上游关闭：请求没有送达
+            if (retry_stale()) {
+                continue;
+            }
+            fail_attempt("发送请求失败：" + std::string(strerror(errno)), 502, false);
+            continue;
+        }
+
+        case STATE_READING_HEAD: {
+            size_t end = in_.find("\r\n\r\n");
+            if (end != std::string::npos) {
+                UpstreamResponseHead head;
+                if (!parse_response_head(std::string_view(in_).substr(0, end + 4), &head) || head.status == 101) {
+                    fail_attempt("响应头格式错误", 502, false);
+                    continue;
+                }
+                if (head.status < 200) {
+                    // 跳过 1xx 中间响应
+                    in_.erase(0, end + 4);
+                    continue;
+                }
+                begin_response(head, end + 4, response);
+                if (state_ == STATE_BODY || state_ == STATE_DONE) {
+                    return PROXY_DONE;
+                }
+                continue;
+            }
+            if (in_.size() > MAX_HEADER_SIZE) {
+                fail_attempt("响应头过大", 502, false);
+                continue;
+            }
+            ssize_t n = receive();
+            if (n > 0) {
+                continue;
+            }
+            if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                if (wait_for(POLLIN)) {
+                    return PROXY_PENDING;
+                }
+                fail_attempt("等待响应超时", 504, false);
+                continue;
+            }
+            if ((n == 0 || errno == ECONNRESET) && retry_stale()) {
+                continue;
+            }
+            fail_attempt(n == 0 ? std::string("上游关闭了连接") : "读取响应失败：" + std::string(strerror(errno)),
+                         502, false);
+            continue;
+        }
+
+        case STATE_BUFFERING: {
+            ssize_t n = receive();
+            if (n > 0) {
+                decode_body();
+                if (body_done_) {
+                    build_buffered_response(response);
+                    finish_body();
+                    return PROXY_DONE;
+                }
+                continue;
+            }
+            if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                if (wait_for(POLLIN)) {
+                    return PROXY_PENDING;
+                }
+                fail_attempt("接收响应体超时", 504, false);
+                continue;
+            }
+            fail_attempt("上游在响应体结束前关闭了连接", 502, false);
+            continue;
+        }
+
+        case STATE_BODY:
+        case STATE_DONE:
+            return PROXY_DONE;
+        }
+    }
+}
+
+void UpstreamExchange::begin_response(const UpstreamResponseHead& head, size_t head_end, Response* response) {
+    group_->report_success(*group_->upstreams_[index_]);
+
+    // 响应体的分帧方式（RFC 9112 6.3）
+    bool no_body = head_request_ || head.status == 204 || head.status == 304;
+    std::string_view connection = head.header("Connection");
+    keep_alive_ = !early_response_ &&
+                  (head.http10 ? list_has_token(connection, "keep-alive") : !list_has_token(connection, "close"));
+    framing_ = FRAMING_NONE;
+    remaining_ = 0;
+    if (!no_body) {
+        std::string_view encoding = head.header("Transfer-Encoding");
+        std::string_view length_value = head.header("Content-Length");
+        if (!encoding.empty()) {
+            size_t last = encoding.find_last_of(',');
+            std::string_view coding = encoding.substr(last == std::string_view::npos ? 0 : last + 1);
+            size_t begin = coding.find_first_not_of(" \t");
+            bool chunked = begin != std::string_view::npos &&
+                           equals_ignore_case(coding.substr(begin, coding.find_last_not_of(" \t") - begin + 1), "chunked");
+            framing_ = chunked ? FRAMING_CHUNKED : FRAMING_CLOSE;
+        } else if (!length_value.empty()) {
+            if (!parse_decimal(length_value, &remaining_)) {
+                fail_attempt("响应的 Content-Length 无效", 502, false);
+                return;
+            }
+            framing_ = FRAMING_LENGTH;
+        } else {
+            framing_ = FRAMING_CLOSE;
+        }
+    }
+    keep_alive_ = keep_alive_ && framing_ != FRAMING_CLOSE;
+    chunk_state_ = CHUNK_SIZE;
+    body_done_ = framing_ == FRAMING_NONE || (framing_ == FRAMING_LENGTH && remaining_ == 0);
+
+    // 转发端到端头部，Date 由本服务器生成，有响应体时分帧头部重新给出
+    response_status_ = head.status;
+    response_reason_ = std::string(head.reason);
+    response_head_.clear();
+    for (const HttpHeader& h : head.headers) {
+        if (is_hop_by_hop(h.name, connection) || equals_ignore_case(h.name, "Date") ||
+            (!no_body && equals_ignore_case(h.name, "Content-Length"))) {
+            continue;
+        }
+        response_head_.append(h.name).append(": ").append(h.value).append("\r\n");
+    }
+
+    // 响应头之后已经收到的数据属于响应体
+    in_.erase(0, head_end);
+    in_offset_ = 0;
+    if (!decode_body()) {
+        fail_attempt("响应体分块格式错误", 502, false);
+        return;
+    }
+    if (body_done_) {
+        build_buffered_response(response);
+        finish_body();
+        return;
+    }
+    if (framing_ == FRAMING_LENGTH && decoded_.size() + remaining_ <= PROXY_BUFFER_SIZE) {
+        state_ = STATE_BUFFERING;
+        return;
+    }
+
+    // 响应头立即发出，响应体随发送逐段读取
+    Response built;
+    ResponseBuilder builder(built, response_status_, response_reason_);
+    builder.raw(response_head_);
+    if (framing_ == FRAMING_LENGTH) {
+        builder.content_length(decoded_.size() + remaining_);
+    } else if (client_h2_) {
+        // HTTP/2 由 DATA 帧的 END_STREAM 结束
+    } else if (client_http10_) {
+        client_close_ = true;
+    } else {
+        builder.raw("Transfer-Encoding: chunked\r\n");
+        built.source_chunked = true;
+    }
+    builder.end_headers();
+    built.source = shared_from_this();
+    *response = std::move(built);
+    state_ = STATE_BODY;
+}
+
+void UpstreamExchange::build_buffered_response(Response* response) {
+    Response built;
+    ResponseBuilder builder(built, response_status_, response_reason_);
+    builder.raw(response_head_);
+    if (framing_ != FRAMING_NONE) {
+        builder.content_length(decoded_.size() - decoded_offset_);
+    }
+    builder.end_headers();
+    builder.body(std::string_view(decoded_).substr(decoded_offset_));
+    decoded_.clear();
+    decoded_offset_ = 0;
+    *response = std::move(built);
+}
+
+void UpstreamExchange::finish_body() {
+    body_done_ = true;
+    state_ = STATE_DONE;
+    // 响应体之后还有多余的数据：上游不按协议响应，不再复用
+    release_upstream(keep_alive_ && in_offset_ == in_.size());
+}
+
+bool UpstreamExchange::decode_body() {
+    while (in_offset_ < in_.size() && !body_done_) {
+        const char* data = in_.data() + in_offset_;
+        size_t len = in_.size() - in_offset_;
+        if (framing_ == FRAMING_CLOSE) {
+            decoded_.append(data, len);
+            in_offset_ += len;
+            continue;
+        }
+        if (framing_ == FRAMING_LENGTH) {
+            size_t n = static_cast<size_t>(std::min<uint64_t>(len, remaining_));
+            decoded_.append(data, n);
+            in_offset_ += n;
+            remaining_ -= n;
+            body_done_ = remaining_ == 0;
+            continue;
+        }
+        if (framing_ != FRAMING_CHUNKED) {
+            break;
+        }
+        if (chunk_state_ == CHUNK_DATA) {
+            size_t n = static_cast<size_t>(std::min<uint64_t>(len, remaining_));
+            decoded_.append(data, n);
+            in_offset_ += n;
+            remaining_ -= n;
+            if (remaining_ == 0) {
+                chunk_state_ = CHUNK_DATA_CRLF;
+            }
+            continue;
+        }
+        if (chunk_state_ == CHUNK_DATA_CRLF) {
+            if (data[0] != '\r' || (len > 1 && data[1] != '\n')) {
+                return false;
+            }
+            if (len < 2) {
+                break;
+            }
+            in_offset_ += 2;
+            chunk_state_ = CHUNK_SIZE;
+            continue;
+        }
+        // 分块长度行或 trailer 行
+        const char* eol = static_cast<const char*>(memchr(data, '\n', len));
+        if (eol == nullptr) {
+            if (len > MAX_CHUNK_LINE) {
+                return false;
+            }
+            break;
+        }
+        std::string_view line(data, eol - data);
+        in_offset_ += line.size() + 1;
+        if (line.size() > MAX_CHUNK_LINE || line.empty() || line.back() != '\r') {
+            return false;
+        }
+        line.remove_suffix(1);
+        if (chunk_state_ == CHUNK_TRAILER) {
+            body_done_ = line.empty();
+            continue;
+        }
+        if (!parse_chunk_size(line, &remaining_)) {
+            return false;
+        }
+        chunk_state_ = remaining_ == 0 ? CHUNK_TRAILER : CHUNK_DATA;
+    }
+    // 已解码的原始数据不再保留
+    if (!body_done_) {
+        in_.erase(0, in_offset_);
+        in_offset_ = 0;
+    }
+    return true;
+}
+
+ssize_t UpstreamExchange::read(char* buf, size_t len) {
+    while (true) {
+        if (decoded_offset_ < decoded_.size()) {
+            size_t n = std::min(len, decoded_.size() - decoded_offset_);
+            memcpy(buf, decoded_.data() + decoded_offset_, n);
+            decoded_offset_ += n;
+            if (decoded_offset_ == decoded_.size()) {
+                decoded_.clear();
+                decoded_offset_ = 0;
+            }
+            return static_cast<ssize_t>(n);
+        }
+        if (body_done_) {
+            if (state_ != STATE_DONE) {
+                finish_body();
+            }
+            return 0;
+        }
+        if (fd_ == -1) {
+            // 之前已经失败
+            errno = EIO;
+            return -1;
+        }
+        ssize_t n;
+        if (framing_ == FRAMING_CHUNKED) {
+            n = receive();
+            if (n > 0) {
+                if (!decode_body()) {
+                    LOGF_WARN("上游 {} 的响应体分块格式错误", group_->upstreams_[index_]->address.name);
+                    release_upstream(false);
+                    errno = EPROTO;
+                    return -1;
+                }
+                continue;
+            }
+        } else {
+            // 按长度或读到关闭为止：直接读进调用方的缓冲区
+            size_t want = framing_ == FRAMING_LENGTH ? static_cast<size_t>(std::min<uint64_t>(len, remaining_)) : len;
+            do {
+                n = recv(fd_, buf, want, 0);
+            } while (n == -1 && errno == EINTR);
+            if (n > 0) {
+                deadline_ms_ = current_time_ms() + group_->settings_.timeout_ms;
+                if (framing_ == FRAMING_LENGTH) {
+                    remaining_ -= n;
+                    if (remaining_ == 0) {
+                        finish_body();
+                    }
+                }
+                return n;
+            }
+        }
+        if (n == 0 && framing_ == FRAMING_CLOSE) {
+            body_done_ = true;
+            continue;
+        }
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (wait_for(POLLIN)) {
+                return -1;
+            }
+            LOGF_WARN("转发到上游 {} 失败：接收响应体超时", group_->upstreams_[index_]->address.name);
+            group_->report_failure(*group_->upstreams_[index_]);
+            release_upstream(false);
+            errno = ETIMEDOUT;
+            return -1;
+        }
+        LOGF_WARN("转发到上游 {} 失败：{}", group_->upstreams_[index_]->address.name,
+                  n == 0 ? std::string("上游在响应体结束前关闭了连接") : std::string(strerror(errno)));
+        release_upstream(false);
+        errno = EPIPE;
+        return -1;
+    }
+}
+
+UpstreamGroup::UpstreamGroup(const std::vector<UpstreamAddress>& addresses, const ProxySettings& settings,
+                             size_t reactors)
+    : settings_(settings), next_(0) {
+    for (const UpstreamAddress& address : addresses) {
+        upstreams_.emplace_back(new Upstream(address));
+    }
+    for (size_t i = 0; i < std::max<size_t>(reactors, 1); ++i) {
+        pools_.emplace_back(new IdlePool());
+        pools_.back()->idle.resize(upstreams_.size());
+    }
+}
+UpstreamGroup::~UpstreamGroup() {
+    for (auto& pool : pools_) {
+        for (auto& idle : pool->idle) {
+            for (int fd : idle) {
+                close(fd);
+            }
+        }
+    }
+}
+
+int UpstreamGroup::select(const std::vector<bool>& tried) {
+    size_t count = upstreams_.size();
+    size_t start = next_.fetch_add(1, std::memory_order_relaxed) % count;
+    int64_t now = current_time_ms();
+    int best = -1;
+    unsigned best_active = UINT_MAX;
+    bool best_healthy = false;
+    for (size_t k = 0; k < count; ++k) {
+        size_t i = (start + k) % count;
+        if (tried[i]) {
+            continue;
+        }
+        const Upstream& upstream = *upstreams_[i];
+        bool healthy = upstream.down_until_ms.load(std::memory_order_relaxed) <= now;
+        unsigned active = settings_.balance == PROXY_LEAST_CONN ? upstream.active.load(std::memory_order_relaxed) : 0;
+        // 健康的优先；全部被标记为不可用时仍然尝试，而不是直接返回502
+        if (best == -1 || (healthy && !best_healthy) || (healthy == best_healthy && active < best_active)) {
+            best = static_cast<int>(i);
+            best_active = active;
+            best_healthy = healthy;
+        }
+    }
+    return best;
+}
+
+int UpstreamGroup::take_idle(size_t reactor_id, size_t upstream) {
+    IdlePool& pool = *pools_[reactor_id % pools_.size()];
+    while (true) {
+        int fd;
+        {
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            std::vector<int>& idle = pool.idle[upstream];
+            if (idle.empty()) {
+                return -1;
+            }
+            // 后进先出，最近用过的连接最不可能已被上游的空闲超时关闭
+            fd = idle.back();
+            idle.pop_back();
+        }
+        // 空闲期间上游关闭了连接（EOF）或发来了意外的数据，这样的连接不能再用
+        char byte;
+        ssize_t n = recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return fd;
+        }
+        close(fd);
+    }
+}
+
+void UpstreamGroup::put_idle(size_t reactor_id, size_t upstream, int fd) {
+    IdlePool& pool = *pools_[reactor_id % pools_.size()];
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        std::vector<int>& idle = pool.idle[upstream];
+        if (idle.size() < settings_.keepalive) {
+            idle.push_back(fd);
+            return;
+        }
+    }
+    close(fd);
+}
+
+int UpstreamGroup::connect_upstream(const Upstream& upstream, bool* in_progress) {
+    const UpstreamAddress& address = upstream.address;
+    int fd = socket(address.addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) {
+        return -1;
+    }
+    if (address.addr.ss_family != AF_UNIX) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    *in_progress = false;
+    if (connect(fd, reinterpret_cast<const struct sockaddr*>(&address.addr), address.addr_len) == -1) {
+        if (errno != EINPROGRESS) {
+            int saved = errno;
+            close(fd);
+            errno = saved;
+            return -1;
+        }
+        *in_progress = true;
+    }
+    return fd;
+}
+
+void UpstreamGroup::report_success(Upstream& upstream) {
+    upstream.fails.store(0, std::memory_order_relaxed);
+    upstream.down_until_ms.store(0, std::memory_order_relaxed);
+}
+
+void UpstreamGroup::report_failure(Upstream& upstream) {
+    // max_fails 为0时不做健康检查
+    if (settings_.max_fails == 0) {
+        return;
+    }
+    if (upstream.fails.fetch_add(1, std::memory_order_relaxed) + 1 >= settings_.max_fails) {
+        upstream.fails.store(0, std::memory_order_relaxed);
+        upstream.down_until_ms.store(current_time_ms() + settings_.fail_timeout_ms, std::memory_order_relaxed);
+        LOGF_WARN("上游 {} 连续失败 {} 次，{} 毫秒内不再选择", upstream.address.name, settings_.max_fails,
+                  settings_.fail_timeout_ms);
+    }
+}
+
+std::shared_ptr<UpstreamExchange> UpstreamGroup::start(size_t reactor_id, const HttpRequest& request,
+                                                       std::string_view client_address) {
+    // 构造函数私有，不用 make_shared
+    std::shared_ptr<UpstreamExchange> exchange(new UpstreamExchange(this, reactor_id));
+    build_request_head(request, client_address, &exchange->head_, &exchange->head_tail_, &exchange->has_host_);
+    exchange->body_ = request.body != nullptr && request.body->size() > 0 ? request.body : nullptr;
+    exchange->idempotent_ = is_idempotent(request.method);
+    exchange->head_request_ = request.method == "HEAD";
+    exchange->client_http10_ = request.version == "HTTP/1.0";
+    exchange->client_h2_ = request.version == "HTTP/2.0";
+    exchange->tried_.assign(upstreams_.size(), false);
+    exchange->index_ = select(exchange->tried_);
+    return exchange;
+}
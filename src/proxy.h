@@ -0,0 +1,240 @@
+#ifndef PROXY_H
+#define PROXY_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include "connection.h"
+
+// 连接上游的超时
+#define DEFAULT_PROXY_CONNECT_TIMEOUT_MS 1000
+// 向上游发送请求、读取响应时两次读写之间的超时
+#define DEFAULT_PROXY_TIMEOUT_MS 30000
+// 每个Reactor对每个上游最多保留的空闲 keep-alive 连接数
+#define DEFAULT_PROXY_KEEPALIVE 32
+// 被动健康检查：连续失败这么多次后，在 fail_timeout 内不再选择该上游
+#define DEFAULT_PROXY_MAX_FAILS 3
+#define DEFAULT_PROXY_FAIL_TIMEOUT_MS 10000
+// 转发请求体、读取响应时的单次读写大小
+#define PROXY_IO_CHUNK (64 * 1024)
+// 不超过这个大小、且在响应头之后很快到齐的响应体整体接收后作为普通响应（可以进入缓存），
+// 更大或长度未知的响应体收到响应头就开始转发，响应体边收边发
+#define PROXY_BUFFER_SIZE (64 * 1024)
+
+// 负载均衡方式
+enum ProxyBalance {
+    PROXY_ROUND_ROBIN,   // 轮转
+    PROXY_LEAST_CONN     // 进行中请求最少的上游（相同时按轮转顺序）
+};
+
+// 所有代理路由共用的参数
+struct ProxySettings {
+    ProxyBalance balance;
+    int64_t connect_timeout_ms;
+    int64_t timeout_ms;
+    size_t keepalive;
+    unsigned max_fails;
+    int64_t fail_timeout_ms;
+
+    ProxySettings() : balance(PROXY_ROUND_ROBIN), connect_timeout_ms(DEFAULT_PROXY_CONNECT_TIMEOUT_MS),
+                      timeout_ms(DEFAULT_PROXY_TIMEOUT_MS), keepalive(DEFAULT_PROXY_KEEPALIVE),
+                      max_fails(DEFAULT_PROXY_MAX_FAILS), fail_timeout_ms(DEFAULT_PROXY_FAIL_TIMEOUT_MS) {}
+};
+
+// 上游地址："host:port"（IPv6 写作 "[addr]:port"）或 "unix:/path/to.sock"，启动时解析一次
+struct UpstreamAddress {
+    std::string name;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+};
+
+bool parse_upstream_address(std::string_view text, UpstreamAddress* address, std::string* error);
+
+// 一条代理路由：匹配 pattern 的请求（所有方法）转发给 upstreams
+struct ProxyRoute {
+    std::string pattern;
+    std::vector<UpstreamAddress> upstreams;
+};
+
+class UpstreamGroup;
+struct UpstreamResponseHead;
+
+// UpstreamExchange::advance 的结果
+enum ProxyProgress {
+    PROXY_PENDING,   // 在等待上游（wait_fd 就绪或截止时间到达后再调用）
+    PROXY_DONE,      // 响应已生成
+    PROXY_FAILED     // 应答 status()（502/504）
+};
+
+// 一次转发：上游socket为非阻塞模式，每次 advance 做完能做的读写后返回，不阻塞工作线程。
+// 收到响应头即生成响应；响应体较大或长度未知时，交换本身作为响应体的来源（ResponseSource）
+// 随响应发送逐段读取，按 Content-Length 原样转发，或解码上游的分块后重新分帧
+class UpstreamExchange : public ResponseSource, public std::enable_shared_from_this<UpstreamExchange> {
+public:
+    ~UpstreamExchange();
+
+    UpstreamExchange(const UpstreamExchange&) = delete;
+    UpstreamExchange& operator=(const UpstreamExchange&) = delete;
+
+    // 继续转发。PROXY_DONE 时响应写入 *response
+    ProxyProgress advance(Response* response);
+    // 失败时应答给客户端的状态码
+    int status() const { return status_; }
+    // 响应体按上游连接关闭结束、客户端是 HTTP/1.0：响应无法分帧，发送完毕后必须关闭客户端连接
+    bool client_must_close() const { return client_close_; }
+
+    ssize_t read(char* buf, size_t len) override;
+    int wait_fd() const override { return fd_; }
+    uint32_t wait_events() const override { return events_; }
+    int64_t deadline_ms() const override { return deadline_ms_; }
+
+private:
+    friend class UpstreamGroup;
+
+    enum State {
+        STATE_SELECT,       // 选择上游，取空闲连接或发起连接
+        STATE_CONNECTING,
+        STATE_SENDING,
+        STATE_READING_HEAD,
+        STATE_BUFFERING,    // 接收较小的响应体，到齐后生成普通响应
+        STATE_BODY,         // 作为响应体来源逐段读取
+        STATE_DONE
+    };
+    // 上游响应体的分帧方式
+    enum Framing {
+        FRAMING_NONE,
+        FRAMING_LENGTH,
+        FRAMING_CHUNKED,
+        FRAMING_CLOSE       // 读到上游关闭为止
+    };
+    // 分块解码的位置
+    enum ChunkState {
+        CHUNK_SIZE,
+        CHUNK_DATA,
+        CHUNK_DATA_CRLF,
+        CHUNK_TRAILER
+    };
+
+    UpstreamExchange(UpstreamGroup* group, size_t reactor_id);
+
+    // 本次尝试失败：关闭连接，retry 时换一个上游（请求还没有发出），否则以 status 结束
+    void fail_attempt(const std::string& reason, int status, bool retry);
+    // 复用的空闲连接已失效、还没有收到任何响应数据：用新建的连接向同一个上游重发
+    bool retry_stale();
+    // 结束本次尝试，reuse 时连接放回空闲池
+    void release_upstream(bool reuse);
+    // 发送请求头和请求体，全部发出返回true；被阻塞（errno 为 EAGAIN）或出错返回false
+    bool send_request();
+    // 读取上游数据追加到 in_，返回读到的字节数；0为上游关闭，-1见errno
+    ssize_t receive();
+    // 收到响应头：确定响应体的分帧方式，生成响应（STATE_BODY/STATE_DONE）或进入 STATE_BUFFERING
+    void begin_response(const UpstreamResponseHead& head, size_t head_end, Response* response);
+    // 把 in_ 中的原始数据按分帧方式解码到 decoded_，格式错误返回false
+    bool decode_body();
+    // 响应体已全部收到：能复用的连接立即放回空闲池
+    void finish_body();
+    void build_buffered_response(Response* response);
+    // 没有数据可读时：截止时间已过返回false（超时），否则登记等待的事件
+    bool wait_for(uint32_t events);
+
+    UpstreamGroup* group_;
+    size_t reactor_id_;
+    State state_;
+    int status_;
+
+    // 请求：发给上游的请求头按所选上游补上 Host
+    std::string head_;            // 请求行和转发的头部
+    std::string head_tail_;       // X-Forwarded-*、Content-Length 和结尾空行
+    bool has_host_;
+    std::string request_;         // 本次尝试发送的完整请求头
+    size_t request_sent_;
+    const RequestBody* body_;     // 属于客户端连接，转发期间请求留在读缓冲区中，不会被释放
+    uint64_t body_sent_;
+    bool idempotent_;
+    bool head_request_;
+    bool client_http10_;
+    bool client_h2_;
+
+    // 当前尝试
+    std::vector<bool> tried_;
+    int index_;
+    bool use_idle_;
+    int fd_;
+    bool reused_;
+    bool counted_;                // 已计入上游的 active
+    bool received_;               // 本次尝试已收到响应数据
+    bool early_response_;         // 请求还没发完上游就开始响应，连接不再复用
+    uint32_t events_;
+    int64_t deadline_ms_;
+
+    // 响应
+    std::string in_;              // 从上游收到、尚未解码的数据
+    size_t in_offset_;
+    std::string decoded_;         // 已解码、尚未交给调用方的响应体
+    size_t decoded_offset_;
+    Framing framing_;
+    ChunkState chunk_state_;
+    uint64_t remaining_;          // FRAMING_LENGTH 剩余长度，或当前分块的剩余长度
+    bool body_done_;
+    bool keep_alive_;             // 上游允许复用该连接
+    bool client_close_;
+    int response_status_;
+    std::string response_reason_;
+    std::string response_head_;   // 转发给客户端的响应头字段（缓冲时等响应体到齐后使用）
+};
+
+// 一组上游服务器：负载均衡、被动健康检查和按Reactor分开的空闲连接池
+class UpstreamGroup {
+public:
+    UpstreamGroup(const std::vector<UpstreamAddress>& addresses, const ProxySettings& settings, size_t reactors);
+    ~UpstreamGroup();
+
+    UpstreamGroup(const UpstreamGroup&) = delete;
+    UpstreamGroup& operator=(const UpstreamGroup&) = delete;
+
+    // 开始把请求转发给一个上游，由调用方反复 advance 直到完成。
+    // 请求体从 RequestBody（内存或临时文件）分段发送，转发结束之前请求必须保持有效
+    std::shared_ptr<UpstreamExchange> start(size_t reactor_id, const HttpRequest& request,
+                                            std::string_view client_address);
+
+private:
+    friend class UpstreamExchange;
+
+    struct Upstream {
+        UpstreamAddress address;
+        std::atomic<unsigned> active;          // 进行中的请求数
+        std::atomic<unsigned> fails;           // 连续失败次数
+        std::atomic<int64_t> down_until_ms;    // 在此之前不再选择（0表示正常）
+
+        explicit Upstream(const UpstreamAddress& a) : address(a), active(0), fails(0), down_until_ms(0) {}
+    };
+
+    // 一个Reactor的空闲连接，按上游下标分开
+    struct IdlePool {
+        std::mutex mutex;
+        std::vector<std::vector<int>> idle;
+    };
+
+    // 选择一个未尝试过的上游，优先健康的；全部尝试过时返回-1
+    int select(const std::vector<bool>& tried);
+    // 取一个空闲连接（丢弃已被上游关闭的），没有时返回-1
+    int take_idle(size_t reactor_id, size_t upstream);
+    void put_idle(size_t reactor_id, size_t upstream, int fd);
+    // 发起非阻塞连接，*in_progress 表示连接尚未建立（等待可写后检查 SO_ERROR）；失败返回-1
+    int connect_upstream(const Upstream& upstream, bool* in_progress);
+    void report_success(Upstream& upstream);
+    void report_failure(Upstream& upstream);
+
+    std::vector<std::unique_ptr<Upstream>> upstreams_;
+    std::vector<std::unique_ptr<IdlePool>> pools_;
+    ProxySettings settings_;
+    std::atomic<size_t> next_;    // 轮转位置
+};
+
+#endif // PROXY_H
@@ -0,0 +1,305 @@
+#include "request_body.h"
+#include "http_parser.h"
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// 每个工作线程一个管道，用于 socket -> 管道 -> 文件 的 splice；每次调用结束时管道总是排空的
+static thread_local int splice_pipe[2] = { -1, -1 };
+
+static bool ensure_splice_pipe() {
+    if (splice_pipe[0] != -1) {
+        return true;
+    }
+    if (pipe2(splice_pipe, O_NONBLOCK | O_CLOEXEC) == -1) {
+        splice_pipe[0] = splice_pipe[1] = -1;
+        return false;
+    }
+    // 加大管道容量，一次 splice 可以搬运更多数据（失败时保持默认的64KB）
+    fcntl(splice_pipe[1], F_SETPIPE_SZ, 1024 * 1024);
+    return true;
+}
+
+static void drop_splice_pipe() {
+    // 管道中可能残留了未写入文件的数据，直接丢弃整个管道
+    close(splice_pipe[0]);
+    close(splice_pipe[1]);
+    splice_pipe[0] = splice_pipe[1] = -1;
+}
+
+static bool write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+RequestBody::RequestBody()
+    : active_(false), state_(STATE_DONE), limits_(nullptr), remaining_(0), size_(0), file_fd_(-1),
+      trailer_bytes_(0) {}
+
+RequestBody::~RequestBody() {
+    reset();
+}
+
+void RequestBody::begin(bool chunked, uint64_t length, const BodyLimits* limits) {
+    reset();
+    active_ = true;
+    limits_ = limits;
+    if (chunked) {
+        state_ = STATE_CHUNK_SIZE;
+    } else {
+        remaining_ = length;
+        state_ = length == 0 ? STATE_DONE : STATE_IDENTITY;
+    }
+}
+
+void RequestBody::begin_unframed(const BodyLimits* limits) {
+    reset();
+    active_ = true;
+    limits_ = limits;
+    state_ = STATE_UNFRAMED;
+}
+
+bool RequestBody::finish() {
+    if (state_ == STATE_UNFRAMED) {
+        state_ = STATE_DONE;
+    }
+    return state_ == STATE_DONE;
+}
+
+void RequestBody::reset() {
+    if (file_fd_ != -1) {
+        close(file_fd_);
+        file_fd_ = -1;
+    }
+    if (memory_.capacity() > DEFAULT_BODY_MEMORY_THRESHOLD) {
+        std::string().swap(memory_);
+    } else {
+        memory_.clear();
+    }
+    line_.clear();
+    active_ = false;
+    state_ = STATE_DONE;
+    remaining_ = 0;
+    size_ = 0;
+    trailer_bytes_ = 0;
+}
+
+bool RequestBody::spill() {
+    // 优先使用 O_TMPFILE：文件没有名字，进程退出或fd关闭后自动回收
+    int fd = open(limits_->spill_dir.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, 0600);
+    if (fd == -1) {
+        std::string path = limits_->spill_dir + "/tws-body-XXXXXX";
+        fd = mkostemp(&path[0], O_CLOEXEC);
+        if (fd == -1) {
+            return false;
+        }
+        unlink(path.c_str());
+    }
+    if (!write_all(fd, memory_.data(), memory_.size())) {
+        close(fd);
+        return false;
+    }
+    file_fd_ = fd;
+    std::string().swap(memory_);
+    return true;
+}
+
+BodyResult RequestBody::store(const char* data, size_t len) {
+    if (file_fd_ == -1 && memory_.size() + len > limits_->memory_threshold) {
+        if (!spill()) {
+            return BODY_IO_ERROR;
+        }
+    }
+    if (file_fd_ == -1) {
+        memory_.append(data, len);
+    } else if (!write_all(file_fd_, data, len)) {
+        return BODY_IO_ERROR;
+    }
+    size_ += len;
+    return BODY_INCOMPLETE;
+}
+
+BodyResult RequestBody::consume(const char* data, size_t len, size_t* consumed) {
+    size_t pos = 0;
+    BodyResult result = BODY_INCOMPLETE;
+    while (pos < len && state_ != STATE_DONE && result == BODY_INCOMPLETE) {
+        switch (state_) {
+        case STATE_IDENTITY:
+        case STATE_CHUNK_DATA: {
+            size_t n = static_cast<size_t>(std::min<uint64_t>(remaining_, len - pos));
+            result = store(data + pos, n);
+            pos += n;
+            remaining_ -= n;
+            if (remaining_ == 0) {
+                state_ = state_ == STATE_IDENTITY ? STATE_DONE : STATE_CHUNK_CRLF;
+            }
+            break;
+        }
+        case STATE_UNFRAMED: {
+            size_t n = len - pos;
+            if (n > limits_->max_size - size_) {
+                result = BODY_TOO_LARGE;
+                break;
+            }
+            result = store(data + pos, n);
+            pos = len;
+            break;
+        }
+        case STATE_CHUNK_CRLF:
+        case STATE_CHUNK_SIZE:
+        case STATE_TRAILER: {
+            // 按行处理：行尾允许CRLF或单独的LF
+            const char* lf = find_char(data + pos, data + len, '\n');
+            size_t end = lf - data;
+            if (line_.size() + (end - pos) > MAX_CHUNK_LINE) {
+                result = BODY_BAD_REQUEST;
+                break;
+            }
+            line_.append(data + pos, end - pos);
+            if (lf == data + len) {
+                pos = len;
+                break;
+            }
+            pos = end + 1;
+            if (!line_.empty() && line_.back() == '\r') {
+                line_.pop_back();
+            }
+            if (state_ == STATE_CHUNK_CRLF) {
+                // 块数据之后必须紧跟空行
+                if (!line_.empty()) {
+                    result = BODY_BAD_REQUEST;
+                }
+                state_ = STATE_CHUNK_SIZE;
+            } else if (state_ == STATE_CHUNK_SIZE) {
+                // 块大小为十六进制，后面可以跟被忽略的扩展 ";name=value"
+                uint64_t chunk = 0;
+                size_t i = 0;
+                for (; i < line_.size(); ++i) {
+                    char c = line_[i];
+                    int digit;
+                    if (c >= '0' && c <= '9') {
+                        digit = c - '0';
+                    } else if (c >= 'a' && c <= 'f') {
+                        digit = c - 'a' + 10;
+                    } else if (c >= 'A' && c <= 'F') {
+                        digit = c - 'A' + 10;
+                    } else {
+                        break;
+                    }
+                    if (i >= 15) {
+                        result = BODY_TOO_LARGE;
+                        break;
+                    }
+                    chunk = chunk * 16 + digit;
+                }
+                if (result != BODY_INCOMPLETE) {
+                    break;
+                }
+                if (i == 0 || (i < line_.size() && line_[i] != ';' && line_[i] != ' ' && line_[i] != '\t')) {
+                    result = BODY_BAD_REQUEST;
+                    break;
+                }
+                if (chunk > limits_->max_size - size_) {
+                    result = BODY_TOO_LARGE;
+                    break;
+                }
+                remaining_ = chunk;
+                state_ = chunk == 0 ? STATE_TRAILER : STATE_CHUNK_DATA;
+            } else {
+                // 尾部字段不使用，只检查总长度；空行表示请求体结束
+                trailer_bytes_ += line_.size();
+                if (trailer_bytes_ > MAX_HEADER_SIZE) {
+                    result = BODY_BAD_REQUEST;
+                } else if (line_.empty()) {
+                    state_ = STATE_DONE;
+                }
+            }
+            line_.clear();
+            break;
+        }
+        case STATE_DONE:
+            break;
+        }
+    }
+    *consumed = pos;
+    if (result != BODY_INCOMPLETE) {
+        return result;
+    }
+    return state_ == STATE_DONE ? BODY_COMPLETE : BODY_INCOMPLETE;
+}
+
+bool RequestBody::can_splice() const {
+    return active_ && state_ == STATE_IDENTITY && file_fd_ != -1;
+}
+
+ssize_t RequestBody::splice_from(int sock_fd, size_t max) {
+    if (!ensure_splice_pipe()) {
+        return -1;
+    }
+    size_t want = static_cast<size_t>(std::min<uint64_t>(remaining_, max));
+    ssize_t n = splice(sock_fd, nullptr, splice_pipe[1], nullptr, want, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (n <= 0) {
+        return n;
+    }
+    // 把管道中的数据全部写入文件（请求体按顺序追加，文件偏移即已接收的大小）
+    loff_t offset = static_cast<loff_t>(size_);
+    size_t left = n;
+    while (left > 0) {
+        ssize_t m = splice(splice_pipe[0], nullptr, file_fd_, &offset, left, SPLICE_F_MOVE);
+        if (m == -1 && errno == EINTR) {
+            continue;
+        }
+        if (m <= 0) {
+            int saved = errno;
+            drop_splice_pipe();
+            // 让调用方按 I/O 错误处理，而不是误当作 EAGAIN
+            errno = saved == EAGAIN ? EIO : saved;
+            return -1;
+        }
+        left -= m;
+    }
+    // 后续 write() 从文件当前位置继续追加
+    lseek(file_fd_, offset, SEEK_SET);
+    size_ += n;
+    remaining_ -= n;
+    if (remaining_ == 0) {
+        state_ = STATE_DONE;
+    }
+    return n;
+}
+
+ssize_t RequestBody::read_at(uint64_t offset, char* buf, size_t len) const {
+    if (offset >= size_) {
+        return 0;
+    }
+    len = static_cast<size_t>(std::min<uint64_t>(len, size_ - offset));
+    if (file_fd_ == -1) {
+        memcpy(buf, memory_.data() + offset, len);
+        return static_cast<ssize_t>(len);
+    }
+    return pread(file_fd_, buf, len, static_cast<off_t>(offset));
+}
+
+ssize_t BodyReader::read(char* buf, size_t len) {
+    if (body_ == nullptr) {
+        return 0;
+    }
+    ssize_t n = body_->read_at(offset_, buf, len);
+    if (n > 0) {
+        offset_ += n;
+    }
+    return n;
+}
@@ -0,0 +1,117 @@
+#ifndef REQUEST_BODY_H
+#define REQUEST_BODY_H
+
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+// 请求体大小上限（Content-Length 超过时在读请求体之前就返回413）
+#define DEFAULT_MAX_BODY_SIZE (64ULL * 1024 * 1024)
+// 请求体超过该大小后转存到临时文件，连接上的内存占用不随上传大小增长
+#define DEFAULT_BODY_MEMORY_THRESHOLD (64 * 1024)
+// 分块编码中块大小行（含扩展）和尾部字段的最大字节数
+#define MAX_CHUNK_LINE 1024
+
+struct BodyLimits {
+    uint64_t max_size;            // 请求体大小上限
+    size_t memory_threshold;      // 超过后转存到临时文件
+    std::string spill_dir;        // 临时文件所在目录
+
+    BodyLimits() : max_size(DEFAULT_MAX_BODY_SIZE), memory_threshold(DEFAULT_BODY_MEMORY_THRESHOLD),
+                   spill_dir("/tmp") {}
+};
+
+enum BodyResult {
+    BODY_INCOMPLETE,   // 还需要更多数据
+    BODY_COMPLETE,     // 请求体已完整
+    BODY_BAD_REQUEST,  // 分块编码格式错误
+    BODY_TOO_LARGE,    // 超出 max_size
+    BODY_IO_ERROR      // 写临时文件失败
+};
+
+// 增量接收的请求体：按 Content-Length 或 Transfer-Encoding: chunked 分帧，
+// 小的请求体留在内存中，超过阈值后转存到已unlink的临时文件
+class RequestBody {
+public:
+    RequestBody();
+    ~RequestBody();
+
+    RequestBody(const RequestBody&) = delete;
+    RequestBody& operator=(const RequestBody&) = delete;
+
+    // 开始接收一个请求体；chunked 为 false 时长度为 length
+    void begin(bool chunked, uint64_t length, const BodyLimits* limits);
+    // 开始接收一个由外层协议分帧的请求体（HTTP/2 的 DATA 帧，没有 Content-Length），
+    // 收到结束标志时调用 finish
+    void begin_unframed(const BodyLimits* limits);
+    // 外层协议表示请求体已结束，按 Content-Length 接收时长度必须恰好相符，否则返回false
+    bool finish();
+
+    // 释放内存和临时文件，准备下一个请求
+    void reset();
+
+    // 正在接收（已 begin 且尚未 reset）
+    bool active() const { return active_; }
+    bool complete() const { return state_ == STATE_DONE; }
+
+    // 消费 data 中属于请求体的字节（解码后写入存储），*consumed 为消费的字节数；
+    // 请求体结束后剩余的数据属于下一个流水线请求，不会被消费
+    BodyResult consume(const char* data, size_t len, size_t* consumed);
+
+    // 已转存到临时文件、按 Content-Length 分帧且尚未收完时，可以直接从socket splice到文件
+    bool can_splice() const;
+    // 从socket splice最多 max 字节到临时文件，返回字节数；0表示对端关闭，-1表示出错（见errno）
+    ssize_t splice_from(int sock_fd, size_t max);
+
+    // 解码后的请求体大小
+    uint64_t size() const { return size_; }
+    // 请求体是否在临时文件中，在则可以用 file_fd() 零拷贝发送
+    bool spilled() const { return file_fd_ != -1; }
+    int file_fd() const { return file_fd_; }
+
+    // 从 offset 处读取最多 len 字节，返回读取的字节数
+    ssize_t read_at(uint64_t offset, char* buf, size_t len) const;
+
+private:
+    enum State {
+        STATE_IDENTITY,      // 按 Content-Length 读取
+        STATE_CHUNK_SIZE,    // 块大小行
+        STATE_CHUNK_DATA,    // 块数据
+        STATE_CHUNK_CRLF,    // 块数据之后的CRLF
+        STATE_TRAILER,       // 尾部字段
+        STATE_UNFRAMED,      // 由外层协议分帧，直到 finish
+        STATE_DONE
+    };
+
+    // 把解码后的数据写入存储，必要时转存到临时文件
+    BodyResult store(const char* data, size_t len);
+    bool spill();
+
+    bool active_;
+    State state_;
+    const BodyLimits* limits_;
+    uint64_t remaining_;      // 当前块（或 Content-Length）剩余的字节数
+    uint64_t size_;
+    std::string memory_;
+    int file_fd_;
+    std::string line_;        // 未完整的块大小行/尾部字段行
+    size_t trailer_bytes_;
+};
+
+// 顺序读取请求体，交给处理函数，不必把整个请求体放进内存
+class BodyReader {
+public:
+    explicit BodyReader(const RequestBody* body) : body_(body), offset_(0) {}
+
+    // 读取下一段数据，返回0表示已读完
+    ssize_t read(char* buf, size_t len);
+
+    uint64_t size() const { return body_ ? body_->size() : 0; }
+
+private:
+    const RequestBody* body_;
+    uint64_t offset_;
+};
+
+#endif // REQUEST_BODY_H
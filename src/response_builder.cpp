@@ -0,0 +1,147 @@
+#include "response_builder.h"
+#include "asset_cache.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <string.h>
+
+std::string_view http_status_line(int status) {
+    switch (status) {
+    case 100: return "HTTP/1.1 100 Continue\r\n";
+    case 101: return "HTTP/1.1 101 Switching Protocols\r\n";
+    case 200: return "HTTP/1.1 200 OK\r\n";
+    case 204: return "HTTP/1.1 204 No Content\r\n";
+    case 206: return "HTTP/1.1 206 Partial Content\r\n";
+    case 301: return "HTTP/1.1 301 Moved Permanently\r\n";
+    case 302: return "HTTP/1.1 302 Found\r\n";
+    case 304: return "HTTP/1.1 304 Not Modified\r\n";
+    case 400: return "HTTP/1.1 400 Bad Request\r\n";
+    case 403: return "HTTP/1.1 403 Forbidden\r\n";
+    case 404: return "HTTP/1.1 404 Not Found\r\n";
+    case 405: return "HTTP/1.1 405 Method Not Allowed\r\n";
+    case 408: return "HTTP/1.1 408 Request Timeout\r\n";
+    case 411: return "HTTP/1.1 411 Length Required\r\n";
+    case 413: return "HTTP/1.1 413 Content Too Large\r\n";
+    case 414: return "HTTP/1.1 414 URI Too Long\r\n";
+    case 416: return "HTTP/1.1 416 Range Not Satisfiable\r\n";
+    case 417: return "HTTP/1.1 417 Expectation Failed\r\n";
+    case 431: return "HTTP/1.1 431 Request Header Fields Too Large\r\n";
+    case 500: return "HTTP/1.1 500 Internal Server Error\r\n";
+    case 501: return "HTTP/1.1 501 Not Implemented\r\n";
+    case 502: return "HTTP/1.1 502 Bad Gateway\r\n";
+    case 503: return "HTTP/1.1 503 Service Unavailable\r\n";
+    case 504: return "HTTP/1.1 504 Gateway Timeout\r\n";
+    default: return std::string_view();
+    }
+}
+
+static const std::string_view HEADER_NAMES[HEADER_NAME_COUNT] = {
+    "Content-Type: ",
+    "Content-Length: ",
+    "Content-Range: ",
+    "Content-Encoding: ",
+    "ETag: ",
+    "Last-Modified: ",
+    "Accept-Ranges: ",
+    "Vary: ",
+    "Retry-After: ",
+    "Location: ",
+};
+
+// "Date: " + IMF-fixdate（固定29字节）+ "\r\n"
+#define DATE_HEADER_SIZE 37
+
+static char date_slots[2][DATE_HEADER_SIZE + 1];
+static std::atomic<int> date_current{0};
+static std::atomic<time_t> date_second{0};
+
+void HttpDateCache::refresh(time_t now) {
+    time_t previous = date_second.load(std::memory_order_relaxed);
+    // 多个Reactor同时调用时只有一个负责格式化
+    if (now == previous || !date_second.compare_exchange_strong(previous, now, std::memory_order_relaxed)) {
+        return;
+    }
+    // 写入当前未被使用的槽位后再切换；读者拿到的最多是上一秒的值
+    int next = 1 - date_current.load(std::memory_order_relaxed);
+    std::string line = "Date: " + format_http_date(now) + "\r\n";
+    memcpy(date_slots[next], line.data(), std::min<size_t>(line.size(), DATE_HEADER_SIZE));
+    date_current.store(next, std::memory_order_release);
+}
+
+void HttpDateCache::append_to(std::string* out) {
+    if (date_second.load(std::memory_order_relaxed) == 0) {
+        refresh(time(nullptr));
+    }
+    out->append(date_slots[date_current.load(std::memory_order_acquire)], DATE_HEADER_SIZE);
+}
+
+ResponseBuilder::ResponseBuilder(Response& response, int status, std::string_view reason)
+    : response_(response) {
+    response_.status = status;
+    response_.head = http_status_line(status);
+    if (response_.head.empty()) {
+        response_.buffer.append("HTTP/1.1 ").append(std::to_string(status)).append(" ");
+        response_.buffer.append(reason).append("\r\n");
+    }
+}
+
+ResponseBuilder::ResponseBuilder(Response& response, int status, std::string_view head,
+                                 std::shared_ptr<const void> owner)
+    : response_(response) {
+    response_.status = status;
+    response_.head = head;
+    response_.head_owner = std::move(owner);
+}
+
+ResponseBuilder& ResponseBuilder::header(HttpHeaderName name, std::string_view value) {
+    response_.buffer.append(HEADER_NAMES[name]).append(value).append("\r\n");
+    return *this;
+}
+
+ResponseBuilder& ResponseBuilder::content_length(uint64_t length) {
+    char digits[24];
+    char* end = std::to_chars(digits, digits + sizeof(digits), length).ptr;
+    return header(HEADER_CONTENT_LENGTH, std::string_view(digits, end - digits));
+}
+
+ResponseBuilder& ResponseBuilder::raw(std::string_view lines) {
+    response_.buffer.append(lines);
+    return *this;
+}
+
+ResponseBuilder& ResponseBuilder::end_headers() {
+    HttpDateCache::append_to(&response_.buffer);
+    response_.header_end = response_.buffer.size();
+    response_.buffer.append("\r\n");
+    return *this;
+}
+
+ResponseBuilder& ResponseBuilder::body(std::string_view data) {
+    response_.buffer.append(data);
+    return *this;
+}
+
+ErrorPages::ErrorPages() {
+    static const int statuses[] = { 400, 403, 404, 405, 408, 411, 413, 414, 417, 431, 500, 501, 502, 503, 504 };
+    for (int status : statuses) {
+        std::string_view line = http_status_line(status);
+        // 去掉 "HTTP/1.1 " 和结尾的 "\r\n"
+        std::string_view title = line.substr(9, line.size() - 11);
+        Page page;
+        page.status = status;
+        page.body = std::make_shared<const std::string>("<html><body><h1>" + std::string(title) +
+                                                        "</h1></body></html>");
+        page.head = std::string(line) + "Content-Type: text/html\r\n"
+                    "Content-Length: " + std::to_string(page.body->size()) + "\r\n";
+        pages_.push_back(std::move(page));
+    }
+}
+
+const ErrorPages::Page* ErrorPages::find(int status) const {
+    for (const Page& page : pages_) {
+        if (page.status == status) {
+            return &page;
+        }
+    }
+    return nullptr;
+}
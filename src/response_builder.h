@@ -0,0 +1,79 @@
+#ifndef RESPONSE_BUILDER_H
+#define RESPONSE_BUILDER_H
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdint.h>
+#include <time.h>
+#include "connection.h"
+
+// 常用响应头字段，名称（含 ": "）来自编译期的表
+enum HttpHeaderName {
+    HEADER_CONTENT_TYPE,
+    HEADER_CONTENT_LENGTH,
+    HEADER_CONTENT_RANGE,
+    HEADER_CONTENT_ENCODING,
+    HEADER_ETAG,
+    HEADER_LAST_MODIFIED,
+    HEADER_ACCEPT_RANGES,
+    HEADER_VARY,
+    HEADER_RETRY_AFTER,
+    HEADER_LOCATION,
+    HEADER_NAME_COUNT
+};
+
+// "HTTP/1.1 200 OK\r\n" 形式的状态行，不在表中的状态码返回空视图
+std::string_view http_status_line(int status);
+
+// 按秒缓存的 Date 头部。事件循环每次醒来调用 refresh（时间轮保证至少每个tick一次），
+// 秒数变化时格式化到另一个槽位再切换，工作线程只做拷贝
+class HttpDateCache {
+public:
+    static void refresh(time_t now);
+    // 追加 "Date: ...\r\n"
+    static void append_to(std::string* out);
+};
+
+// 在 Response 上构建响应头：状态行和预生成的片段只以指针形式放进 Response::head，
+// 作为单独的 iovec 发送；buffer 中只有逐个请求不同的字段、Date 和结尾空行
+class ResponseBuilder {
+public:
+    // 状态行取自静态表；不在表中的状态码用 reason 动态生成
+    ResponseBuilder(Response& response, int status, std::string_view reason = std::string_view());
+    // head 为预生成的响应头（含状态行，不含结尾空行），owner 持有其内存直到发送完毕（静态内存时为空）
+    ResponseBuilder(Response& response, int status, std::string_view head, std::shared_ptr<const void> owner);
+
+    ResponseBuilder& header(HttpHeaderName name, std::string_view value);
+    ResponseBuilder& content_length(uint64_t length);
+    // 追加原样的响应头行（须以 \r\n 结尾）
+    ResponseBuilder& raw(std::string_view lines);
+    // 追加 Date 和结尾空行，并记录插入 Connection 头部的位置
+    ResponseBuilder& end_headers();
+    // 小的动态响应体直接跟在响应头后面
+    ResponseBuilder& body(std::string_view data);
+
+private:
+    Response& response_;
+};
+
+// 启动时预生成的错误页：响应头片段和共享的响应体，发送时不再拼接
+class ErrorPages {
+public:
+    ErrorPages();
+
+    struct Page {
+        int status;
+        std::string head;
+        std::shared_ptr<const std::string> body;
+    };
+
+    // 未预生成的状态码返回nullptr
+    const Page* find(int status) const;
+
+private:
+    std::vector<Page> pages_;
+};
+
+#endif // RESPONSE_BUILDER_H
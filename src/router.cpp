@@ -0,0 +1,207 @@
+#include "router.h"
+#include "logger.h"
+#include <algorithm>
+
+struct Router::Node {
+    std::string prefix;                              // 静态片段（压缩后的公共前缀）
+    std::vector<std::unique_ptr<Node>> children;     // 静态子节点，首字符互不相同
+    std::unique_ptr<Node> param_child;               // ":name"
+    std::string param_name;
+    std::unique_ptr<Node> wildcard_child;            // "*name"
+    std::string wildcard_name;
+    int routes[HTTP_METHOD_COUNT];                   // 各方法对应的路由下标，-1表示未注册
+
+    Node() { std::fill(routes, routes + HTTP_METHOD_COUNT, -1); }
+
+    // method 为 HTTP_METHOD_COUNT 时表示任意方法
+    bool accepts(HttpMethod method) const {
+        if (method != HTTP_METHOD_COUNT) {
+            return routes[method] != -1;
+        }
+        return std::any_of(routes, routes + HTTP_METHOD_COUNT, [](int r) { return r != -1; });
+    }
+};
+
+static const char* const METHOD_NAMES[HTTP_METHOD_COUNT] = {
+    "GET", "HEAD", "POST", "PUT", "DELETE", "PATCH", "OPTIONS"
+};
+
+HttpMethod http_method_from(std::string_view method) {
+    for (int i = 0; i < HTTP_METHOD_COUNT; ++i) {
+        if (method == METHOD_NAMES[i]) {
+            return static_cast<HttpMethod>(i);
+        }
+    }
+    return HTTP_METHOD_COUNT;
+}
+
+const char* http_method_name(HttpMethod method) {
+    return method < HTTP_METHOD_COUNT ? METHOD_NAMES[method] : "";
+}
+
+std::string_view RouteParams::get(std::string_view name) const {
+    for (size_t i = 0; i < count; ++i) {
+        if (names[i] == name) {
+            return values[i];
+        }
+    }
+    return std::string_view();
+}
+
+Router::Router() : root_(new Node()) {}
+
+Router::~Router() {}
+
+bool Router::add(HttpMethod method, std::string_view pattern, RouteHandler handler, RouteMode mode,
+                 const MicrocachePolicy* cache) {
+    bool valid = method < HTTP_METHOD_COUNT && !pattern.empty() && pattern[0] == '/';
+    // 参数和通配只能出现在路径段的开头，通配只能在最后
+    for (size_t i = 1; valid && i < pattern.size(); ++i) {
+        if ((pattern[i] == ':' || pattern[i] == '*') && pattern[i - 1] != '/') {
+            valid = false;
+        }
+        if (pattern[i] == '*' && pattern.find('/', i) != std::string_view::npos) {
+            valid = false;
+        }
+    }
+    int index = static_cast<int>(routes_.size());
+    if (!valid || !insert(root_.get(), pattern, method, index)) {
+        LOG_ERROR("路由注册失败：" + std::string(http_method_name(method)) + " " + std::string(pattern));
+        return false;
+    }
+    routes_.emplace_back(new Route{ std::string(pattern), std::move(handler), mode, cache });
+    return true;
+}
+
+bool Router::insert(Node* node, std::string_view pattern, HttpMethod method, int route_index) {
+    if (pattern.empty()) {
+        if (node->routes[method] != -1) {
+            return false;
+        }
+        node->routes[method] = route_index;
+        return true;
+    }
+
+    if (pattern[0] == ':') {
+        size_t end = std::min(pattern.find('/'), pattern.size());
+        std::string_view name = pattern.substr(1, end - 1);
+        if (name.empty()) {
+            return false;
+        }
+        // 同一位置的参数必须同名，否则同一个值会有两个名字
+        if (!node->param_child) {
+            node->param_child.reset(new Node());
+            node->param_name = std::string(name);
+        } else if (node->param_name != name) {
+            return false;
+        }
+        return insert(node->param_child.get(), pattern.substr(end), method, route_index);
+    }
+
+    if (pattern[0] == '*') {
+        std::string_view name = pattern.substr(1);
+        if (name.empty()) {
+            return false;
+        }
+        if (!node->wildcard_child) {
+            node->wildcard_child.reset(new Node());
+            node->wildcard_name = std::string(name);
+        } else if (node->wildcard_name != name) {
+            return false;
+        }
+        return insert(node->wildcard_child.get(), std::string_view(), method, route_index);
+    }
+
+    // 静态片段：到下一个参数或通配为止
+    std::string_view run = pattern.substr(0, std::min(pattern.find_first_of(":*"), pattern.size()));
+    for (std::unique_ptr<Node>& child : node->children) {
+        if (child->prefix[0] != run[0]) {
+            continue;
+        }
+        size_t common = 0;
+        while (common < run.size() && common < child->prefix.size() && run[common] == child->prefix[common]) {
+            ++common;
+        }
+        if (common < child->prefix.size()) {
+            // 在公共前缀处拆分已有节点
+            std::unique_ptr<Node> middle(new Node());
+            middle->prefix = child->prefix.substr(0, common);
+            child->prefix.erase(0, common);
+            middle->children.push_back(std::move(child));
+            child = std::move(middle);
+        }
+        return insert(child.get(), pattern.substr(common), method, route_index);
+    }
+    node->children.emplace_back(new Node());
+    Node* child = node->children.back().get();
+    child->prefix = std::string(run);
+    return insert(child, pattern.substr(run.size()), method, route_index);
+}
+
+const Router::Node* Router::find(const Node* node, std::string_view path, HttpMethod method,
+                                 RouteParams* params) const {
+    if (path.compare(0, node->prefix.size(), node->prefix) != 0) {
+        return nullptr;
+    }
+    path.remove_prefix(node->prefix.size());
+    if (path.empty() && node->accepts(method)) {
+        return node;
+    }
+    if (!path.empty()) {
+        for (const std::unique_ptr<Node>& child : node->children) {
+            if (child->prefix[0] == path[0]) {
+                const Node* found = find(child.get(), path, method, params);
+                if (found != nullptr) {
+                    return found;
+                }
+                break;
+            }
+        }
+    }
+    if (params->count >= MAX_ROUTE_PARAMS) {
+        return nullptr;
+    }
+    if (node->param_child) {
+        std::string_view segment = path.substr(0, std::min(path.find('/'), path.size()));
+        if (!segment.empty()) {
+            size_t index = params->count++;
+            params->names[index] = node->param_name;
+            params->values[index] = segment;
+            const Node* found = find(node->param_child.get(), path.substr(segment.size()), method, params);
+            if (found != nullptr) {
+                return found;
+            }
+            --params->count;
+        }
+    }
+    if (node->wildcard_child && node->wildcard_child->accepts(method)) {
+        size_t index = params->count++;
+        params->names[index] = node->wildcard_name;
+        params->values[index] = path;
+        return node->wildcard_child.get();
+    }
+    return nullptr;
+}
+
+const Route* Router::match(HttpMethod method, std::string_view path, RouteParams* params, unsigned* allowed) const {
+    params->count = 0;
+    *allowed = 0;
+    if (method < HTTP_METHOD_COUNT) {
+        const Node* node = find(root_.get(), path, method, params);
+        if (node != nullptr) {
+            return routes_[node->routes[method]].get();
+        }
+    }
+    // 路径存在但方法不匹配时返回405，需要知道该路径允许哪些方法
+    RouteParams ignored;
+    const Node* node = find(root_.get(), path, HTTP_METHOD_COUNT, &ignored);
+    if (node != nullptr) {
+        for (int i = 0; i < HTTP_METHOD_COUNT; ++i) {
+            if (node->routes[i] != -1) {
+                *allowed |= 1u << i;
+            }
+        }
+    }
+    params->count = 0;
+    return nullptr;
+}
@@ -0,0 +1,88 @@
+#ifndef ROUTER_H
+#define ROUTER_H
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stddef.h>
+
+struct Connection;
+struct HttpRequest;
+struct MicrocachePolicy;
+
+// 一条路由最多捕获的参数数量
+#define MAX_ROUTE_PARAMS 8
+
+enum HttpMethod {
+    HTTP_GET,
+    HTTP_HEAD,
+    HTTP_POST,
+    HTTP_PUT,
+    HTTP_DELETE,
+    HTTP_PATCH,
+    HTTP_OPTIONS,
+    HTTP_METHOD_COUNT   // 不认识的方法
+};
+
+HttpMethod http_method_from(std::string_view method);
+const char* http_method_name(HttpMethod method);
+
+// 处理函数在哪里执行
+enum RouteMode {
+    ROUTE_INLINE,    // 足够轻量：在解析请求的线程上直接执行，流水线中的后续请求紧接着处理
+    ROUTE_OFFLOAD    // 可能阻塞或耗时：连接作为一个新任务重新提交给线程池，可以被空闲线程窃取
+};
+
+// 路径参数：名称指向路由表，值指向请求的URL，查找过程不分配内存
+struct RouteParams {
+    std::string_view names[MAX_ROUTE_PARAMS];
+    std::string_view values[MAX_ROUTE_PARAMS];
+    size_t count;
+
+    RouteParams() : count(0) {}
+
+    // 不存在时返回空视图
+    std::string_view get(std::string_view name) const;
+};
+
+typedef std::function<void(Connection* conn, const HttpRequest& request, const RouteParams& params)> RouteHandler;
+
+struct Route {
+    std::string pattern;
+    RouteHandler handler;
+    RouteMode mode;
+    const MicrocachePolicy* cache;   // 响应缓存策略，为空表示不缓存
+};
+
+// 按方法和路径模式注册处理函数，用压缩前缀树（radix trie）匹配。
+// 模式由静态片段、":name"（匹配一个非空路径段）和结尾的 "*name"（匹配剩余部分，可以为空）组成，
+// 匹配优先级：静态 > 参数 > 通配，失败时回溯。路由表在启动时建立，运行期间只读，多线程查找无需加锁
+class Router {
+public:
+    Router();
+    ~Router();
+
+    Router(const Router&) = delete;
+    Router& operator=(const Router&) = delete;
+
+    // 注册路由，模式不合法或与已有路由冲突时记录错误并返回false。cache 须在路由表存在期间有效
+    bool add(HttpMethod method, std::string_view pattern, RouteHandler handler, RouteMode mode = ROUTE_INLINE,
+             const MicrocachePolicy* cache = nullptr);
+
+    // 查找路由，path 不含查询字符串。没有匹配的方法时返回nullptr，
+    // 此时 *allowed 为该路径上已注册方法的位掩码（0表示路径不存在）
+    const Route* match(HttpMethod method, std::string_view path, RouteParams* params, unsigned* allowed) const;
+
+private:
+    struct Node;
+
+    bool insert(Node* node, std::string_view pattern, HttpMethod method, int route_index);
+    const Node* find(const Node* node, std::string_view path, HttpMethod method, RouteParams* params) const;
+
+    std::unique_ptr<Node> root_;
+    std::vector<std::unique_ptr<Route>> routes_;
+};
+
+#endif // ROUTER_H
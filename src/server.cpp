@@ -6,36 +6,129 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
+#include <limits.h>
+#include <poll.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
 #include <sstream>
 #include <algorithm>
+#include <chrono>
 #include <cctype>
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/sendfile.h>
 #include <unistd.h>
 
-Server::Server(int port, int thread_num)
-    : port_(port), thread_pool_(thread_num) {
+// 静态资源根目录
+static const std::string RESOURCE_ROOT = "./resource";
+
+// 启动时解析一次根目录的绝对路径（去掉符号链接和 "."/".."），请求路径只在它下面拼接
+static std::string canonical_root(const std::string& root) {
+    char resolved[PATH_MAX];
+    if (realpath(root.c_str(), resolved) == nullptr) {
+        return root;
+    }
+    return resolved;
+}
+
+// 按配置计算Reactor和工作线程的绑定位置，返回工作线程部分（作为线程池的构造参数）
+static const std::vector<ThreadPlacement>& plan_threads(const ServerConfig& config,
+                                                        std::vector<ThreadPlacement>* reactors,
+                                                        std::vector<ThreadPlacement>* workers) {
+    if (config.affinity != AFFINITY_NONE) {
+        plan_thread_placement(CpuTopology::detect(),
+                              config.affinity == AFFINITY_LIST ? config.cpu_list : std::vector<int>(),
+                              std::max(config.reactors, 1), std::max(config.worker_threads, 1),
+                              reactors, workers);
+    }
+    return *workers;
+}
+
+// 绑定位置的简要描述，用于启动日志
+static std::string describe_placement(const ThreadPlacement& placement) {
+    if (placement.cpus.empty()) {
+        return "-";
+    }
+    std::string text = "node" + std::to_string(placement.node) + ":" + std::to_string(placement.cpus.front());
+    if (placement.cpus.size() > 1) {
+        text += "-" + std::to_string(placement.cpus.back());
+    }
+    return text;
+}
+
+Server::Server(const ServerConfig& config)
+    : port_(config.port),
+      thread_pool_(std::max(config.worker_threads, 1),
+                   plan_threads(config, &reactor_placement_, &worker_placement_)),
+      resource_root_(canonical_root(RESOURCE_ROOT)),
+      asset_cache_(resource_root_, config.cache_budget), microcache_policies_(config.microcache),
+      microcache_(config.microcache_budget), proxy_catch_all_(false),
+      io_backend_(config.io_backend), use_uring_(false),
+      exec_argv_(config.exec_argv), drain_timeout_ms_(config.drain_timeout_ms), upgrade_channel_(-1),
+      draining_(false), http2_enabled_(config.http2), event_batch_(config.event_batch), read_per_event_(config.read_per_event),
+      write_per_event_(config.write_per_event), uring_buffer_count_(config.uring_buffer_count),
+      uring_buffer_size_(config.uring_buffer_size), active_connections_(0),
+      shed_connections_(0) {
+    int reactor_num = std::max(config.reactors, 1);
+    for (int i = 0; i < reactor_num; ++i) {
+        std::unique_ptr<Reactor> reactor(new Reactor());
+        reactor->id = i;
+        if (static_cast<size_t>(i) < reactor_placement_.size()) {
+            reactor->placement = reactor_placement_[i];
+        }
+        reactors_.push_back(std::move(reactor));
+    }
     init_socket();
-    init_logger();     // 初始化日志系统
+    init_logger(config);     // 初始化日志系统
+    set_timeouts(config.timeouts);
+    set_body_limits(config.body_limits);
+    set_admission(config.admission);
+    register_proxy_routes(config);
+    register_default_routes();
+
+    if (config.affinity != AFFINITY_NONE) {
+        std::string layout = "线程绑定：Reactor";
+        for (const ThreadPlacement& placement : reactor_placement_) {
+            layout += " " + describe_placement(placement);
+        }
+        layout += "，工作线程";
+        for (const ThreadPlacement& placement : worker_placement_) {
+            layout += " " + describe_placement(placement);
+        }
+        LOG_INFO(layout);
+    }
 }
 Server::~Server() {
-    close(listen_fd_);
-    close(epoll_fd_);
+    for (auto& reactor : reactors_) {
+        close(reactor->listen_fd);
+        close(reactor->epoll_fd);
+        if (reactor->spare_fd != -1) {
+            close(reactor->spare_fd);
+        }
+        if (reactor->wake_fd != -1) {
+            close(reactor->wake_fd);
+        }
+    }
 }
 
-void Server::init_socket() {
-    listen_fd_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (listen_fd_ == -1) {
+int Server::create_listen_socket() {
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1) {
         perror("socket error");
         exit(EXIT_FAILURE);
     }
 
-    // 设置地址复用
+    // 设置地址复用；SO_REUSEPORT让每个Reactor绑定同一端口，由内核在它们之间分发新连接
     int opt = 1;
-    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) == -1) {
+        perror("setsockopt SO_REUSEPORT error");
+        close(listen_fd);
+        exit(EXIT_FAILURE);
+    }
 
     // 绑定地址和端口
     struct sockaddr_in server_addr;
@@ -44,80 +137,208 @@ void Server::init_socket() {
     server_addr.sin_addr.s_addr = htonl(INADDR_ANY); // 监听所有地址
     server_addr.sin_port = htons(port_);
 
-    if (bind(listen_fd_, (struct sockaddr*)&server_addr, sizeof(server_addr)) == -1) {
+    if (bind(listen_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) == -1) {
         perror("bind error");
-        close(listen_fd_);
+        close(listen_fd);
         exit(EXIT_FAILURE);
     }
 
     // 开始监听
-    if (listen(listen_fd_, SOMAXCONN) == -1) {
+    if (listen(listen_fd, SOMAXCONN) == -1) {
         perror("listen error");
-        close(listen_fd_);
+        close(listen_fd);
         exit(EXIT_FAILURE);
     }
 
     // 设置非阻塞
-    set_nonblocking(listen_fd_);
+    set_nonblocking(listen_fd);
+    return listen_fd;
+}
+
+void Server::init_socket() {
+    // 由热升级启动时沿用旧进程的监听套接字，其队列中已完成握手的连接由本进程继续 accept
+    std::vector<int> inherited;
+    upgrade_channel_ = inherit_listeners(&inherited);
+    for (int fd : inherited) {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        if (getsockname(fd, (struct sockaddr*)&addr, &addr_len) == -1 || ntohs(addr.sin_port) != port_) {
+            LOG_WARN("热升级：继承的监听套接字端口与配置不符，重新创建");
+            for (int other : inherited) {
+                close(other);
+            }
+            inherited.clear();
+            break;
+        }
+    }
+    // 每个继承的套接字都要有Reactor接手，否则其中排队的连接会在旧进程退出时被重置
+    if (inherited.size() > reactors_.size()) {
+        LOG_WARN("热升级：继承了 " + std::to_string(inherited.size()) + " 个监听套接字，Reactor数量相应增加");
+        while (reactors_.size() < inherited.size()) {
+            std::unique_ptr<Reactor> reactor(new Reactor());
+            reactor->id = static_cast<int>(reactors_.size());
+            reactors_.push_back(std::move(reactor));
+        }
+    }
 
-    // 创建epoll实例
-    epoll_fd_ = create_epoll_fd();
+    for (size_t i = 0; i < reactors_.size(); ++i) {
+        Reactor* reactor = reactors_[i].get();
+        reactor->listen_fd = i < inherited.size() ? inherited[i] : create_listen_socket();
 
-    // 将监听套接字加入epoll
-    add_fd_to_epoll(epoll_fd_, listen_fd_, true); // 使用ET模式
+        // 创建epoll实例
+        reactor->epoll_fd = create_epoll_fd();
+
+        // 将监听套接字加入该Reactor的epoll
+        add_fd_to_epoll(reactor->epoll_fd, reactor->listen_fd, true); // 使用ET模式
+
+        reactor->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
+}
+
+void Server::set_timeouts(const TimeoutConfig& timeouts) {
+    timeouts_ = timeouts;
+}
+
+void Server::set_body_limits(const BodyLimits& limits) {
+    body_limits_ = limits;
+}
+
+void Server::set_io_backend(IoBackend backend) {
+    io_backend_ = backend;
+}
+
+void Server::set_admission(const AdmissionConfig& admission) {
+    admission_ = admission;
+    if (admission_.max_connections == 0 || admission_.max_connections > connections_.capacity()) {
+        admission_.max_connections = connections_.capacity();
+    }
+    if (admission_.high_water == 0 || admission_.high_water > admission_.max_connections) {
+        admission_.high_water = admission_.max_connections / 10 * 9;
+    }
+    // 过载时的响应只生成一次，拒绝连接时直接发送
+    std::string body = "<html><body><h1>503 Service Unavailable</h1></body></html>";
+    shed_response_ = "HTTP/1.1 503 Service Unavailable\r\n"
+                     "Content-Type: text/html\r\n"
+                     "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                     "Retry-After: " + std::to_string(admission_.retry_after_s) + "\r\n"
+                     "Connection: close\r\n"
+                     "\r\n" + body;
 }
 
 void Server::run() {
-    LOG_INFO("服务器启动，监听端口：" + std::to_string(port_));
-    event_loop();  // 进入事件循环
+    if (io_backend_ == IO_BACKEND_URING) {
+        use_uring_ = true;
+        for (auto& reactor : reactors_) {
+            if (!init_uring(reactor.get())) {
+                use_uring_ = false;
+                break;
+            }
+        }
+        if (!use_uring_) {
+            LOG_WARN("内核不支持所需的 io_uring 功能，退回 epoll 后端");
+            for (auto& reactor : reactors_) {
+                reactor->uring.reset();
+            }
+        }
+    }
+    LOG_INFO("服务器启动，监听端口：" + std::to_string(port_) +
+             "，Reactor数量：" + std::to_string(reactors_.size()) +
+             "，I/O后端：" + (use_uring_ ? "io_uring" : "epoll"));
+    // 每个Reactor在独立线程中运行自己的事件循环
+    for (auto& reactor : reactors_) {
+        Reactor* r = reactor.get();
+        r->thread = std::thread(use_uring_ ? &Server::uring_event_loop : &Server::event_loop, this, r);
+    }
+    if (upgrade_channel_ != -1) {
+        // 已开始服务，旧进程可以停止 accept 了
+        notify_upgrade_ready(upgrade_channel_);
+        upgrade_channel_ = -1;
+        LOG_INFO("热升级：已接管监听套接字");
+    }
+    std::thread(&Server::wait_for_upgrade, this).detach();
+    for (auto& reactor : reactors_) {
+        if (reactor->thread.joinable()) {
+            reactor->thread.join();
+        }
+    }
     LOG_INFO("服务器停止运行。");
 }
 
-void Server::event_loop() {
-    struct epoll_event events[MAX_EVENTS];
+void Server::event_loop(Reactor* reactor) {
+    // 先绑定CPU，事件数组等之后分配的内存落在本节点
+    apply_thread_placement(reactor->placement);
+    // 批量事件数组，一次epoll_wait取回多个就绪事件
+    std::vector<struct epoll_event> events(event_batch_);
+    // 本轮待提交的任务，整批交给线程池，只唤醒一次
+    std::vector<Task> batch(event_batch_);
+    auto on_expire = [this, reactor](Connection* conn, uint32_t generation) {
+        expire_connection(reactor, conn, generation);
+    };
 
     while (true) {
-        int n = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+        // 最多等到时间轮的下一个tick
+        int timeout = reactor->timers.next_timeout(current_time_ms());
+        int n = epoll_wait(reactor->epoll_fd, events.data(), event_batch_, timeout);
+        drain_timer_requests(reactor);
+        reactor->timers.advance(current_time_ms(), on_expire);
+        HttpDateCache::refresh(time(nullptr));
         if (n == -1) {
-            LOG_ERROR("epoll_wait() 错误：" + std::string(strerror(errno)));
+            if (errno == EINTR) {
+                continue;
+            }
+            LOG_ERROR("Reactor " + std::to_string(reactor->id) +
+                      " epoll_wait() 错误：" + std::string(strerror(errno)));
             break;
         }
 
+        size_t batch_size = 0;
         for (int i = 0; i < n; ++i) {
-            int fd = events[i].data.fd;
+            uint32_t key_fd = static_cast<uint32_t>(conn_key_fd(events[i].data.u64));
+            int fd = static_cast<int>(key_fd & ~(UPSTREAM_KEY_FLAG | PARKED_KEY_FLAG));
+
+            if (key_fd == static_cast<uint32_t>(reactor->listen_fd)) {
+                accept_connections(reactor);
+                continue;
+            }
+
+            // 根据 fd + 代数 找到连接；代数不匹配说明是已关闭连接的过期事件
+            Connection* conn = connections_.get(fd, conn_key_generation(events[i].data.u64));
+            if (conn == nullptr) {
+                continue;
+            }
+
+            // 等待上游的连接（见 park_connection）：先取得连接。之后才到达的、
+            // 或连接已恢复 EPOLLONESHOT 交接时的过期事件不再处理
+            if (key_fd & (UPSTREAM_KEY_FLAG | PARKED_KEY_FLAG)) {
+                if (!claim_parked_connection(conn)) {
+                    continue;
+                }
+                if ((key_fd & PARKED_KEY_FLAG) && (events[i].events & (EPOLLERR | EPOLLHUP))) {
+                    LOGF_WARN("文件描述符 {} 发生错误或挂起，关闭连接。", fd);
+                    close_connection(conn);
+                } else {
+                    batch[batch_size++] = Task([this, conn]() { resume_connection(conn); });
+                }
+                continue;
+            }
 
-            // 错误事件处理
+            // 错误事件处理（EPOLLONESHOT保证此时没有工作线程持有该连接）
             if (events[i].events & (EPOLLERR | EPOLLHUP)) {
-                LOG_WARN("文件描述符 " + std::to_string(fd) + " 发生错误或挂起，关闭连接。");
-                close(fd);
+                LOGF_WARN("文件描述符 {} 发生错误或挂起，关闭连接。", fd);
+                close_connection(conn);
                 continue;
             }
 
-            if (fd == listen_fd_) {
-                accept_connections();
-            } else {
-                // 将I/O事件的处理任务提交给线程池
-                if (events[i].events & EPOLLIN) {
-                    // 可读事件
-                    thread_pool_.enqueue([this, fd]() { handle_read(fd); });
-                } else if (events[i].events & EPOLLOUT) {
-                    // 可写事件
-                    thread_pool_.enqueue([this, fd]() { handle_write(fd); });
-                }            
-            }
-            // if (fd == listen_fd_) {
-            //     // 处理新的连接请求
-            //     accept_connections();
-            // } else if (events[i].events & EPOLLIN) {
-            //     // 处理可读事件
-            //     handle_read(fd);
-            // } else if (events[i].events & EPOLLOUT) {
-            //     // 处理可写事件
-            //     handle_write(fd);
-            // } else {
-            //     continue;
-            // }
+            // 将I/O事件的处理任务提交给线程池，任务执行期间由该工作线程独占连接
+            if (events[i].events & EPOLLIN) {
+                // 可读事件
+                batch[batch_size++] = Task([this, conn]() { handle_read(conn); });
+            } else if (events[i].events & EPOLLOUT) {
+                // 可写事件
+                batch[batch_size++] = Task([this, conn]() { handle_write(conn); });
+            }
         }
+        thread_pool_.submit_batch(batch.data(), batch_size, reactor->placement.node);
     }
 }
 
@@ -149,287 +370,1723 @@ void Server::event_loop() {
 //         add_fd_to_epoll(epoll_fd_, conn_fd, true); // 使用ET模式
 //     }
 // }
-void Server::accept_connections() {
-    struct sockaddr_in client_addr;
-    socklen_t client_addr_len = sizeof(client_addr);
-    int conn_fd = accept(listen_fd_, (struct sockaddr*)&client_addr, &client_addr_len);
-    if (conn_fd == -1) {
-        LOG_ERROR("accept() 错误：" + std::string(strerror(errno)));
-        return;
+void Server::accept_connections(Reactor* reactor) {
+    // 监听socket是边缘触发：必须一直accept到EAGAIN，否则积压的连接要等下一个新连接到来才会被处理
+    while (true) {
+        struct sockaddr_in client_addr;
+        socklen_t client_addr_len = sizeof(client_addr);
+        int conn_fd = accept4(reactor->listen_fd, (struct sockaddr*)&client_addr, &client_addr_len,
+                              SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (conn_fd == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if ((errno == EMFILE || errno == ENFILE) && accept_with_spare_fd(reactor)) {
+                continue;
+            }
+            LOG_ERROR("accept() 错误：" + std::string(strerror(errno)));
+            break;
+        }
+
+        if (!admit_connection(conn_fd)) {
+            continue;
+        }
+        Connection* conn = open_connection(reactor, conn_fd);
+        if (conn == nullptr) {
+            continue;
+        }
+
+        // 添加到接受它的Reactor的 epoll 监听，之后该连接的事件都由这个Reactor处理
+        uint64_t key = pack_conn_key(conn_fd, conn->generation.load(std::memory_order_relaxed));
+        if (!add_fd_to_epoll(reactor->epoll_fd, conn_fd, EPOLLIN | EPOLLET | EPOLLONESHOT, key)) {
+            close_connection(conn);
+            continue;
+        }
+
+        if (Logger::enabled(INFO)) {
+            char client_ip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, sizeof(client_ip));
+            LOGF_INFO("Reactor {} 接受新连接，文件描述符：{}, 来自：{}:{}", reactor->id, conn_fd,
+                      client_ip, ntohs(client_addr.sin_port));
+        }
     }
+}
 
-    // 设置非阻塞模式
-    set_nonblocking(conn_fd);
+bool Server::admit_connection(int conn_fd) {
+    size_t active = active_connections_.load(std::memory_order_relaxed);
+    if (active < admission_.high_water) {
+        return true;
+    }
+    // 超过上限时连503也不发，尽快释放fd
+    shed_connection(conn_fd, active < admission_.max_connections);
+    return false;
+}
 
-    // 添加到 epoll 监听
-    add_fd_to_epoll(epoll_fd_, conn_fd, EPOLLIN | EPOLLET);
+bool Server::accept_with_spare_fd(Reactor* reactor) {
+    if (reactor->spare_fd == -1) {
+        // 上次释放后被其他线程占用了，重新预留
+        reactor->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if (reactor->spare_fd == -1) {
+            return false;
+        }
+    }
+    LOG_WARN("Reactor " + std::to_string(reactor->id) + " 文件描述符耗尽，拒绝积压的连接");
+    close(reactor->spare_fd);
+    int conn_fd = accept4(reactor->listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (conn_fd != -1) {
+        shed_connection(conn_fd, true);
+    }
+    reactor->spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    return conn_fd != -1;
+}
 
-    LOG_INFO("接受新连接，文件描述符：" + std::to_string(conn_fd) +
-             ", 来自：" + inet_ntoa(client_addr.sin_addr) +
-             ":" + std::to_string(ntohs(client_addr.sin_port)));
+void Server::shed_connection(int conn_fd, bool respond) {
+    shed_connections_.fetch_add(1, std::memory_order_relaxed);
+    if (respond) {
+        // 先读掉已到达的请求：关闭时接收缓冲区非空会发出RST，客户端可能来不及读到503
+        char discard[4096];
+        (void)recv(conn_fd, discard, sizeof(discard), MSG_DONTWAIT);
+        (void)send(conn_fd, shed_response_.data(), shed_response_.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+    LOGF_DEBUG("连接数过多，拒绝连接，文件描述符：{}", conn_fd);
+    close(conn_fd);
 }
 
+Connection* Server::open_connection(Reactor* reactor, int conn_fd) {
+    Connection* conn = connections_.open(conn_fd, reactor);
+    if (conn == nullptr) {
+        LOGF_WARN("文件描述符 {} 超出连接槽位容量，拒绝连接。", conn_fd);
+        close(conn_fd);
+        return nullptr;
+    }
+    active_connections_.fetch_add(1, std::memory_order_relaxed);
+    Metrics::local().accepted.add();
 
-// 在server.cpp中
-bool Server::parse_request_header(const std::string& request_header, HttpRequest& request) {
-    std::istringstream stream(request_header);
-    std::string line;
+    // 连接建立后必须在 header 超时内发来完整的第一个请求头
+    uint32_t generation = conn->generation.load(std::memory_order_relaxed);
+    conn->deadline_ms.store(conn->created_ms + timeouts_.header_ms, std::memory_order_relaxed);
+    conn->timeout_kind.store(TIMEOUT_HEADER, std::memory_order_relaxed);
+    reactor->timers.add(conn, generation, conn->created_ms + timeouts_.header_ms);
+    return conn;
+}
 
-    // 解析请求行
-    if (std::getline(stream, line)) {
-        std::istringstream line_stream(line);
-        if (!(line_stream >> request.method >> request.url >> request.version)) {
-            return false;
+// Connection 头部（逗号分隔的列表）中是否包含某个选项，大小写不敏感
+static bool connection_has_token(std::string_view value, const char* token) {
+    size_t token_len = strlen(token);
+    size_t pos = 0;
+    while (pos < value.size()) {
+        size_t comma = value.find(',', pos);
+        if (comma == std::string_view::npos) {
+            comma = value.size();
         }
-    } else {
+        std::string_view item = value.substr(pos, comma - pos);
+        size_t begin = item.find_first_not_of(" \t");
+        size_t end = item.find_last_not_of(" \t");
+        if (begin != std::string_view::npos && end - begin + 1 == token_len &&
+            strncasecmp(item.data() + begin, token, token_len) == 0) {
+            return true;
+        }
+        pos = comma + 1;
+    }
+    return false;
+}
+
+static bool wants_keep_alive(const HttpRequest& request) {
+    std::string_view connection = request.header("Connection");
+    if (request.version == "HTTP/1.0") {
+        // HTTP/1.0 默认短连接，除非显式要求 keep-alive
+        return connection_has_token(connection, "keep-alive");
+    }
+    // HTTP/1.1 默认持久连接
+    return !connection_has_token(connection, "close");
+}
+
+// HTTP/1.1 升级到 h2c：Upgrade 中有 h2c、带 HTTP2-Settings，且 Connection 中列出了这两个头部
+static bool wants_h2c_upgrade(const HttpRequest& request) {
+    std::string_view connection = request.header("Connection");
+    return request.version == "HTTP/1.1" && connection_has_token(request.header("Upgrade"), "h2c") &&
+           !request.header("HTTP2-Settings").empty() && connection_has_token(connection, "upgrade") &&
+           connection_has_token(connection, "http2-settings");
+}
+
+bool Server::parse_http_request(Connection* conn) {
+    // 获取该连接的读缓冲区
+    IoBuffer& buffer = conn->read_buffer;
+    int64_t parse_start = current_time_ns();
+
+    // 请求头要求连续：把数据拉到第一个分段（请求头上限小于分段大小）
+    if (!conn->parser.headers_complete()) {
+        buffer.pullup(IO_SEGMENT_SIZE);
+    }
+    // 增量解析请求头，从上次停止的位置继续
+    ParseResult result = conn->parser.parse(buffer.front_data(), buffer.front_size());
+    if (result == PARSE_INCOMPLETE) {
+        // 未接收到完整的请求头，继续等待
         return false;
     }
+    if (result != PARSE_COMPLETE) {
+        // 解析失败，返回错误响应；连接上剩余的数据已无法可靠分帧，发送完毕后关闭
+        if (result == PARSE_HEADER_TOO_LARGE) {
+            send_error_response(conn, 431, "Request Header Fields Too Large");
+        } else {
+            send_error_response(conn, 400, "Bad Request");
+        }
+        finish_response(conn, false, false);
+        return true;
+    }
+
+    // 解析请求行和请求头部（视图指向读缓冲区，不拷贝）
+    HttpRequest request;
+    conn->parser.fill_request(buffer.front_data(), &request);
+    size_t header_length = conn->parser.header_length();
+
+    if (!conn->body.active() && !begin_request_body(conn, request)) {
+        // 错误响应已排入队列；请求体无法可靠分帧，发送完毕后关闭
+        finish_response(conn, false, false);
+        return true;
+    }
 
-    // 解析请求头部字段
-    while (std::getline(stream, line) && line != "\r") {
-        size_t pos = line.find(":");
-        if (pos != std::string::npos) {
-            std::string key = line.substr(0, pos);
-            std::string value = line.substr(pos + 1);
-            // 去除可能的空格和回车
-            key.erase(remove_if(key.begin(), key.end(), isspace), key.end());
-            value.erase(remove_if(value.begin(), value.end(), isspace), value.end());
-            request.headers[key] = value;
+    // 把请求头之后已到达的数据移入请求体（分块编码在这里解码），读缓冲区中只保留请求头
+    // 和属于下一个流水线请求的数据
+    BodyResult body_result = conn->body.complete() ? BODY_COMPLETE : BODY_INCOMPLETE;
+    while (body_result == BODY_INCOMPLETE && buffer.size() > header_length) {
+        const char* data;
+        size_t len = buffer.peek(header_length, &data);
+        size_t consumed = 0;
+        body_result = conn->body.consume(data, len, &consumed);
+        buffer.erase_after(header_length, consumed);
+        if (consumed < len) {
+            break;
+        }
+    }
+    if (body_result == BODY_INCOMPLETE) {
+        return false;
+    }
+    if (body_result != BODY_COMPLETE) {
+        if (body_result == BODY_TOO_LARGE) {
+            send_error_response(conn, 413, "Content Too Large");
+        } else if (body_result == BODY_IO_ERROR) {
+            LOG_ERROR("请求体写入临时文件失败：" + std::string(strerror(errno)));
+            send_error_response(conn, 500, "Internal Server Error");
+        } else {
+            send_error_response(conn, 400, "Bad Request");
         }
+        finish_response(conn, false, false);
+        return true;
+    }
+    // 移除请求体数据时请求头在分段内移动过，重新生成视图
+    conn->parser.fill_request(buffer.front_data(), &request);
+    request.body = conn->body.size() > 0 ? &conn->body : nullptr;
+
+    // 不带请求体的升级请求：回复101，之后按 HTTP/2 处理，该请求作为流1响应
+    if (http2_enabled_ && request.body == nullptr && !draining_.load(std::memory_order_relaxed) &&
+        wants_h2c_upgrade(request) && upgrade_to_http2(conn, request)) {
+        buffer.consume(header_length);
+        conn->body.reset();
+        conn->parser.reset();
+        return true;
+    }
+
+    // 处理请求
+    int64_t handler_start = current_time_ns();
+    if (!handle_request(conn, request)) {
+        // 路由要求转交线程池：请求留在读缓冲区中，新任务重新解析到这里时再执行
+        return false;
+    }
+    MetricsShard& metrics = Metrics::local();
+    metrics.methods[Metrics::method_index(request.method)].add();
+    metrics.stages[STAGE_PARSE].record(handler_start - parse_start);
+    metrics.stages[STAGE_HANDLER].record(current_time_ns() - handler_start);
+    finish_response(conn, wants_keep_alive(request), request.version == "HTTP/1.0");
+
+    // 移除已处理的请求，为下一次请求做准备
+    buffer.consume(header_length);
+    conn->body.reset();
+    conn->parser.reset();
+    ++conn->request_count;
+    if (!buffer.empty()) {
+        // 流水线中的下一个请求已经开始到达
+        conn->request_started_ms = current_time_ms();
     }
     return true;
 }
 
-bool Server::parse_http_request(int fd) {
-    // 获取该连接的读缓冲区
-    std::string& buffer = read_buffers_[fd];
-
-    // 查找请求头和请求体的分隔位置（空行）
-    size_t pos = buffer.find("\r\n\r\n");
-    if (pos != std::string::npos) {
-        // 已经接收到完整的请求头部
-
-        // 提取请求头部
-        std::string request_header = buffer.substr(0, pos + 4);
-
-        // 解析请求行和请求头部
-        HttpRequest request;
-        if (parse_request_header(request_header, request)) {
-            // 判断是否有请求体（针对POST请求）
-            if (request.method == "POST") {
-                // 获取Content-Length字段，确定请求体长度
-                auto it = request.headers.find("Content-Length");
-                if (it != request.headers.end()) {
-                    int content_length = std::stoi(it->second);
-                    // 检查是否接收到了完整的请求体
-                    if (buffer.size() >= pos + 4 + content_length) {
-                        // 提取请求体
-                        request.body = buffer.substr(pos + 4, content_length);
-                        // 处理请求
-                        handle_request(fd, request);
-                        // 清空缓冲区，为下一次请求做准备
-                        buffer.erase(0, pos + 4 + content_length);
-                        return true;
-                    }
-                } else {
-                    // 没有Content-Length，无法确定请求体长度，返回错误
-                    send_error_response(fd, 400, "Bad Request");
-                    return false;
-                }
-            } else {
-                // GET请求，无请求体
-                // 处理请求
-                handle_request(fd, request);
-                // 清空缓冲区，为下一次请求做准备
-                buffer.erase(0, pos + 4);
-                return true;
-            }
-        } else {
-            // 解析失败，返回错误响应
-            send_error_response(fd, 400, "Bad Request");
+bool Server::begin_request_body(Connection* conn, const HttpRequest& request) {
+    // Transfer-Encoding 只支持 chunked；同时带 Content-Length 时无法确定以哪个为准（请求走私），直接拒绝
+    std::string_view encoding = request.header("Transfer-Encoding");
+    std::string_view length_value = request.header("Content-Length");
+    bool chunked = false;
+    uint64_t content_length = 0;
+    if (!encoding.empty()) {
+        if (!length_value.empty()) {
+            send_error_response(conn, 400, "Bad Request");
+            return false;
+        }
+        if (encoding.size() != 7 || strncasecmp(encoding.data(), "chunked", 7) != 0) {
+            send_error_response(conn, 501, "Not Implemented");
+            return false;
+        }
+        chunked = true;
+    } else if (!length_value.empty()) {
+        if (!parse_decimal(length_value, &content_length)) {
+            send_error_response(conn, 400, "Bad Request");
+            return false;
+        }
+        // 在读取请求体之前就拒绝过大的上传
+        if (content_length > body_limits_.max_size) {
+            send_error_response(conn, 413, "Content Too Large");
             return false;
         }
+    } else if (request.method == "POST") {
+        // 没有Content-Length也不是分块编码，无法确定请求体长度
+        send_error_response(conn, 411, "Length Required");
+        return false;
     }
-    // 未接收到完整的请求，继续等待
-    return false;
+
+    // Expect: 100-continue：客户端在等待许可，请求体还没发来时先回复100
+    std::string_view expect = request.header("Expect");
+    if (!expect.empty()) {
+        if (expect.size() != 12 || strncasecmp(expect.data(), "100-continue", 12) != 0) {
+            send_error_response(conn, 417, "Expectation Failed");
+            return false;
+        }
+        if (request.version != "HTTP/1.0" && (chunked || content_length > 0) &&
+            conn->read_buffer.size() == conn->parser.header_length()) {
+            // 独立的中间响应，不经过 finish_response，也不需要 Date
+            ResponseBuilder(conn->add_response(), 100).raw("\r\n");
+        }
+    }
+    conn->body.begin(chunked, content_length, &body_limits_);
+    return true;
 }
 
+void Server::finish_response(Connection* conn, bool keep_alive, bool http10) {
+    Response& response = conn->last_response_head();
+    if (response.status > 0 && response.status < METRICS_STATUS_LIMIT) {
+        Metrics::local().statuses[response.status].add();
+    }
 
-void Server::handle_read(int fd) {
-    LOG_DEBUG("处理读事件，文件描述符：" + std::to_string(fd));
-    char buffer[4096];
-    while (true) {
-        ssize_t bytes_read = read(fd, buffer, sizeof(buffer));
-        if (bytes_read > 0) {
-            // 将读取到的数据追加到读缓冲区中
-            read_buffers_[fd].append(buffer, bytes_read);
+    const char* extra = nullptr;
+    // 处理函数已决定发送后关闭（如响应体无法分帧）
+    if (!keep_alive || conn->close_after_write || draining_.load(std::memory_order_relaxed)) {
+        extra = "Connection: close\r\n";
+        conn->close_after_write = true;
+    } else if (http10) {
+        extra = "Connection: keep-alive\r\n";
+    }
+    if (extra == nullptr) {
+        return;
+    }
+    // 插入到响应头结尾的空行之前
+    if (response.header_end != std::string::npos) {
+        response.buffer.insert(response.header_end, extra);
+    }
+}
 
-            // 尝试解析HTTP请求
-            if (parse_http_request(fd)) {
-                // 解析成功，修改事件为EPOLLOUT，等待发送响应
-                modify_fd_in_epoll(epoll_fd_, fd, EPOLLOUT | EPOLLET);
+bool Server::process_requests(Connection* conn) {
+    IoBuffer& buffer = conn->read_buffer;
+    if (conn->h2 == nullptr && http2_enabled_ && conn->request_count == 0 && !conn->parser.headers_complete() &&
+        !buffer.empty()) {
+        // 连接以 HTTP/2 前言开始（prior knowledge），前言不完整时先等待
+        size_t n = std::min<size_t>(buffer.size(), H2_PREFACE_SIZE);
+        buffer.pullup(n);
+        if (memcmp(buffer.front_data(), H2_PREFACE, n) == 0) {
+            if (n < H2_PREFACE_SIZE) {
+                return false;
             }
-            break;
+            start_http2(conn);
+        }
+    }
+    if (conn->h2 != nullptr) {
+        return process_http2(conn);
+    }
+
+    size_t before = conn->pending_responses();
+    // 一次处理缓冲区中所有完整的流水线请求；队列达到上限时暂停，发送完毕后再继续
+    while (!conn->close_after_write && !conn->offload_pending() &&
+           conn->pending_responses() < MAX_PIPELINE_DEPTH && conn->h2 == nullptr &&
+           !conn->read_buffer.empty() && parse_http_request(conn)) {
+    }
+    if (conn->h2 != nullptr) {
+        // 刚完成 Upgrade：101 已排入队列，继续处理随后到达的帧和流1
+        process_http2(conn);
+        return true;
+    }
+    return conn->pending_responses() > before;
+}
+
+void Server::handle_read(Connection* conn) {
+    int fd = conn->fd;
+    LOGF_DEBUG("处理读事件，文件描述符：{}", fd);
+    conn->last_active_ms = current_time_ms();
+    size_t total_read = 0;
+    // 读到EAGAIN为止；单次事件读取量有上限，未读完的数据在重新arm时（EPOLL_CTL_MOD会重新检查就绪状态）继续触发
+    while (total_read < read_per_event_) {
+        // 大请求体已转存到临时文件、读缓冲区中没有待处理的请求体数据时，
+        // 剩余部分直接 socket -> 管道 -> 文件，不经过用户态缓冲区
+        bool spliced = conn->body.can_splice() && conn->read_buffer.size() == conn->parser.header_length();
+        bool was_empty = conn->read_buffer.empty();
+        // 否则 readv 直接读进读缓冲区的空闲分段
+        ssize_t bytes_read = spliced ? conn->body.splice_from(fd, read_per_event_ - total_read)
+                                     : conn->read_buffer.read_from(fd);
+        if (bytes_read > 0) {
+            if (was_empty) {
+                // 新请求的第一个字节，请求头超时从这里开始计算
+                conn->request_started_ms = conn->last_active_ms;
+            }
+            total_read += bytes_read;
         } else if (bytes_read == 0) {
-            // 客户端关闭连接
-            printf("Client disconnected on fd %d\n", fd);
-            close(fd);
-            read_buffers_.erase(fd); // 移除对应的缓冲区
+            // 客户端关闭写方向，已收到的请求仍然要处理并响应
+            LOGF_DEBUG("客户端断开连接，文件描述符：{}", fd);
+            conn->peer_closed = true;
             break;
         } else {
+            if (errno == EINTR) {
+                continue;
+            }
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
                 // 数据已全部读取完毕
                 break;
-            } else {
-                perror("read error");
-                close(fd);
-                read_buffers_.erase(fd); // 移除对应的缓冲区
-                break;
             }
+            LOG_ERROR("read() 错误：" + std::string(strerror(errno)));
+            close_connection(conn);
+            return;
         }
     }
+    Metrics::local().bytes_in.add(total_read);
+    process_input(conn);
 }
 
-void Server::handle_request(int fd, const HttpRequest& request) {
-    // 根据请求的方法和URL处理请求
-    if (request.method == "GET") {
-        handle_get_request(fd, request);
-    } else if (request.method == "POST") {
-        handle_post_request(fd, request);
+void Server::process_input(Connection* conn) {
+    // 解析缓冲区中所有完整的请求，并立即尝试发送（通常socket可写，省去一次EPOLLOUT往返）。
+    // 等待上游后被唤醒时，队列中（或 HTTP/2 的流中）还有响应体在等待来源
+    if (process_requests(conn) || conn->pending_responses() > 0 ||
+        (conn->h2 != nullptr && conn->h2->streaming())) {
+        send_responses(conn);
+    } else if (conn->offload_pending()) {
+        offload_connection(conn);
+    } else if (conn->peer_closed) {
+        close_connection(conn);
     } else {
-        // 不支持的方法，返回405错误
-        send_error_response(fd, 405, "Method Not Allowed");
+        // 请求尚不完整，继续等待读事件
+        rearm_connection(conn, EPOLLIN);
     }
 }
 
-void Server::handle_get_request(int fd, const HttpRequest& request) {
-    // 根据请求的URL返回静态资源
-    std::string file_path = "./resource" + request.url; // 假设网站根目录为当前目录
-
-    // 如果请求的URL为"/"，则返回"/index.html"
-    if (request.url == "/") {
-        file_path = "./resource/index.html";
+void Server::rearm_connection(Connection* conn, uint32_t events) {
+    update_deadline(conn, events);
+    if (use_uring_) {
+        // 接收由 multishot recv 持续进行，只有写阻塞时才需要 Reactor 代为等待可写
+        if (events & EPOLLOUT) {
+            uring_request(conn->reactor, UringRequest::POLL_OUT, conn->fd,
+                          conn->generation.load(std::memory_order_relaxed));
+        } else {
+            release_uring_connection(conn);
+        }
+        return;
+    }
+    if (conn->park.load(std::memory_order_relaxed) != Connection::PARK_NONE) {
+        // 之前等待过上游：先恢复 EPOLLONESHOT 交接，之后到达的挂起期间的事件都是过期的
+        uint8_t expected = Connection::PARK_CLAIMED;
+        if (!conn->park.compare_exchange_strong(expected, Connection::PARK_NONE, std::memory_order_acq_rel)) {
+            // 持有期间有事件到达，可能是客户端断开，由当前线程再处理一次
+            conn->park.store(Connection::PARK_CLAIMED, std::memory_order_relaxed);
+            thread_pool_.enqueue([this, conn]() { resume_connection(conn); });
+            return;
+        }
+    }
+    // 重新arm之后其他线程可能立即接手该连接，调用方此后不得再访问conn
+    uint64_t key = pack_conn_key(conn->fd, conn->generation.load(std::memory_order_relaxed));
+    if (!modify_fd_in_epoll(conn->reactor->epoll_fd, conn->fd, events | EPOLLET | EPOLLONESHOT, key)) {
+        close_connection(conn);
     }
-
-    // 读取文件内容并发送响应
-    send_file_response(fd, file_path);
 }
 
-void Server::handle_post_request(int fd, const HttpRequest& request) {
-    // 处理POST请求，根据需求实现
-    // 这里简单地返回请求体内容
-
-    std::string response_body = "Received POST data:\n" + request.body;
-    std::string response_header = "HTTP/1.1 200 OK\r\n"
-                                  "Content-Type: text/plain\r\n"
-                                  "Content-Length: " + std::to_string(response_body.size()) + "\r\n"
-                                  "\r\n";
+void Server::close_connection(Connection* conn) {
+    int fd = conn->fd;
+    active_connections_.fetch_sub(1, std::memory_order_relaxed);
+    if (!conn->lead_key.empty()) {
+        // 处理函数在等待上游时连接关闭：结束这次执行，等待者各自重新执行
+        microcache_.complete(conn->lead_key, nullptr, 0);
+        conn->lead_key.clear();
+    }
+    // 先释放槽位再关闭fd：close之后该fd编号可能立即被其他Reactor accept复用。
+    // fd没有被dup，close会自动将其从epoll中移除，无需额外的EPOLL_CTL_DEL。
+    if (use_uring_) {
+        // 固定文件表和进行中的 multishot recv 都持有该socket，shutdown 让recv结束，
+        // 由所属 Reactor 从固定文件表中移除后再close
+        Reactor* reactor = conn->reactor;
+        {
+            std::lock_guard<std::mutex> lock(conn->close_mutex);
+            std::lock_guard<std::mutex> inbox_lock(conn->inbox_mutex);
+            connections_.release(conn);
+            shutdown(fd, SHUT_RDWR);
+        }
+        uring_request(reactor, UringRequest::CLOSE, fd, 0);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(conn->close_mutex);
+    connections_.release(conn);
+    close(fd);
+}
 
-    // 将响应头和响应体添加到待发送的缓冲区中
-    write_buffers_[fd] = response_header + response_body;
+void Server::update_deadline(Connection* conn, uint32_t events) {
+    int64_t now = current_time_ms();
+    TimeoutKind kind;
+    int64_t deadline;
+    if ((events & EPOLLOUT) || (conn->h2 != nullptr && conn->h2->has_pending_data())) {
+        // 响应发送被阻塞（HTTP/2 还包括等待对端的 WINDOW_UPDATE）：对端在 write 超时内必须读走数据
+        kind = TIMEOUT_WRITE;
+        deadline = now + timeouts_.write_ms;
+    } else if (conn->parser.headers_complete() || (conn->h2 != nullptr && conn->h2->has_open_streams())) {
+        // 正在接收请求体：两次收到数据的间隔不能超过 body 超时
+        kind = TIMEOUT_BODY;
+        deadline = now + timeouts_.body_ms;
+    } else if (!conn->read_buffer.empty() || (conn->request_count == 0 && conn->h2 == nullptr)) {
+        // 请求头（HTTP/2 为帧）尚未完整：从请求开始计算的固定时限，逐字节发送也无法续期
+        kind = TIMEOUT_HEADER;
+        deadline = conn->request_started_ms + timeouts_.header_ms;
+    } else {
+        kind = TIMEOUT_IDLE;
+        deadline = now + timeouts_.idle_ms;
+    }
+    conn->timeout_kind.store(kind, std::memory_order_relaxed);
+    conn->deadline_ms.store(deadline, std::memory_order_relaxed);
 }
 
-void Server::send_file_response(int fd, const std::string& file_path) {
-    // 打开文件
-    int file_fd = open(file_path.c_str(), O_RDONLY);
-    if (file_fd == -1) {
-        // 文件不存在，返回404错误
-        send_error_response(fd, 404, "Not Found");
+void Server::expire_connection(Reactor* reactor, Connection* conn, uint32_t generation) {
+    int fd = -1;
+    TimeoutKind kind;
+    int64_t retry_ms = current_time_ms() + 1000;
+    if (conn->timeout_kind.load(std::memory_order_relaxed) == TIMEOUT_UPSTREAM) {
+        // 等待上游超时：唤醒连接，由处理函数（或响应体的来源）按上游超时应答或中止。
+        // 保留条目，唤醒后没有重新设置截止时间时稍后再检查
+        Task task;
+        if (wake_connection(conn, generation, &task)) {
+            thread_pool_.enqueue(std::move(task));
+        }
+        reactor->timers.add(conn, generation, retry_ms);
         return;
     }
-
-    // 获取文件大小
-    struct stat stat_buf;
-    fstat(file_fd, &stat_buf);
-    size_t file_size = stat_buf.st_size;
-
-    // 读取文件内容
-    char* file_content = new char[file_size];
-    read(file_fd, file_content, file_size);
-    close(file_fd);
-
-    // 确定Content-Type
-    std::string content_type = get_content_type(file_path);
-
-    // 构建响应头
-    std::string response_header = "HTTP/1.1 200 OK\r\n"
-                                  "Content-Type: " + content_type + "\r\n"
-                                  "Content-Length: " + std::to_string(file_size) + "\r\n"
-                                  "\r\n";
-
-    // 将响应头和响应体添加到待发送的缓冲区中
-    write_buffers_[fd] = response_header + std::string(file_content, file_size);
-
-    delete[] file_content;
+    {
+        std::lock_guard<std::mutex> lock(conn->close_mutex);
+        if (conn->generation.load(std::memory_order_acquire) != generation) {
+            return;
+        }
+        // 连接可能正被工作线程持有，这里不直接close，而是shutdown：
+        // 空闲的连接会收到EPOLLHUP，正在处理的连接读写会失败，都由持有者走正常的关闭流程
+        fd = conn->fd;
+        kind = static_cast<TimeoutKind>(conn->timeout_kind.load(std::memory_order_relaxed));
+        shutdown(fd, SHUT_RDWR);
+        // 保留条目，万一持有者没有及时关闭，稍后再检查一次
+        conn->deadline_ms.store(retry_ms, std::memory_order_relaxed);
+    }
+    LOGF_INFO("连接{}超时，关闭连接，文件描述符：{}", timeout_kind_name(kind), fd);
+    reactor->timers.add(conn, generation, retry_ms);
 }
 
-bool ends_with(const std::string& value, const std::string& ending) {
-    if (ending.size() > value.size()) return false;
-    return std::equal(ending.rbegin(), ending.rend(), value.rbegin());
+void Server::drain_timer_requests(Reactor* reactor) {
+    std::vector<std::pair<Connection*, uint32_t>> requests;
+    {
+        std::lock_guard<std::mutex> lock(reactor->timer_mutex);
+        if (reactor->timer_requests.empty()) {
+            return;
+        }
+        requests.swap(reactor->timer_requests);
+    }
+    for (const auto& request : requests) {
+        Connection* conn = request.first;
+        if (conn->generation.load(std::memory_order_acquire) == request.second) {
+            reactor->timers.add(conn, request.second, conn->deadline_ms.load(std::memory_order_relaxed));
+        }
+    }
 }
 
-std::string Server::get_content_type(const std::string& file_path) {
-    if (ends_with(file_path, ".html") || ends_with(file_path, ".htm")) {
-        return "text/html";
-    } else if (ends_with(file_path, ".css")) {
-        return "text/css";
-    } else if (ends_with(file_path, ".js")) {
-        return "application/javascript";
-    } else if (ends_with(file_path, ".png")) {
-        return "image/png";
-    } else if (ends_with(file_path, ".jpg") || ends_with(file_path, ".jpeg")) {
-        return "image/jpeg";
-    } else if (ends_with(file_path, ".gif")) {
-        return "image/gif";
-    } else {
-        return "application/octet-stream";
+void Server::collect_upstream_waits(Connection* conn, std::vector<ResponseSource*>* waits) {
+    if (conn->offload == Connection::OFFLOAD_RESUME && conn->exchange) {
+        waits->push_back(conn->exchange.get());
+    }
+    if (conn->pending_responses() > 0) {
+        const Response& response = conn->responses[conn->response_head];
+        if (response.source && response.source_blocked) {
+            waits->push_back(response.source.get());
+        }
+    }
+    if (conn->h2 != nullptr) {
+        conn->h2->blocked_sources(waits);
     }
 }
 
+void Server::park_connection(Connection* conn) {
+    // 重新执行时回到挂起的处理函数
+    if (conn->offload == Connection::OFFLOAD_UPSTREAM) {
+        conn->offload = Connection::OFFLOAD_RESUME;
+    }
+    std::vector<ResponseSource*> waits;
+    collect_upstream_waits(conn, &waits);
+    if (waits.empty()) {
+        thread_pool_.enqueue([this, conn]() { process_input(conn); });
+        return;
+    }
 
-void Server::send_error_response(int fd, int status_code, const std::string& status_message) {
-    std::string response_body = "<html><body><h1>" + std::to_string(status_code) + " " + status_message + "</h1></body></html>";
-    std::string response_header = "HTTP/1.1 " + std::to_string(status_code) + " " + status_message + "\r\n"
-                                  "Content-Type: text/html\r\n"
-                                  "Content-Length: " + std::to_string(response_body.size()) + "\r\n"
-                                  "\r\n";
-    // 将响应头和响应体添加到待发送的缓冲区中
-    write_buffers_[fd] = response_header + response_body;
-
-    // 修改事件为EPOLLOUT，等待发送响应
-    modify_fd_in_epoll(epoll_fd_, fd, EPOLLOUT | EPOLLET);
-}
+    // 截止时间取最早到期的等待；HTTP/2 还有数据在等待对端的 WINDOW_UPDATE 时不晚于写超时
+    int64_t deadline = waits[0]->deadline_ms();
+    for (ResponseSource* source : waits) {
+        deadline = std::min(deadline, source->deadline_ms());
+    }
+    TimeoutKind kind = TIMEOUT_UPSTREAM;
+    int64_t write_deadline = current_time_ms() + timeouts_.write_ms;
+    if (conn->h2 != nullptr && conn->h2->has_pending_data() && write_deadline < deadline) {
+        kind = TIMEOUT_WRITE;
+        deadline = write_deadline;
+    }
+    Reactor* reactor = conn->reactor;
+    uint32_t generation = conn->generation.load(std::memory_order_relaxed);
+    int64_t previous = conn->deadline_ms.load(std::memory_order_relaxed);
+    conn->timeout_kind.store(kind, std::memory_order_relaxed);
+    conn->deadline_ms.store(deadline, std::memory_order_relaxed);
+    if (deadline < previous) {
+        // 时间轮中的条目只会推迟检查，截止时间提前时由 Reactor 重新放入
+        std::lock_guard<std::mutex> lock(reactor->timer_mutex);
+        reactor->timer_requests.emplace_back(conn, generation);
+    }
+    // HTTP/2 在等待期间继续接收客户端的帧（WINDOW_UPDATE、新的流）；HTTP/1 只关心断开
+    bool client_frames = conn->h2 != nullptr && conn->offload != Connection::OFFLOAD_RESUME && !conn->peer_closed;
 
+    if (use_uring_) {
+        // 客户端的数据由 multishot recv 照常接收
+        for (ResponseSource* source : waits) {
+            uring_request(reactor, UringRequest::POLL_UPSTREAM, conn->fd, generation, source->wait_fd(),
+                          source->wait_events());
+        }
+        release_uring_connection(conn);
+        return;
+    }
 
-void Server::handle_write(int fd) {
-    LOG_DEBUG("处理写事件，文件描述符：" + std::to_string(fd));
-    std::string& buffer = write_buffers_[fd];
-    ssize_t bytes_written = write(fd, buffer.c_str(), buffer.size());
-    if (bytes_written == -1) {
-        if (errno == EAGAIN || errno == EWOULDBLOCK) {
-            // 写缓冲区已满，稍后再写
-            return;
-        } else {
-            perror("write error");
-            close(fd);
-            write_buffers_.erase(fd);
+    // 客户端fd和各个上游fd都以 EPOLLONESHOT 登记，先到的事件取得连接；
+    // 登记期间到达的事件由当前线程补上（PARK_MISSED）
+    conn->park.store(Connection::PARK_CLAIMED, std::memory_order_relaxed);
+    uint64_t upstream_key = pack_conn_key(static_cast<int>(conn->fd | UPSTREAM_KEY_FLAG), generation);
+    for (ResponseSource* source : waits) {
+        struct epoll_event ev;
+        ev.data.u64 = upstream_key;
+        ev.events = EPOLLET | EPOLLONESHOT | ((source->wait_events() & POLLIN) ? EPOLLIN : 0) |
+                    ((source->wait_events() & POLLOUT) ? EPOLLOUT : 0);
+        // 空闲池中的连接可能已经登记过
+        int fd = source->wait_fd();
+        if (epoll_ctl(reactor->epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1 &&
+            (errno != ENOENT || epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1)) {
+            LOG_ERROR("epoll_ctl() 登记上游连接错误：" + std::string(strerror(errno)));
+            close_connection(conn);
             return;
         }
     }
+    uint64_t key = pack_conn_key(static_cast<int>(conn->fd | PARKED_KEY_FLAG), generation);
+    if (!modify_fd_in_epoll(reactor->epoll_fd, conn->fd, (client_frames ? EPOLLIN : 0) | EPOLLET | EPOLLONESHOT,
+                            key)) {
+        close_connection(conn);
+        return;
+    }
+    uint8_t expected = Connection::PARK_CLAIMED;
+    if (!conn->park.compare_exchange_strong(expected, Connection::PARK_WAITING, std::memory_order_acq_rel)) {
+        conn->park.store(Connection::PARK_CLAIMED, std::memory_order_relaxed);
+        thread_pool_.enqueue([this, conn]() { resume_connection(conn); });
+    }
+}
 
-    // 更新写缓冲区，移除已发送的数据
-    buffer.erase(0, bytes_written);
+bool Server::claim_parked_connection(Connection* conn) {
+    uint8_t state = conn->park.load(std::memory_order_acquire);
+    while (true) {
+        if (state == Connection::PARK_WAITING) {
+            if (conn->park.compare_exchange_weak(state, Connection::PARK_CLAIMED, std::memory_order_acq_rel)) {
+                return true;
+            }
+        } else if (state == Connection::PARK_CLAIMED) {
+            // 持有者还没有交出连接：记下这次事件，由持有者补上
+            if (conn->park.compare_exchange_weak(state, Connection::PARK_MISSED, std::memory_order_acq_rel)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+}
 
-    if (buffer.empty()) {
-        // 数据已全部发送完毕，修改事件为EPOLLIN，继续监听读事件
-        modify_fd_in_epoll(epoll_fd_, fd, EPOLLIN | EPOLLET);
-        write_buffers_.erase(fd); // 移除写缓冲区
+bool Server::wake_connection(Connection* conn, uint32_t generation, Task* task) {
+    if (use_uring_) {
+        std::lock_guard<std::mutex> lock(conn->inbox_mutex);
+        if (conn->generation.load(std::memory_order_relaxed) != generation) {
+            return false;
+        }
+        if (conn->scheduled) {
+            // 持有者交出连接之前再处理一次
+            conn->upstream_ready = true;
+            return false;
+        }
+        conn->scheduled = true;
+        *task = Task([this, conn]() { handle_uring_read(conn); });
+        return true;
+    }
+    if (conn->generation.load(std::memory_order_acquire) != generation || !claim_parked_connection(conn)) {
+        return false;
+    }
+    *task = Task([this, conn]() { resume_connection(conn); });
+    return true;
+}
+
+void Server::resume_connection(Connection* conn) {
+    conn->last_active_ms = current_time_ms();
+    if (conn->h2 != nullptr && conn->offload != Connection::OFFLOAD_RESUME && !conn->peer_closed) {
+        handle_read(conn);
+        return;
+    }
+    process_input(conn);
+}
+
+void Server::wait_for_upgrade() {
+    while (true) {
+        wait_upgrade_signal();
+        LOG_INFO("收到 SIGUSR2，开始热升级");
+        std::vector<int> listen_fds;
+        for (auto& reactor : reactors_) {
+            listen_fds.push_back(reactor->listen_fd);
+        }
+        pid_t pid = spawn_upgrade(exec_argv_, listen_fds);
+        if (pid > 0) {
+            LOG_INFO("热升级：新进程 " + std::to_string(pid) + " 已就绪");
+            drain_and_exit();
+        }
+    }
+}
+
+void Server::stop_accepting() {
+    // 监听套接字仍然打开（新进程持有同一个套接字），只是本进程不再从中 accept
+    for (auto& reactor : reactors_) {
+        if (use_uring_) {
+            uring_request(reactor.get(), UringRequest::STOP_ACCEPT, reactor->listen_fd, 0);
+        } else {
+            delete_fd_from_epoll(reactor->epoll_fd, reactor->listen_fd);
+        }
+    }
+}
+
+void Server::close_idle_connections() {
+    for (size_t fd = 0; fd < connections_.capacity(); ++fd) {
+        Connection* conn = connections_.slot(fd);
+        if (conn == nullptr) {
+            continue;
+        }
+        // 只关闭读方向：空闲连接读到EOF后走正常的关闭流程；刚好有请求到达的连接仍能读出
+        // 已在接收队列中的数据，响应（带 Connection: close）照常发出
+        std::lock_guard<std::mutex> lock(conn->close_mutex);
+        if (conn->active.load(std::memory_order_acquire) &&
+            conn->timeout_kind.load(std::memory_order_relaxed) == TIMEOUT_IDLE) {
+            shutdown(conn->fd, SHUT_RD);
+        }
+    }
+}
+
+void Server::drain_and_exit() {
+    draining_.store(true, std::memory_order_relaxed);
+    stop_accepting();
+    int64_t deadline = current_time_ms() + drain_timeout_ms_;
+    while (active_connections_.load(std::memory_order_relaxed) > 0 && current_time_ms() < deadline) {
+        close_idle_connections();
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    size_t remaining = active_connections_.load(std::memory_order_relaxed);
+    if (remaining > 0) {
+        LOG_WARN("热升级：等待超时，关闭剩余的 " + std::to_string(remaining) + " 个连接");
+    }
+    LOG_INFO("热升级：旧进程退出");
+    // 工作线程和Reactor仍在运行，不做析构，写出日志后直接退出
+    Logger::get_instance().flush();
+    _exit(0);
+}
+
+void Server::offload_connection(Connection* conn) {
+    if (conn->offload == Connection::OFFLOAD_UPSTREAM) {
+        // 不占用工作线程等待上游：连接交给 Reactor，上游就绪后重新执行
+        park_connection(conn);
+        return;
+    }
+    if (conn->offload == Connection::OFFLOAD_WAITING) {
+        // 登记到同一缓存键进行中的执行上，由执行者结束时重新提交；已经结束则立即重新提交
+        std::string key = std::move(conn->wait_key);
+        conn->wait_key.clear();
+        conn->offload = Connection::OFFLOAD_READY;
+        if (microcache_.wait(key, [this, conn]() { thread_pool_.enqueue([this, conn]() { process_input(conn); }); })) {
+            return;
+        }
+    }
+    conn->offload = Connection::OFFLOAD_READY;
+    // 连接没有重新arm，仍归当前线程所有；新任务进入本线程的队列，空闲线程可以窃取
+    thread_pool_.enqueue([this, conn]() { process_input(conn); });
+}
+
+void Server::register_default_routes() {
+    route(HTTP_GET, "/metrics", [this](Connection* conn, const HttpRequest&, const RouteParams&) {
+        send_metrics_response(conn);
+    });
+    if (proxy_catch_all_) {
+        return;
+    }
+    route(HTTP_GET, "/*path", [this](Connection* conn, const HttpRequest& request, const RouteParams& params) {
+        handle_static_request(conn, request, params.get("path"));
+    });
+    // 请求体可能在临时文件中，回显涉及磁盘读取
+    route(HTTP_POST, "/*path", [this](Connection* conn, const HttpRequest& request, const RouteParams&) {
+        handle_post_request(conn, request);
+    }, ROUTE_OFFLOAD);
+}
+
+void Server::register_proxy_routes(const ServerConfig& config) {
+    for (const ProxyRoute& proxy : config.proxy_routes) {
+        upstream_groups_.emplace_back(new UpstreamGroup(proxy.upstreams, config.proxy, reactors_.size()));
+        UpstreamGroup* upstreams = upstream_groups_.back().get();
+        for (int method = 0; method < HTTP_METHOD_COUNT; ++method) {
+            route(static_cast<HttpMethod>(method), proxy.pattern,
+                  [this, upstreams](Connection* conn, const HttpRequest& request, const RouteParams&) {
+                handle_proxy_request(conn, request, upstreams);
+            });
+        }
+        proxy_catch_all_ = proxy_catch_all_ || proxy.pattern.compare(0, 2, "/*") == 0;
+        std::string upstream_names;
+        for (const UpstreamAddress& address : proxy.upstreams) {
+            upstream_names += " " + address.name;
+        }
+        LOG_INFO("反向代理：" + proxy.pattern + " ->" + upstream_names);
+    }
+}
+
+bool Server::route(HttpMethod method, std::string_view pattern, RouteHandler handler, RouteMode mode) {
+    const MicrocachePolicy* cache = nullptr;
+    for (const MicrocachePolicy& policy : microcache_policies_) {
+        if (policy.pattern == pattern) {
+            cache = &policy;
+        }
+    }
+    return router_.add(method, pattern, std::move(handler), mode, cache);
+}
+
+bool Server::handle_request(Connection* conn, const HttpRequest& request) {
+    // 按方法和路径（不含查询字符串）查找路由
+    HttpMethod method = http_method_from(request.method);
+    std::string_view path = request.url.substr(0, request.url.find('?'));
+    RouteParams params;
+    unsigned allowed = 0;
+    const Route* route = router_.match(method, path, &params, &allowed);
+    if (route == nullptr) {
+        if (method == HTTP_METHOD_COUNT) {
+            send_error_response(conn, 501, "Not Implemented");
+        } else if (allowed == 0) {
+            send_error_response(conn, 404, "Not Found");
+        } else {
+            send_method_not_allowed(conn, allowed);
+        }
+        return true;
+    }
+    if (conn->offload == Connection::OFFLOAD_RESUME) {
+        // 回到等待上游的处理函数（缓存的查找和 ROUTE_OFFLOAD 的转交都已做过）
+        conn->offload = Connection::OFFLOAD_NONE;
+        return run_route_handler(conn, request, route, params);
+    }
+    // 缓存命中时不执行处理函数，也不必转交线程池
+    std::string cache_key;
+    if (route->cache != nullptr && microcache_eligible(request, *route->cache)) {
+        cache_key = microcache_key(request, *route->cache);
+        // 等待过执行结果的请求已计为 coalesced，每个请求只计一次
+        std::shared_ptr<const MicrocachedResponse> cached = microcache_.find(cache_key, current_time_ms(),
+                                                                             !conn->coalesced);
+        if (cached) {
+            conn->offload = Connection::OFFLOAD_NONE;
+            conn->coalesced = false;
+            send_microcached_response(conn, cached);
+            return true;
+        }
+    }
+    if (route->mode == ROUTE_OFFLOAD && conn->offload != Connection::OFFLOAD_READY) {
+        conn->offload = Connection::OFFLOAD_PENDING;
+        return false;
+    }
+    conn->offload = Connection::OFFLOAD_NONE;
+    if (!cache_key.empty()) {
+        return handle_cached_request(conn, request, route, params, cache_key);
+    }
+    return run_route_handler(conn, request, route, params);
+}
+
+bool Server::run_route_handler(Connection* conn, const HttpRequest& request, const Route* route,
+                               const RouteParams& params) {
+    size_t first = conn->responses.size();
+    route->handler(conn, request, params);
+    if (conn->offload == Connection::OFFLOAD_UPSTREAM) {
+        return false;
+    }
+    if (conn->lead_key.empty()) {
+        return true;
+    }
+    std::shared_ptr<MicrocachedResponse> response;
+    if (conn->responses.size() == first + 1) {
+        response = make_microcached_response(conn->responses[first]);
+    }
+    int64_t now = current_time_ms();
+    if (response) {
+        response->fresh_until_ms = now + route->cache->ttl_ms;
+        response->stale_until_ms = response->fresh_until_ms + route->cache->stale_ms;
+    }
+    // 不可缓存的结果在一个新鲜期内不再合并，避免等待者逐个排队执行
+    std::string key = std::move(conn->lead_key);
+    conn->lead_key.clear();
+    microcache_.complete(key, response, now + route->cache->ttl_ms);
+    return true;
+}
+
+bool Server::handle_cached_request(Connection* conn, const HttpRequest& request, const Route* route,
+                                   const RouteParams& params, const std::string& key) {
+    std::shared_ptr<const MicrocachedResponse> cached;
+    MicrocacheStatus status = microcache_.acquire(key, current_time_ms(), &cached, !conn->coalesced);
+    conn->coalesced = false;
+    switch (status) {
+    case MICROCACHE_HIT:
+        send_microcached_response(conn, cached);
+        return true;
+    case MICROCACHE_WAIT:
+        // 不占用工作线程等待：请求留在原处，连接挂起，执行结束后在新任务中重新处理
+        conn->offload = Connection::OFFLOAD_WAITING;
+        conn->wait_key = key;
+        conn->coalesced = true;
+        return false;
+    case MICROCACHE_PASS:
+        return run_route_handler(conn, request, route, params);
+    case MICROCACHE_LEAD:
+        break;
+    }
+    // 处理函数挂起（等待上游）期间保持，完成后放入缓存
+    conn->lead_key = key;
+    return run_route_handler(conn, request, route, params);
+}
+
+void Server::send_microcached_response(Connection* conn, const std::shared_ptr<const MicrocachedResponse>& cached) {
+    // 响应头和响应体都引用缓存条目，只重新生成 Date
+    Response& response = conn->add_response();
+    ResponseBuilder(response, cached->status, cached->head, cached).end_headers();
+    response.body = cached->body;
+}
+
+// 对端的IP地址（X-Forwarded-For）
+static std::string peer_address(int fd) {
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    char text[INET6_ADDRSTRLEN] = "";
+    if (getpeername(fd, reinterpret_cast<struct sockaddr*>(&addr), &len) == 0) {
+        if (addr.ss_family == AF_INET6) {
+            inet_ntop(AF_INET6, &reinterpret_cast<struct sockaddr_in6*>(&addr)->sin6_addr, text, sizeof(text));
+        } else if (addr.ss_family == AF_INET) {
+            inet_ntop(AF_INET, &reinterpret_cast<struct sockaddr_in*>(&addr)->sin_addr, text, sizeof(text));
+        }
+    }
+    return text;
+}
+
+void Server::handle_proxy_request(Connection* conn, const HttpRequest& request, UpstreamGroup* upstreams) {
+    if (!conn->exchange) {
+        conn->exchange = upstreams->start(conn->reactor->id, request, peer_address(conn->fd));
+    }
+    Response response;
+    switch (conn->exchange->advance(&response)) {
+    case PROXY_PENDING:
+        // 挂起：连接交给 Reactor 等待上游，就绪后重新执行到这里继续
+        conn->offload = Connection::OFFLOAD_UPSTREAM;
+        return;
+    case PROXY_FAILED:
+        send_error_response(conn, conn->exchange->status(), "");
+        break;
+    case PROXY_DONE:
+        // 响应体按上游连接关闭结束而客户端是 HTTP/1.0：发送完毕后关闭连接
+        if (conn->exchange->client_must_close()) {
+            conn->close_after_write = true;
+        }
+        conn->responses.push_back(std::move(response));
+        break;
+    }
+    conn->exchange.reset();
+}
+
+void Server::send_method_not_allowed(Connection* conn, unsigned allowed) {
+    std::string allow = "Allow: ";
+    for (int i = 0; i < HTTP_METHOD_COUNT; ++i) {
+        if (allowed & (1u << i)) {
+            if (allow.size() > 7) {
+                allow += ", ";
+            }
+            allow += http_method_name(static_cast<HttpMethod>(i));
+        }
+    }
+    allow += "\r\n";
+    const ErrorPages::Page* page = error_pages_.find(405);
+    Response& response = conn->add_response();
+    ResponseBuilder(response, 405, page->head, nullptr).raw(allow).end_headers();
+    response.body = page->body;
+}
+
+static int hex_digit(char c) {
+    return isdigit(static_cast<unsigned char>(c)) ? c - '0' : tolower(static_cast<unsigned char>(c)) - 'a' + 10;
+}
+
+// 百分号解码并按段规范化 "." 和 ".."，结果以 '/' 开头、不含空段；
+// 原路径以 '/' 结尾时结果也以 '/' 结尾。越过根目录、编码的 '/' 或NUL视为非法
+static bool normalize_path(std::string_view path, std::string* out) {
+    out->clear();
+    size_t pos = 0;
+    bool trailing_slash = path.empty() || path.back() == '/';
+    while (pos < path.size()) {
+        size_t end = std::min(path.find('/', pos), path.size());
+        std::string segment;
+        for (size_t i = pos; i < end; ++i) {
+            char c = path[i];
+            if (c == '%') {
+                if (i + 2 >= end || !isxdigit(static_cast<unsigned char>(path[i + 1])) ||
+                    !isxdigit(static_cast<unsigned char>(path[i + 2]))) {
+                    return false;
+                }
+                c = static_cast<char>(hex_digit(path[i + 1]) << 4 | hex_digit(path[i + 2]));
+                i += 2;
+            }
+            if (c == '\0' || c == '/') {
+                return false;
+            }
+            segment += c;
+        }
+        pos = end + 1;
+        if (segment.empty() || segment == ".") {
+            trailing_slash = trailing_slash || end == path.size();
+            continue;
+        }
+        if (segment == "..") {
+            if (out->empty()) {
+                return false;
+            }
+            out->erase(out->rfind('/'));
+            trailing_slash = trailing_slash || end == path.size();
+            continue;
+        }
+        out->append("/").append(segment);
+    }
+    if (out->empty() || trailing_slash) {
+        out->push_back('/');
+    }
+    return true;
+}
+
+void Server::handle_static_request(Connection* conn, const HttpRequest& request, std::string_view path) {
+    // 根据请求的路径返回静态资源，规范化后只在资源根目录下拼接
+    std::string relative;
+    if (!normalize_path(path, &relative)) {
+        send_error_response(conn, 404, "Not Found");
+        return;
+    }
+    std::string file_path = resource_root_ + relative;
+    // 目录（包括根目录"/"）返回其中的 index.html
+    if (file_path.back() == '/') {
+        file_path += "index.html";
+    }
+
+    // 小文件优先从缓存返回：响应头预先生成，响应体共享缓存中的内存，不访问文件系统
+    // 可压缩的资源按 Accept-Encoding 返回 br/gzip 版本。
+    // Range 请求总是针对原文件（不压缩的表示），走文件路径
+    std::shared_ptr<const CachedAsset> asset;
+    if (!request.has_header("Range")) {
+        asset = asset_cache_.get(file_path, accepted_encodings(request));
+    }
+    if (asset) {
+        // 响应头直接指向缓存中的字符串，由 head_owner 保证发送完之前缓存条目不被释放
+        Response& response = conn->add_response();
+        if (is_not_modified(request, asset->etag, asset->mtime)) {
+            ResponseBuilder(response, 304, asset->not_modified_header, asset).end_headers();
+            return;
+        }
+        ResponseBuilder(response, 200, asset->header, asset).end_headers();
+        response.body = asset->body;
+        return;
+    }
+
+    // 缓存未命中（文件过大或不存在），直接发送文件
+    send_file_response(conn, request, file_path);
+}
+
+void Server::handle_post_request(Connection* conn, const HttpRequest& request) {
+    // 处理POST请求，根据需求实现
+    // 这里简单地返回请求体内容
+    const std::string_view prefix = "Received POST data:\n";
+    uint64_t body_size = request.body ? request.body->size() : 0;
+
+    if (request.body && request.body->spilled()) {
+        // 请求体在临时文件中：用sendfile原样发回，不读进内存
+        int file_fd = fcntl(request.body->file_fd(), F_DUPFD_CLOEXEC, 0);
+        if (file_fd == -1) {
+            LOG_ERROR("fcntl(F_DUPFD_CLOEXEC) 错误：" + std::string(strerror(errno)));
+            send_error_response(conn, 500, "Internal Server Error");
+            return;
+        }
+        Response& response = conn->add_response();
+        ResponseBuilder(response, 200)
+            .header(HEADER_CONTENT_TYPE, "text/plain")
+            .content_length(prefix.size() + body_size)
+            .end_headers()
+            .body(prefix);
+        response.file_fd = file_fd;
+        response.file_offset = 0;
+        response.file_remaining = body_size;
+        return;
+    }
+
+    // 小的请求体在内存中，直接读进响应
+    Response& response = conn->add_response();
+    ResponseBuilder(response, 200)
+        .header(HEADER_CONTENT_TYPE, "text/plain")
+        .content_length(prefix.size() + body_size)
+        .end_headers()
+        .body(prefix);
+    BodyReader reader(request.body);
+    char chunk[4096];
+    ssize_t n;
+    while ((n = reader.read(chunk, sizeof(chunk))) > 0) {
+        response.buffer.append(chunk, n);
+    }
+}
+
+// Range 头部的解析结果
+enum RangeResult {
+    RANGE_OK,              // 至少有一个可满足的区间
+    RANGE_IGNORE,          // 格式不支持或区间过多，忽略 Range 返回完整内容
+    RANGE_UNSATISFIABLE    // 所有区间都超出文件范围，返回416
+};
+
+// 解析 "bytes=0-99,200-,-500"，得到闭区间 [first, last] 的列表
+static RangeResult parse_byte_ranges(std::string_view value, size_t size,
+                                     std::vector<std::pair<size_t, size_t>>* ranges) {
+    const std::string_view prefix = "bytes=";
+    if (value.size() <= prefix.size() || strncasecmp(value.data(), "bytes=", prefix.size()) != 0) {
+        return RANGE_IGNORE;
+    }
+    value.remove_prefix(prefix.size());
+    size_t count = 0;
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        std::string_view spec = value.substr(0, comma);
+        value = comma == std::string_view::npos ? std::string_view() : value.substr(comma + 1);
+        while (!spec.empty() && (spec.front() == ' ' || spec.front() == '\t')) {
+            spec.remove_prefix(1);
+        }
+        while (!spec.empty() && (spec.back() == ' ' || spec.back() == '\t')) {
+            spec.remove_suffix(1);
+        }
+        if (spec.empty()) {
+            continue;
+        }
+        if (++count > MAX_BYTE_RANGES) {
+            return RANGE_IGNORE;
+        }
+        size_t dash = spec.find('-');
+        if (dash == std::string_view::npos) {
+            return RANGE_IGNORE;
+        }
+        uint64_t first = 0;
+        uint64_t last = 0;
+        if (dash == 0) {
+            // 后缀区间 "-N"：最后N个字节
+            uint64_t suffix;
+            if (!parse_decimal(spec.substr(1), &suffix)) {
+                return RANGE_IGNORE;
+            }
+            if (suffix == 0 || size == 0) {
+                continue;
+            }
+            first = suffix >= size ? 0 : size - suffix;
+            last = size - 1;
+        } else {
+            if (!parse_decimal(spec.substr(0, dash), &first)) {
+                return RANGE_IGNORE;
+            }
+            if (dash + 1 == spec.size()) {
+                last = size - 1;
+            } else if (!parse_decimal(spec.substr(dash + 1), &last) || last < first) {
+                return RANGE_IGNORE;
+            }
+            if (first >= size) {
+                continue;
+            }
+            last = std::min<uint64_t>(last, size - 1);
+        }
+        ranges->emplace_back(static_cast<size_t>(first), static_cast<size_t>(last));
+    }
+    if (count == 0) {
+        return RANGE_IGNORE;
+    }
+    return ranges->empty() ? RANGE_UNSATISFIABLE : RANGE_OK;
+}
+
+// If-Range：ETag 须强匹配，日期须与 Last-Modified 完全相同；不满足时忽略 Range
+static bool if_range_matches(const HttpRequest& request, const std::string& etag, time_t mtime) {
+    if (!request.has_header("If-Range")) {
+        return true;
+    }
+    std::string value(request.header("If-Range"));
+    if (!value.empty() && (value[0] == '"' || value.compare(0, 2, "W/") == 0)) {
+        return value == etag;
+    }
+    time_t date;
+    return parse_http_date(value, &date) && date == mtime;
+}
+
+// If-None-Match 中是否包含给定的ETag（弱比较，支持 "*" 和逗号分隔的列表）
+static bool etag_matches(const std::string& header_value, const std::string& etag) {
+    size_t pos = 0;
+    while (pos < header_value.size()) {
+        size_t comma = header_value.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = header_value.size();
+        }
+        size_t begin = header_value.find_first_not_of(" \t", pos);
+        size_t end = header_value.find_last_not_of(" \t", comma - 1);
+        if (begin != std::string::npos && begin < comma && end >= begin) {
+            std::string candidate = header_value.substr(begin, end - begin + 1);
+            if (candidate.compare(0, 2, "W/") == 0) {
+                candidate.erase(0, 2);
+            }
+            if (candidate == "*" || candidate == etag) {
+                return true;
+            }
+        }
+        pos = comma + 1;
+    }
+    return false;
+}
+
+unsigned Server::accepted_encodings(const HttpRequest& request) {
+    std::string value(request.header("Accept-Encoding"));
+    if (value.empty()) {
+        return ENCODING_IDENTITY;
+    }
+    // 形如 "gzip, deflate, br;q=0.9, *;q=0"，q=0 表示不接受
+    unsigned accepted = ENCODING_IDENTITY;
+    unsigned rejected = ENCODING_IDENTITY;
+    bool wildcard = false;
+    size_t pos = 0;
+    while (pos < value.size()) {
+        size_t comma = value.find(',', pos);
+        if (comma == std::string::npos) {
+            comma = value.size();
+        }
+        std::string item = value.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        size_t semicolon = item.find(';');
+        std::string coding = item.substr(0, semicolon);
+        coding.erase(remove_if(coding.begin(), coding.end(), isspace), coding.end());
+        std::transform(coding.begin(), coding.end(), coding.begin(), ::tolower);
+        bool zero_q = false;
+        if (semicolon != std::string::npos) {
+            size_t q = item.find("q=", semicolon);
+            zero_q = q != std::string::npos && atof(item.c_str() + q + 2) <= 0.0;
+        }
+
+        unsigned flag = ENCODING_IDENTITY;
+        if (coding == "gzip" || coding == "x-gzip") {
+            flag = ENCODING_GZIP;
+        } else if (coding == "br") {
+            flag = ENCODING_BR;
+        } else if (coding == "*") {
+            wildcard = !zero_q;
+            continue;
+        }
+        if (zero_q) {
+            rejected |= flag;
+        } else {
+            accepted |= flag;
+        }
+    }
+    if (wildcard) {
+        accepted |= ENCODING_GZIP | ENCODING_BR;
+    }
+    return accepted & ~rejected;
+}
+
+bool Server::is_not_modified(const HttpRequest& request, const std::string& etag, time_t mtime) {
+    // If-None-Match 优先于 If-Modified-Since
+    if (request.has_header("If-None-Match")) {
+        return etag_matches(std::string(request.header("If-None-Match")), etag);
+    }
+    std::string_view ims = request.header("If-Modified-Since");
+    if (!ims.empty()) {
+        time_t since;
+        if (parse_http_date(std::string(ims), &since)) {
+            return mtime <= since;
+        }
+    }
+    return false;
+}
+
+void Server::send_file_response(Connection* conn, const HttpRequest& request, const std::string& file_path) {
+    // 打开文件
+    int file_fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file_fd == -1) {
+        // 文件不存在，返回404错误
+        send_error_response(conn, 404, "Not Found");
+        return;
+    }
+
+    // 获取文件大小，只发送普通文件（目录等返回404）
+    struct stat stat_buf;
+    if (fstat(file_fd, &stat_buf) == -1 || !S_ISREG(stat_buf.st_mode)) {
+        close(file_fd);
+        send_error_response(conn, 404, "Not Found");
+        return;
+    }
+    size_t file_size = stat_buf.st_size;
+
+    std::string etag = make_etag(stat_buf);
+    std::string last_modified = format_http_date(stat_buf.st_mtime);
+    if (is_not_modified(request, etag, stat_buf.st_mtime)) {
+        close(file_fd);
+        ResponseBuilder(conn->add_response(), 304)
+            .header(HEADER_ETAG, etag)
+            .header(HEADER_LAST_MODIFIED, last_modified)
+            .end_headers();
+        return;
+    }
+
+    // 确定Content-Type
+    std::string content_type = get_content_type(file_path);
+    std::string validators = "ETag: " + etag + "\r\n"
+                             "Last-Modified: " + last_modified + "\r\n"
+                             "Accept-Ranges: bytes\r\n" +
+                             // 大文件不压缩，但同一URL的小版本可能被压缩过，缓存仍需区分
+                             std::string(is_compressible_type(content_type) ? "Vary: Accept-Encoding\r\n" : "");
+
+    // 断点续传/分段下载
+    if (request.has_header("Range") && if_range_matches(request, etag, stat_buf.st_mtime)) {
+        std::vector<std::pair<size_t, size_t>> ranges;
+        RangeResult result = parse_byte_ranges(request.header("Range"), file_size, &ranges);
+        if (result == RANGE_UNSATISFIABLE) {
+            close(file_fd);
+            static const std::string_view body = "<html><body><h1>416 Range Not Satisfiable</h1></body></html>";
+            ResponseBuilder(conn->add_response(), 416)
+                .header(HEADER_CONTENT_TYPE, "text/html")
+                .header(HEADER_CONTENT_RANGE, "bytes */" + std::to_string(file_size))
+                .content_length(body.size())
+                .end_headers()
+                .body(body);
+            return;
+        }
+        if (result == RANGE_OK) {
+            send_range_response(conn, file_fd, file_size, ranges, content_type, validators);
+            return;
+        }
+    }
+
+    // 内存中只放响应头；文件体不读入内存，由flush_responses用sendfile直接从file_fd发送
+    Response& response = conn->add_response();
+    ResponseBuilder(response, 200)
+        .header(HEADER_CONTENT_TYPE, content_type)
+        .content_length(file_size)
+        .raw(validators)
+        .end_headers();
+    if (file_size > 0) {
+        response.file_fd = file_fd;
+        response.file_remaining = file_size;
+    } else {
+        close(file_fd);
+    }
+}
+
+void Server::send_range_response(Connection* conn, int file_fd, size_t file_size,
+                                 const std::vector<std::pair<size_t, size_t>>& ranges,
+                                 const std::string& content_type, const std::string& validators) {
+    std::string total = "/" + std::to_string(file_size);
+    if (ranges.size() == 1) {
+        size_t first = ranges[0].first;
+        size_t length = ranges[0].second - first + 1;
+        Response& response = conn->add_response();
+        ResponseBuilder(response, 206)
+            .header(HEADER_CONTENT_TYPE, content_type)
+            .header(HEADER_CONTENT_RANGE, "bytes " + std::to_string(first) + "-" +
+                                          std::to_string(ranges[0].second) + total)
+            .content_length(length)
+            .raw(validators)
+            .end_headers();
+        response.file_fd = file_fd;
+        response.file_offset = static_cast<off_t>(first);
+        response.file_remaining = length;
+        return;
+    }
+
+    // 多个区间：每个分段是一个后续响应（分段头 + 文件区间），各自持有一个dup出来的fd，
+    // 仍由 flush_responses 按顺序用 sendmsg/sendfile 发送，内存中只有分段头
+    char boundary[32];
+    snprintf(boundary, sizeof(boundary), "%016llx",
+             static_cast<unsigned long long>(current_time_ns()) ^ reinterpret_cast<uintptr_t>(conn));
+    std::vector<std::string> part_headers;
+    size_t content_length = 0;
+    for (const auto& range : ranges) {
+        part_headers.push_back(std::string("\r\n--") + boundary + "\r\n"
+                               "Content-Type: " + content_type + "\r\n"
+                               "Content-Range: bytes " + std::to_string(range.first) + "-" +
+                               std::to_string(range.second) + total + "\r\n\r\n");
+        content_length += part_headers.back().size() + (range.second - range.first + 1);
+    }
+    std::string closing = std::string("\r\n--") + boundary + "--\r\n";
+    content_length += closing.size();
+
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        int part_fd = i == 0 ? file_fd : fcntl(file_fd, F_DUPFD_CLOEXEC, 0);
+        if (part_fd == -1) {
+            // fd耗尽：已排入的分段无法补全，只能关闭连接
+            LOG_ERROR("fcntl(F_DUPFD_CLOEXEC) 错误：" + std::string(strerror(errno)));
+            conn->close_after_write = true;
+            break;
+        }
+        Response& response = conn->add_response();
+        if (i == 0) {
+            ResponseBuilder(response, 206)
+                .header(HEADER_CONTENT_TYPE, "multipart/byteranges; boundary=" + std::string(boundary))
+                .content_length(content_length)
+                .raw(validators)
+                .end_headers();
+        } else {
+            response.continuation = true;
+        }
+        response.buffer += part_headers[i];
+        response.file_fd = part_fd;
+        response.file_offset = static_cast<off_t>(ranges[i].first);
+        response.file_remaining = ranges[i].second - ranges[i].first + 1;
+    }
+    Response& tail = conn->add_response();
+    tail.continuation = true;
+    tail.buffer = closing;
+}
+
+void Server::send_error_response(Connection* conn, int status_code, const std::string& status_message) {
+    Response& response = conn->add_response();
+    // 常见的错误页在启动时预生成：响应头片段和响应体都直接引用，只追加 Date
+    const ErrorPages::Page* page = error_pages_.find(status_code);
+    if (page != nullptr) {
+        ResponseBuilder(response, status_code, page->head, nullptr).end_headers();
+        response.body = page->body;
+        return;
+    }
+    std::string response_body = "<html><body><h1>" + std::to_string(status_code) + " " + status_message + "</h1></body></html>";
+    ResponseBuilder(response, status_code, status_message)
+        .header(HEADER_CONTENT_TYPE, "text/html")
+        .content_length(response_body.size())
+        .end_headers()
+        .body(response_body);
+}
+
+
+void Server::send_metrics_response(Connection* conn) {
+    std::string body;
+    Metrics::get_instance().render(&body);
+
+    // 抓取时读取的即时值
+    metrics_append_header(&body, "tws_connections_active", "gauge", "Currently open connections.");
+    metrics_append_value(&body, "tws_connections_active", "",
+                         active_connections_.load(std::memory_order_relaxed));
+    metrics_append_header(&body, "tws_connections_shed_total", "counter",
+                          "Connections rejected by admission control.");
+    metrics_append_value(&body, "tws_connections_shed_total", "",
+                         shed_connections_.load(std::memory_order_relaxed));
+    metrics_append_header(&body, "tws_microcache_requests_total", "counter",
+                          "Requests to cached routes by result (hit, stale, coalesced, miss).");
+    metrics_append_value(&body, "tws_microcache_requests_total", "result=\"hit\"", microcache_.hits());
+    metrics_append_value(&body, "tws_microcache_requests_total", "result=\"stale\"", microcache_.stale_hits());
+    metrics_append_value(&body, "tws_microcache_requests_total", "result=\"coalesced\"", microcache_.coalesced());
+    metrics_append_value(&body, "tws_microcache_requests_total", "result=\"miss\"", microcache_.misses());
+    metrics_append_header(&body, "tws_thread_pool_threads", "gauge", "Worker threads.");
+    metrics_append_value(&body, "tws_thread_pool_threads", "", thread_pool_.thread_count());
+    metrics_append_header(&body, "tws_thread_pool_queued_tasks", "gauge", "Tasks waiting in the thread pool.");
+    metrics_append_value(&body, "tws_thread_pool_queued_tasks", "", thread_pool_.pending_tasks());
+    Logger& logger = Logger::get_instance();
+    metrics_append_header(&body, "tws_log_queued_bytes", "gauge", "Log bytes waiting for the writer thread.");
+    metrics_append_value(&body, "tws_log_queued_bytes", "", logger.queued_bytes());
+    metrics_append_header(&body, "tws_log_dropped_total", "counter", "Log records dropped because a buffer was full.");
+    metrics_append_value(&body, "tws_log_dropped_total", "", logger.dropped_count());
+
+    Response& response = conn->add_response();
+    ResponseBuilder(response, 200)
+        .header(HEADER_CONTENT_TYPE, "text/plain; version=0.0.4")
+        .raw("Cache-Control: no-store\r\n")
+        .content_length(body.size())
+        .end_headers();
+    response.body = std::make_shared<const std::string>(std::move(body));
+}
+
+void Server::handle_write(Connection* conn) {
+    LOGF_DEBUG("处理写事件，文件描述符：{}", conn->fd);
+    conn->last_active_ms = current_time_ms();
+    send_responses(conn);
+}
+
+void Server::send_responses(Connection* conn) {
+    FlushResult result;
+    while (true) {
+        int64_t write_start = current_time_ns();
+        result = conn->h2 != nullptr ? flush_http2(conn) : flush_responses(conn);
+        Metrics::local().stages[STAGE_WRITE].record(current_time_ns() - write_start);
+        if (result == FLUSH_ERROR) {
+            close_connection(conn);
+            return;
+        }
+        if (result == FLUSH_BLOCKED) {
+            // 写缓冲区已满，稍后再写
+            rearm_connection(conn, EPOLLOUT);
+            return;
+        }
+        if (result == FLUSH_DONE && conn->close_after_write) {
+            close_connection(conn);
+            return;
+        }
+        // 继续处理因队列达到上限而暂停的流水线请求
+        if (!process_requests(conn)) {
+            break;
+        }
+    }
+
+    if (result == FLUSH_UPSTREAM) {
+        // 响应体在等待上游的数据，之前排入的请求（如等待上游的处理函数）一起挂起
+        park_connection(conn);
+        return;
+    }
+    if (conn->offload_pending()) {
+        // 之前的响应已发出，剩下的请求交给新任务
+        offload_connection(conn);
+        return;
+    }
+    if (conn->peer_closed) {
+        close_connection(conn);
+        return;
+    }
+    // 数据已全部发送完毕，修改事件为EPOLLIN，继续监听读事件
+    rearm_connection(conn, EPOLLIN);
+}
+
+Server::FlushResult Server::flush_responses(Connection* conn) {
+    int fd = conn->fd;
+    std::vector<Response>& queue = conn->responses;
+    // 本次调用已发送的字节数：超过一个窗口就当作写阻塞返回，等下一次可写事件再继续，
+    // 大文件不会长时间占住工作线程，每个连接的发送状态也只有文件偏移
+    size_t window_sent = 0;
+
+    while (conn->response_head < queue.size()) {
+        if (window_sent >= write_per_event_) {
+            return FLUSH_BLOCKED;
+        }
+        // 把连续多个响应的内存部分（响应头、共享响应体）收集起来，一次sendmsg发出；
+        // 遇到带文件体的响应时停下，文件体用sendfile发送，逐段到达的响应体读出一段写一段
+        struct iovec iov[MAX_WRITE_IOVECS];
+        int iov_count = 0;
+        bool file_follows = false;
+        for (size_t i = conn->response_head; i < queue.size() && iov_count + 3 <= MAX_WRITE_IOVECS; ++i) {
+            Response& response = queue[i];
+            if (response.head_offset < response.head.size()) {
+                iov[iov_count].iov_base = const_cast<char*>(response.head.data() + response.head_offset);
+                iov[iov_count].iov_len = response.head.size() - response.head_offset;
+                ++iov_count;
+            }
+            if (response.buffer_offset < response.buffer.size()) {
+                iov[iov_count].iov_base = &response.buffer[response.buffer_offset];
+                iov[iov_count].iov_len = response.buffer.size() - response.buffer_offset;
+                ++iov_count;
+            }
+            if (response.body && response.body_offset < response.body->size()) {
+                iov[iov_count].iov_base = const_cast<char*>(response.body->data() + response.body_offset);
+                iov[iov_count].iov_len = response.body->size() - response.body_offset;
+                ++iov_count;
+            }
+            if (response.file_remaining > 0) {
+                file_follows = true;
+                break;
+            }
+            if (response.source) {
+                break;
+            }
+        }
+
+        if (iov_count > 0) {
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov;
+            msg.msg_iovlen = iov_count;
+            // 后面还有文件体时用MSG_MORE，让内核把响应头与文件数据合并成满包
+            int flags = MSG_NOSIGNAL | (file_follows ? MSG_MORE : 0);
+            ssize_t bytes_written = sendmsg(fd, &msg, flags);
+            if (bytes_written == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return FLUSH_BLOCKED;
+                }
+                LOG_ERROR("write() 错误：" + std::string(strerror(errno)));
+                return FLUSH_ERROR;
+            }
+
+            // 按顺序把已发送的字节数记到各个响应上，移除已完整发送的响应
+            Metrics::local().bytes_out.add(bytes_written);
+            window_sent += bytes_written;
+            size_t written = bytes_written;
+            for (size_t i = conn->response_head; i < queue.size(); ++i) {
+                Response& response = queue[i];
+                size_t n = std::min(written, response.head.size() - response.head_offset);
+                response.head_offset += n;
+                written -= n;
+                n = std::min(written, response.buffer.size() - response.buffer_offset);
+                response.buffer_offset += n;
+                written -= n;
+                if (response.body) {
+                    n = std::min(written, response.body->size() - response.body_offset);
+                    response.body_offset += n;
+                    written -= n;
+                }
+                if (!response.memory_sent() || response.file_remaining > 0 || response.source) {
+                    break;
+                }
+                response.buffer.clear();
+                response.body.reset();
+                response.head_owner.reset();
+                ++conn->response_head;
+            }
+            continue;
+        }
+
+        Response& response = queue[conn->response_head];
+        if (response.source || response.source_offset < response.source_buffer.size()) {
+            FlushResult result = flush_source(conn, response, &window_sent);
+            if (result != FLUSH_DONE) {
+                return result;
+            }
+            response.source_buffer.clear();
+            response.head_owner.reset();
+            ++conn->response_head;
+            continue;
+        }
+        // 队首响应只剩文件体：用sendfile零拷贝发送，部分发送时记录偏移，下次EPOLLOUT从同一位置继续
+        while (response.file_remaining > 0) {
+            if (window_sent >= write_per_event_) {
+                return FLUSH_BLOCKED;
+            }
+            size_t chunk = std::min(response.file_remaining, write_per_event_ - window_sent);
+            ssize_t bytes_sent = sendfile(fd, response.file_fd, &response.file_offset, chunk);
+            if (bytes_sent == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return FLUSH_BLOCKED;
+                }
+                LOG_ERROR("sendfile() 错误：" + std::string(strerror(errno)));
+                return FLUSH_ERROR;
+            }
+            if (bytes_sent == 0) {
+                // 文件在发送过程中被截短，无法再满足Content-Length，只能关闭连接
+                LOGF_WARN("文件在发送过程中被截短，关闭连接，文件描述符：{}", fd);
+                return FLUSH_ERROR;
+            }
+            response.file_remaining -= bytes_sent;
+            window_sent += bytes_sent;
+            Metrics::local().bytes_out.add(bytes_sent);
+        }
+        response.close_file();
+        ++conn->response_head;
+    }
+
+    // 全部发送完毕，保留vector容量供后续请求复用
+    queue.clear();
+    conn->response_head = 0;
+    return FLUSH_DONE;
+}
+
+Server::FlushResult Server::flush_source(Connection* conn, Response& response, size_t* window_sent) {
+    response.source_blocked = false;
+    while (true) {
+        // 先写完上次读出的数据：写不进去时不再读取，来源随之被限速
+        while (response.source_offset < response.source_buffer.size()) {
+            if (*window_sent >= write_per_event_) {
+                return FLUSH_BLOCKED;
+            }
+            ssize_t bytes_sent = send(conn->fd, response.source_buffer.data() + response.source_offset,
+                                      response.source_buffer.size() - response.source_offset, MSG_NOSIGNAL);
+            if (bytes_sent == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return FLUSH_BLOCKED;
+                }
+                LOG_ERROR("write() 错误：" + std::string(strerror(errno)));
+                return FLUSH_ERROR;
+            }
+            response.source_offset += bytes_sent;
+            *window_sent += bytes_sent;
+            Metrics::local().bytes_out.add(bytes_sent);
+        }
+        if (!response.source) {
+            return FLUSH_DONE;
+        }
+        if (*window_sent >= write_per_event_) {
+            return FLUSH_BLOCKED;
+        }
+
+        // 读取下一段；分块编码时在数据前留出块大小行的位置
+        const size_t prefix = response.source_chunked ? 10 : 0;
+        response.source_buffer.resize(prefix + SOURCE_READ_SIZE + 2);
+        response.source_offset = prefix;
+        ssize_t n = response.source->read(&response.source_buffer[prefix], SOURCE_READ_SIZE);
+        if (n == -1) {
+            response.source_buffer.clear();
+            response.source_offset = 0;
+            if (errno == EAGAIN) {
+                response.source_blocked = true;
+                return FLUSH_UPSTREAM;
+            }
+            // 响应头已经发出，无法再改为错误响应，只能中止连接
+            LOGF_WARN("响应体来源出错，关闭连接，文件描述符：{}，错误：{}", conn->fd, strerror(errno));
+            return FLUSH_ERROR;
+        }
+        if (n == 0) {
+            response.source.reset();
+            if (response.source_chunked) {
+                response.source_buffer.assign("0\r\n\r\n");
+            } else {
+                response.source_buffer.clear();
+            }
+            response.source_offset = 0;
+            continue;
+        }
+        if (response.source_chunked) {
+            char line[16];
+            int len = snprintf(line, sizeof(line), "%zx\r\n", static_cast<size_t>(n));
+            response.source_offset = prefix - len;
+            memcpy(&response.source_buffer[response.source_offset], line, len);
+            response.source_buffer.resize(prefix + n);
+            response.source_buffer.append("\r\n");
+        } else {
+            response.source_buffer.resize(n);
+        }
     }
 }
 
 // 在 server.cpp 中
-void Server::init_logger() {
-    Logger::get_instance().set_level(DEBUG);    // 设置日志级别（DEBUG、INFO、WARN、ERROR）
-    Logger::get_instance().set_async(true);     // 设置为异步日志（true：异步，false：同步）
+void Server::init_logger(const ServerConfig& config) {
+    Logger::get_instance().set_level(config.log_level);     // 日志级别（DEBUG、INFO、WARN、ERROR）
+    Logger::get_instance().set_async(config.log_async);     // 异步日志（true：异步，false：同步）
+    Logger::get_instance().set_console(config.log_console); // 是否同时输出到控制台
+    Logger::get_instance().set_flush_interval(config.log_flush_interval_ms);   // 写线程批量写出的间隔（毫秒）
+    Logger::get_instance().set_full_policy(config.log_full_policy);   // 缓冲区写满时丢弃并计数，或等待
+    Logger::get_instance().set_binary(config.log_binary);   // 二进制日志（server.binlog，用 logdecode 还原为文本）
 }
 
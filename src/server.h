@@ -4,53 +4,375 @@
 #include "ThreadPool.h"
 #include <unordered_map>
 #include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
 #include "logger.h"
+#include "connection.h"
+#include "http_parser.h"
+#include "timer.h"
+#include "asset_cache.h"
+#include "uring.h"
+#include "metrics.h"
+#include "response_builder.h"
+#include "router.h"
+#include "cpu_topology.h"
+#include "epoll.h"
+#include "upgrade.h"
+#include "http2.h"
+#include "proxy.h"
+#include "microcache.h"
 
-// 在server.h中
-struct HttpRequest {
-    std::string method;
-    std::string url;
-    std::string version;
-    std::unordered_map<std::string, std::string> headers;
-    std::string body;
+// 单次读事件最多读取的字节数，避免一个连接长时间占用工作线程
+#define MAX_READ_PER_EVENT (256 * 1024)
+// 一次sendmsg最多合并的iovec数量
+#define MAX_WRITE_IOVECS 64
+// 单次写事件最多发送的字节数：大文件按窗口分段发送，发完一个窗口就让出工作线程，等下一次可写事件
+#define MAX_WRITE_PER_EVENT (1024 * 1024)
+// 一个 Range 请求最多包含的区间数，超过时忽略 Range 返回完整内容
+#define MAX_BYTE_RANGES 16
+// 逐段到达的响应体（反向代理）单次读取、写出的大小
+#define SOURCE_READ_SIZE (64 * 1024)
+// epoll 事件数据中fd部分的标记位：上游fd的事件（其余部分是所属客户端连接的 fd + 代数），
+// 和等待上游期间客户端fd的事件（与恢复 EPOLLONESHOT 交接之后的事件区分）
+#define UPSTREAM_KEY_FLAG 0x80000000u
+#define PARKED_KEY_FLAG 0x40000000u
+
+// io_uring 后端：提交队列大小、接收缓冲区（provided buffer ring）的默认数量和大小
+#define URING_ENTRIES 4096
+#define URING_BUFFER_GROUP 0
+#define URING_BUFFER_COUNT 1024
+#define URING_BUFFER_SIZE 16384
+// 连接 inbox 积压超过该值时暂停接收，避免对端持续发送而工作线程来不及处理
+#define URING_INBOX_LIMIT (1024 * 1024)
+
+// 连接准入控制
+struct AdmissionConfig {
+    size_t max_connections;   // 同时保持的连接数上限，达到后新连接直接关闭
+    size_t high_water;        // 连接数达到该值后对新连接返回预先生成的503再关闭，0表示取上限的90%
+    int retry_after_s;        // 503 响应的 Retry-After（秒）
+
+    AdmissionConfig() : max_connections(MAX_CONNECTIONS), high_water(0), retry_after_s(1) {}
+};
+
+// I/O 后端
+enum IoBackend {
+    IO_BACKEND_EPOLL,   // 就绪通知：epoll_wait + read/write，EPOLLONESHOT 交接连接
+    IO_BACKEND_URING    // 完成通知：io_uring 多路 accept/recv，内核不支持时退回 epoll
+};
+
+// 线程绑定方式
+enum AffinityMode {
+    AFFINITY_NONE,   // 不绑定，由调度器决定
+    AFFINITY_AUTO,   // 按 /sys 中的CPU/NUMA拓扑自动布局
+    AFFINITY_LIST    // 按 cpu_list 的顺序依次分给Reactor和工作线程
+};
+
+// 启动参数，来自配置文件（config.h）和命令行
+struct ServerConfig {
+    int port;
+    int worker_threads;
+    int reactors;
+    size_t cache_budget;          // 静态资源缓存内存预算
+    IoBackend io_backend;
+    AdmissionConfig admission;
+    TimeoutConfig timeouts;
+    BodyLimits body_limits;
+
+    int event_batch;              // 一次 epoll_wait / 收割CQE 最多处理的事件数
+    size_t read_per_event;        // 单次读事件最多读取的字节数
+    size_t write_per_event;       // 单次写事件最多发送的字节数
+    unsigned uring_buffer_count;  // io_uring 接收缓冲区数量（2的幂）
+    unsigned uring_buffer_size;
+
+    LogLevel log_level;
+    bool log_async;
+    bool log_console;
+    int log_flush_interval_ms;               // 写线程批量写出的间隔
+    LogFullPolicy log_full_policy;           // 日志缓冲区写满时丢弃并计数，或等待写线程
+    bool log_binary;                         // 二进制日志（server.binlog，用 logdecode 还原为文本）
+
+    AffinityMode affinity;
+    std::vector<int> cpu_list;
+
+    int64_t drain_timeout_ms;                // 热升级后旧进程等待已有连接处理完毕的时限
+    bool http2;                              // 接受明文 HTTP/2（h2c：前言或 Upgrade）
+
+    ProxySettings proxy;                     // 反向代理的负载均衡、超时、连接池和健康检查参数
+    std::vector<ProxyRoute> proxy_routes;
+    size_t microcache_budget;                // 动态响应缓存的内存预算
+    std::vector<MicrocachePolicy> microcache;   // 按路由模式开启的响应缓存
+    std::vector<std::string> exec_argv;      // 热升级时执行的命令行（通常是本进程的 argv）
+
+    ServerConfig() : port(8080), worker_threads(8), reactors(1), cache_budget(DEFAULT_ASSET_CACHE_BUDGET),
+                     io_backend(IO_BACKEND_EPOLL), event_batch(MAX_EVENTS),
+                     read_per_event(MAX_READ_PER_EVENT), write_per_event(MAX_WRITE_PER_EVENT),
+                     uring_buffer_count(URING_BUFFER_COUNT), uring_buffer_size(URING_BUFFER_SIZE),
+                     log_level(INFO), log_async(true), log_console(true),
+                     log_flush_interval_ms(100), log_full_policy(LOG_DROP), log_binary(false),
+                     affinity(AFFINITY_NONE),
+                     drain_timeout_ms(DEFAULT_DRAIN_TIMEOUT_MS), http2(true),
+                     microcache_budget(DEFAULT_MICROCACHE_BUDGET) {}
+};
+
+// 工作线程请求 Reactor 代为提交的 io_uring 操作（环只由 Reactor 线程访问）
+struct UringRequest {
+    enum Type {
+        POLL_OUT,      // 发送被阻塞，等待可写
+        RESUME_RECV,   // inbox 已取走，恢复接收
+        CLOSE,         // 从固定文件表中移除并关闭fd
+        STOP_ACCEPT,   // 热升级：取消 multishot accept，不再接受新连接
+        POLL_UPSTREAM  // 连接在等待上游：upstream_fd 就绪后唤醒连接
+    };
+    Type type;
+    int fd;
+    uint32_t generation;
+    int upstream_fd;
+    uint32_t events;
+};
+
+// 一个Reactor对应一个事件循环线程：拥有独立的epoll实例和SO_REUSEPORT监听套接字，
+// 由它accept的连接始终注册在它自己的epoll上
+struct Reactor {
+    int id;
+    ThreadPlacement placement;   // 事件循环线程的绑定位置
+    int listen_fd;
+    int epoll_fd;
+    int spare_fd;         // 预留的fd，进程fd耗尽（EMFILE）时释放它来接受并拒绝积压的连接
+    std::thread thread;
+    TimingWheel timers;   // 该Reactor上连接的超时检查
+
+    // io_uring 后端
+    std::unique_ptr<IoUring> uring;
+    std::vector<int> fixed_fds;        // FILES_UPDATE 的参数，下标即固定文件槽位（与fd相同）
+    int wake_fd = -1;                  // eventfd，工作线程在 Reactor 休眠时用它唤醒
+    uint64_t wake_value = 0;
+    int64_t accept_resume_ms = 0;      // fd耗尽后暂停 accept，到该时间重新提交（0表示未暂停）
+    bool accept_stopped = false;       // 已交出监听套接字，不再提交 accept
+    std::atomic<bool> sleeping{false};
+    std::mutex pending_mutex;
+    std::vector<UringRequest> pending;
+    // 进行中的上游 POLL_ADD：上游fd -> 等待它的连接（fd + 代数）和事件，已有覆盖所需事件的 poll 时
+    // 只改登记的连接，不重复提交（只由 Reactor 线程访问）
+    std::unordered_map<int, std::pair<uint64_t, uint32_t>> upstream_polls;
+
+    // 工作线程提前了截止时间（开始等待上游）的连接，Reactor线程在下一个tick之前重新放入时间轮
+    std::mutex timer_mutex;
+    std::vector<std::pair<Connection*, uint32_t>> timer_requests;
 };
 
 class Server {
 public:
-    Server(int port, int thread_num = 8); // 增加线程数量参数
+    explicit Server(const ServerConfig& config);
     ~Server();
 
     void run();
-    
+
+    // 设置连接超时（需在run之前调用）
+    void set_timeouts(const TimeoutConfig& timeouts);
+
+    // 选择I/O后端（需在run之前调用），io_uring 不可用时自动退回 epoll
+    void set_io_backend(IoBackend backend);
+
+    // 设置连接数上限和过载时的503阈值（需在run之前调用）
+    void set_admission(const AdmissionConfig& admission);
+
+    // 设置请求体大小上限和转存临时文件的阈值（需在run之前调用）
+    void set_body_limits(const BodyLimits& limits);
+
+    // 注册路由（需在run之前调用）。默认已注册 GET /metrics、GET /*path（静态资源）和 POST /*path（回显）。
+    // 配置了同一模式的 microcache 时，该路由的 GET/HEAD/POST 响应按策略缓存
+    bool route(HttpMethod method, std::string_view pattern, RouteHandler handler, RouteMode mode = ROUTE_INLINE);
+
 
 private:
     void init_socket();
-    void event_loop();
-    void accept_connections();
-    void handle_read(int fd);
-    void handle_write(int fd);
-
-    bool parse_request_header(const std::string& request_header, HttpRequest& request);
-    bool parse_http_request(int fd) ;
-    void handle_request(int fd, const HttpRequest& request); 
-    void handle_get_request(int fd, const HttpRequest& request) ;
-    void handle_post_request(int fd, const HttpRequest& request) ;
-    void send_file_response(int fd, const std::string& file_path);
-    std::string get_content_type(const std::string& file_path) ;
-    void send_error_response(int fd, int status_code, const std::string& status_message) ;
-    void init_logger();
+    int create_listen_socket();
+    void event_loop(Reactor* reactor);
+    void accept_connections(Reactor* reactor);
+    // 准入检查：连接数超过阈值时拒绝（必要时先发送503）并关闭fd，返回是否接受
+    bool admit_connection(int conn_fd);
+    // fd耗尽时释放预留fd，接受一个积压的连接并以503拒绝，返回是否取到了连接
+    bool accept_with_spare_fd(Reactor* reactor);
+    void shed_connection(int conn_fd, bool respond);
+    // 为新accept的fd建立连接并登记header超时，失败时关闭fd并返回nullptr
+    Connection* open_connection(Reactor* reactor, int conn_fd);
+    void handle_read(Connection* conn);
+    // 读到数据（或对端关闭）之后：解析并响应，或者继续等待
+    void process_input(Connection* conn);
+    void handle_write(Connection* conn);
+
+    // 发送结果
+    enum FlushResult {
+        FLUSH_DONE,      // 队列已全部发送
+        FLUSH_BLOCKED,   // socket发送缓冲区已满，等待EPOLLOUT
+        FLUSH_UPSTREAM,  // 响应体在等待上游的数据（ResponseSource）
+        FLUSH_ERROR      // 发送出错，需要关闭连接
+    };
+    // 把响应队列尽量合并成少量 sendmsg/sendfile 调用发出
+    FlushResult flush_responses(Connection* conn);
+    // 队首响应的逐段响应体：读出一段写一段，客户端写不进去时不再读取
+    FlushResult flush_source(Connection* conn, Response& response, size_t* window_sent);
+    // 发送响应并继续处理读缓冲区中剩余的流水线请求，最后重新arm或关闭连接
+    void send_responses(Connection* conn);
+    // 解析读缓冲区中所有完整的请求并依次排入响应队列，返回是否有新的响应
+    bool process_requests(Connection* conn);
+    // 根据请求的版本和Connection头部决定是否保持连接，并补充相应的响应头
+    void finish_response(Connection* conn, bool keep_alive, bool http10);
+    // 处理完一个事件后重新arm（EPOLLONESHOT），交出连接的所有权
+    void rearm_connection(Connection* conn, uint32_t events);
+    void close_connection(Connection* conn);
+    // 根据连接当前状态（空闲/读请求头/读请求体/写阻塞）更新超时截止时间
+    void update_deadline(Connection* conn, uint32_t events);
+    // 时间轮回调：连接超时，在Reactor线程上执行
+    void expire_connection(Reactor* reactor, Connection* conn, uint32_t generation);
+    // 把工作线程提前了截止时间的连接放入时间轮（Reactor线程）
+    void drain_timer_requests(Reactor* reactor);
+
+    // 等待上游：连接在等待的上游fd就绪、截止时间到达或客户端有事件（HTTP/2 的帧、断开）时被唤醒，
+    // 在新任务中继续处理，工作线程不阻塞在上游的读写上
+    void park_connection(Connection* conn);
+    // 连接正在等待的上游：等待响应头的转发和读不到数据的响应体
+    void collect_upstream_waits(Connection* conn, std::vector<ResponseSource*>* waits);
+    // epoll 后端：把挂起的连接从 PARK_WAITING 改为 PARK_CLAIMED，成功时由调用方继续处理
+    bool claim_parked_connection(Connection* conn);
+    // 上游就绪或等待超时（Reactor线程）：连接由调用方取得时设置继续处理的任务并返回true
+    bool wake_connection(Connection* conn, uint32_t generation, Task* task);
+    // 被唤醒的连接继续处理：HTTP/2 连接同时在等待客户端的帧，先读取；HTTP/1 等待期间不读取新的请求
+    void resume_connection(Connection* conn);
+
+    // io_uring 后端（server_uring.cpp）
+    bool init_uring(Reactor* reactor);
+    void uring_event_loop(Reactor* reactor);
+    void uring_arm_accept(Reactor* reactor);
+    void uring_accept(Reactor* reactor, int conn_fd);
+    void uring_arm_recv(Reactor* reactor, Connection* conn);
+    void uring_complete(Reactor* reactor, const struct io_uring_cqe& cqe, Task* batch, size_t* batch_size);
+    void uring_submit_requests(Reactor* reactor, std::vector<UringRequest>& requests);
+    // 工作线程把操作交给连接所属的 Reactor 提交
+    void uring_request(Reactor* reactor, UringRequest::Type type, int fd, uint32_t generation,
+                       int upstream_fd = -1, uint32_t events = 0);
+    // 工作线程：取走 inbox 中的数据并处理
+    void handle_uring_read(Connection* conn);
+    // 工作线程处理完毕：inbox 中还有数据就继续处理，否则交出连接
+    void release_uring_connection(Connection* conn);
+
+    bool parse_http_request(Connection* conn) ;
+    // 请求头完整后确定请求体的分帧方式并开始接收；请求不合法时排入错误响应并返回false
+    bool begin_request_body(Connection* conn, const HttpRequest& request);
+    // 按路由分发请求；路由要求转交线程池而当前不在转交后的任务中时返回false，请求未处理
+    bool handle_request(Connection* conn, const HttpRequest& request);
+    // 执行处理函数；处理函数在等待上游时返回false（OFFLOAD_UPSTREAM），之后重新执行时继续。
+    // 作为缓存的执行者（lead_key）时，完成后把结果放入缓存
+    bool run_route_handler(Connection* conn, const HttpRequest& request, const Route* route,
+                           const RouteParams& params);
+    // 把连接作为新任务重新提交给线程池，继续处理 ROUTE_OFFLOAD 的请求；
+    // OFFLOAD_WAITING 时等到同一缓存键的执行结束再提交
+    void offload_connection(Connection* conn);
+    void register_default_routes();
+    // 为每条代理路由建立上游组并注册所有方法。转发不阻塞：等待上游时处理函数挂起，连接交给 Reactor 等待
+    void register_proxy_routes(const ServerConfig& config);
+    void handle_proxy_request(Connection* conn, const HttpRequest& request, UpstreamGroup* upstreams);
+    // 带缓存策略的路由：同一个key只有一个请求执行处理函数，其余挂起等待结果或返回旧响应。
+    // 需要挂起时返回false（OFFLOAD_WAITING），请求未处理
+    bool handle_cached_request(Connection* conn, const HttpRequest& request, const Route* route,
+                               const RouteParams& params, const std::string& key);
+    void send_microcached_response(Connection* conn, const std::shared_ptr<const MicrocachedResponse>& cached);
+    // 405 响应，Allow 列出该路径上注册的方法
+    void send_method_not_allowed(Connection* conn, unsigned allowed);
+    // path 为相对资源根目录的URL路径（未解码）
+    void handle_static_request(Connection* conn, const HttpRequest& request, std::string_view path);
+    void handle_post_request(Connection* conn, const HttpRequest& request) ;
+    void send_file_response(Connection* conn, const HttpRequest& request, const std::string& file_path);
+    // 206 响应：单个区间直接发送，多个区间用 multipart/byteranges（接管 file_fd）
+    void send_range_response(Connection* conn, int file_fd, size_t file_size,
+                             const std::vector<std::pair<size_t, size_t>>& ranges,
+                             const std::string& content_type, const std::string& validators);
+    // 解析 Accept-Encoding，返回客户端接受的 ContentEncoding 位掩码
+    unsigned accepted_encodings(const HttpRequest& request);
+    // 根据 If-None-Match / If-Modified-Since 判断能否返回304
+    bool is_not_modified(const HttpRequest& request, const std::string& etag, time_t mtime);
+    void send_error_response(Connection* conn, int status_code, const std::string& status_message) ;
+    // GET /metrics：Prometheus 文本格式的运行指标
+    void send_metrics_response(Connection* conn);
+    void init_logger(const ServerConfig& config);
+
+    // HTTP/2（server_http2.cpp）：连接收到 h2c 前言时建立会话
+    void start_http2(Connection* conn);
+    // HTTP/1.1 请求带 Upgrade: h2c 时排入101并建立会话，该请求作为流1处理；HTTP2-Settings 无效时返回false
+    bool upgrade_to_http2(Connection* conn, const HttpRequest& request);
+    // 处理读缓冲区中的帧并分发已完整的请求，返回是否有待发送的数据
+    bool process_http2(Connection* conn);
+    // 依次执行就绪流的请求；遇到需要转交线程池的路由时返回false
+    bool dispatch_http2_streams(Connection* conn);
+    // 把处理函数排入 conn->responses（从 first 开始）的响应转给流，响应头编码为 HEADERS 帧
+    void submit_http2_response(Connection* conn, Http2Stream* stream, size_t first);
+    // 生成 DATA 帧并与控制帧一起合并写出
+    FlushResult flush_http2(Connection* conn);
+
+    // 热升级（upgrade.h）：收到 SIGUSR2 后启动新进程并交出监听套接字，成功后停止 accept，
+    // 在期限内等待已有连接处理完毕，然后退出进程
+    void wait_for_upgrade();
+    void stop_accepting();
+    // 关闭空闲的 keep-alive 连接（正在处理请求的连接在响应后自行关闭）
+    void close_idle_connections();
+    void drain_and_exit();
 
 
     int port_;
+    // 线程绑定位置，须在 thread_pool_ 之前初始化
+    std::vector<ThreadPlacement> reactor_placement_;
+    std::vector<ThreadPlacement> worker_placement_;
     ThreadPool thread_pool_; // 线程池成员
 
-    int listen_fd_;
-    int epoll_fd_;
+    // 每个Reactor一个事件循环
+    std::vector<std::unique_ptr<Reactor>> reactors_;
+
+    // 按fd索引的连接槽位，所有Reactor共享（fd在进程内唯一）
+    ConnectionSlab connections_;
+
+    // 规范化后的静态资源根目录（绝对路径），须在 asset_cache_ 之前初始化
+    std::string resource_root_;
+    // 静态资源缓存，所有工作线程共享
+    AssetCache asset_cache_;
+
+    // 启动时建立，运行期间只读
+    Router router_;
+    std::vector<std::unique_ptr<UpstreamGroup>> upstream_groups_;
+    std::vector<MicrocachePolicy> microcache_policies_;   // 路由持有其中元素的指针
+    Microcache microcache_;
+    bool proxy_catch_all_;   // 有代理路由接管了整个路径空间（"/*name"），不再注册默认的静态资源和回显路由
+
+    TimeoutConfig timeouts_;
+    BodyLimits body_limits_;
+
+    IoBackend io_backend_;
+    bool use_uring_;    // 实际使用的后端
+
+    // 热升级
+    std::vector<std::string> exec_argv_;
+    int64_t drain_timeout_ms_;
+    int upgrade_channel_;              // 由热升级启动时与旧进程通信的fd，开始服务后通知旧进程
+    std::atomic<bool> draining_;       // 已交出监听套接字：响应后关闭连接，不再 keep-alive
+
+    bool http2_enabled_;
+
+    // 运行参数（ServerConfig 中的同名项）
+    int event_batch_;
+    size_t read_per_event_;
+    size_t write_per_event_;
+    unsigned uring_buffer_count_;
+    unsigned uring_buffer_size_;
+
+    // 预生成的错误页
+    ErrorPages error_pages_;
 
-    // 添加一个映射，存储每个文件描述符对应的读缓冲区
-    std::unordered_map<int, std::string> read_buffers_;
-    // 添加一个映射，存储每个文件描述符对应的写缓冲区
-    std::unordered_map<int, std::string> write_buffers_;
+    AdmissionConfig admission_;
+    std::string shed_response_;                  // 预先生成的503响应
+    std::atomic<size_t> active_connections_;
+    std::atomic<uint64_t> shed_connections_;     // 因过载被拒绝的连接数
 };
 
 #endif // SERVER_H
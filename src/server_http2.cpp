@@ -0,0 +1,152 @@
+// HTTP/2（h2c）与服务器的衔接：帧的收发和流的状态在 Http2Session 中，这里把就绪的流交给路由，
+// 处理函数照常生成 HTTP/1 形式的 Response，响应头转成 HEADERS 帧，响应体由会话切成 DATA 帧。
+// 多个流的帧排在同一个输出缓冲区中，一次 sendmsg 写出。
+#include "server.h"
+#include "utils.h"
+
+#include <errno.h>
+#include <string.h>
+
+void Server::start_http2(Connection* conn) {
+    conn->h2 = new Http2Session(&body_limits_);
+    conn->h2->start();
+    LOGF_DEBUG("连接切换到 HTTP/2，文件描述符：{}", conn->fd);
+}
+
+bool Server::upgrade_to_http2(Connection* conn, const HttpRequest& request) {
+    std::unique_ptr<Http2Session> session(new Http2Session(&body_limits_));
+    if (!session->apply_upgrade_settings(request.header("HTTP2-Settings"))) {
+        // 按普通的 HTTP/1.1 请求处理
+        return false;
+    }
+    ResponseBuilder(conn->add_response(), 101).raw("Connection: Upgrade\r\nUpgrade: h2c\r\n\r\n");
+    session->start();
+    session->open_upgrade_stream(request);
+    conn->h2 = session.release();
+    LOGF_DEBUG("连接升级到 HTTP/2，文件描述符：{}", conn->fd);
+    return true;
+}
+
+bool Server::process_http2(Connection* conn) {
+    Http2Session* session = conn->h2;
+    if (conn->close_after_write) {
+        return false;
+    }
+    // 转交线程池的请求完成之前不再读取新的帧，流的状态保持不变
+    if (!dispatch_http2_streams(conn)) {
+        return session->wants_write();
+    }
+    if (!session->receive(conn->read_buffer)) {
+        // 连接错误：GOAWAY 已排入，发送后关闭
+        conn->close_after_write = true;
+        return true;
+    }
+    if (!dispatch_http2_streams(conn)) {
+        return session->wants_write();
+    }
+    if (draining_.load(std::memory_order_relaxed)) {
+        // 热升级：不再接受新的流，已有的流处理完后关闭
+        session->shutdown();
+    }
+    if (session->finished()) {
+        conn->close_after_write = true;
+    }
+    return session->wants_write() || conn->close_after_write;
+}
+
+bool Server::dispatch_http2_streams(Connection* conn) {
+    Http2Session* session = conn->h2;
+    if (conn->offload_pending()) {
+        // 队首的流已交给新任务（或在等待缓存结果、上游），在那里继续分发
+        return false;
+    }
+    while (Http2Stream* stream = session->next_ready()) {
+        size_t first = conn->responses.size();
+        int64_t handler_start = current_time_ns();
+        if (stream->error_status != 0) {
+            // 接收阶段发现的错误（请求头过大、请求体超限），错误页都是预生成的
+            send_error_response(conn, stream->error_status, "");
+        } else {
+            HttpRequest request;
+            stream->fill_request(&request);
+            request.body = stream->body.size() > 0 ? &stream->body : nullptr;
+            if (!handle_request(conn, request)) {
+                // 路由要求转交线程池：流留在就绪队列队首，新任务中重新执行
+                return false;
+            }
+            Metrics::local().methods[Metrics::method_index(request.method)].add();
+        }
+        Metrics::local().stages[STAGE_HANDLER].record(current_time_ns() - handler_start);
+        submit_http2_response(conn, stream, first);
+        session->pop_ready();
+        ++conn->request_count;
+    }
+    return true;
+}
+
+void Server::submit_http2_response(Connection* conn, Http2Stream* stream, size_t first) {
+    std::vector<Response>& responses = conn->responses;
+    if (responses.size() == first) {
+        send_error_response(conn, 500, "Internal Server Error");
+    }
+    // 状态行和响应头字段（head 与 buffer 中结尾空行之前的部分）编码为头部块，其余部分是响应体
+    Response& response = responses[first];
+    std::string header_block;
+    hpack_encode_status(response.status, &header_block);
+    hpack_encode_http1_fields(response.head, &header_block);
+    size_t header_end = std::min(response.header_end, response.buffer.size());
+    hpack_encode_http1_fields(std::string_view(response.buffer).substr(0, header_end), &header_block);
+    response.buffer_offset = std::min(header_end + 2, response.buffer.size());
+    if (response.status > 0 && response.status < METRICS_STATUS_LIMIT) {
+        Metrics::local().statuses[response.status].add();
+    }
+
+    for (size_t i = first; i < responses.size(); ++i) {
+        responses[i].head_offset = responses[i].head.size();
+        stream->responses.push_back(std::move(responses[i]));
+    }
+    responses.erase(responses.begin() + first, responses.end());
+    conn->h2->submit_response(stream, header_block);
+}
+
+Server::FlushResult Server::flush_http2(Connection* conn) {
+    // 升级时的101（HTTP/1.1）先发出
+    if (conn->pending_responses() > 0) {
+        FlushResult result = flush_responses(conn);
+        if (result != FLUSH_DONE) {
+            return result;
+        }
+    }
+    Http2Session* session = conn->h2;
+    IoBuffer& out = session->output();
+    size_t window_sent = 0;
+    while (true) {
+        // 各个流按轮转生成 DATA 帧，直到输出缓冲区达到上限或流量控制窗口用完
+        if (!session->produce()) {
+            LOG_ERROR("读取响应文件错误：" + std::string(strerror(errno)));
+            return FLUSH_ERROR;
+        }
+        if (out.empty()) {
+            // 有流的响应体在等待上游的数据
+            std::vector<ResponseSource*> sources;
+            session->blocked_sources(&sources);
+            return sources.empty() ? FLUSH_DONE : FLUSH_UPSTREAM;
+        }
+        if (window_sent >= write_per_event_) {
+            return FLUSH_BLOCKED;
+        }
+        ssize_t bytes_written = out.write_to(conn->fd);
+        if (bytes_written == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return FLUSH_BLOCKED;
+            }
+            LOG_ERROR("write() 错误：" + std::string(strerror(errno)));
+            return FLUSH_ERROR;
+        }
+        Metrics::local().bytes_out.add(bytes_written);
+        window_sent += bytes_written;
+    }
+}
@@ -0,0 +1,473 @@
+// io_uring I/O 后端：每个Reactor一个环，多路 accept 和多路 recv（provided buffer ring）
+// 在内核中持续进行，一次 io_uring_enter 同时完成提交和收割，不再需要 epoll_wait/read/epoll_ctl。
+// 响应仍由工作线程直接 sendmsg/sendfile 发出（多个流水线响应合并为一次调用），
+// 只有发送被阻塞时才交给 Reactor 提交 POLLOUT 等待。
+#include "server.h"
+#include "utils.h"
+#include "epoll.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+// 完成事件 user_data 的编码：操作类型(8位) | fd(24位) | 连接代数(32位)
+enum UringOp {
+    URING_OP_ACCEPT = 1,
+    URING_OP_RECV,
+    URING_OP_POLL_OUT,
+    URING_OP_WAKE,
+    URING_OP_CANCEL,
+    URING_OP_FILES_UPDATE,
+    URING_OP_CLOSE,
+    URING_OP_POLL_UPSTREAM   // fd 为上游fd，等待它的连接见 Reactor::upstream_polls
+};
+
+static inline uint64_t uring_data(UringOp op, int fd, uint32_t generation) {
+    return (static_cast<uint64_t>(op) << 56) |
+           (static_cast<uint64_t>(static_cast<uint32_t>(fd) & 0xffffffu) << 32) | generation;
+}
+
+static inline UringOp uring_data_op(uint64_t data) {
+    return static_cast<UringOp>(data >> 56);
+}
+
+static inline int uring_data_fd(uint64_t data) {
+    return static_cast<int>((data >> 32) & 0xffffffu);
+}
+
+static inline uint32_t uring_data_generation(uint64_t data) {
+    return static_cast<uint32_t>(data);
+}
+
+bool Server::init_uring(Reactor* reactor) {
+    std::unique_ptr<IoUring> ring(new IoUring());
+    if (!ring->init(URING_ENTRIES)) {
+        LOG_WARN("io_uring_setup() 失败：" + std::string(strerror(errno)));
+        return false;
+    }
+    // multishot recv 与 SEND_ZC 同一版本（6.0）引入，用后者的探测结果判断前者是否可用
+    const uint8_t required[] = { IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_POLL_ADD, IORING_OP_READ,
+                                 IORING_OP_FILES_UPDATE, IORING_OP_CLOSE, IORING_OP_ASYNC_CANCEL,
+                                 IORING_OP_SEND_ZC };
+    for (uint8_t opcode : required) {
+        if (!ring->supports(opcode)) {
+            LOG_WARN("io_uring 不支持操作码 " + std::to_string(opcode));
+            return false;
+        }
+    }
+
+    // 固定文件槽位按fd编号分配，数量受 RLIMIT_NOFILE 限制
+    struct rlimit limit;
+    size_t file_count = MAX_CONNECTIONS;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < file_count) {
+        file_count = limit.rlim_cur;
+    }
+    if (!ring->register_files_sparse(static_cast<unsigned>(file_count))) {
+        LOG_WARN("io_uring 注册固定文件表失败：" + std::string(strerror(errno)));
+        return false;
+    }
+    if (!ring->register_buffer_ring(URING_BUFFER_GROUP, uring_buffer_count_, uring_buffer_size_)) {
+        LOG_WARN("io_uring 注册接收缓冲区失败：" + std::string(strerror(errno)));
+        return false;
+    }
+    int wake_fd = eventfd(0, EFD_CLOEXEC);
+    if (wake_fd == -1) {
+        LOG_WARN("eventfd() 失败：" + std::string(strerror(errno)));
+        return false;
+    }
+
+    reactor->fixed_fds.assign(file_count, -1);
+    reactor->wake_fd = wake_fd;
+    reactor->uring = std::move(ring);
+    return true;
+}
+
+void Server::uring_event_loop(Reactor* reactor) {
+    apply_thread_placement(reactor->placement);
+    IoUring& ring = *reactor->uring;
+    std::vector<struct io_uring_cqe> cqes(event_batch_);
+    // 本轮待提交的任务，整批交给线程池，只唤醒一次
+    std::vector<Task> batch(event_batch_);
+    std::vector<UringRequest> requests;
+    auto on_expire = [this, reactor](Connection* conn, uint32_t generation) {
+        expire_connection(reactor, conn, generation);
+    };
+
+    uring_arm_accept(reactor);
+    struct io_uring_sqe* sqe = ring.get_sqe();
+    uring_prep_read(sqe, reactor->wake_fd, &reactor->wake_value, sizeof(reactor->wake_value),
+                    uring_data(URING_OP_WAKE, 0, 0));
+
+    while (true) {
+        // 提交工作线程请求的操作
+        {
+            std::lock_guard<std::mutex> lock(reactor->pending_mutex);
+            requests.swap(reactor->pending);
+        }
+        uring_submit_requests(reactor, requests);
+
+        int ret;
+        if (ring.cq_ready()) {
+            ret = ring.submit(false, 0);
+        } else {
+            // 登记为休眠后再检查一次请求队列，与 uring_request 配对，保证不会丢失唤醒
+            reactor->sleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            bool has_requests;
+            {
+                std::lock_guard<std::mutex> lock(reactor->pending_mutex);
+                has_requests = !reactor->pending.empty();
+            }
+            // 最多等到时间轮的下一个tick
+            int timeout = reactor->timers.next_timeout(current_time_ms());
+            ret = ring.submit(!has_requests, timeout);
+            reactor->sleeping.store(false, std::memory_order_relaxed);
+        }
+        drain_timer_requests(reactor);
+        reactor->timers.advance(current_time_ms(), on_expire);
+        HttpDateCache::refresh(time(nullptr));
+        if (reactor->accept_resume_ms != 0 && current_time_ms() >= reactor->accept_resume_ms) {
+            uring_arm_accept(reactor);
+        }
+        if (ret < 0 && ret != -ETIME && ret != -EINTR && ret != -EBUSY) {
+            LOG_ERROR("Reactor " + std::to_string(reactor->id) +
+                      " io_uring_enter() 错误：" + std::string(strerror(-ret)));
+            break;
+        }
+
+        size_t batch_size = 0;
+        unsigned n = ring.copy_cqes(cqes.data(), static_cast<unsigned>(cqes.size()));
+        for (unsigned i = 0; i < n; ++i) {
+            uring_complete(reactor, cqes[i], batch.data(), &batch_size);
+        }
+        // 本轮用完的接收缓冲区一次性归还给内核
+        ring.publish_buffers();
+        thread_pool_.submit_batch(batch.data(), batch_size, reactor->placement.node);
+    }
+}
+
+void Server::uring_arm_accept(Reactor* reactor) {
+    reactor->accept_resume_ms = 0;
+    if (reactor->accept_stopped) {
+        return;
+    }
+    struct io_uring_sqe* sqe = reactor->uring->get_sqe();
+    uring_prep_accept_multishot(sqe, reactor->listen_fd, false, SOCK_NONBLOCK | SOCK_CLOEXEC,
+                                uring_data(URING_OP_ACCEPT, 0, 0));
+}
+
+void Server::uring_accept(Reactor* reactor, int conn_fd) {
+    if (static_cast<size_t>(conn_fd) >= reactor->fixed_fds.size()) {
+        LOGF_WARN("文件描述符 {} 超出固定文件表容量，拒绝连接。", conn_fd);
+        close(conn_fd);
+        return;
+    }
+    Connection* conn = open_connection(reactor, conn_fd);
+    if (conn == nullptr) {
+        return;
+    }
+
+    // 先把fd登记到固定文件表（槽位号即fd），链接的 recv 使用固定文件，免去每次操作查找fd
+    reactor->fixed_fds[conn_fd] = conn_fd;
+    struct io_uring_sqe* sqe = reactor->uring->get_sqe();
+    uring_prep_files_update(sqe, &reactor->fixed_fds[conn_fd], 1, conn_fd,
+                            uring_data(URING_OP_FILES_UPDATE, conn_fd,
+                                       conn->generation.load(std::memory_order_relaxed)));
+    sqe->flags |= IOSQE_IO_LINK | IOSQE_CQE_SKIP_SUCCESS;
+    uring_arm_recv(reactor, conn);
+
+    if (Logger::enabled(INFO)) {
+        struct sockaddr_in client_addr;
+        socklen_t client_addr_len = sizeof(client_addr);
+        char client_ip[INET_ADDRSTRLEN] = "?";
+        int client_port = 0;
+        if (getpeername(conn_fd, (struct sockaddr*)&client_addr, &client_addr_len) == 0) {
+            inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, sizeof(client_ip));
+            client_port = ntohs(client_addr.sin_port);
+        }
+        LOGF_INFO("Reactor {} 接受新连接，文件描述符：{}, 来自：{}:{}", reactor->id, conn_fd,
+                  client_ip, client_port);
+    }
+}
+
+void Server::uring_arm_recv(Reactor* reactor, Connection* conn) {
+    if (conn->recv_active) {
+        return;
+    }
+    conn->recv_active = true;
+    struct io_uring_sqe* sqe = reactor->uring->get_sqe();
+    uring_prep_recv_multishot(sqe, conn->fd, true, URING_BUFFER_GROUP,
+                              uring_data(URING_OP_RECV, conn->fd,
+                                         conn->generation.load(std::memory_order_relaxed)));
+}
+
+void Server::uring_complete(Reactor* reactor, const struct io_uring_cqe& cqe, Task* batch,
+                            size_t* batch_size) {
+    IoUring& ring = *reactor->uring;
+    int fd = uring_data_fd(cqe.user_data);
+    uint32_t generation = uring_data_generation(cqe.user_data);
+
+    switch (uring_data_op(cqe.user_data)) {
+    case URING_OP_ACCEPT:
+        if (cqe.res >= 0) {
+            if (admit_connection(cqe.res)) {
+                uring_accept(reactor, cqe.res);
+            }
+        } else if (cqe.res == -EMFILE || cqe.res == -ENFILE) {
+            // fd耗尽：用预留fd把积压的连接逐个取出并拒绝。io_uring 的 accept 在等待连接之前
+            // 就分配fd，立即重新提交会反复失败，所以暂停到下一个tick再提交
+            while (accept_with_spare_fd(reactor)) {
+            }
+            reactor->accept_resume_ms = current_time_ms() + 1;
+        } else if (cqe.res != -EAGAIN && cqe.res != -EINTR && cqe.res != -ECANCELED) {
+            LOG_ERROR("accept() 错误：" + std::string(strerror(-cqe.res)));
+        }
+        if (!(cqe.flags & IORING_CQE_F_MORE) && reactor->accept_resume_ms == 0) {
+            // multishot accept 已终止（如出错），重新提交
+            uring_arm_accept(reactor);
+        }
+        break;
+
+    case URING_OP_RECV: {
+        bool has_buffer = (cqe.flags & IORING_CQE_F_BUFFER) != 0;
+        uint16_t bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        Connection* conn = connections_.get(fd, generation);
+        if (conn == nullptr || cqe.res == -ECANCELED) {
+            // 已关闭连接的残留事件，或因 inbox 积压而主动取消的接收
+            if (has_buffer) {
+                ring.recycle_buffer(bid);
+            }
+            break;
+        }
+        if (!(cqe.flags & IORING_CQE_F_MORE)) {
+            // multishot recv 已终止（对端关闭、出错、缓冲区用尽或完成队列溢出）
+            conn->recv_active = false;
+        }
+        if (cqe.res == -ENOBUFS) {
+            // 接收缓冲区暂时用尽，multishot 已终止，缓冲区归还后重新提交
+            uring_arm_recv(reactor, conn);
+            break;
+        }
+
+        bool schedule = false;
+        bool pause = false;
+        {
+            std::lock_guard<std::mutex> lock(conn->inbox_mutex);
+            // 加锁后再检查代数：工作线程在该锁内释放连接
+            if (conn->generation.load(std::memory_order_relaxed) == generation) {
+                if (cqe.res > 0) {
+                    conn->inbox.append(ring.buffer(bid), cqe.res);
+                    if (conn->inbox.size() > URING_INBOX_LIMIT && conn->recv_active) {
+                        conn->recv_paused = pause = true;
+                    }
+                } else {
+                    // 对端关闭（0）或接收出错：交给持有者按对端关闭处理
+                    conn->inbox_eof = true;
+                }
+                schedule = !conn->scheduled;
+                conn->scheduled = true;
+            }
+        }
+        if (has_buffer) {
+            ring.recycle_buffer(bid);
+        }
+        if (cqe.res > 0 && !pause) {
+            // multishot recv 被内核终止（如完成队列溢出）时重新提交
+            uring_arm_recv(reactor, conn);
+        }
+        if (pause) {
+            conn->recv_active = false;
+            struct io_uring_sqe* sqe = ring.get_sqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = cqe.user_data;
+            sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+            sqe->user_data = uring_data(URING_OP_CANCEL, fd, generation);
+        }
+        if (schedule) {
+            batch[(*batch_size)++] = Task([this, conn]() { handle_uring_read(conn); });
+        }
+        break;
+    }
+
+    case URING_OP_POLL_OUT: {
+        Connection* conn = connections_.get(fd, generation);
+        if (conn != nullptr) {
+            batch[(*batch_size)++] = Task([this, conn]() { handle_write(conn); });
+        }
+        break;
+    }
+
+    case URING_OP_POLL_UPSTREAM: {
+        auto it = reactor->upstream_polls.find(fd);
+        if (it == reactor->upstream_polls.end()) {
+            break;
+        }
+        uint64_t key = it->second.first;
+        reactor->upstream_polls.erase(it);
+        // 上游连接可能已经归还或关闭，多余的唤醒只会让连接再检查一次
+        Connection* conn = connections_.get(conn_key_fd(key), conn_key_generation(key));
+        Task task;
+        if (conn != nullptr && wake_connection(conn, conn_key_generation(key), &task)) {
+            batch[(*batch_size)++] = std::move(task);
+        }
+        break;
+    }
+
+    case URING_OP_WAKE: {
+        struct io_uring_sqe* sqe = ring.get_sqe();
+        uring_prep_read(sqe, reactor->wake_fd, &reactor->wake_value, sizeof(reactor->wake_value),
+                        uring_data(URING_OP_WAKE, 0, 0));
+        break;
+    }
+
+    case URING_OP_FILES_UPDATE:
+        // 只有失败时才有完成事件；链接的 recv 会以 -ECANCELED 结束，这里关闭连接
+        LOGF_ERROR("io_uring 登记固定文件失败：{}，文件描述符：{}", strerror(-cqe.res), fd);
+        if (Connection* conn = connections_.get(fd, generation)) {
+            // 新连接尚未交给工作线程，按对端关闭处理，由工作线程走正常的关闭流程
+            std::lock_guard<std::mutex> lock(conn->inbox_mutex);
+            conn->inbox_eof = true;
+            if (!conn->scheduled) {
+                conn->scheduled = true;
+                batch[(*batch_size)++] = Task([this, conn]() { handle_uring_read(conn); });
+            }
+        }
+        break;
+
+    case URING_OP_CLOSE:
+        LOGF_ERROR("io_uring close 错误：{}，文件描述符：{}", strerror(-cqe.res), fd);
+        break;
+
+    default:
+        break;
+    }
+}
+
+void Server::uring_submit_requests(Reactor* reactor, std::vector<UringRequest>& requests) {
+    IoUring& ring = *reactor->uring;
+    for (const UringRequest& request : requests) {
+        int fd = request.fd;
+        switch (request.type) {
+        case UringRequest::POLL_OUT: {
+            struct io_uring_sqe* sqe = ring.get_sqe();
+            uring_prep_poll(sqe, fd, true, POLLOUT,
+                            uring_data(URING_OP_POLL_OUT, fd, request.generation));
+            break;
+        }
+        case UringRequest::RESUME_RECV: {
+            Connection* conn = connections_.get(fd, request.generation);
+            if (conn != nullptr) {
+                uring_arm_recv(reactor, conn);
+            }
+            break;
+        }
+        case UringRequest::CLOSE: {
+            // 先清空固定文件槽位再关闭，硬链接保证清空失败时仍然关闭
+            reactor->fixed_fds[fd] = -1;
+            struct io_uring_sqe* sqe = ring.get_sqe();
+            uring_prep_files_update(sqe, &reactor->fixed_fds[fd], 1, fd,
+                                    uring_data(URING_OP_FILES_UPDATE, fd, 0));
+            sqe->flags |= IOSQE_IO_HARDLINK | IOSQE_CQE_SKIP_SUCCESS;
+            sqe = ring.get_sqe();
+            uring_prep_close(sqe, fd, uring_data(URING_OP_CLOSE, fd, 0));
+            sqe->flags |= IOSQE_CQE_SKIP_SUCCESS;
+            break;
+        }
+        case UringRequest::POLL_UPSTREAM: {
+            // 同一个上游fd已有覆盖所需事件的 poll 时只改为唤醒新的等待者
+            uint64_t key = pack_conn_key(fd, request.generation);
+            auto it = reactor->upstream_polls.find(request.upstream_fd);
+            if (it != reactor->upstream_polls.end() && (it->second.second & request.events) == request.events) {
+                it->second.first = key;
+                break;
+            }
+            uint32_t events = request.events | (it != reactor->upstream_polls.end() ? it->second.second : 0);
+            reactor->upstream_polls[request.upstream_fd] = std::make_pair(key, events);
+            struct io_uring_sqe* sqe = ring.get_sqe();
+            uring_prep_poll(sqe, request.upstream_fd, false, events,
+                            uring_data(URING_OP_POLL_UPSTREAM, request.upstream_fd, 0));
+            break;
+        }
+        case UringRequest::STOP_ACCEPT: {
+            // 取消 multishot accept；之后 uring_arm_accept 不再重新提交
+            reactor->accept_stopped = true;
+            reactor->accept_resume_ms = 0;
+            struct io_uring_sqe* sqe = ring.get_sqe();
+            sqe->opcode = IORING_OP_ASYNC_CANCEL;
+            sqe->fd = -1;
+            sqe->addr = uring_data(URING_OP_ACCEPT, 0, 0);
+            sqe->flags = IOSQE_CQE_SKIP_SUCCESS;
+            sqe->user_data = uring_data(URING_OP_CANCEL, fd, 0);
+            break;
+        }
+        }
+    }
+    requests.clear();
+}
+
+void Server::uring_request(Reactor* reactor, UringRequest::Type type, int fd, uint32_t generation,
+                           int upstream_fd, uint32_t events) {
+    {
+        std::lock_guard<std::mutex> lock(reactor->pending_mutex);
+        reactor->pending.push_back(UringRequest{ type, fd, generation, upstream_fd, events });
+    }
+    // 与 uring_event_loop 中的休眠登记配对
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (reactor->sleeping.load(std::memory_order_relaxed)) {
+        uint64_t one = 1;
+        if (write(reactor->wake_fd, &one, sizeof(one)) == -1) {
+            LOG_ERROR("唤醒Reactor失败：" + std::string(strerror(errno)));
+        }
+    }
+}
+
+void Server::handle_uring_read(Connection* conn) {
+    LOGF_DEBUG("处理读事件，文件描述符：{}", conn->fd);
+    conn->last_active_ms = current_time_ms();
+    bool resume = false;
+    {
+        std::lock_guard<std::mutex> lock(conn->inbox_mutex);
+        if (!conn->inbox.empty()) {
+            Metrics::local().bytes_in.add(conn->inbox.size());
+            if (conn->read_buffer.empty()) {
+                // 新请求的第一个字节，请求头超时从这里开始计算
+                conn->request_started_ms = conn->last_active_ms;
+            }
+            // 分段整体移入读缓冲区，不拷贝数据
+            conn->read_buffer.append(conn->inbox);
+        }
+        if (conn->inbox_eof) {
+            // 客户端关闭写方向，已收到的请求仍然要处理并响应
+            LOGF_DEBUG("客户端断开连接，文件描述符：{}", conn->fd);
+            conn->peer_closed = true;
+            conn->inbox_eof = false;
+        }
+        resume = conn->recv_paused;
+        conn->recv_paused = false;
+        conn->upstream_ready = false;
+    }
+    if (resume) {
+        uring_request(conn->reactor, UringRequest::RESUME_RECV, conn->fd,
+                      conn->generation.load(std::memory_order_relaxed));
+    }
+    process_input(conn);
+}
+
+void Server::release_uring_connection(Connection* conn) {
+    {
+        std::lock_guard<std::mutex> lock(conn->inbox_mutex);
+        if (conn->inbox.empty() && !conn->inbox_eof && !conn->upstream_ready) {
+            conn->scheduled = false;
+            return;
+        }
+    }
+    // 处理期间又收到了数据（或等待的上游已就绪），由当前线程继续持有；任务进入本线程的队列
+    thread_pool_.enqueue([this, conn]() { handle_uring_read(conn); });
+}
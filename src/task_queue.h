@@ -0,0 +1,224 @@
+#ifndef TASK_QUEUE_H
+#define TASK_QUEUE_H
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+
+// 任务内联存储的字节数，足够放下捕获几个指针的lambda
+#define TASK_INLINE_SIZE 48
+
+// 定长任务槽：可平凡复制的lambda直接存在内联缓冲区里，入队出队只是内存拷贝，不分配内存。
+// 过大或不可平凡复制的可调用对象才退化为在堆上分配，只存指针。
+// Task 本身可平凡复制，窃取时可以先拷贝再用CAS确认，失败时直接丢弃拷贝。
+class Task {
+public:
+    Task() : enqueued_ns(0), invoke_(nullptr) {}
+
+    template <typename F>
+    explicit Task(F&& f) : enqueued_ns(0) {
+        typedef typename std::decay<F>::type Fn;
+        store(std::forward<F>(f),
+              std::integral_constant<bool, sizeof(Fn) <= TASK_INLINE_SIZE &&
+                                           alignof(Fn) <= alignof(max_align_t) &&
+                                           std::is_trivially_copyable<Fn>::value>());
+    }
+
+    bool empty() const { return invoke_ == nullptr; }
+
+    // 执行任务（每个任务只能执行一次）
+    void operator()() { invoke_(storage_); }
+
+    int64_t enqueued_ns;   // 入队时间，用于统计排队等待时间
+
+private:
+    template <typename F>
+    void store(F&& f, std::true_type /* inline */) {
+        typedef typename std::decay<F>::type Fn;
+        new (storage_) Fn(std::forward<F>(f));
+        invoke_ = [](void* storage) { (*static_cast<Fn*>(storage))(); };
+    }
+
+    template <typename F>
+    void store(F&& f, std::false_type /* heap */) {
+        typedef typename std::decay<F>::type Fn;
+        Fn* fn = new Fn(std::forward<F>(f));
+        memcpy(storage_, &fn, sizeof(fn));
+        invoke_ = [](void* storage) {
+            Fn* fn;
+            memcpy(&fn, storage, sizeof(fn));
+            struct Deleter {
+                Fn* fn;
+                ~Deleter() { delete fn; }
+            } deleter = { fn };
+            (*fn)();
+        };
+    }
+
+    void (*invoke_)(void*);
+    alignas(max_align_t) unsigned char storage_[TASK_INLINE_SIZE];
+};
+
+static_assert(std::is_trivially_copyable<Task>::value, "Task must be trivially copyable");
+
+// Chase-Lev 工作窃取双端队列（定长）。
+// 所有者线程在底部 push/pop（LIFO，缓存友好），其他线程从顶部 steal。
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(size_t capacity = 4096)
+        : top_(0), bottom_(0), mask_(capacity - 1), buffer_(new Task[capacity]) {}
+    ~WorkStealingDeque() { delete[] buffer_; }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // 仅所有者调用，队列满时返回false
+    bool push(const Task& task) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        if (b - t > static_cast<int64_t>(mask_)) {
+            return false;
+        }
+        buffer_[b & mask_] = task;
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom_.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // 仅所有者调用
+    bool pop(Task* out) {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        if (t > b) {
+            // 队列为空
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        *out = buffer_[b & mask_];
+        if (t == b) {
+            // 最后一个元素，与窃取者竞争
+            bool won = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                                    std::memory_order_relaxed);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // 任意线程调用。读出的槽位可能正被所有者覆盖，但那种情况下top已经移动，CAS必然失败，拷贝被丢弃
+    bool steal(Task* out) {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t >= b) {
+            return false;
+        }
+        Task task;
+        memcpy(static_cast<void*>(&task), &buffer_[t & mask_], sizeof(Task));
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+            return false;
+        }
+        *out = task;
+        return true;
+    }
+
+    // 近似长度
+    size_t size() const {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+private:
+    alignas(64) std::atomic<int64_t> top_;
+    alignas(64) std::atomic<int64_t> bottom_;
+    alignas(64) size_t mask_;
+    Task* buffer_;
+};
+
+// 有界无锁多生产者多消费者队列（Vyukov），用于外部线程（Reactor）提交任务
+class InjectionQueue {
+public:
+    explicit InjectionQueue(size_t capacity = 65536)
+        : mask_(capacity - 1), cells_(new Cell[capacity]), enqueue_pos_(0), dequeue_pos_(0) {
+        for (size_t i = 0; i < capacity; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+    ~InjectionQueue() { delete[] cells_; }
+
+    InjectionQueue(const InjectionQueue&) = delete;
+    InjectionQueue& operator=(const InjectionQueue&) = delete;
+
+    // 队列满时返回false
+    bool push(const Task& task) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->task = task;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(Task* out) {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        *out = cell->task;
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 近似长度
+    size_t size() const {
+        size_t enq = enqueue_pos_.load(std::memory_order_relaxed);
+        size_t deq = dequeue_pos_.load(std::memory_order_relaxed);
+        return enq > deq ? enq - deq : 0;
+    }
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<size_t> sequence;
+        Task task;
+    };
+
+    size_t mask_;
+    Cell* cells_;
+    alignas(64) std::atomic<size_t> enqueue_pos_;
+    alignas(64) std::atomic<size_t> dequeue_pos_;
+};
+
+#endif // TASK_QUEUE_H
@@ -0,0 +1,76 @@
+#include "timer.h"
+#include "connection.h"
+
+const char* timeout_kind_name(TimeoutKind kind) {
+    switch (kind) {
+        case TIMEOUT_IDLE:
+            return "空闲";
+        case TIMEOUT_HEADER:
+            return "读请求头";
+        case TIMEOUT_BODY:
+            return "读请求体";
+        case TIMEOUT_WRITE:
+            return "写阻塞";
+        case TIMEOUT_UPSTREAM:
+            return "等待上游";
+    }
+    return "未知";
+}
+
+TimingWheel::TimingWheel(int64_t tick_ms, size_t slot_count)
+    : slots_(slot_count), tick_ms_(tick_ms), current_tick_(-1) {}
+
+void TimingWheel::add(Connection* conn, uint32_t generation, int64_t deadline_ms) {
+    int64_t tick = deadline_ms / tick_ms_;
+    if (current_tick_ >= 0 && tick < current_tick_) {
+        // 已经过去的截止时间放到下一个待处理的tick
+        tick = current_tick_;
+    }
+    if (conn->timer_tick.load(std::memory_order_relaxed) == tick) {
+        // 已经在这个tick上
+        return;
+    }
+    conn->timer_tick.store(tick, std::memory_order_relaxed);
+    Entry entry;
+    entry.conn = conn;
+    entry.generation = generation;
+    entry.tick = tick;
+    slots_[tick % slots_.size()].push_back(entry);
+}
+
+void TimingWheel::advance(int64_t now_ms, const std::function<void(Connection*, uint32_t)>& on_expire) {
+    int64_t now_tick = now_ms / tick_ms_;
+    if (current_tick_ < 0) {
+        current_tick_ = now_tick;
+    }
+    while (current_tick_ <= now_tick) {
+        std::vector<Entry>& slot = slots_[current_tick_ % slots_.size()];
+        expiring_.swap(slot);
+        ++current_tick_;
+        for (const Entry& entry : expiring_) {
+            Connection* conn = entry.conn;
+            if (conn->generation.load(std::memory_order_acquire) != entry.generation ||
+                conn->timer_tick.load(std::memory_order_relaxed) != entry.tick) {
+                // 连接已关闭，或条目已被截止时间更早的新条目取代
+                continue;
+            }
+            conn->timer_tick.store(-1, std::memory_order_relaxed);
+            int64_t deadline = conn->deadline_ms.load(std::memory_order_relaxed);
+            if (deadline > now_ms) {
+                // 截止时间已被推后（或超过了一圈），重新放入对应槽位
+                add(conn, entry.generation, deadline);
+            } else {
+                on_expire(conn, entry.generation);
+            }
+        }
+        expiring_.clear();
+    }
+}
+
+int TimingWheel::next_timeout(int64_t now_ms) const {
+    if (current_tick_ < 0) {
+        return static_cast<int>(tick_ms_);
+    }
+    int64_t next = current_tick_ * tick_ms_;
+    return next > now_ms ? static_cast<int>(next - now_ms) : 0;
+}
@@ -0,0 +1,63 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <vector>
+#include <functional>
+#include <stdint.h>
+#include <stddef.h>
+
+struct Connection;
+
+// 连接超时配置（毫秒）
+struct TimeoutConfig {
+    int64_t idle_ms;     // keep-alive 空闲：等待下一个请求的最长时间
+    int64_t header_ms;   // 从请求第一个字节（或连接建立）起读完整个请求头的时限，防止slow-loris
+    int64_t body_ms;     // 读请求体时两次收到数据之间的最长间隔
+    int64_t write_ms;    // 发送响应时对端不读取导致写阻塞的最长时间
+
+    TimeoutConfig() : idle_ms(60000), header_ms(10000), body_ms(30000), write_ms(30000) {}
+};
+
+// 连接当前所处的超时阶段
+enum TimeoutKind {
+    TIMEOUT_IDLE,
+    TIMEOUT_HEADER,
+    TIMEOUT_BODY,
+    TIMEOUT_WRITE,
+    TIMEOUT_UPSTREAM   // 等待上游（反向代理）：到期时唤醒连接，由转发自己判断超时，不关闭客户端连接
+};
+
+const char* timeout_kind_name(TimeoutKind kind);
+
+// 哈希时间轮，由所属Reactor线程独占使用。
+// 每个连接在轮上只有一个有效条目；工作线程推后截止时间时只修改连接上的原子变量，不移动条目，
+// 指针转到该槽位时再按新的截止时间重新放入（惰性调度）。每个tick只处理当前槽位，
+// 每个条目的处理是O(1)，不需要对全部连接排序或扫描。
+// 截止时间提前时（开始等待上游）重新 add，新条目取代旧条目（Connection::timer_tick），旧条目到期时丢弃
+class TimingWheel {
+public:
+    TimingWheel(int64_t tick_ms = 100, size_t slot_count = 512);
+
+    // 登记连接，截止时间到达时检查；取代该连接之前的条目
+    void add(Connection* conn, uint32_t generation, int64_t deadline_ms);
+
+    // 推进到 now_ms；已到期的连接交给回调处理，已关闭（代数不匹配）的条目直接丢弃
+    void advance(int64_t now_ms, const std::function<void(Connection*, uint32_t)>& on_expire);
+
+    // 距离下一个tick的毫秒数，用作epoll_wait的超时
+    int next_timeout(int64_t now_ms) const;
+
+private:
+    struct Entry {
+        Connection* conn;
+        uint32_t generation;
+        int64_t tick;
+    };
+
+    std::vector<std::vector<Entry>> slots_;
+    std::vector<Entry> expiring_;   // 当前槽位的条目，处理时复用，避免分配
+    int64_t tick_ms_;
+    int64_t current_tick_;          // 下一个待处理的tick
+};
+
+#endif // TIMER_H
@@ -0,0 +1,185 @@
+#include "upgrade.h"
+#include "logger.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+void block_upgrade_signal() {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR2);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+}
+
+void wait_upgrade_signal() {
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR2);
+    int signal_number = 0;
+    while (sigwait(&set, &signal_number) != 0 || signal_number != SIGUSR2) {
+    }
+}
+
+// 一条消息：4字节的数量 + SCM_RIGHTS 控制消息
+static bool send_fds(int channel, const std::vector<int>& fds) {
+    uint32_t count = static_cast<uint32_t>(fds.size());
+    struct iovec iov = { &count, sizeof(count) };
+    char control[CMSG_SPACE(sizeof(int) * MAX_INHERITED_LISTENERS)];
+    memset(control, 0, sizeof(control));
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * count);
+    return sendmsg(channel, &msg, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(count));
+}
+
+static bool recv_fds(int channel, std::vector<int>* fds) {
+    uint32_t count = 0;
+    struct iovec iov = { &count, sizeof(count) };
+    char control[CMSG_SPACE(sizeof(int) * MAX_INHERITED_LISTENERS)];
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n;
+    do {
+        n = recvmsg(channel, &msg, MSG_CMSG_CLOEXEC);
+    } while (n == -1 && errno == EINTR);
+    if (n != static_cast<ssize_t>(sizeof(count))) {
+        return false;
+    }
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        size_t received = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const unsigned char* data = CMSG_DATA(cmsg);
+        for (size_t i = 0; i < received; ++i) {
+            int fd;
+            memcpy(&fd, data + i * sizeof(int), sizeof(int));
+            fds->push_back(fd);
+        }
+    }
+    return fds->size() == count && !(msg.msg_flags & MSG_CTRUNC);
+}
+
+pid_t spawn_upgrade(const std::vector<std::string>& argv, const std::vector<int>& listen_fds) {
+    if (argv.empty() || listen_fds.empty() || listen_fds.size() > MAX_INHERITED_LISTENERS) {
+        LOG_ERROR("热升级：没有可用的命令行或监听套接字");
+        return -1;
+    }
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) == -1) {
+        LOG_ERROR("socketpair() 错误：" + std::string(strerror(errno)));
+        return -1;
+    }
+    // 新进程的一端不带 CLOEXEC，exec 后保留
+    int child_end = dup(pair[1]);
+    close(pair[1]);
+    if (child_end == -1) {
+        LOG_ERROR("dup() 错误：" + std::string(strerror(errno)));
+        close(pair[0]);
+        return -1;
+    }
+
+    // fork 之后子进程只能调用异步信号安全的函数，参数和环境变量提前准备好
+    std::string path = argv[0].find('/') != std::string::npos ? argv[0] : "/proc/self/exe";
+    std::vector<char*> args;
+    for (const std::string& arg : argv) {
+        args.push_back(const_cast<char*>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+    std::string channel_env = std::string(UPGRADE_ENV) + "=" + std::to_string(child_end);
+    std::vector<char*> env;
+    for (char** entry = environ; *entry != nullptr; ++entry) {
+        if (strncmp(*entry, UPGRADE_ENV "=", sizeof(UPGRADE_ENV)) != 0) {
+            env.push_back(*entry);
+        }
+    }
+    env.push_back(const_cast<char*>(channel_env.c_str()));
+    env.push_back(nullptr);
+    sigset_t empty;
+    sigemptyset(&empty);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // 新进程从空的信号屏蔽开始，由它自己的 main 重新屏蔽
+        pthread_sigmask(SIG_SETMASK, &empty, nullptr);
+        execve(path.c_str(), args.data(), env.data());
+        _exit(127);
+    }
+    close(child_end);
+    if (pid == -1) {
+        LOG_ERROR("fork() 错误：" + std::string(strerror(errno)));
+        close(pair[0]);
+        return -1;
+    }
+
+    // 交出监听套接字后等待新进程开始服务；它退出（exec失败、启动出错）时读到EOF
+    bool ready = false;
+    if (send_fds(pair[0], listen_fds)) {
+        struct pollfd pfd = { pair[0], POLLIN, 0 };
+        int n;
+        do {
+            n = poll(&pfd, 1, UPGRADE_READY_TIMEOUT_MS);
+        } while (n == -1 && errno == EINTR);
+        char byte;
+        ready = n == 1 && read(pair[0], &byte, 1) == 1;
+    }
+    close(pair[0]);
+    if (!ready) {
+        LOG_ERROR("热升级失败：新进程 " + std::to_string(pid) + " 未能就绪，继续由当前进程服务");
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+        return -1;
+    }
+    return pid;
+}
+
+int inherit_listeners(std::vector<int>* listen_fds) {
+    const char* value = getenv(UPGRADE_ENV);
+    if (value == nullptr) {
+        return -1;
+    }
+    int channel = atoi(value);
+    unsetenv(UPGRADE_ENV);
+    fcntl(channel, F_SETFD, FD_CLOEXEC);
+    if (!recv_fds(channel, listen_fds)) {
+        LOG_ERROR("热升级：接收监听套接字失败，重新创建");
+        for (int fd : *listen_fds) {
+            close(fd);
+        }
+        listen_fds->clear();
+        close(channel);
+        return -1;
+    }
+    return channel;
+}
+
+void notify_upgrade_ready(int channel) {
+    char byte = 1;
+    if (write(channel, &byte, 1) != 1) {
+        LOG_ERROR("热升级：通知旧进程失败：" + std::string(strerror(errno)));
+    }
+    close(channel);
+}
@@ -0,0 +1,38 @@
+#ifndef UPGRADE_H
+#define UPGRADE_H
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+// 热升级：运行中的进程收到 SIGUSR2 后 fork 并 exec 新的二进制（同样的命令行），
+// 通过 socketpair 用 SCM_RIGHTS 把监听套接字交给它。新进程开始服务后回复一个字节，
+// 旧进程随即停止 accept，在期限内处理完已有连接后退出。监听套接字始终有进程持有，
+// 升级期间新连接不会被拒绝（SO_REUSEPORT 组内排队的连接由新进程继续 accept）。
+
+// 新进程从该环境变量得到与旧进程通信的fd
+#define UPGRADE_ENV "TWS_UPGRADE_FD"
+// 一次最多交接的监听套接字数量
+#define MAX_INHERITED_LISTENERS 64
+// 等待新进程就绪的时限
+#define UPGRADE_READY_TIMEOUT_MS 10000
+// 旧进程等待已有连接处理完毕的默认时限
+#define DEFAULT_DRAIN_TIMEOUT_MS 30000
+
+// 屏蔽 SIGUSR2，由 wait_upgrade_signal 同步等待。须在创建任何线程之前调用，之后创建的线程都继承屏蔽
+void block_upgrade_signal();
+
+// 阻塞直到收到 SIGUSR2
+void wait_upgrade_signal();
+
+// 旧进程：启动新进程并交出 listen_fds，等待它就绪。成功返回新进程pid；
+// 失败（exec失败、新进程退出或超时）时回收新进程并返回-1，旧进程继续服务
+pid_t spawn_upgrade(const std::vector<std::string>& argv, const std::vector<int>& listen_fds);
+
+// 新进程：由热升级启动时取得继承的监听套接字，返回与旧进程通信的fd；普通启动返回-1
+int inherit_listeners(std::vector<int>* listen_fds);
+
+// 新进程：已开始服务，通知旧进程停止 accept
+void notify_upgrade_ready(int channel);
+
+#endif // UPGRADE_H
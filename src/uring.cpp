@@ -0,0 +1,239 @@
+#include "uring.h"
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* params) {
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                              const void* arg, size_t arg_size) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg,
+                                    arg_size));
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, const void* arg, unsigned nr_args) {
+    return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+IoUring::IoUring()
+    : ring_fd_(-1), features_(0), sq_ring_(MAP_FAILED), sq_ring_size_(0), sq_head_(nullptr),
+      sq_tail_(nullptr), sq_mask_(nullptr), sq_array_(nullptr), sqes_(nullptr), sqes_size_(0),
+      sq_entries_(0), sqe_tail_(0), sqe_submitted_(0), cq_ring_(MAP_FAILED), cq_ring_size_(0),
+      cq_head_(nullptr), cq_tail_(nullptr), cq_mask_(nullptr), cqes_(nullptr), buf_ring_(nullptr),
+      buf_ring_size_(0), buf_entries_(0), buf_tail_(0), buffers_(nullptr), buffer_size_(0) {
+    memset(supported_ops_, 0, sizeof(supported_ops_));
+}
+
+IoUring::~IoUring() {
+    if (buffers_ != nullptr) {
+        munmap(buffers_, buffer_size_ * buf_entries_);
+    }
+    if (buf_ring_ != nullptr) {
+        munmap(buf_ring_, buf_ring_size_);
+    }
+    if (sqes_ != nullptr) {
+        munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != MAP_FAILED) {
+        munmap(sq_ring_, sq_ring_size_);
+    }
+    if (ring_fd_ != -1) {
+        close(ring_fd_);
+    }
+}
+
+bool IoUring::init(unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    // 完成队列开大一些：多路 accept/recv 一次提交会产生多个完成事件
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = entries * 4;
+    ring_fd_ = sys_io_uring_setup(entries, &params);
+    if (ring_fd_ < 0) {
+        ring_fd_ = -1;
+        return false;
+    }
+    features_ = params.features;
+    sq_entries_ = params.sq_entries;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (features_ & IORING_FEAT_SINGLE_MMAP) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        return false;
+    }
+    if (features_ & IORING_FEAT_SINGLE_MMAP) {
+        cq_ring_ = sq_ring_;
+    } else {
+        cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+            return false;
+        }
+    }
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    char* cq = static_cast<char*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+    sqe_tail_ = sqe_submitted_ = *sq_tail_;
+
+    // 查询支持的操作码
+    size_t probe_size = sizeof(struct io_uring_probe) + IORING_OP_LAST * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = static_cast<struct io_uring_probe*>(calloc(1, probe_size));
+    if (probe != nullptr) {
+        if (sys_io_uring_register(ring_fd_, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == 0) {
+            for (unsigned i = 0; i < probe->ops_len && i < IORING_OP_LAST; ++i) {
+                supported_ops_[i] = (probe->ops[i].flags & IO_URING_OP_SUPPORTED) != 0;
+            }
+        }
+        free(probe);
+    }
+    return true;
+}
+
+bool IoUring::supports(uint8_t opcode) const {
+    return opcode < IORING_OP_LAST && supported_ops_[opcode] && (features_ & IORING_FEAT_EXT_ARG);
+}
+
+bool IoUring::register_files_sparse(unsigned count) {
+    struct io_uring_rsrc_register reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.nr = count;
+    reg.flags = IORING_RSRC_REGISTER_SPARSE;
+    return sys_io_uring_register(ring_fd_, IORING_REGISTER_FILES2, &reg, sizeof(reg)) == 0;
+}
+
+bool IoUring::register_buffer_ring(uint16_t group, unsigned entries, size_t buffer_size) {
+    buf_entries_ = entries;
+    buffer_size_ = buffer_size;
+    buf_ring_size_ = entries * sizeof(struct io_uring_buf);
+    void* ring = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) {
+        return false;
+    }
+    buf_ring_ = static_cast<struct io_uring_buf_ring*>(ring);
+    void* buffers = mmap(nullptr, buffer_size_ * entries, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffers == MAP_FAILED) {
+        return false;
+    }
+    buffers_ = static_cast<char*>(buffers);
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+    reg.ring_entries = entries;
+    reg.bgid = group;
+    if (sys_io_uring_register(ring_fd_, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        return false;
+    }
+    for (unsigned i = 0; i < entries; ++i) {
+        recycle_buffer(static_cast<uint16_t>(i));
+    }
+    publish_buffers();
+    return true;
+}
+
+void IoUring::recycle_buffer(uint16_t bid) {
+    // 不经过 bufs 成员访问：C++ 中内核头文件的空结构体占1字节，会让 bufs 的偏移错位
+    struct io_uring_buf* bufs = reinterpret_cast<struct io_uring_buf*>(buf_ring_);
+    struct io_uring_buf* buf = &bufs[buf_tail_ & (buf_entries_ - 1)];
+    buf->addr = reinterpret_cast<uint64_t>(buffer(bid));
+    buf->len = static_cast<uint32_t>(buffer_size_);
+    buf->bid = bid;
+    ++buf_tail_;
+}
+
+void IoUring::publish_buffers() {
+    __atomic_store_n(&buf_ring_->tail, buf_tail_, __ATOMIC_RELEASE);
+}
+
+struct io_uring_sqe* IoUring::get_sqe() {
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sqe_tail_ - head >= sq_entries_) {
+        submit(false, 0);
+        head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (sqe_tail_ - head >= sq_entries_) {
+            return nullptr;
+        }
+    }
+    unsigned index = sqe_tail_ & *sq_mask_;
+    struct io_uring_sqe* sqe = &sqes_[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    ++sqe_tail_;
+    return sqe;
+}
+
+int IoUring::submit(bool wait, int timeout_ms) {
+    unsigned to_submit = sqe_tail_ - sqe_submitted_;
+    if (to_submit > 0) {
+        __atomic_store_n(sq_tail_, sqe_tail_, __ATOMIC_RELEASE);
+        sqe_submitted_ = sqe_tail_;
+    }
+    if (to_submit == 0 && !wait) {
+        return 0;
+    }
+
+    unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    const void* arg_ptr = nullptr;
+    size_t arg_size = 0;
+    if (wait && timeout_ms >= 0) {
+        ts.tv_sec = timeout_ms / 1000;
+        ts.tv_nsec = static_cast<long long>(timeout_ms % 1000) * 1000000;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        flags |= IORING_ENTER_EXT_ARG;
+        arg_ptr = &arg;
+        arg_size = sizeof(arg);
+    }
+    int ret = sys_io_uring_enter(ring_fd_, to_submit, wait ? 1 : 0, flags, arg_ptr, arg_size);
+    return ret < 0 ? -errno : ret;
+}
+
+unsigned IoUring::copy_cqes(struct io_uring_cqe* out, unsigned max) {
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    unsigned count = 0;
+    while (head != tail && count < max) {
+        out[count++] = cqes_[head & *cq_mask_];
+        ++head;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+bool IoUring::cq_ready() const {
+    return *cq_head_ != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+}
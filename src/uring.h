@@ -0,0 +1,143 @@
+#ifndef URING_H
+#define URING_H
+
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+// 直接基于系统调用的精简 io_uring 封装（不依赖 liburing），由所属Reactor线程独占使用
+class IoUring {
+public:
+    IoUring();
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    // 创建环，失败（内核不支持、被禁用等）返回false，errno 保留原因
+    bool init(unsigned entries);
+
+    // 内核是否支持某个操作码
+    bool supports(uint8_t opcode) const;
+
+    // 注册 count 个空的固定文件槽位，之后用 IORING_OP_FILES_UPDATE 填入
+    bool register_files_sparse(unsigned count);
+
+    // 注册 entries 个大小为 buffer_size 的接收缓冲区（provided buffer ring），组号为 group
+    bool register_buffer_ring(uint16_t group, unsigned entries, size_t buffer_size);
+
+    char* buffer(uint16_t bid) const { return buffers_ + static_cast<size_t>(bid) * buffer_size_; }
+
+    // 归还接收缓冲区；归还的缓冲区在 publish_buffers 之后才对内核可见
+    void recycle_buffer(uint16_t bid);
+    void publish_buffers();
+
+    // 取一个空闲的SQE（已清零），提交队列满时先提交已有的SQE
+    struct io_uring_sqe* get_sqe();
+
+    // 提交所有待提交的SQE；wait 为真时至少等待一个完成事件，最多等待 timeout_ms（-1为不限）。
+    // 返回提交的数量，出错返回 -errno（超时返回 -ETIME）
+    int submit(bool wait, int timeout_ms);
+
+    // 取出最多 max 个完成事件并推进完成队列头部
+    unsigned copy_cqes(struct io_uring_cqe* out, unsigned max);
+
+    // 完成队列中是否有未取出的事件
+    bool cq_ready() const;
+
+    int fd() const { return ring_fd_; }
+
+private:
+    int ring_fd_;
+    unsigned features_;
+
+    // 提交队列
+    void* sq_ring_;
+    size_t sq_ring_size_;
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned* sq_mask_;
+    unsigned* sq_array_;
+    struct io_uring_sqe* sqes_;
+    size_t sqes_size_;
+    unsigned sq_entries_;
+    unsigned sqe_tail_;      // 本地已填写但尚未发布的SQE位置
+    unsigned sqe_submitted_; // 已发布给内核的SQE位置
+
+    // 完成队列
+    void* cq_ring_;
+    size_t cq_ring_size_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned* cq_mask_;
+    struct io_uring_cqe* cqes_;
+
+    // 支持的操作码
+    uint8_t supported_ops_[IORING_OP_LAST];
+
+    // 接收缓冲区环
+    struct io_uring_buf_ring* buf_ring_;
+    size_t buf_ring_size_;
+    unsigned buf_entries_;
+    uint16_t buf_tail_;
+    char* buffers_;
+    size_t buffer_size_;
+};
+
+inline void uring_prep_accept_multishot(struct io_uring_sqe* sqe, int fd, bool fixed,
+                                        uint32_t accept_flags, uint64_t user_data) {
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->flags = fixed ? IOSQE_FIXED_FILE : 0;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = accept_flags;
+    sqe->user_data = user_data;
+}
+
+inline void uring_prep_recv_multishot(struct io_uring_sqe* sqe, int fd, bool fixed,
+                                      uint16_t buffer_group, uint64_t user_data) {
+    sqe->opcode = IORING_OP_RECV;
+    sqe->flags = IOSQE_BUFFER_SELECT | (fixed ? IOSQE_FIXED_FILE : 0);
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->buf_group = buffer_group;
+    sqe->user_data = user_data;
+}
+
+inline void uring_prep_files_update(struct io_uring_sqe* sqe, int* fds, unsigned count,
+                                    unsigned offset, uint64_t user_data) {
+    sqe->opcode = IORING_OP_FILES_UPDATE;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<uint64_t>(fds);
+    sqe->len = count;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+}
+
+inline void uring_prep_poll(struct io_uring_sqe* sqe, int fd, bool fixed, uint32_t events,
+                            uint64_t user_data) {
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->flags = fixed ? IOSQE_FIXED_FILE : 0;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->user_data = user_data;
+}
+
+inline void uring_prep_read(struct io_uring_sqe* sqe, int fd, void* buf, unsigned len,
+                            uint64_t user_data) {
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buf);
+    sqe->len = len;
+    sqe->off = static_cast<uint64_t>(-1);   // 使用并推进文件当前偏移（eventfd 忽略）
+    sqe->user_data = user_data;
+}
+
+inline void uring_prep_close(struct io_uring_sqe* sqe, int fd, uint64_t user_data) {
+    sqe->opcode = IORING_OP_CLOSE;
+    sqe->fd = fd;
+    sqe->user_data = user_data;
+}
+
+#endif // URING_H
@@ -2,6 +2,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <time.h>
+#include <algorithm>
 
 void set_nonblocking(int fd) {
     int flags = fcntl(fd, F_GETFL, 0);
@@ -15,3 +17,44 @@ void set_nonblocking(int fd) {
         exit(EXIT_FAILURE);
     }
 }
+
+int64_t current_time_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+int64_t current_time_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+bool ends_with(const std::string& value, const std::string& ending) {
+    if (ending.size() > value.size()) return false;
+    return std::equal(ending.rbegin(), ending.rend(), value.rbegin());
+}
+
+std::string get_content_type(const std::string& file_path) {
+    if (ends_with(file_path, ".html") || ends_with(file_path, ".htm")) {
+        return "text/html";
+    } else if (ends_with(file_path, ".css")) {
+        return "text/css";
+    } else if (ends_with(file_path, ".js")) {
+        return "application/javascript";
+    } else if (ends_with(file_path, ".png")) {
+        return "image/png";
+    } else if (ends_with(file_path, ".jpg") || ends_with(file_path, ".jpeg")) {
+        return "image/jpeg";
+    } else if (ends_with(file_path, ".gif")) {
+        return "image/gif";
+    } else if (ends_with(file_path, ".svg")) {
+        return "image/svg+xml";
+    } else if (ends_with(file_path, ".json")) {
+        return "application/json";
+    } else if (ends_with(file_path, ".txt")) {
+        return "text/plain";
+    } else {
+        return "application/octet-stream";
+    }
+}
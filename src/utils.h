@@ -2,7 +2,19 @@
 #define UTILS_H
 
 #include <fcntl.h>
+#include <stdint.h>
+#include <string>
 
 void set_nonblocking(int fd);
 
+// 单调时钟的当前时间（毫秒）
+int64_t current_time_ms();
+// 单调时钟的当前时间（纳秒），用于测量耗时
+int64_t current_time_ns();
+
+bool ends_with(const std::string& value, const std::string& ending);
+
+// 根据文件扩展名确定Content-Type
+std::string get_content_type(const std::string& file_path);
+
 #endif // UTILS_H
@@ -0,0 +1,132 @@
+// 二进制日志解码：把 server.binlog 还原为与文本日志相同的格式
+// 用法：./logdecode [server.binlog] > server.log，多个文件可以用 cat 拼接后解码
+#include "logger.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    const char* path = argc >= 2 ? argv[1] : "server.binlog";
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        fprintf(stderr, "无法打开 %s\n", path);
+        return 1;
+    }
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    size_t file_header = LOG_BINARY_MAGIC_LEN + sizeof(uint64_t);
+    if (data.size() < file_header || data.compare(0, LOG_BINARY_MAGIC_LEN, LOG_BINARY_MAGIC) != 0) {
+        fprintf(stderr, "%s 不是二进制日志文件\n", path);
+        return 1;
+    }
+    uint64_t tsc_hz;
+    memcpy(&tsc_hz, data.data() + LOG_BINARY_MAGIC_LEN, sizeof(tsc_hz));
+    if (tsc_hz == 0) {
+        tsc_hz = 1000000000ull;
+    }
+
+    std::vector<std::string_view> formats;
+    std::vector<LogArg> args;
+    // 各线程的缓冲区是分批写出的，按时间戳稳定排序后再输出
+    std::vector<std::pair<int64_t, std::string>> lines;
+    uint64_t sync_tsc = 0;
+    int64_t sync_ns = 0;
+    size_t pos = file_header;
+
+    while (pos + sizeof(LogRecordHeader) <= data.size()) {
+        // 多个文件拼接（或旧版本追加写入）时出现新的文件头：格式编号和TSC频率属于新的进程
+        if (data.compare(pos, LOG_BINARY_MAGIC_LEN, LOG_BINARY_MAGIC) == 0 &&
+            pos + file_header <= data.size()) {
+            memcpy(&tsc_hz, data.data() + pos + LOG_BINARY_MAGIC_LEN, sizeof(tsc_hz));
+            if (tsc_hz == 0) {
+                tsc_hz = 1000000000ull;
+            }
+            formats.clear();
+            sync_tsc = 0;
+            sync_ns = 0;
+            pos += file_header;
+            continue;
+        }
+        LogRecordHeader header;
+        memcpy(&header, data.data() + pos, sizeof(header));
+        const char* body = data.data() + pos + sizeof(header);
+        size_t body_len = header.length;
+        if (header.type == LOG_RECORD_SYNC || header.type == LOG_RECORD_EVENT) {
+            body_len = header.type == LOG_RECORD_SYNC ? 16 : header.length + sizeof(uint64_t);
+        }
+        if (pos + sizeof(header) + body_len > data.size()) {
+            fprintf(stderr, "日志在偏移 %zu 处被截断\n", pos);
+            break;
+        }
+        pos += sizeof(header) + body_len;
+
+        if (header.type == LOG_RECORD_FORMAT) {
+            if (formats.size() <= header.id) {
+                formats.resize(header.id + 1);
+            }
+            formats[header.id] = std::string_view(body, header.length);
+        } else if (header.type == LOG_RECORD_SYNC) {
+            memcpy(&sync_tsc, body, sizeof(sync_tsc));
+            memcpy(&sync_ns, body + sizeof(sync_tsc), sizeof(sync_ns));
+        } else if (header.type == LOG_RECORD_EVENT) {
+            uint64_t tsc;
+            memcpy(&tsc, body, sizeof(tsc));
+            const char* p = body + sizeof(tsc);
+            const char* end = p + header.length;
+            args.clear();
+            while (p < end) {
+                LogArg arg;
+                arg.type = *p++;
+                if (arg.type == 's') {
+                    uint16_t len;
+                    memcpy(&len, p, sizeof(len));
+                    arg.str = p + sizeof(len);
+                    arg.len = len;
+                    p += sizeof(len) + len;
+                } else {
+                    memcpy(arg.type == 'i' ? static_cast<void*>(&arg.i)
+                           : arg.type == 'u' ? static_cast<void*>(&arg.u)
+                                             : static_cast<void*>(&arg.d),
+                           p, 8);
+                    p += 8;
+                }
+                args.push_back(arg);
+            }
+
+            // 以最近的同步点为基准换算时间（事件可能早于同步点，差值按有符号计算）
+            int64_t delta_ns = static_cast<int64_t>(
+                static_cast<double>(static_cast<int64_t>(tsc - sync_tsc)) * 1e9 / tsc_hz);
+            int64_t event_ns = sync_ns + delta_ns;
+            time_t seconds = static_cast<time_t>(event_ns / 1000000000ll);
+            struct tm tm_event;
+            localtime_r(&seconds, &tm_event);
+            char time_text[32];
+            strftime(time_text, sizeof(time_text), "[%Y-%m-%d %H:%M:%S] ", &tm_event);
+
+            std::string message;
+            if (header.id < formats.size() && formats[header.id].data() != nullptr) {
+                message = format_log_message(formats[header.id], args.data(), args.size());
+            } else {
+                message = "<未知格式 " + std::to_string(header.id) + ">";
+            }
+            LogLevel level = header.level <= ERROR ? static_cast<LogLevel>(header.level) : ERROR;
+            lines.emplace_back(event_ns, std::string(time_text) + log_level_tag(level) + message + "\n");
+        } else {
+            fprintf(stderr, "偏移 %zu 处出现未知记录类型\n", pos);
+            break;
+        }
+    }
+
+    std::stable_sort(lines.begin(), lines.end(),
+                     [](const std::pair<int64_t, std::string>& a,
+                        const std::pair<int64_t, std::string>& b) { return a.first < b.first; });
+    for (const auto& line : lines) {
+        fwrite(line.second.data(), 1, line.second.size(), stdout);
+    }
+    return 0;
+}